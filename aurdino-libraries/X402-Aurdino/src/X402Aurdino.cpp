@@ -2,6 +2,8 @@
 #include "httputils.h"
 #include "paymentutils.h"
 #include "stackmonitor.h"
+#include "jsonscanner.h"
+#include "facilitatorconnection.h"
 
 // PaymentPayload constructor - automatically parses JSON string correctly
 PaymentPayload::PaymentPayload(const String& paymentJsonStr) {
@@ -18,19 +20,154 @@ PaymentPayload::PaymentPayload(const String& paymentJsonStr) {
     payloadJson = paymentJsonStr;
 }
 
-AssetInfo getAssetForNetwork(const String &network)
+// Sorted by name (checked at compile time below) for binary search
+constexpr EvmNetworkInfo EvmNetworks[] PROGMEM = {
+    {"avalanche", 43114, {"0xB97EF9Ef8734C71904D8002F8b6Bc66Dd9c48a6E", "USD Coin"}},
+    {"avalanche-fuji", 43113, {"0x5425890298aed601595a70AB815c96711a31Bc65", "USD Coin"}},
+    {"base", 8453, {"0x833589fCD6eDb6E08f4c7C32D4f71b54bdA02913", "USD Coin"}},
+    {"base-sepolia", 84532, {"0x036CbD53842c5426634e7929541eC2318f3dCF7e", "USDC"}},
+    {"iotex", 4689, {"0xcdf79194c6c285077a58da47641d4dbe51f63542", "Bridged USDC"}},
+    {"peaq", 3338, {"0xbbA60da06c2c5424f03f7434542280FCAd453d10", "USDC"}},
+    {"polygon", 137, {"0x3c499c542cef5e3811e1192ce70d8cc03d5c3359", "USD Coin"}},
+    {"polygon-amoy", 80002, {"0x41E94Eb019C0762f9Bfcf9Fb1E58725BfB0e7582", "USDC"}},
+    {"sei", 1329, {"0xe15fc38f6d8c56af07bbcbe3baf5708a2bf42392", "USDC"}},
+    {"sei-testnet", 1328, {"0x4fcf1784b31630811181f670aea7a7bef803eaed", "USDC"}},
+};
+constexpr size_t EvmNetworkCount = sizeof(EvmNetworks) / sizeof(EvmNetworks[0]);
+
+static constexpr int constexprStrcmp(const char *a, const char *b)
+{
+    return (*a != *b || *a == '\0') ? (unsigned char)*a - (unsigned char)*b : constexprStrcmp(a + 1, b + 1);
+}
+
+static constexpr bool networksSorted(size_t i = 1)
+{
+    return i >= EvmNetworkCount ||
+           (constexprStrcmp(EvmNetworks[i - 1].name, EvmNetworks[i].name) < 0 && networksSorted(i + 1));
+}
+static_assert(networksSorted(), "EvmNetworks must be sorted by name");
+
+// Runtime-registered networks (own copies of the strings)
+struct CustomEvmNetwork
+{
+    char name[32];
+    char usdcAddress[43];
+    char usdcName[32];
+    EvmNetworkInfo info;
+};
+static CustomEvmNetwork customNetworks[X402_MAX_CUSTOM_NETWORKS];
+static size_t customNetworkCount = 0;
+
+static bool copyField(char *dst, size_t size, const char *src)
 {
-    // Check if the network exists in our mapping
-    auto it = EvmNetworkToChainId.find(network);
-    if (it != EvmNetworkToChainId.end())
+    size_t len = src ? strlen(src) : 0;
+    if (len >= size)
+        return false;
+    memcpy(dst, src ? src : "", len + 1);
+    return true;
+}
+
+bool registerEvmNetwork(const char *name, uint32_t chainId, const char *usdcAddress, const char *usdcName)
+{
+    if (!name || *name == '\0')
+        return false;
+
+    // Re-registering a runtime network replaces it
+    CustomEvmNetwork *entry = nullptr;
+    for (size_t i = 0; i < customNetworkCount; ++i)
     {
-        uint32_t chainId = it->second;
-        auto assetIt = EvmUSDC.find(chainId);
-        if (assetIt != EvmUSDC.end())
+        if (strcmp(customNetworks[i].name, name) == 0)
         {
-            return assetIt->second;
+            entry = &customNetworks[i];
+            break;
         }
     }
+    if (!entry)
+    {
+        if (customNetworkCount >= X402_MAX_CUSTOM_NETWORKS)
+            return false;
+        entry = &customNetworks[customNetworkCount];
+    }
+
+    CustomEvmNetwork candidate;
+    if (!copyField(candidate.name, sizeof(candidate.name), name) ||
+        !copyField(candidate.usdcAddress, sizeof(candidate.usdcAddress), usdcAddress) ||
+        !copyField(candidate.usdcName, sizeof(candidate.usdcName), usdcName))
+    {
+        return false;
+    }
+
+    *entry = candidate;
+    entry->info.name = entry->name;
+    entry->info.chainId = chainId;
+    entry->info.usdc.usdcAddress = entry->usdcAddress;
+    entry->info.usdc.usdcName = entry->usdcName;
+    if (entry == &customNetworks[customNetworkCount])
+    {
+        customNetworkCount++;
+    }
+    return true;
+}
+
+const EvmNetworkInfo *findEvmNetwork(const char *name)
+{
+    if (!name)
+        return nullptr;
+
+    for (size_t i = 0; i < customNetworkCount; ++i)
+    {
+        if (strcmp(customNetworks[i].name, name) == 0)
+            return &customNetworks[i].info;
+    }
+
+    // Binary search over the sorted built-in table
+    size_t lo = 0;
+    size_t hi = EvmNetworkCount;
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        int cmp = strcmp(name, EvmNetworks[mid].name);
+        if (cmp == 0)
+            return &EvmNetworks[mid];
+        if (cmp < 0)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return nullptr;
+}
+
+const EvmNetworkInfo *findEvmNetworkByChainId(uint32_t chainId)
+{
+    for (size_t i = 0; i < customNetworkCount; ++i)
+    {
+        if (customNetworks[i].info.chainId == chainId)
+            return &customNetworks[i].info;
+    }
+
+    // Ten entries - a linear scan beats a second index
+    for (size_t i = 0; i < EvmNetworkCount; ++i)
+    {
+        if (EvmNetworks[i].chainId == chainId)
+            return &EvmNetworks[i];
+    }
+    return nullptr;
+}
+
+uint32_t getChainIdForNetwork(const String &network)
+{
+    const EvmNetworkInfo *info = findEvmNetwork(network.c_str());
+    return info ? info->chainId : 0;
+}
+
+AssetInfo getAssetForNetwork(const String &network)
+{
+    // Single lookup: name -> network entry (which carries its USDC asset)
+    const EvmNetworkInfo *info = findEvmNetwork(network.c_str());
+    if (info)
+    {
+        return info->usdc;
+    }
 
     // Return empty AssetInfo if network not found
     AssetInfo empty = {"", ""};
@@ -89,64 +226,86 @@ String buildDefaultPaymentRementsJson(const String network, const String payTo,
     return result;
 }
 
-bool verifyPayment(const PaymentPayload &decodedSignedPayload, const String &paymentRequirements, const String &customHeaders)
+void PaymentRequirementsTemplate::build(const String &network, const String &payTo, const String &resource, const String &description)
+{
+    // Render once with an empty price and split at the price slot
+    String full = buildDefaultPaymentRementsJson(network, payTo, "", resource, description);
+
+    static const char *slotKey = "\"maxAmountRequired\":\"";
+    int slot = full.indexOf(slotKey);
+    if (slot < 0)
+    {
+        clear();
+        return;
+    }
+    slot += strlen(slotKey);
+
+    prefix_ = full.substring(0, slot);
+    suffix_ = full.substring(slot);
+    full = "";  // Free memory
+}
+
+void PaymentRequirementsTemplate::clear()
+{
+    prefix_ = String();
+    suffix_ = String();
+}
+
+String PaymentRequirementsTemplate::render(const String &maxAmountRequired) const
+{
+    String json;
+    json.reserve(prefix_.length() + maxAmountRequired.length() + suffix_.length());
+    json = prefix_;
+    json += maxAmountRequired;
+    json += suffix_;
+    return json;
+}
+
+bool verifyPayment(const PaymentPayload &decodedSignedPayload, const String &paymentRequirements, const String &customHeaders, FacilitatorConnection *connection)
 {
     STACK_CHECKPOINT("verifyPayment:start");
     
-    // Make API call using utility function
-    HttpResponse response = makePaymentApiCall("verify", decodedSignedPayload, paymentRequirements, customHeaders);
+    // Stream the response through the scanner - the body is never buffered
+    static const char *const keys[] = {"isValid", "invalidReason"};
+    JsonCapture fields(keys, 2, 128);
+    HttpResponse response = makePaymentApiCall("verify", decodedSignedPayload, paymentRequirements, fields, customHeaders, connection);
     STACK_CHECKPOINT("verifyPayment:after_api_call");
     
     if (response.success && response.statusCode > 0) {
-        // Parse response manually
-        String isValidStr = extractJsonValue(response.body, "isValid");
-        bool isValid = (isValidStr == "true");
+        bool isValid = fields.isTrue(0);
         
-        // Free memory immediately after use
-        isValidStr = "";
-        
-        STACK_CHECKPOINT("verifyPayment:after_parse");
-        
-        if (!isValid) {
-            String invalidReason = extractJsonValue(response.body, "invalidReason");
-            if (invalidReason.length() > 0) {
-                Serial.print("ERROR: Payment verification failed - ");
-                Serial.println(invalidReason);
-            }
-            invalidReason = "";  // Free memory
+        if (!isValid && fields.type(1) == JSON_STRING && fields.value(1).length() > 0) {
+            Serial.print("ERROR: Payment verification failed - ");
+            Serial.println(fields.value(1));
         }
         
-        // Clear response body to free memory
-        response.body = "";
-        
         STACK_CHECKPOINT("verifyPayment:end");
         return isValid;
     }
     
     Serial.print("ERROR: HTTP request failed - Code: ");
     Serial.println(response.statusCode);
-    response.body = "";  // Free memory
     
     STACK_CHECKPOINT("verifyPayment:end_error");
     return false;
 }
 
 // Overloaded verifyPayment that accepts raw JSON strings
-bool verifyPayment(const String &paymentPayloadJson, const String &paymentRequirements, const String &customHeaders)
+bool verifyPayment(const String &paymentPayloadJson, const String &paymentRequirements, const String &customHeaders, FacilitatorConnection *connection)
 {
     // Parse the payment JSON string into PaymentPayload struct
     PaymentPayload payload = parsePaymentString(paymentPayloadJson);
     
     // Call the main verifyPayment function
-    return verifyPayment(payload, paymentRequirements, customHeaders);
+    return verifyPayment(payload, paymentRequirements, customHeaders, connection);
 }
 
-String settlePayment(const PaymentPayload &decodedSignedPayload, const String &paymentRequirements, const String &customHeaders)
+String settlePayment(const PaymentPayload &decodedSignedPayload, const String &paymentRequirements, const String &customHeaders, FacilitatorConnection *connection)
 {
     STACK_CHECKPOINT("settlePayment:start");
     
     // Make API call using utility function
-    HttpResponse response = makePaymentApiCall("settle", decodedSignedPayload, paymentRequirements, customHeaders);
+    HttpResponse response = makePaymentApiCall("settle", decodedSignedPayload, paymentRequirements, customHeaders, connection);
     
     STACK_CHECKPOINT("settlePayment:after_api_call");
     Serial.println("Settlement response : " + String(response.body));
@@ -172,3 +331,67 @@ String settlePayment(const PaymentPayload &decodedSignedPayload, const String &p
         return "";
     }
 }
+
+bool settlePayment(const PaymentPayload &decodedSignedPayload, const String &paymentRequirements, SettlementResult &result, const String &customHeaders, FacilitatorConnection *connection)
+{
+    STACK_CHECKPOINT("settlePayment:stream:start");
+    
+    // Only these fields are kept; the rest of the body is parsed and dropped
+    static const char *const keys[] = {"success", "transaction", "payer", "network", "errorReason"};
+    JsonCapture fields(keys, 5, 128);
+    HttpResponse response = makePaymentApiCall("settle", decodedSignedPayload, paymentRequirements, fields, customHeaders, connection);
+    
+    result.statusCode = response.statusCode;
+    result.success = response.success && response.statusCode == 200 && fields.isTrue(0);
+    result.transaction = fields.takeString(1);
+    result.payer = fields.takeString(2);
+    result.network = fields.takeString(3);
+    result.errorReason = fields.takeString(4);
+    
+    if (!result.success) {
+        Serial.print("ERROR: Settlement failed - Code: ");
+        Serial.println(response.statusCode);
+        if (result.errorReason.length() > 0) {
+            Serial.print("ERROR: ");
+            Serial.println(result.errorReason);
+        }
+    }
+    
+    STACK_CHECKPOINT("settlePayment:stream:end");
+    return result.success;
+}
+
+size_t settlePaymentBatch(SettlementBatchItem *items, size_t count, const String &customHeaders, FacilitatorConnection *connection)
+{
+    FacilitatorConnection &conn = connection ? *connection : FacilitatorConnection::shared();
+    size_t settled = 0;
+    bool reachable = true;
+    bool reconnected = false;
+
+    conn.hold();
+    for (size_t i = 0; i < count; ++i)
+    {
+        SettlementBatchItem &item = items[i];
+        item.result = SettlementResult();
+        item.sent = false;
+        if (!reachable || !item.payment || !item.paymentRequirements)
+            continue;
+
+        if (settlePayment(*item.payment, *item.paymentRequirements, item.result, customHeaders, &conn))
+            settled++;
+        item.sent = !FacilitatorConnection::isUnsentError(item.result.statusCode);
+
+        // No response at all: a dropped socket gets one fresh connection; if
+        // that fails too the rest would only wait out the same timeout
+        if (item.result.statusCode <= 0)
+        {
+            if (reconnected)
+                reachable = false;
+            reconnected = true;
+            conn.close();
+        }
+    }
+    conn.release();
+
+    return settled;
+}
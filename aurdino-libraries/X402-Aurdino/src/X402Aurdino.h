@@ -2,11 +2,13 @@
 #define X402AURDINO_H
 
 #include <Arduino.h>
-#include <map>
 #include <string>
 
-// Use canonical host with www to avoid HTTP 308 redirects
-static const char *DEFAULT_FACILITATOR_URL = "https://www.x402.org/facilitator";
+// Use canonical host with www to avoid HTTP 308 redirects.
+// Used until facilitators are added to FacilitatorRegistry.
+static const char *const DEFAULT_FACILITATOR_URL = "https://www.x402.org/facilitator";
+
+class FacilitatorConnection;
 
 struct AssetInfo
 {
@@ -41,31 +43,34 @@ struct PaymentPayload
     PaymentPayload(const String& paymentJsonStr);
 };
 
-const std::map<String, uint32_t> EvmNetworkToChainId = {
-    {"base-sepolia", 84532},
-    {"base", 8453},
-    {"avalanche-fuji", 43113},
-    {"avalanche", 43114},
-    {"iotex", 4689},
-    {"sei", 1329},
-    {"sei-testnet", 1328},
-    {"polygon", 137},
-    {"polygon-amoy", 80002},
-    {"peaq", 3338},
+// Network/USDC metadata for one EVM chain
+struct EvmNetworkInfo
+{
+    const char *name;
+    uint32_t chainId;
+    AssetInfo usdc;
 };
 
-const std::map<uint32_t, AssetInfo> EvmUSDC = {
-    {84532, {"0x036CbD53842c5426634e7929541eC2318f3dCF7e", "USDC"}},
-    {8453, {"0x833589fCD6eDb6E08f4c7C32D4f71b54bdA02913", "USD Coin"}},
-    {43113, {"0x5425890298aed601595a70AB815c96711a31Bc65", "USD Coin"}},
-    {43114, {"0xB97EF9Ef8734C71904D8002F8b6Bc66Dd9c48a6E", "USD Coin"}},
-    {4689, {"0xcdf79194c6c285077a58da47641d4dbe51f63542", "Bridged USDC"}},
-    {1328, {"0x4fcf1784b31630811181f670aea7a7bef803eaed", "USDC"}},
-    {1329, {"0xe15fc38f6d8c56af07bbcbe3baf5708a2bf42392", "USDC"}},
-    {137, {"0x3c499c542cef5e3811e1192ce70d8cc03d5c3359", "USD Coin"}},
-    {80002, {"0x41E94Eb019C0762f9Bfcf9Fb1E58725BfB0e7582", "USDC"}},
-    {3338, {"0xbbA60da06c2c5424f03f7434542280FCAd453d10", "USDC"}},
-};
+// Built-in networks: a constexpr table sorted by name, defined once in
+// X402Aurdino.cpp so it lives in flash (.rodata) with no static-init cost
+extern const EvmNetworkInfo EvmNetworks[];
+extern const size_t EvmNetworkCount;
+
+// Extra networks that can be registered at runtime
+#ifndef X402_MAX_CUSTOM_NETWORKS
+#define X402_MAX_CUSTOM_NETWORKS 4
+#endif
+
+// Register (or override) a network at runtime; strings are copied.
+// Returns false if the table is full or a field is too long.
+bool registerEvmNetwork(const char *name, uint32_t chainId, const char *usdcAddress, const char *usdcName);
+
+// Lookup by network name or chain ID (runtime entries first); nullptr if unknown
+const EvmNetworkInfo *findEvmNetwork(const char *name);
+const EvmNetworkInfo *findEvmNetworkByChainId(uint32_t chainId);
+
+// Chain ID for a network name, 0 if unknown
+uint32_t getChainIdForNetwork(const String &network);
 
 AssetInfo getAssetForNetwork(const String &network);
 
@@ -73,12 +78,65 @@ String buildRequirementsJson(const String &network, const String &payTo, const S
 
 String buildDefaultPaymentRementsJson(const String network, const String payTo, const String maxAmountRequired, const String resource, const String description = "");
 
+// Payment requirements JSON pre-rendered once and split around maxAmountRequired,
+// the only field that changes between payments. render() output is identical to
+// buildDefaultPaymentRementsJson() for the same arguments.
+class PaymentRequirementsTemplate
+{
+public:
+    void build(const String &network, const String &payTo, const String &resource, const String &description = "");
+    void clear();
+    bool isBuilt() const { return prefix_.length() > 0; }
+
+    // Requirements for the given price - a single sized allocation
+    String render(const String &maxAmountRequired) const;
+
+private:
+    String prefix_; // ... "maxAmountRequired":"
+    String suffix_; // ","resource": ... }
+};
+
+// Verify and settle go through a kept-alive facilitator connection.
+// Pass nullptr to use FacilitatorConnection::shared().
+
 // Verify payment using PaymentPayload struct
-bool verifyPayment(const PaymentPayload &decodedSignedPayload, const String &paymentRequirements, const String &customHeaders = "");
+bool verifyPayment(const PaymentPayload &decodedSignedPayload, const String &paymentRequirements, const String &customHeaders = "", FacilitatorConnection *connection = nullptr);
 
 // Verify payment using raw JSON strings (convenience method)
-bool verifyPayment(const String &paymentPayloadJson, const String &paymentRequirements, const String &customHeaders = "");
+bool verifyPayment(const String &paymentPayloadJson, const String &paymentRequirements, const String &customHeaders = "", FacilitatorConnection *connection = nullptr);
+
+String settlePayment(const PaymentPayload &decodedSignedPayload, const String &paymentRequirements, const String &customHeaders = "", FacilitatorConnection *connection = nullptr);
+
+// Fields of a facilitator /settle response
+struct SettlementResult
+{
+    bool success = false;
+    int statusCode = 0;
+    String transaction;
+    String payer;
+    String network;
+    String errorReason;
+};
+
+// Settle payment, streaming the response straight into result (no body buffer).
+// Returns result.success.
+bool settlePayment(const PaymentPayload &decodedSignedPayload, const String &paymentRequirements, SettlementResult &result, const String &customHeaders = "", FacilitatorConnection *connection = nullptr);
+
+// One payment of a settlement batch; result is filled in by settlePaymentBatch()
+struct SettlementBatchItem
+{
+    const PaymentPayload *payment = nullptr;
+    const String *paymentRequirements = nullptr;
+    SettlementResult result;
+    bool sent = false; // false: never reached the facilitator, safe to settle again
+};
 
-String settlePayment(const PaymentPayload &decodedSignedPayload, const String &paymentRequirements, const String &customHeaders = "");
+// Settle several payments back to back on one kept-alive connection, held for
+// the whole batch, so it costs at most one TLS handshake. The facilitator API
+// settles one authorization per request; each item gets its own result. After
+// a connection-level failure the next item gets one fresh connection; if that
+// fails as well the rest is not attempted (sent stays false, statusCode 0).
+// Returns how many settled.
+size_t settlePaymentBatch(SettlementBatchItem *items, size_t count, const String &customHeaders = "", FacilitatorConnection *connection = nullptr);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,325 @@
+#include "facilitatorconnection.h"
+#include "X402Aurdino.h"
+#include "stackmonitor.h"
+#include "jsonscanner.h"
+#include <utility>
+
+// Errors that indicate the server closed a kept-alive socket under us.
+// The last two can also happen after the request went out.
+static bool isStaleConnectionError(int code)
+{
+    return FacilitatorConnection::isUnsentError(code) ||
+           code == HTTPC_ERROR_CONNECTION_LOST ||
+           code == HTTPC_ERROR_NO_HTTP_SERVER;
+}
+
+bool FacilitatorConnection::isUnsentError(int code)
+{
+    return code == HTTPC_ERROR_CONNECTION_REFUSED ||
+           code == HTTPC_ERROR_SEND_HEADER_FAILED ||
+           code == HTTPC_ERROR_SEND_PAYLOAD_FAILED ||
+           code == HTTPC_ERROR_NOT_CONNECTED;
+}
+
+// Redirects a POST may follow with its body: 303 would turn it into a GET
+static bool isMethodKeepingRedirect(int code)
+{
+    return code == HTTP_CODE_MOVED_PERMANENTLY || code == HTTP_CODE_FOUND ||
+           code == HTTP_CODE_TEMPORARY_REDIRECT || code == HTTP_CODE_PERMANENT_REDIRECT;
+}
+
+// Absolute URL for a Location header sent in reply to url; "" if unusable
+static String resolveLocation(const String &url, const String &location)
+{
+    if (location.startsWith("https://") || location.startsWith("http://"))
+        return location;
+    if (!location.startsWith("/"))
+        return String();
+
+    // Same origin: scheme://host[:port] of the request
+    int hostStart = url.indexOf("://");
+    int pathStart = hostStart < 0 ? -1 : url.indexOf('/', hostStart + 3);
+    String resolved = pathStart < 0 ? url : url.substring(0, pathStart);
+    resolved += location;
+    return resolved;
+}
+
+// Feeds a response body straight into a JsonScanner instead of a String
+class ScannerStream : public Stream
+{
+public:
+    explicit ScannerStream(JsonScanner &scanner) : scanner_(scanner) {}
+
+    size_t write(uint8_t c) override
+    {
+        scanner_.feed((const char *)&c, 1);
+        return 1;
+    }
+
+    // Always accept everything so the body is drained and the socket stays reusable
+    size_t write(const uint8_t *buffer, size_t size) override
+    {
+        scanner_.feed((const char *)buffer, size);
+        return size;
+    }
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+
+private:
+    JsonScanner &scanner_;
+};
+
+FacilitatorConnection::FacilitatorConnection(const char *baseUrl, uint32_t idleTimeoutMs)
+    : baseUrl_(baseUrl ? baseUrl : DEFAULT_FACILITATOR_URL),
+      idleTimeoutMs_(idleTimeoutMs),
+      requestTimeoutMs_(FACILITATOR_REQUEST_TIMEOUT_MS),
+      routeTimeoutMs_(0),
+      lastUsedMs_(0),
+      connectCount_(0),
+      lock_(xSemaphoreCreateRecursiveMutex())
+{
+    // Same trust model as HTTPClient::begin(url) without a CA bundle
+    client_.setInsecure();
+    http_.setReuse(true);
+}
+
+FacilitatorConnection::~FacilitatorConnection()
+{
+    close();
+    if (lock_)
+    {
+        vSemaphoreDelete(lock_);
+        lock_ = nullptr;
+    }
+}
+
+FacilitatorConnection &FacilitatorConnection::shared()
+{
+    static FacilitatorConnection instance;
+    return instance;
+}
+
+void FacilitatorConnection::close()
+{
+    client_.stop();
+    lastUsedMs_ = 0;
+}
+
+void FacilitatorConnection::setBaseUrl(const char *baseUrl)
+{
+    if (!baseUrl || baseUrl_ == baseUrl)
+        return;
+    if (lock_)
+        xSemaphoreTakeRecursive(lock_, portMAX_DELAY);
+    if (routeUrl_.length() == 0)
+        close();
+    baseUrl_ = baseUrl;
+    if (lock_)
+        xSemaphoreGiveRecursive(lock_);
+}
+
+void FacilitatorConnection::setRoute(const char *url, uint32_t timeoutMs)
+{
+    if (lock_)
+        xSemaphoreTakeRecursive(lock_, portMAX_DELAY);
+    if (getUrl() != (url ? url : baseUrl_.c_str()))
+        close();
+    routeUrl_ = url ? url : "";
+    routeTimeoutMs_ = url ? timeoutMs : 0;
+    if (lock_)
+        xSemaphoreGiveRecursive(lock_);
+}
+
+void FacilitatorConnection::hold()
+{
+    if (lock_)
+        xSemaphoreTakeRecursive(lock_, portMAX_DELAY);
+}
+
+bool FacilitatorConnection::tryHold()
+{
+    return !lock_ || xSemaphoreTakeRecursive(lock_, 0) == pdTRUE;
+}
+
+void FacilitatorConnection::release()
+{
+    if (lock_)
+        xSemaphoreGiveRecursive(lock_);
+}
+
+bool FacilitatorConnection::isOpen()
+{
+    return client_.connected();
+}
+
+HttpResponse FacilitatorConnection::post(const String &endpoint, const String &jsonPayload, const String &customHeaders)
+{
+    return request(endpoint, &jsonPayload, nullptr, customHeaders, nullptr);
+}
+
+HttpResponse FacilitatorConnection::post(const String &endpoint, const String &jsonPayload, JsonScanner &scanner, const String &customHeaders)
+{
+    return request(endpoint, &jsonPayload, nullptr, customHeaders, &scanner);
+}
+
+HttpResponse FacilitatorConnection::post(const String &endpoint, GatherStream &body, const String &customHeaders)
+{
+    return request(endpoint, nullptr, &body, customHeaders, nullptr);
+}
+
+HttpResponse FacilitatorConnection::post(const String &endpoint, GatherStream &body, JsonScanner &scanner, const String &customHeaders)
+{
+    return request(endpoint, nullptr, &body, customHeaders, &scanner);
+}
+
+HttpResponse FacilitatorConnection::request(const String &endpoint, const String *jsonPayload, GatherStream *body,
+                                            const String &customHeaders, JsonScanner *scanner)
+{
+    STACK_CHECKPOINT("FacilitatorConnection::post:start");
+
+    HttpResponse response;
+    response.success = false;
+    response.statusCode = 0;
+    response.body = "";
+
+    if (lock_)
+        xSemaphoreTakeRecursive(lock_, portMAX_DELAY);
+
+    // Build URL without concatenation - Memory optimized
+    const String &target = getUrl();
+    String url;
+    url.reserve(target.length() + endpoint.length() + 2);
+    url = target;
+    url += '/';
+    url += endpoint;
+
+    // Drop sockets that sat idle long enough for the server to have closed them
+    if (lastUsedMs_ != 0 && (millis() - lastUsedMs_) > idleTimeoutMs_)
+    {
+        close();
+    }
+
+    bool reused = client_.connected();
+    int code = send(url, jsonPayload, body, customHeaders, scanner, response);
+
+    // A reused socket may have been closed by the server - reconnect once.
+    // A settle is only resent if it never left: a second submission of an
+    // authorization that already went on chain comes back as a failure.
+    bool resend = endpoint == "settle" ? isUnsentError(code) : isStaleConnectionError(code);
+    if (reused && resend)
+    {
+        close();
+        code = send(url, jsonPayload, body, customHeaders, scanner, response);
+    }
+
+    lastUsedMs_ = client_.connected() ? millis() : 0;
+    url = "";
+
+    if (lock_)
+        xSemaphoreGiveRecursive(lock_);
+
+    STACK_CHECKPOINT("FacilitatorConnection::post:end");
+    return response;
+}
+
+bool FacilitatorConnection::begin(const String &url, const String &customHeaders)
+{
+    if (!http_.begin(client_, url))
+    {
+        return false;
+    }
+
+    http_.setFollowRedirects(HTTPC_FORCE_FOLLOW_REDIRECTS);
+    // HTTPClient's read timeout is 16-bit: longer routes wait as long as it allows
+    uint32_t timeoutMs = routeTimeoutMs_ ? routeTimeoutMs_ : requestTimeoutMs_;
+    http_.setTimeout(timeoutMs > UINT16_MAX ? UINT16_MAX : (uint16_t)timeoutMs);
+    http_.addHeader("Content-Type", "application/json");
+    addCustomHeaders(http_, customHeaders);
+    return true;
+}
+
+int FacilitatorConnection::send(const String &url, const String *jsonPayload, GatherStream *body,
+                                const String &customHeaders, JsonScanner *scanner, HttpResponse &response)
+{
+    if (!client_.connected())
+    {
+        connectCount_++;
+    }
+
+    response.success = false;
+    response.statusCode = 0;
+    response.body = "";
+
+    if (!begin(url, customHeaders))
+    {
+        return HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+
+    int httpResponseCode;
+    if (body)
+    {
+        // Sent straight from the parts; sendRequest() sets Content-Length.
+        // Unlike POST(String) it never follows redirects, so do it here.
+        String redirected;
+        for (uint8_t hops = 0;; ++hops)
+        {
+            body->rewind();
+            httpResponseCode = http_.sendRequest("POST", body, body->size());
+            if (!isMethodKeepingRedirect(httpResponseCode) || hops >= FACILITATOR_MAX_REDIRECTS)
+                break;
+
+            String location = resolveLocation(redirected.length() ? redirected : url, http_.getLocation());
+            if (location.length() == 0)
+                break;
+            redirected = std::move(location);
+
+            // The new location may be on another host: start on a fresh socket
+            http_.end();
+            client_.stop();
+            connectCount_++;
+            if (!begin(redirected, customHeaders))
+            {
+                return HTTPC_ERROR_CONNECTION_REFUSED;
+            }
+        }
+    }
+    else
+    {
+        httpResponseCode = http_.POST(*jsonPayload);
+    }
+
+    STACK_CHECKPOINT("FacilitatorConnection::send:after_post");
+
+    response.statusCode = httpResponseCode;
+    if (httpResponseCode > 0 && scanner)
+    {
+        // Parse while reading - only the requested fields are ever materialized.
+        // writeToStream() also handles chunked transfer encoding.
+        scanner->reset();
+        ScannerStream sink(*scanner);
+        int written = http_.writeToStream(&sink);
+        response.success = written >= 0 && (httpResponseCode >= 200 && httpResponseCode < 300);
+        if (written < 0)
+        {
+            client_.stop();
+        }
+    }
+    else if (httpResponseCode > 0)
+    {
+        response.body.reserve(512); // Pre-allocate expected response size
+        response.body = http_.getString();
+        response.success = (httpResponseCode >= 200 && httpResponseCode < 300);
+    }
+    else
+    {
+        // Connection-level failure: never reuse this socket
+        client_.stop();
+    }
+
+    // With reuse enabled this keeps the socket open when the server allows it
+    http_.end();
+
+    return httpResponseCode;
+}
@@ -0,0 +1,114 @@
+#ifndef FACILITATORCONNECTION_H
+#define FACILITATORCONNECTION_H
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <WiFiClientSecure.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "httputils.h"
+
+class JsonScanner;
+
+// Default idle time after which a kept-alive socket is closed before reuse.
+// Most facilitator front-ends drop idle keep-alive sockets after 30-60s.
+#define FACILITATOR_IDLE_TIMEOUT_MS 30000
+
+// Default request timeout (settle can take 30-45s on-chain)
+#define FACILITATOR_REQUEST_TIMEOUT_MS 60000
+
+// Redirects followed per request (301/302/307/308; the body is resent)
+#define FACILITATOR_MAX_REDIRECTS 3
+
+/**
+ * Persistent connection to a facilitator.
+ *
+ * Keeps one TLS socket open across requests (HTTP/1.1 keep-alive) so that
+ * verify and settle for the same payment - and subsequent payments - skip
+ * the TCP + TLS handshake. The socket is closed after an idle timeout and
+ * transparently re-opened (with one retry) when the server has dropped it;
+ * settle requests are only retried when they never reached the server.
+ *
+ * Calls are serialized with a (recursive) mutex, so one instance may be
+ * shared between tasks; hold() keeps it for a run of back-to-back requests. Each open connection holds ~40KB of TLS buffers on ESP32.
+ */
+class FacilitatorConnection
+{
+public:
+    explicit FacilitatorConnection(const char *baseUrl = nullptr,
+                                   uint32_t idleTimeoutMs = FACILITATOR_IDLE_TIMEOUT_MS);
+    ~FacilitatorConnection();
+
+    FacilitatorConnection(const FacilitatorConnection &) = delete;
+    FacilitatorConnection &operator=(const FacilitatorConnection &) = delete;
+
+    // POST jsonPayload to <baseUrl>/<endpoint> over the kept-alive socket
+    HttpResponse post(const String &endpoint, const String &jsonPayload, const String &customHeaders = "");
+
+    // Same, but the response body is streamed into scanner instead of being
+    // buffered; the returned body is left empty
+    HttpResponse post(const String &endpoint, const String &jsonPayload, JsonScanner &scanner, const String &customHeaders = "");
+
+    // Stream the request body from its parts with an exact Content-Length,
+    // so it is never joined into one String
+    HttpResponse post(const String &endpoint, GatherStream &body, const String &customHeaders = "");
+    HttpResponse post(const String &endpoint, GatherStream &body, JsonScanner &scanner, const String &customHeaders = "");
+
+    // Reserve the connection for the calling task across several requests
+    // (e.g. a settlement batch); every hold() needs a release()
+    void hold();
+    void release();
+    // hold() without waiting: false while another task has the connection
+    bool tryHold();
+
+    // Close the underlying socket (next request reconnects)
+    void close();
+
+    // Changing the base URL closes the current socket
+    void setBaseUrl(const char *baseUrl);
+    const String &getBaseUrl() const { return baseUrl_; }
+
+    // Send the following requests to url with timeoutMs instead of the base
+    // URL and request timeout (used by FacilitatorRegistry); nullptr goes
+    // back to them. Changing the target closes the current socket.
+    void setRoute(const char *url, uint32_t timeoutMs = 0);
+    // Where the next request goes: the route if set, else the base URL
+    const String &getUrl() const { return routeUrl_.length() ? routeUrl_ : baseUrl_; }
+
+    void setIdleTimeout(uint32_t ms) { idleTimeoutMs_ = ms; }
+    void setRequestTimeout(uint16_t ms) { requestTimeoutMs_ = ms; }
+
+    bool isOpen();
+
+    // Number of fresh (non-reused) connections opened so far
+    uint32_t getConnectCount() const { return connectCount_; }
+
+    // True for errors raised before the request left the device, so the
+    // facilitator cannot have acted on it (safe to resend, even a settle)
+    static bool isUnsentError(int code);
+
+    // Process-wide connection used when callers don't pass their own
+    static FacilitatorConnection &shared();
+
+private:
+    // Exactly one of jsonPayload / body is set
+    HttpResponse request(const String &endpoint, const String *jsonPayload, GatherStream *body,
+                         const String &customHeaders, JsonScanner *scanner);
+    // Point http_ at url with the timeout and headers of every request
+    bool begin(const String &url, const String &customHeaders);
+    int send(const String &url, const String *jsonPayload, GatherStream *body,
+             const String &customHeaders, JsonScanner *scanner, HttpResponse &response);
+
+    WiFiClientSecure client_;
+    HTTPClient http_;
+    String baseUrl_;
+    String routeUrl_;
+    uint32_t idleTimeoutMs_;
+    uint16_t requestTimeoutMs_;
+    uint32_t routeTimeoutMs_;
+    unsigned long lastUsedMs_;
+    uint32_t connectCount_;
+    SemaphoreHandle_t lock_;
+};
+
+#endif // FACILITATORCONNECTION_H
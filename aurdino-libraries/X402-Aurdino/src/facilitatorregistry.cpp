@@ -0,0 +1,667 @@
+#include "facilitatorregistry.h"
+#include "facilitatorconnection.h"
+#include "jsonscanner.h"
+#include "stackmonitor.h"
+#include <freertos/task.h>
+
+// A request the facilitator never answered properly
+static bool isFailure(int statusCode)
+{
+    return statusCode <= 0 || statusCode >= 500;
+}
+
+// One raced /verify. Shared by the caller and both legs; whoever lets go
+// last frees it.
+struct FacilitatorRegistry::HedgeRace
+{
+    // A leg's cursor over the caller's body. Read under the registry lock,
+    // so a caller that leaves while the leg is still sending can move it
+    // onto a copy first.
+    struct Body : GatherStream
+    {
+        void assign(const GatherStream &parts)
+        {
+            GatherStream::operator=(parts);
+            rewind();
+        }
+        int peek() override;
+        size_t readBytes(char *buffer, size_t length) override;
+        using Stream::readBytes;
+    };
+
+    struct Leg
+    {
+        uint8_t index;
+        FacilitatorConnection *connection;
+        Body body;
+        volatile bool started;
+        volatile bool finished;
+        HttpResponse response;
+    };
+
+    String endpoint;
+    String customHeaders;
+    char *bodyCopy;          // only made if the caller leaves before a leg is done sending
+    Leg legs[2];             // the primary, sent at once, and the backup
+    uint8_t lane;
+    TickType_t backupAt;
+    TickType_t deadline;     // the caller stops waiting for the legs
+    volatile bool settled;   // the caller has its answer: legs not sent yet stand down
+    SemaphoreHandle_t go;       // wakes the backup early
+    SemaphoreHandle_t answered; // given by each leg as it finishes
+    uint8_t refs;
+};
+
+int FacilitatorRegistry::HedgeRace::Body::peek()
+{
+    portMUX_TYPE &mux = instance().mux_;
+    portENTER_CRITICAL(&mux);
+    int c = GatherStream::peek();
+    portEXIT_CRITICAL(&mux);
+    return c;
+}
+
+size_t FacilitatorRegistry::HedgeRace::Body::readBytes(char *buffer, size_t length)
+{
+    portMUX_TYPE &mux = instance().mux_;
+    portENTER_CRITICAL(&mux);
+    size_t n = GatherStream::readBytes(buffer, length);
+    portEXIT_CRITICAL(&mux);
+    return n;
+}
+
+FacilitatorRegistry &FacilitatorRegistry::instance()
+{
+    static FacilitatorRegistry registry;
+    return registry;
+}
+
+FacilitatorRegistry::FacilitatorRegistry()
+    : count_(0), hedgeDelayMs_(0), hedgeLaneCount_(0), mux_(portMUX_INITIALIZER_UNLOCKED)
+{
+    memset(endpoints_, 0, sizeof(endpoints_));
+    memset(hedgeLanes_, 0, sizeof(hedgeLanes_));
+}
+
+int8_t FacilitatorRegistry::add(const char *url, uint32_t verifyTimeoutMs, uint32_t settleTimeoutMs)
+{
+    size_t len = url ? strlen(url) : 0;
+    if (len == 0 || len >= X402_FACILITATOR_MAX_URL)
+        return -1;
+
+    int8_t index = -1;
+    portENTER_CRITICAL(&mux_);
+    for (uint8_t i = 0; i < count_; ++i)
+    {
+        if (strcmp(endpoints_[i].url, url) == 0)
+        {
+            index = i;
+            break;
+        }
+    }
+    if (index < 0 && count_ < X402_MAX_FACILITATORS)
+    {
+        index = count_++;
+        memset(&endpoints_[index], 0, sizeof(FacilitatorEndpoint));
+        memcpy(endpoints_[index].url, url, len + 1);
+    }
+    if (index >= 0)
+    {
+        endpoints_[index].verifyTimeoutMs = verifyTimeoutMs;
+        endpoints_[index].settleTimeoutMs = settleTimeoutMs;
+    }
+    portEXIT_CRITICAL(&mux_);
+    return index;
+}
+
+void FacilitatorRegistry::clear()
+{
+    portENTER_CRITICAL(&mux_);
+    count_ = 0;
+    memset(endpoints_, 0, sizeof(endpoints_));
+    portEXIT_CRITICAL(&mux_);
+}
+
+bool FacilitatorRegistry::getEndpoint(uint8_t index, FacilitatorEndpoint &out) const
+{
+    portENTER_CRITICAL(&mux_);
+    bool ok = index < count_;
+    if (ok)
+        out = endpoints_[index];
+    portEXIT_CRITICAL(&mux_);
+    return ok;
+}
+
+void FacilitatorRegistry::resetHealth()
+{
+    portENTER_CRITICAL(&mux_);
+    for (uint8_t i = 0; i < count_; ++i)
+    {
+        FacilitatorEndpoint &e = endpoints_[i];
+        e.verifyLatencyMs = 0;
+        e.settleLatencyMs = 0;
+        e.errorRate = 0;
+        e.consecutiveFailures = 0;
+        e.requests = 0;
+        e.failures = 0;
+        e.downUntilMs = 0;
+    }
+    portEXIT_CRITICAL(&mux_);
+}
+
+uint8_t FacilitatorRegistry::rank(uint8_t *order, uint8_t capacity, const char *currentUrl) const
+{
+    uint32_t score[X402_MAX_FACILITATORS];
+    bool down[X402_MAX_FACILITATORS];
+    int8_t current = -1;
+    uint32_t now = millis();
+
+    portENTER_CRITICAL(&mux_);
+    uint8_t n = count_;
+
+    // An endpoint measured on one call only gets the average for the other
+    uint32_t verifySum = 0, settleSum = 0;
+    uint8_t verifyCount = 0, settleCount = 0;
+    for (uint8_t i = 0; i < n; ++i)
+    {
+        if (endpoints_[i].verifyLatencyMs)
+        {
+            verifySum += endpoints_[i].verifyLatencyMs;
+            verifyCount++;
+        }
+        if (endpoints_[i].settleLatencyMs)
+        {
+            settleSum += endpoints_[i].settleLatencyMs;
+            settleCount++;
+        }
+    }
+
+    for (uint8_t i = 0; i < n; ++i)
+    {
+        const FacilitatorEndpoint &e = endpoints_[i];
+        uint32_t verifyMs = e.verifyLatencyMs ? e.verifyLatencyMs : (verifyCount ? verifySum / verifyCount : 0);
+        uint32_t settleMs = e.settleLatencyMs ? e.settleLatencyMs : (settleCount ? settleSum / settleCount : 0);
+        // Unmeasured endpoints score 0 so they get probed.
+        // 25% errors doubles the effective latency.
+        score[i] = e.requests == 0 ? 0 : (uint32_t)(((uint64_t)(verifyMs + settleMs) * (1000 + 4 * e.errorRate)) / 1000);
+        down[i] = e.downUntilMs != 0 && (int32_t)(now - e.downUntilMs) < 0;
+        if (currentUrl && strcmp(e.url, currentUrl) == 0)
+            current = i;
+    }
+    portEXIT_CRITICAL(&mux_);
+
+    // Insertion sort: parked endpoints last, then by score, ties in
+    // registration order
+    uint8_t sorted[X402_MAX_FACILITATORS];
+    for (uint8_t i = 0; i < n; ++i)
+    {
+        uint8_t pos = i;
+        while (pos > 0)
+        {
+            uint8_t prev = sorted[pos - 1];
+            bool before = down[i] != down[prev] ? !down[i] : score[i] < score[prev];
+            if (!before)
+                break;
+            sorted[pos] = prev;
+            pos--;
+        }
+        sorted[pos] = i;
+    }
+
+    // Switching endpoints costs a TLS handshake: stay unless clearly worse
+    if (current >= 0 && !down[current] &&
+        (uint64_t)score[current] * 100 <= (uint64_t)score[sorted[0]] * (100 + X402_FACILITATOR_STICKY_PERCENT))
+    {
+        uint8_t pos = 0;
+        while (sorted[pos] != current)
+            pos++;
+        for (; pos > 0; --pos)
+            sorted[pos] = sorted[pos - 1];
+        sorted[0] = current;
+    }
+
+    if (n > capacity)
+        n = capacity;
+    memcpy(order, sorted, n);
+    return n;
+}
+
+void FacilitatorRegistry::record(uint8_t index, bool verify, int statusCode, uint32_t elapsedMs)
+{
+    bool failed = isFailure(statusCode);
+    uint32_t now = millis();
+
+    portENTER_CRITICAL(&mux_);
+    if (index < count_)
+    {
+        FacilitatorEndpoint &e = endpoints_[index];
+        uint32_t &latency = verify ? e.verifyLatencyMs : e.settleLatencyMs;
+        uint32_t timeoutMs = verify ? e.verifyTimeoutMs : e.settleTimeoutMs;
+
+        // A refused connection is quick but no better than a timeout
+        uint32_t sample = failed && timeoutMs > elapsedMs ? timeoutMs : elapsedMs;
+        if (sample == 0)
+            sample = 1; // 0 means "not measured yet"
+        latency = latency == 0 ? sample : (latency * 3 + sample) / 4;
+
+        e.errorRate = (uint16_t)((e.errorRate * 7 + (failed ? 1000 : 0)) / 8);
+        e.requests++;
+        if (failed)
+        {
+            e.failures++;
+            if (e.consecutiveFailures < 255)
+                e.consecutiveFailures++;
+            // Parked again after every failed probe once over the threshold
+            if (e.consecutiveFailures >= X402_FACILITATOR_FAILURE_THRESHOLD)
+                e.downUntilMs = (now + X402_FACILITATOR_COOLDOWN_MS) | 1;
+        }
+        else
+        {
+            e.consecutiveFailures = 0;
+            e.downUntilMs = 0;
+        }
+    }
+    portEXIT_CRITICAL(&mux_);
+}
+
+bool FacilitatorRegistry::enableHedging(uint32_t delayMs, uint8_t lanes, size_t stackBytes, UBaseType_t prio, BaseType_t core)
+{
+    hedgeDelayMs_ = delayMs;
+    if (delayMs == 0)
+        return true;
+    if (lanes > X402_FACILITATOR_HEDGE_LANES)
+        lanes = X402_FACILITATOR_HEDGE_LANES;
+
+    // A later call starts whatever could not be started before
+    while (hedgeLaneCount_ < lanes)
+    {
+        uint8_t laneIndex = hedgeLaneCount_;
+        HedgeLane &lane = hedgeLanes_[laneIndex];
+
+        // Kept apart from the callers' connections so the backup never waits on them
+        if (!lane.connection)
+            lane.connection = new (std::nothrow) FacilitatorConnection();
+        if (!lane.connection)
+            return false;
+
+        while (lane.tasks < 2)
+        {
+            uint8_t leg = lane.tasks;
+            if (!lane.queue[leg])
+                lane.queue[leg] = xQueueCreate(1, sizeof(HedgeRace *));
+            if (!lane.queue[leg])
+                return false;
+
+            char name[16];
+            snprintf(name, sizeof(name), "pay_hedge%u%c", (unsigned)laneIndex, leg ? 'b' : 'a');
+            if (xTaskCreatePinnedToCore(hedgeTrampoline, name, stackBytes / sizeof(StackType_t),
+                                        (void *)(uintptr_t)(laneIndex * 2 + leg), prio, nullptr, core) != pdPASS)
+                return false;
+            lane.tasks++;
+        }
+        hedgeLaneCount_++;
+    }
+    return true;
+}
+
+bool FacilitatorRegistry::route(uint8_t index, bool verify, FacilitatorConnection &connection)
+{
+    char url[X402_FACILITATOR_MAX_URL];
+    uint32_t timeoutMs = 0;
+    portENTER_CRITICAL(&mux_);
+    bool known = index < count_;
+    if (known)
+    {
+        memcpy(url, endpoints_[index].url, sizeof(url));
+        timeoutMs = verify ? endpoints_[index].verifyTimeoutMs : endpoints_[index].settleTimeoutMs;
+    }
+    portEXIT_CRITICAL(&mux_);
+
+    if (known)
+        connection.setRoute(url, timeoutMs);
+    return known;
+}
+
+FacilitatorRegistry::HedgeRace *FacilitatorRegistry::startRace(const uint8_t *order, const String &endpoint, GatherStream &body,
+                                                               const String &customHeaders, FacilitatorConnection &connection)
+{
+    // A free lane, or no race this time: waiting for another caller's race
+    // (whose lost leg may be stuck until its timeout) would cost more
+    int8_t laneIndex = -1;
+    portENTER_CRITICAL(&mux_);
+    for (uint8_t i = 0; i < hedgeLaneCount_ && laneIndex < 0; ++i)
+    {
+        if (hedgeLanes_[i].active == 0)
+        {
+            laneIndex = i;
+            hedgeLanes_[i].active = 2;
+        }
+    }
+    portEXIT_CRITICAL(&mux_);
+    if (laneIndex < 0)
+        return nullptr;
+    HedgeLane &lane = hedgeLanes_[laneIndex];
+
+    HedgeRace *race = new (std::nothrow) HedgeRace();
+    if (race)
+    {
+        race->refs = 1;
+        race->go = xSemaphoreCreateBinary();
+        race->answered = xSemaphoreCreateBinary();
+    }
+    if (!race || !race->go || !race->answered)
+    {
+        if (race)
+            releaseRace(race);
+        portENTER_CRITICAL(&mux_);
+        lane.active = 0;
+        portEXIT_CRITICAL(&mux_);
+        return nullptr;
+    }
+
+    uint32_t latencyMs = 0, budgetMs = 0;
+    portENTER_CRITICAL(&mux_);
+    for (uint8_t i = 0; i < 2; ++i)
+    {
+        if (order[i] < count_)
+            budgetMs += endpoints_[order[i]].verifyTimeoutMs;
+    }
+    if (order[0] < count_)
+        latencyMs = endpoints_[order[0]].verifyLatencyMs;
+    portEXIT_CRITICAL(&mux_);
+
+    uint32_t delayMs = latencyMs * 2 > hedgeDelayMs_ ? latencyMs * 2 : hedgeDelayMs_;
+    TickType_t now = xTaskGetTickCount();
+
+    race->endpoint = endpoint;
+    race->customHeaders = customHeaders;
+    race->bodyCopy = nullptr;
+    race->lane = laneIndex;
+    for (uint8_t i = 0; i < 2; ++i)
+    {
+        // Each leg reads the caller's buffers through a cursor of its own
+        race->legs[i].index = order[i];
+        race->legs[i].body.assign(body);
+        race->legs[i].started = false;
+        race->legs[i].finished = false;
+        race->legs[i].response.statusCode = 0;
+        race->legs[i].response.success = false;
+    }
+    // The primary goes over the caller's connection, so a settle after it
+    // reuses the socket; the backup over the lane's own
+    race->legs[0].connection = &connection;
+    race->legs[1].connection = lane.connection;
+    race->backupAt = now + pdMS_TO_TICKS(delayMs);
+    // Each leg is bounded by its timeout, twice over with the reconnect retry
+    race->deadline = now + pdMS_TO_TICKS(delayMs + 2 * budgetMs);
+    race->settled = false;
+    race->refs = 3;
+
+    if (xQueueSend(lane.queue[0], &race, 0) != pdTRUE)
+    {
+        race->refs = 1;
+        releaseRace(race);
+        portENTER_CRITICAL(&mux_);
+        lane.active = 0;
+        portEXIT_CRITICAL(&mux_);
+        return nullptr;
+    }
+    if (xQueueSend(lane.queue[1], &race, 0) != pdTRUE)
+    {
+        // Primary only
+        portENTER_CRITICAL(&mux_);
+        race->legs[1].finished = true;
+        lane.active--;
+        portEXIT_CRITICAL(&mux_);
+        releaseRace(race);
+    }
+    return race;
+}
+
+bool FacilitatorRegistry::finishRace(HedgeRace *race, GatherStream &body, HttpResponse &response)
+{
+    int8_t winner = -1;
+    bool finished[2] = {false, false};
+    for (;;)
+    {
+        portENTER_CRITICAL(&mux_);
+        finished[0] = race->legs[0].finished;
+        finished[1] = race->legs[1].finished;
+        portEXIT_CRITICAL(&mux_);
+
+        for (uint8_t i = 0; i < 2 && winner < 0; ++i)
+        {
+            if (finished[i] && !isFailure(race->legs[i].response.statusCode))
+                winner = i;
+        }
+        if (winner >= 0 || (finished[0] && finished[1]))
+            break;
+
+        TickType_t now = xTaskGetTickCount();
+        if ((int32_t)(race->deadline - now) <= 0)
+            break;
+        xSemaphoreTake(race->answered, race->deadline - now);
+    }
+
+    // Whatever has not been sent yet stands down
+    portENTER_CRITICAL(&mux_);
+    race->settled = true;
+    bool sending = false;
+    for (uint8_t i = 0; i < 2; ++i)
+        sending |= race->legs[i].started && !race->legs[i].finished;
+    portEXIT_CRITICAL(&mux_);
+    xSemaphoreGive(race->go);
+
+    // The caller's buffers go when it returns: a leg still sending (or about
+    // to resend) moves to a copy, made only now that it is needed
+    if (sending)
+    {
+        char *copy = (char *)malloc(body.size() ? body.size() : 1);
+        if (copy)
+        {
+            GatherStream parts = body;
+            parts.rewind();
+            parts.readBytes(copy, body.size());
+            portENTER_CRITICAL(&mux_);
+            for (uint8_t i = 0; i < 2; ++i)
+            {
+                if (!race->legs[i].finished)
+                    race->legs[i].body.relocate(copy);
+            }
+            race->bodyCopy = copy;
+            portEXIT_CRITICAL(&mux_);
+        }
+        else
+        {
+            // No room for a copy: wait for the legs instead
+            for (;;)
+            {
+                portENTER_CRITICAL(&mux_);
+                sending = (race->legs[0].started && !race->legs[0].finished) ||
+                          (race->legs[1].started && !race->legs[1].finished);
+                portEXIT_CRITICAL(&mux_);
+                if (!sending)
+                    break;
+                xSemaphoreTake(race->answered, pdMS_TO_TICKS(100));
+            }
+        }
+    }
+
+    if (winner >= 0)
+        response = race->legs[winner].response;
+    else if (finished[0])
+        response = race->legs[0].response;
+    return winner >= 0;
+}
+
+void FacilitatorRegistry::releaseRace(HedgeRace *race)
+{
+    portENTER_CRITICAL(&mux_);
+    bool last = --race->refs == 0;
+    portEXIT_CRITICAL(&mux_);
+    if (!last)
+        return;
+
+    if (race->go)
+        vSemaphoreDelete(race->go);
+    if (race->answered)
+        vSemaphoreDelete(race->answered);
+    free(race->bodyCopy);
+    delete race;
+}
+
+void FacilitatorRegistry::hedgeTrampoline(void *arg)
+{
+    uintptr_t task = (uintptr_t)arg;
+    instance().hedgeLoop((uint8_t)(task / 2), (uint8_t)(task % 2));
+}
+
+void FacilitatorRegistry::hedgeLoop(uint8_t laneIndex, uint8_t legIndex)
+{
+    HedgeLane &lane = hedgeLanes_[laneIndex];
+    for (;;)
+    {
+        HedgeRace *race = nullptr;
+        if (xQueueReceive(lane.queue[legIndex], &race, portMAX_DELAY) != pdTRUE || !race)
+            continue;
+
+        HedgeRace::Leg &leg = race->legs[legIndex];
+
+        if (legIndex == 1)
+        {
+            // Sleep out the hedge delay unless the primary fails (or the
+            // race is settled) sooner
+            TickType_t now = xTaskGetTickCount();
+            TickType_t wait = (int32_t)(race->backupAt - now) > 0 ? race->backupAt - now : 0;
+            xSemaphoreTake(race->go, wait);
+        }
+
+        portENTER_CRITICAL(&mux_);
+        bool send = !race->settled;
+        leg.started = send;
+        portEXIT_CRITICAL(&mux_);
+
+        if (send)
+        {
+            leg.connection->hold();
+            if (route(leg.index, true, *leg.connection))
+            {
+                unsigned long startMs = millis();
+                HttpResponse response = leg.connection->post(race->endpoint, leg.body, race->customHeaders);
+                record(leg.index, true, response.statusCode, millis() - startMs);
+                leg.response = response;
+            }
+            leg.connection->release();
+        }
+
+        // A failed primary sends the backup right away
+        if (legIndex == 0 && isFailure(leg.response.statusCode))
+            xSemaphoreGive(race->go);
+
+        portENTER_CRITICAL(&mux_);
+        leg.finished = true;
+        lane.active--;
+        portEXIT_CRITICAL(&mux_);
+        xSemaphoreGive(race->answered);
+        releaseRace(race);
+    }
+}
+
+HttpResponse FacilitatorRegistry::post(const String &endpoint, GatherStream &body, JsonScanner *scanner,
+                                       const String &customHeaders, FacilitatorConnection &connection)
+{
+    STACK_CHECKPOINT("FacilitatorRegistry::post:start");
+
+    bool verify = endpoint == "verify";
+
+    HttpResponse response;
+    response.success = false;
+    response.statusCode = 0;
+    response.body = "";
+
+    // Stay on the endpoint the connection is on. One still busy with the
+    // lost leg of an earlier race is not waited for: rank without it.
+    String currentUrl;
+    if (connection.tryHold())
+    {
+        currentUrl = connection.getUrl();
+        connection.release();
+    }
+
+    uint8_t order[X402_MAX_FACILITATORS];
+    uint8_t n = rank(order, X402_MAX_FACILITATORS, currentUrl.c_str());
+    currentUrl = "";
+
+    if (n == 0)
+    {
+        // Nothing registered (any more): back to the connection's base URL
+        connection.hold();
+        connection.setRoute(nullptr);
+        response = scanner ? connection.post(endpoint, body, *scanner, customHeaders)
+                           : connection.post(endpoint, body, customHeaders);
+        connection.release();
+        STACK_CHECKPOINT("FacilitatorRegistry::post:end");
+        return response;
+    }
+
+    // Race the first /verify against the runner-up
+    uint8_t raced = 0;
+    if (verify && n > 1 && isHedgingEnabled())
+    {
+        HedgeRace *race = startRace(order, endpoint, body, customHeaders, connection);
+        if (race)
+        {
+            raced = 2;
+            bool answered = finishRace(race, body, response);
+            releaseRace(race);
+            if (answered)
+            {
+                if (scanner)
+                {
+                    scanner->reset();
+                    scanner->feed(response.body.c_str(), response.body.length());
+                    response.body = "";
+                }
+                STACK_CHECKPOINT("FacilitatorRegistry::post:end");
+                return response;
+            }
+        }
+    }
+
+    // Base URL and timeout change per attempt: keep other tasks off the connection
+    connection.hold();
+    for (uint8_t i = raced; i < n; ++i)
+    {
+        uint8_t index = order[i];
+        if (!route(index, verify, connection))
+            continue;
+
+        unsigned long startMs = millis();
+        response = scanner ? connection.post(endpoint, body, *scanner, customHeaders)
+                           : connection.post(endpoint, body, customHeaders);
+        record(index, verify, response.statusCode, millis() - startMs);
+
+        if (!isFailure(response.statusCode))
+            break;
+        if (!verify && !FacilitatorConnection::isUnsentError(response.statusCode))
+            break;
+    }
+    connection.release();
+
+    STACK_CHECKPOINT("FacilitatorRegistry::post:end");
+    return response;
+}
+
+void FacilitatorRegistry::print() const
+{
+    Serial.println("=== X402 Facilitators ===");
+    FacilitatorEndpoint e;
+    for (uint8_t i = 0; getEndpoint(i, e); ++i)
+    {
+        Serial.printf("%u %s verify=%ums settle=%ums errors=%u%% req=%u fail=%u%s\n",
+                      (unsigned)i, e.url, (unsigned)e.verifyLatencyMs, (unsigned)e.settleLatencyMs,
+                      (unsigned)(e.errorRate / 10), (unsigned)e.requests, (unsigned)e.failures,
+                      e.downUntilMs != 0 && (int32_t)(millis() - e.downUntilMs) < 0 ? " (parked)" : "");
+    }
+    Serial.println("=========================");
+}
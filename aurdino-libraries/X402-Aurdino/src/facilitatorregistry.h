@@ -0,0 +1,161 @@
+#ifndef FACILITATORREGISTRY_H
+#define FACILITATORREGISTRY_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include "httputils.h"
+
+class FacilitatorConnection;
+class JsonScanner;
+
+#ifndef X402_MAX_FACILITATORS
+#define X402_MAX_FACILITATORS 4
+#endif
+
+// Longest facilitator base URL, including the terminator
+#define X402_FACILITATOR_MAX_URL 96
+
+// Default per-endpoint timeouts. Verify is a signature/balance check and
+// answers in well under a second; settle waits for the transaction on-chain.
+#define FACILITATOR_VERIFY_TIMEOUT_MS 10000
+#define FACILITATOR_SETTLE_TIMEOUT_MS 60000
+
+// Consecutive failures after which an endpoint is parked for the cooldown
+#define X402_FACILITATOR_FAILURE_THRESHOLD 3
+#define X402_FACILITATOR_COOLDOWN_MS 30000
+
+// Most races run at once. Each lane is two tasks, one per leg of a race, so
+// a primary stuck on a stalled facilitator never holds up the backup, and a
+// backup connection of its own.
+#define X402_FACILITATOR_HEDGE_LANES 4
+
+// The connection stays on its endpoint while within this many percent of the best
+#define X402_FACILITATOR_STICKY_PERCENT 25
+
+// One registered facilitator and its health, as seen by this device
+struct FacilitatorEndpoint
+{
+    char url[X402_FACILITATOR_MAX_URL];
+    uint32_t verifyTimeoutMs;
+    uint32_t settleTimeoutMs;
+
+    // EWMA (alpha = 1/4) of request time, 0 until the first request.
+    // A failed request counts as taking the whole timeout.
+    uint32_t verifyLatencyMs;
+    uint32_t settleLatencyMs;
+    // EWMA (alpha = 1/8) of failed requests, per mille
+    uint16_t errorRate;
+    uint8_t consecutiveFailures;
+    uint32_t requests;
+    uint32_t failures;
+    // millis() until which the endpoint is only tried as a last resort
+    uint32_t downUntilMs;
+};
+
+/**
+ * Set of facilitator endpoints that verify / settle calls are routed over.
+ *
+ * While the registry is empty, makePaymentApiCall() posts to the connection's
+ * own base URL (DEFAULT_FACILITATOR_URL) exactly as before. Once endpoints are
+ * added, each call goes to the healthiest one: lowest verify + settle latency
+ * EWMA, scaled up by the error rate. Verify and settle share that ranking and
+ * the connection stays on its current endpoint unless another is clearly
+ * better, so both calls of a payment reuse one kept-alive socket. Endpoints
+ * that have not been measured yet rank first, so every endpoint gets probed.
+ * A call that gets no answer or a 5xx fails over to the next endpoint; settle
+ * only fails over when the request never reached the server, so one
+ * authorization is never submitted to two facilitators.
+ *
+ * With hedging enabled, a /verify is raced: two background tasks send it to
+ * the best endpoint at once and, if that has not answered after the hedge
+ * delay (or failed before), to the second-best one. The caller takes the
+ * first good answer. Verify is read-only, so the duplicate is harmless.
+ * Each race takes a lane (a pair of tasks); a /verify that finds every lane
+ * busy is sent unraced rather than queued behind another caller's race.
+ *
+ * Safe to call from any task.
+ */
+class FacilitatorRegistry
+{
+public:
+    static FacilitatorRegistry &instance();
+
+    // Register an endpoint (URL is copied). Returns its index, or -1 if the
+    // table is full or the URL too long. Adding a known URL updates its timeouts.
+    int8_t add(const char *url,
+               uint32_t verifyTimeoutMs = FACILITATOR_VERIFY_TIMEOUT_MS,
+               uint32_t settleTimeoutMs = FACILITATOR_SETTLE_TIMEOUT_MS);
+    void clear();
+
+    uint8_t size() const { return count_; }
+    bool isEmpty() const { return count_ == 0; }
+
+    // Copy taken under the lock
+    bool getEndpoint(uint8_t index, FacilitatorEndpoint &out) const;
+
+    // Endpoint indexes, best first. The endpoint whose URL is currentUrl
+    // keeps first place while it is within X402_FACILITATOR_STICKY_PERCENT
+    // of the best. Returns how many were written.
+    uint8_t rank(uint8_t *order, uint8_t capacity, const char *currentUrl = nullptr) const;
+
+    // Feed one request outcome into the endpoint's health. A request failed
+    // when it got no response (statusCode <= 0) or a 5xx.
+    void record(uint8_t index, bool verify, int statusCode, uint32_t elapsedMs);
+
+    // Race /verify requests, sending the backup after delayMs (at least
+    // twice the primary's usual verify time), up to `lanes` races at once
+    // (one per verifying task). Starts two hedge tasks per lane; each lane's
+    // backup goes over a connection of its own, which holds ~40KB of TLS
+    // buffers while in use. Lanes are only ever added. Returns false if the
+    // tasks could not be started; delayMs = 0 turns hedging off.
+    bool enableHedging(uint32_t delayMs, uint8_t lanes = 1, size_t stackBytes = 8192, UBaseType_t prio = 1, BaseType_t core = 0);
+    bool isHedgingEnabled() const { return hedgeDelayMs_ > 0 && hedgeLaneCount_ > 0; }
+
+    // Forget measured health (e.g. after the network changed)
+    void resetHealth();
+
+    // POST body to <endpoint> over the registered facilitators, best first,
+    // using connection and the endpoint's timeout for this call. While the
+    // registry is empty, connection is pointed back at its base URL.
+    HttpResponse post(const String &endpoint, GatherStream &body, JsonScanner *scanner,
+                      const String &customHeaders, FacilitatorConnection &connection);
+
+    void print() const;
+
+private:
+    struct HedgeRace;
+
+    // Two tasks racing one /verify at a time
+    struct HedgeLane
+    {
+        QueueHandle_t queue[2]; // the race, one slot per leg
+        uint8_t tasks;          // started so far
+        uint8_t active;         // legs of the current race not finished yet
+        FacilitatorConnection *connection; // the backup's
+    };
+
+    FacilitatorRegistry();
+
+    bool route(uint8_t index, bool verify, FacilitatorConnection &connection);
+
+    HedgeRace *startRace(const uint8_t *order, const String &endpoint, GatherStream &body,
+                         const String &customHeaders, FacilitatorConnection &connection);
+    bool finishRace(HedgeRace *race, GatherStream &body, HttpResponse &response);
+    void releaseRace(HedgeRace *race);
+
+    static void hedgeTrampoline(void *arg);
+    void hedgeLoop(uint8_t lane, uint8_t leg);
+
+    FacilitatorEndpoint endpoints_[X402_MAX_FACILITATORS];
+    uint8_t count_;
+
+    uint32_t hedgeDelayMs_;
+    HedgeLane hedgeLanes_[X402_FACILITATOR_HEDGE_LANES];
+    uint8_t hedgeLaneCount_; // lanes with both tasks running
+
+    mutable portMUX_TYPE mux_;
+};
+
+#endif // FACILITATORREGISTRY_H
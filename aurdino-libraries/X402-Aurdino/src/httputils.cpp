@@ -3,6 +3,120 @@
 #include <HTTPClient.h>
 #include <WiFi.h>
 
+bool GatherStream::add(const char *data, size_t length)
+{
+    if (count_ >= MAX_SEGMENTS)
+        return false;
+    if (length == 0)
+        return true;
+    segments_[count_].data = data;
+    segments_[count_].length = length;
+    count_++;
+    size_ += length;
+    return true;
+}
+
+void GatherStream::rewind()
+{
+    current_ = 0;
+    offset_ = 0;
+    consumed_ = 0;
+}
+
+void GatherStream::relocate(const char *copy)
+{
+    for (uint8_t i = 0; i < count_; ++i)
+    {
+        segments_[i].data = copy;
+        copy += segments_[i].length;
+    }
+}
+
+int GatherStream::available()
+{
+    size_t remaining = size_ - consumed_;
+    return remaining > INT32_MAX ? INT32_MAX : (int)remaining;
+}
+
+int GatherStream::read()
+{
+    char c;
+    return readBytes(&c, 1) == 1 ? (uint8_t)c : -1;
+}
+
+int GatherStream::peek()
+{
+    if (current_ >= count_)
+        return -1;
+    return (uint8_t)segments_[current_].data[offset_];
+}
+
+size_t GatherStream::readBytes(char *buffer, size_t length)
+{
+    size_t copied = 0;
+    while (copied < length && current_ < count_)
+    {
+        const Segment &segment = segments_[current_];
+        size_t n = segment.length - offset_;
+        if (n > length - copied)
+            n = length - copied;
+        memcpy(buffer + copied, segment.data + offset_, n);
+        copied += n;
+        offset_ += n;
+        if (offset_ == segment.length)
+        {
+            current_++;
+            offset_ = 0;
+        }
+    }
+    consumed_ += copied;
+    return copied;
+}
+
+// Add "Name: Value" headers separated by '\n' - Memory optimized
+void addCustomHeaders(HTTPClient &http, const String &customHeaders)
+{
+    if (customHeaders.length() == 0)
+        return;
+
+    int startIndex = 0;
+    int endIndex = customHeaders.indexOf('\n');
+
+    while (startIndex < (int)customHeaders.length())
+    {
+        String headerLine;
+        headerLine.reserve(100); // Pre-allocate for header line
+
+        if (endIndex == -1)
+        {
+            headerLine = customHeaders.substring(startIndex);
+            startIndex = customHeaders.length();
+        }
+        else
+        {
+            headerLine = customHeaders.substring(startIndex, endIndex);
+            startIndex = endIndex + 1;
+            endIndex = customHeaders.indexOf('\n', startIndex);
+        }
+
+        // Parse individual header (format: "HeaderName: HeaderValue")
+        int colonIndex = headerLine.indexOf(':');
+        if (colonIndex > 0)
+        {
+            String headerName = headerLine.substring(0, colonIndex);
+            String headerValue = headerLine.substring(colonIndex + 1);
+            headerName.trim();
+            headerValue.trim();
+            http.addHeader(headerName, headerValue);
+
+            // Free memory immediately
+            headerName = "";
+            headerValue = "";
+        }
+        headerLine = ""; // Free memory
+    }
+}
+
 HttpResponse postJson(const String &url, const String &jsonPayload, const String &customHeaders)
 {
     STACK_CHECKPOINT("postJson:start");
@@ -31,48 +145,8 @@ HttpResponse postJson(const String &url, const String &jsonPayload, const String
     // Default content type
     http.addHeader("Content-Type", "application/json");
 
-    // Add custom headers if provided - Memory optimized
-    if (customHeaders.length() > 0)
-    {
-        int startIndex = 0;
-        int endIndex = customHeaders.indexOf('\n');
-
-        while (startIndex < customHeaders.length())
-        {
-            String headerLine;
-            headerLine.reserve(100); // Pre-allocate for header line
-
-            if (endIndex == -1)
-            {
-                headerLine = customHeaders.substring(startIndex);
-                startIndex = customHeaders.length();
-            }
-            else
-            {
-                headerLine = customHeaders.substring(startIndex, endIndex);
-                startIndex = endIndex + 1;
-                endIndex = customHeaders.indexOf('\n', startIndex);
-            }
-
-            // Parse individual header (format: "HeaderName: HeaderValue")
-            int colonIndex = headerLine.indexOf(':');
-            if (colonIndex > 0)
-            {
-                String headerName = headerLine.substring(0, colonIndex);
-                String headerValue = headerLine.substring(colonIndex + 1);
-                headerName.trim();
-                headerValue.trim();
-                http.addHeader(headerName, headerValue);
-
-                // Free memory immediately
-                headerName = "";
-                headerValue = "";
-            }
-            headerLine = ""; // Free memory
-        }
-    }
-
-
+    // Add custom headers if provided
+    addCustomHeaders(http, customHeaders);
 
     // Perform POST request
     int httpResponseCode = http.POST(jsonPayload);
@@ -3,12 +3,65 @@
 
 #include <Arduino.h>
 
+class HTTPClient;
+
 struct HttpResponse {
     int statusCode;
     String body;
     bool success;
 };
 
+/**
+ * Read-only Stream over several existing buffers, sent back to back without
+ * joining them into one String (scatter/gather). The buffers must stay
+ * alive and unchanged while the stream is in use.
+ */
+class GatherStream : public Stream
+{
+public:
+    static const uint8_t MAX_SEGMENTS = 8;
+
+    GatherStream() : count_(0), current_(0), offset_(0), size_(0), consumed_(0) {}
+
+    bool add(const char *data, size_t length);
+    bool add(const String &str) { return add(str.c_str(), str.length()); }
+
+    // Total body length (the Content-Length)
+    size_t size() const { return size_; }
+
+    // Start reading from the first segment again (e.g. to resend)
+    void rewind();
+
+    // Read from copy (all segments back to back, size() bytes) instead of
+    // the original buffers, keeping the read position, so they can go
+    void relocate(const char *copy);
+
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t readBytes(char *buffer, size_t length) override;
+    using Stream::readBytes;
+
+    size_t write(uint8_t) override { return 0; }
+
+private:
+    struct Segment
+    {
+        const char *data;
+        size_t length;
+    };
+
+    Segment segments_[MAX_SEGMENTS];
+    uint8_t count_;
+    uint8_t current_;
+    size_t offset_;   // position within the current segment
+    size_t size_;
+    size_t consumed_;
+};
+
+// Add custom headers ("Name: Value" lines separated by '\n') to a request
+void addCustomHeaders(HTTPClient &http, const String &customHeaders);
+
 // Function to perform HTTP POST request with JSON payload
 HttpResponse postJson(const String &url, const String &jsonPayload, const String &customHeaders = "");
 
@@ -0,0 +1,404 @@
+#include "jsonscanner.h"
+
+static inline bool isJsonWhitespace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Characters that can make up a number, true, false or null
+static inline bool isLiteralChar(char c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || c == '-' || c == '+' || c == '.' || c == 'E';
+}
+
+bool JsonView::equals(const char *literal) const
+{
+    size_t literalLength = strlen(literal);
+    return length == literalLength && memcmp(data, literal, length) == 0;
+}
+
+String JsonView::toString() const
+{
+    String s;
+    if (length > 0)
+    {
+        s.reserve(length);
+        s.concat(data, length);
+    }
+    return s;
+}
+
+JsonScanner::JsonScanner(const char *const *keys, uint8_t keyCount)
+    : keys_(keys), keyCount_(keyCount > MAX_KEYS ? MAX_KEYS : keyCount)
+{
+    allMask_ = keyCount_ >= 16 ? 0xFFFF : (uint16_t)((1u << keyCount_) - 1);
+    reset();
+}
+
+void JsonScanner::reset()
+{
+    state_ = EXPECT_VALUE;
+    stringIsKey_ = false;
+    depth_ = 0;
+    objectBits_ = 0;
+    consumed_ = 0;
+    keyCandidates_ = 0;
+    keyPos_ = 0;
+    pendingKey_ = MAX_KEYS;
+    foundMask_ = 0;
+    capturingMask_ = 0;
+    scalarKey_ = MAX_KEYS;
+}
+
+void JsonScanner::beginCapture(uint8_t keyIndex, JsonValueType type, size_t offset, const char *at)
+{
+    foundMask_ |= (uint16_t)(1u << keyIndex);
+    capturingMask_ |= (uint16_t)(1u << keyIndex);
+    runStart_[keyIndex] = at;
+    onValueStart(keyIndex, type, offset);
+}
+
+void JsonScanner::endCapture(uint8_t keyIndex, size_t offset, const char *at)
+{
+    if (at > runStart_[keyIndex])
+    {
+        onValueData(keyIndex, runStart_[keyIndex], at - runStart_[keyIndex]);
+    }
+    capturingMask_ &= (uint16_t)~(1u << keyIndex);
+    onValueEnd(keyIndex, offset);
+}
+
+void JsonScanner::valueCompleted()
+{
+    scalarKey_ = MAX_KEYS;
+    state_ = depth_ == 0 ? DONE : AFTER_VALUE;
+
+    // Nothing left to look for - stop early
+    if (foundMask_ == allMask_ && capturingMask_ == 0)
+    {
+        state_ = DONE;
+    }
+}
+
+bool JsonScanner::push(bool isObject)
+{
+    if (depth_ >= MAX_DEPTH)
+    {
+        state_ = FAILED;
+        return false;
+    }
+    if (isObject)
+        objectBits_ |= (1u << depth_);
+    else
+        objectBits_ &= ~(1u << depth_);
+    depth_++;
+    return true;
+}
+
+void JsonScanner::matchKeyChar(char c)
+{
+    if (keyPos_ == 0xFF)
+    {
+        keyCandidates_ = 0;
+        return;
+    }
+    for (uint8_t k = 0; keyCandidates_ >> k; ++k)
+    {
+        if (((keyCandidates_ >> k) & 1) && keys_[k][keyPos_] != c)
+        {
+            keyCandidates_ &= (uint16_t)~(1u << k);
+        }
+    }
+    keyPos_++;
+}
+
+bool JsonScanner::feed(const char *data, size_t length)
+{
+    if (state_ == FAILED)
+        return false;
+    if (state_ == DONE)
+        return true;
+
+    // Captures left open by the previous piece continue at the start of this one
+    for (uint8_t k = 0; k < keyCount_; ++k)
+    {
+        if ((capturingMask_ >> k) & 1)
+            runStart_[k] = data;
+    }
+
+    size_t i = 0;
+    for (; i < length && state_ != DONE && state_ != FAILED; ++i)
+    {
+        const char c = data[i];
+        const char *at = data + i;
+        const size_t offset = consumed_ + i;
+
+        switch (state_)
+        {
+        case IN_STRING:
+            if (c == '\\')
+            {
+                state_ = IN_STRING_ESCAPE;
+                if (stringIsKey_)
+                    keyCandidates_ = 0; // wanted keys never contain escapes
+            }
+            else if (c == '"')
+            {
+                if (stringIsKey_)
+                {
+                    // First still-wanted key whose full name matched
+                    pendingKey_ = MAX_KEYS;
+                    for (uint8_t k = 0; keyCandidates_ >> k; ++k)
+                    {
+                        if (((keyCandidates_ >> k) & 1) && keys_[k][keyPos_] == '\0')
+                        {
+                            pendingKey_ = k;
+                            break;
+                        }
+                    }
+                    state_ = EXPECT_COLON;
+                }
+                else
+                {
+                    if (scalarKey_ < MAX_KEYS)
+                        endCapture(scalarKey_, offset, at);
+                    valueCompleted();
+                }
+            }
+            else if (stringIsKey_ && keyCandidates_)
+            {
+                matchKeyChar(c);
+            }
+            break;
+
+        case IN_STRING_ESCAPE:
+            // \uXXXX needs no special care: hex digits are plain string chars
+            state_ = IN_STRING;
+            break;
+
+        case IN_LITERAL:
+            if (isLiteralChar(c))
+                break;
+            if (scalarKey_ < MAX_KEYS)
+                endCapture(scalarKey_, offset, at);
+            valueCompleted();
+            // The delimiter belongs to the enclosing container - process it again
+            if (state_ == AFTER_VALUE)
+                --i;
+            break;
+
+        case EXPECT_COLON:
+            if (c == ':')
+                state_ = EXPECT_VALUE;
+            else if (!isJsonWhitespace(c))
+                state_ = FAILED;
+            break;
+
+        case EXPECT_VALUE:
+        case EXPECT_VALUE_OR_END:
+        {
+            if (isJsonWhitespace(c))
+                break;
+            if (state_ == EXPECT_VALUE_OR_END && c == ']')
+            {
+                state_ = AFTER_VALUE;
+                --i; // handled as a container close below
+                break;
+            }
+
+            uint8_t key = pendingKey_;
+            pendingKey_ = MAX_KEYS;
+
+            if (c == '"')
+            {
+                stringIsKey_ = false;
+                scalarKey_ = MAX_KEYS;
+                state_ = IN_STRING;
+                if (key < MAX_KEYS)
+                {
+                    scalarKey_ = key;
+                    beginCapture(key, JSON_STRING, offset + 1, at + 1);
+                }
+            }
+            else if (c == '{' || c == '[')
+            {
+                if (!push(c == '{'))
+                    break;
+                if (key < MAX_KEYS)
+                {
+                    captureDepth_[key] = depth_;
+                    beginCapture(key, c == '{' ? JSON_OBJECT : JSON_ARRAY, offset, at);
+                }
+                state_ = c == '{' ? EXPECT_KEY_OR_END : EXPECT_VALUE_OR_END;
+            }
+            else if (isLiteralChar(c))
+            {
+                scalarKey_ = MAX_KEYS;
+                state_ = IN_LITERAL;
+                if (key < MAX_KEYS)
+                {
+                    scalarKey_ = key;
+                    beginCapture(key, JSON_LITERAL, offset, at);
+                }
+            }
+            else
+            {
+                state_ = FAILED;
+            }
+            break;
+        }
+
+        case EXPECT_KEY_OR_END:
+        case EXPECT_KEY:
+            if (isJsonWhitespace(c))
+                break;
+            if (c == '"')
+            {
+                stringIsKey_ = true;
+                keyCandidates_ = allMask_ & (uint16_t)~foundMask_; // first occurrence wins
+                keyPos_ = 0;
+                state_ = IN_STRING;
+            }
+            else if (c == '}' && state_ == EXPECT_KEY_OR_END)
+            {
+                state_ = AFTER_VALUE;
+                --i; // handled as a container close below
+            }
+            else
+            {
+                state_ = FAILED;
+            }
+            break;
+
+        case AFTER_VALUE:
+        {
+            if (isJsonWhitespace(c))
+                break;
+            bool inObject = depth_ > 0 && ((objectBits_ >> (depth_ - 1)) & 1);
+            if (c == ',' && depth_ > 0)
+            {
+                state_ = inObject ? EXPECT_KEY : EXPECT_VALUE;
+            }
+            else if ((c == '}' && inObject) || (c == ']' && depth_ > 0 && !inObject))
+            {
+                // Close captures of containers that end here (bracket included)
+                for (uint8_t k = 0; k < keyCount_; ++k)
+                {
+                    if (((capturingMask_ >> k) & 1) && k != scalarKey_ && captureDepth_[k] == depth_)
+                        endCapture(k, offset + 1, at + 1);
+                }
+                depth_--;
+                valueCompleted();
+            }
+            else
+            {
+                state_ = FAILED;
+            }
+            break;
+        }
+
+        case DONE:
+        case FAILED:
+            break;
+        }
+    }
+
+    // Hand over the bytes of captures that continue into the next piece, or
+    // that came before the offending byte, so a value cut short by bad input
+    // reads the same however the input was split
+    if (state_ != DONE)
+    {
+        const char *end = state_ == FAILED ? data + i - 1 : data + length;
+        for (uint8_t k = 0; k < keyCount_; ++k)
+        {
+            if (((capturingMask_ >> k) & 1) && end > runStart_[k])
+                onValueData(k, runStart_[k], end - runStart_[k]);
+        }
+    }
+
+    consumed_ += length;
+    return state_ != FAILED;
+}
+
+JsonCapture::JsonCapture(const char *const *keys, uint8_t keyCount, size_t maxValueLength)
+    : JsonScanner(keys, keyCount), maxValueLength_(maxValueLength)
+{
+    for (uint8_t k = 0; k < MAX_KEYS; ++k)
+    {
+        types_[k] = JSON_NONE;
+    }
+}
+
+void JsonCapture::reset()
+{
+    JsonScanner::reset();
+    for (uint8_t k = 0; k < MAX_KEYS; ++k)
+    {
+        values_[k] = "";
+        types_[k] = JSON_NONE;
+    }
+}
+
+void JsonCapture::onValueStart(uint8_t keyIndex, JsonValueType type, size_t /*offset*/)
+{
+    types_[keyIndex] = type;
+    values_[keyIndex] = "";
+}
+
+void JsonCapture::onValueData(uint8_t keyIndex, const char *data, size_t length)
+{
+    String &value = values_[keyIndex];
+    if (value.length() >= maxValueLength_)
+        return;
+    if (length > maxValueLength_ - value.length())
+        length = maxValueLength_ - value.length();
+    value.concat(data, length);
+}
+
+// Records value boundaries as views into the scanned buffer
+class JsonViewScanner : public JsonScanner
+{
+public:
+    JsonViewScanner(const char *json, const char *const *keys, JsonView *values, uint8_t keyCount)
+        : JsonScanner(keys, keyCount), json_(json), values_(values) {}
+
+protected:
+    void onValueStart(uint8_t keyIndex, JsonValueType type, size_t offset) override
+    {
+        values_[keyIndex].data = json_ + offset;
+        pendingTypes_[keyIndex] = type;
+    }
+
+    void onValueEnd(uint8_t keyIndex, size_t offset) override
+    {
+        // Only values that closed inside the buffer are reported
+        values_[keyIndex].length = (json_ + offset) - values_[keyIndex].data;
+        values_[keyIndex].type = pendingTypes_[keyIndex];
+    }
+
+private:
+    const char *json_;
+    JsonView *values_;
+    JsonValueType pendingTypes_[MAX_KEYS];
+};
+
+uint8_t scanJson(const char *json, size_t length, const char *const *keys, JsonView *values, uint8_t keyCount)
+{
+    for (uint8_t k = 0; k < keyCount; ++k)
+    {
+        values[k] = JsonView();
+    }
+    if (!json || length == 0)
+        return 0;
+
+    JsonViewScanner scanner(json, keys, values, keyCount);
+    scanner.feed(json, length);
+
+    uint8_t found = 0;
+    for (uint8_t k = 0; k < keyCount; ++k)
+    {
+        if (values[k].found())
+            found++;
+    }
+    return found;
+}
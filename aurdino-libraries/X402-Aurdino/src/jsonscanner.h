@@ -0,0 +1,146 @@
+#ifndef JSONSCANNER_H
+#define JSONSCANNER_H
+
+#include <Arduino.h>
+#include <utility>
+
+enum JsonValueType : uint8_t
+{
+    JSON_NONE = 0,
+    JSON_STRING,   // view excludes the quotes; escapes are left as-is
+    JSON_LITERAL,  // number, true, false or null
+    JSON_OBJECT,   // view includes the braces
+    JSON_ARRAY     // view includes the brackets
+};
+
+// Zero-copy view of one value inside a scanned buffer (not NUL-terminated)
+struct JsonView
+{
+    const char *data = nullptr;
+    size_t length = 0;
+    JsonValueType type = JSON_NONE;
+
+    bool found() const { return type != JSON_NONE; }
+    bool equals(const char *literal) const;
+    bool isTrue() const { return type == JSON_LITERAL && equals("true"); }
+
+    // Copy the raw value out (only when it must outlive the buffer)
+    String toString() const;
+};
+
+/**
+ * Single-pass, incremental JSON key scanner.
+ *
+ * Walks the document once, tracking nesting and string escapes, and reports
+ * the value of the first occurrence (at any depth) of each requested key.
+ * Input may arrive in arbitrary pieces through feed(); subclasses receive
+ * value boundaries as absolute offsets plus the value bytes of each piece.
+ * Keys inside string values never match, unlike an indexOf() search.
+ *
+ * Scanning stops at the end of the top-level value or as soon as every
+ * requested key has been captured; later input is ignored.
+ */
+class JsonScanner
+{
+public:
+    static const uint8_t MAX_KEYS = 16;
+    static const uint8_t MAX_DEPTH = 32;
+
+    // keys must outlive the scanner
+    JsonScanner(const char *const *keys, uint8_t keyCount);
+    virtual ~JsonScanner() {}
+
+    // Start over on a new document (also clears subclass results)
+    virtual void reset();
+
+    // Consume the next bytes; false once the input is known to be malformed
+    bool feed(const char *data, size_t length);
+
+    bool isComplete() const { return state_ == DONE; }
+    bool hasError() const { return state_ == FAILED; }
+    bool isFound(uint8_t keyIndex) const { return (foundMask_ >> keyIndex) & 1; }
+
+protected:
+    virtual void onValueStart(uint8_t /*keyIndex*/, JsonValueType /*type*/, size_t /*offset*/) {}
+    virtual void onValueData(uint8_t /*keyIndex*/, const char * /*data*/, size_t /*length*/) {}
+    virtual void onValueEnd(uint8_t /*keyIndex*/, size_t /*offset*/) {}
+
+private:
+    enum State : uint8_t
+    {
+        EXPECT_VALUE,
+        EXPECT_VALUE_OR_END, // just after '['
+        EXPECT_KEY,          // after ',' in an object
+        EXPECT_KEY_OR_END,   // just after '{'
+        EXPECT_COLON,
+        AFTER_VALUE,
+        IN_STRING,
+        IN_STRING_ESCAPE,
+        IN_LITERAL,
+        DONE,
+        FAILED
+    };
+
+    void beginCapture(uint8_t keyIndex, JsonValueType type, size_t offset, const char *at);
+    void endCapture(uint8_t keyIndex, size_t offset, const char *at);
+    void valueCompleted();
+    bool push(bool isObject);
+    void matchKeyChar(char c);
+
+    const char *const *keys_;
+    uint8_t keyCount_;
+    uint16_t allMask_;
+
+    State state_;
+    bool stringIsKey_;
+    uint8_t depth_;
+    uint32_t objectBits_;        // bit n set: container at depth n+1 is an object
+    size_t consumed_;            // bytes fed before the current piece
+
+    uint16_t keyCandidates_;     // keys still matching the key being read
+    uint8_t keyPos_;
+    uint8_t pendingKey_;         // key whose value comes next, or MAX_KEYS
+
+    uint16_t foundMask_;         // keys whose value started
+    uint16_t capturingMask_;     // keys whose value is still being captured
+    uint8_t scalarKey_;          // key capturing the current string/literal, or MAX_KEYS
+    uint8_t captureDepth_[MAX_KEYS];
+    const char *runStart_[MAX_KEYS]; // start of capture within the current piece
+};
+
+/**
+ * Scanner that copies the requested values into Strings as they stream past,
+ * so a response body never has to be held in memory - only these fields are.
+ * Values longer than maxValueLength are truncated.
+ */
+class JsonCapture : public JsonScanner
+{
+public:
+    JsonCapture(const char *const *keys, uint8_t keyCount, size_t maxValueLength = 256);
+
+    void reset() override;
+
+    const String &value(uint8_t keyIndex) const { return values_[keyIndex]; }
+    JsonValueType type(uint8_t keyIndex) const { return types_[keyIndex]; }
+    bool isTrue(uint8_t keyIndex) const { return types_[keyIndex] == JSON_LITERAL && values_[keyIndex] == "true"; }
+
+    // Hand a captured value over without copying it
+    String take(uint8_t keyIndex) { return std::move(values_[keyIndex]); }
+
+    // Same, for a field that should hold a string: null or any other type gives ""
+    String takeString(uint8_t keyIndex) { return types_[keyIndex] == JSON_STRING ? take(keyIndex) : String(); }
+
+protected:
+    void onValueStart(uint8_t keyIndex, JsonValueType type, size_t offset) override;
+    void onValueData(uint8_t keyIndex, const char *data, size_t length) override;
+
+private:
+    String values_[MAX_KEYS];
+    JsonValueType types_[MAX_KEYS];
+    size_t maxValueLength_;
+};
+
+// Scan a complete buffer once and fill values[i] for keys[i]; returns how many were found
+uint8_t scanJson(const char *json, size_t length, const char *const *keys, JsonView *values, uint8_t keyCount);
+
+#endif // JSONSCANNER_H
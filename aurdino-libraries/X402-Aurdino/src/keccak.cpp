@@ -0,0 +1,104 @@
+#include "keccak.h"
+
+static const uint64_t KeccakRoundConstants[24] = {
+    0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL, 0x8000000080008000ULL,
+    0x000000000000808bULL, 0x0000000080000001ULL, 0x8000000080008081ULL, 0x8000000000008009ULL,
+    0x000000000000008aULL, 0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000aULL,
+    0x000000008000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL, 0x8000000000008003ULL,
+    0x8000000000008002ULL, 0x8000000000000080ULL, 0x000000000000800aULL, 0x800000008000000aULL,
+    0x8000000080008081ULL, 0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL};
+
+// Rotation offsets and lane order of the combined rho/pi step
+static const uint8_t KeccakRotations[24] = {1, 3, 6, 10, 15, 21, 28, 36, 45, 55, 2, 14,
+                                            27, 41, 56, 8, 25, 43, 62, 18, 39, 61, 20, 44};
+static const uint8_t KeccakPiLanes[24] = {10, 7, 11, 17, 18, 3, 5, 16, 8, 21, 24, 4,
+                                          15, 23, 19, 13, 12, 2, 20, 14, 22, 9, 6, 1};
+
+static inline uint64_t rotl64(uint64_t x, uint8_t n)
+{
+    return (x << n) | (x >> (64 - n));
+}
+
+static void keccakF1600(uint64_t state[25])
+{
+    uint64_t c[5];
+    for (uint8_t round = 0; round < 24; ++round)
+    {
+        // theta
+        for (uint8_t x = 0; x < 5; ++x)
+            c[x] = state[x] ^ state[x + 5] ^ state[x + 10] ^ state[x + 15] ^ state[x + 20];
+        for (uint8_t x = 0; x < 5; ++x)
+        {
+            uint64_t d = c[(x + 4) % 5] ^ rotl64(c[(x + 1) % 5], 1);
+            for (uint8_t y = 0; y < 25; y += 5)
+                state[y + x] ^= d;
+        }
+
+        // rho and pi
+        uint64_t lane = state[1];
+        for (uint8_t i = 0; i < 24; ++i)
+        {
+            uint8_t j = KeccakPiLanes[i];
+            uint64_t next = state[j];
+            state[j] = rotl64(lane, KeccakRotations[i]);
+            lane = next;
+        }
+
+        // chi
+        for (uint8_t y = 0; y < 25; y += 5)
+        {
+            for (uint8_t x = 0; x < 5; ++x)
+                c[x] = state[y + x];
+            for (uint8_t x = 0; x < 5; ++x)
+                state[y + x] = c[x] ^ ((~c[(x + 1) % 5]) & c[(x + 2) % 5]);
+        }
+
+        // iota
+        state[0] ^= KeccakRoundConstants[round];
+    }
+}
+
+void Keccak256::reset()
+{
+    memset(state_, 0, sizeof(state_));
+    position_ = 0;
+}
+
+// Lanes are little-endian regardless of the host
+static inline void xorByte(uint64_t state[25], size_t index, uint8_t value)
+{
+    state[index / 8] ^= (uint64_t)value << (8 * (index % 8));
+}
+
+void Keccak256::update(const uint8_t *data, size_t length)
+{
+    for (size_t i = 0; i < length; ++i)
+    {
+        xorByte(state_, position_++, data[i]);
+        if (position_ == RATE)
+        {
+            keccakF1600(state_);
+            position_ = 0;
+        }
+    }
+}
+
+void Keccak256::finalize(uint8_t digest[DIGEST_SIZE])
+{
+    xorByte(state_, position_, 0x01);
+    xorByte(state_, RATE - 1, 0x80);
+    keccakF1600(state_);
+
+    for (size_t i = 0; i < DIGEST_SIZE; ++i)
+    {
+        digest[i] = (uint8_t)(state_[i / 8] >> (8 * (i % 8)));
+    }
+    reset();
+}
+
+void keccak256(const uint8_t *data, size_t length, uint8_t digest[Keccak256::DIGEST_SIZE])
+{
+    Keccak256 hash;
+    hash.update(data, length);
+    hash.finalize(digest);
+}
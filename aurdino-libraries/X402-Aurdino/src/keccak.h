@@ -0,0 +1,34 @@
+#ifndef KECCAK_H
+#define KECCAK_H
+
+#include <Arduino.h>
+
+/**
+ * Keccak-256 as used by Ethereum (original padding 0x01, not SHA3-256's 0x06).
+ *
+ * Incremental: update() any number of times, then finalize() once. The state
+ * is 200 bytes on the stack; no allocation.
+ */
+class Keccak256
+{
+public:
+    static const size_t DIGEST_SIZE = 32;
+
+    Keccak256() { reset(); }
+
+    void reset();
+    void update(const uint8_t *data, size_t length);
+    void update(const char *str) { update((const uint8_t *)str, strlen(str)); }
+    void finalize(uint8_t digest[DIGEST_SIZE]);
+
+private:
+    static const size_t RATE = 136; // bytes absorbed per permutation
+
+    uint64_t state_[25];
+    size_t position_; // bytes absorbed into the current block
+};
+
+// One-shot helper
+void keccak256(const uint8_t *data, size_t length, uint8_t digest[Keccak256::DIGEST_SIZE]);
+
+#endif // KECCAK_H
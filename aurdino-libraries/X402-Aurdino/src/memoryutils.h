@@ -9,6 +9,7 @@
 // Memory monitoring utilities for ESP32
 #ifdef ESP32
     #include <esp_system.h>
+    #include "metrics.h"
     
     // Get free heap memory
     inline uint32_t getFreeHeap() {
@@ -121,16 +122,22 @@ public:
     }
 };
 
-// Macro for memory monitoring
+// Macro for memory monitoring - always feeds the metrics registry,
+// prints only in DEBUG_MEMORY builds
+#ifndef METRICS_RECORD
+    #define METRICS_RECORD(label)
+#endif
+
 #ifdef DEBUG_MEMORY
     #define MEMORY_CHECKPOINT(label) \
+        METRICS_RECORD(label); \
         Serial.print("MEMORY ["); \
         Serial.print(label); \
         Serial.print("]: "); \
         Serial.print(getFreeHeap()); \
         Serial.println(" bytes free");
 #else
-    #define MEMORY_CHECKPOINT(label) // No-op in production
+    #define MEMORY_CHECKPOINT(label) METRICS_RECORD(label)
 #endif
 
 #endif // MEMORYUTILS_H
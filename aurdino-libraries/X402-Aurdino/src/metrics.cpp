@@ -0,0 +1,392 @@
+#include "metrics.h"
+#include "memoryutils.h"
+#include "stackmonitor.h"
+#include <freertos/task.h>
+#ifdef ESP32
+#include <esp_heap_caps.h>
+#endif
+
+static uint32_t currentAllocatedBlocks()
+{
+#ifdef ESP32
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, MALLOC_CAP_DEFAULT);
+    return info.allocated_blocks;
+#else
+    return 0;
+#endif
+}
+
+static uint8_t heapBucket(uint32_t freeHeap)
+{
+    uint8_t bucket = 0;
+    uint32_t threshold = 4096;
+    while (bucket < X402_METRICS_HEAP_BUCKETS - 1 && freeHeap >= threshold)
+    {
+        bucket++;
+        threshold <<= 1;
+    }
+    return bucket;
+}
+
+MetricsRegistry &MetricsRegistry::instance()
+{
+    static MetricsRegistry registry;
+    return registry;
+}
+
+MetricsRegistry::MetricsRegistry()
+    : enabled_(true), mux_(portMUX_INITIALIZER_UNLOCKED)
+{
+    reset();
+}
+
+void MetricsRegistry::reset()
+{
+    portENTER_CRITICAL(&mux_);
+    memset(checkpoints_, 0, sizeof(checkpoints_));
+    memset(tasks_, 0, sizeof(tasks_));
+    memset(&payments_, 0, sizeof(payments_));
+    checkpointCount_ = 0;
+    taskCount_ = 0;
+    activePayments_ = 0;
+    paymentStartFree_ = 0;
+    paymentStartBlocks_ = 0;
+    paymentLowFree_ = 0;
+    paymentHighBlocks_ = 0;
+    portEXIT_CRITICAL(&mux_);
+}
+
+// Called with mux_ held
+MetricsCheckpoint *MetricsRegistry::findOrAddCheckpoint(const char *label)
+{
+    // Labels are string literals: pointer compare first, text only on a miss
+    for (uint8_t i = 0; i < checkpointCount_; ++i)
+    {
+        if (checkpoints_[i].label == label)
+            return &checkpoints_[i];
+    }
+    for (uint8_t i = 0; i < checkpointCount_; ++i)
+    {
+        if (strcmp(checkpoints_[i].label, label) == 0)
+            return &checkpoints_[i];
+    }
+    if (checkpointCount_ >= X402_METRICS_MAX_CHECKPOINTS)
+        return nullptr;
+
+    MetricsCheckpoint *cp = &checkpoints_[checkpointCount_++];
+    cp->label = label;
+    cp->minFreeHeap = UINT32_MAX;
+    cp->minFreeStack = UINT32_MAX;
+    return cp;
+}
+
+// Called with mux_ held
+void MetricsRegistry::recordTask(uint32_t freeStack)
+{
+    TaskHandle_t handle = xTaskGetCurrentTaskHandle();
+    for (uint8_t i = 0; i < taskCount_; ++i)
+    {
+        if (tasks_[i].handle == handle)
+        {
+            if (freeStack < tasks_[i].minFreeStack)
+                tasks_[i].minFreeStack = freeStack;
+            return;
+        }
+    }
+    if (taskCount_ >= X402_METRICS_MAX_TASKS)
+        return;
+
+    MetricsTask &task = tasks_[taskCount_++];
+    task.handle = handle;
+    strncpy(task.name, pcTaskGetName(handle), sizeof(task.name) - 1);
+    task.name[sizeof(task.name) - 1] = '\0';
+    task.minFreeStack = freeStack;
+}
+
+void MetricsRegistry::checkpoint(const char *label)
+{
+    if (!enabled_ || !label)
+        return;
+
+    // Sample outside the critical section
+    uint32_t freeHeap = getFreeHeap();
+    uint8_t fragmentation = getHeapFragmentation();
+    uint32_t freeStack = getStackHighWaterMark();
+    uint32_t blocks = activePayments_ ? currentAllocatedBlocks() : 0;
+
+    portENTER_CRITICAL(&mux_);
+    MetricsCheckpoint *cp = findOrAddCheckpoint(label);
+    if (cp)
+    {
+        cp->hits++;
+        if (freeHeap < cp->minFreeHeap)
+            cp->minFreeHeap = freeHeap;
+        if (freeStack < cp->minFreeStack)
+            cp->minFreeStack = freeStack;
+        if (fragmentation > cp->maxFragmentation)
+            cp->maxFragmentation = fragmentation;
+        cp->heapHistogram[heapBucket(freeHeap)]++;
+    }
+    recordTask(freeStack);
+    if (activePayments_)
+    {
+        if (freeHeap < paymentLowFree_)
+            paymentLowFree_ = freeHeap;
+        if (blocks > paymentHighBlocks_)
+            paymentHighBlocks_ = blocks;
+    }
+    portEXIT_CRITICAL(&mux_);
+}
+
+void MetricsRegistry::beginPayment()
+{
+    if (!enabled_)
+        return;
+
+    uint32_t freeHeap = getFreeHeap();
+    uint32_t blocks = currentAllocatedBlocks();
+
+    portENTER_CRITICAL(&mux_);
+    if (activePayments_++ == 0)
+    {
+        paymentStartFree_ = freeHeap;
+        paymentStartBlocks_ = blocks;
+        paymentLowFree_ = freeHeap;
+        paymentHighBlocks_ = blocks;
+    }
+    portEXIT_CRITICAL(&mux_);
+}
+
+void MetricsRegistry::endPayment()
+{
+    if (!enabled_)
+        return;
+
+    portENTER_CRITICAL(&mux_);
+    if (activePayments_ > 0)
+    {
+        payments_.count++;
+        // Peak since the first of the overlapping payments began
+        uint32_t peakBytes = paymentStartFree_ > paymentLowFree_ ? paymentStartFree_ - paymentLowFree_ : 0;
+        uint32_t peakBlocks = paymentHighBlocks_ > paymentStartBlocks_ ? paymentHighBlocks_ - paymentStartBlocks_ : 0;
+        if (peakBytes > payments_.maxPeakBytes)
+            payments_.maxPeakBytes = peakBytes;
+        if (peakBlocks > payments_.maxPeakBlocks)
+            payments_.maxPeakBlocks = peakBlocks;
+        payments_.totalPeakBytes += peakBytes;
+        payments_.totalPeakBlocks += peakBlocks;
+        activePayments_--;
+    }
+    portEXIT_CRITICAL(&mux_);
+}
+
+bool MetricsRegistry::getCheckpoint(uint8_t index, MetricsCheckpoint &out) const
+{
+    bool ok = false;
+    portENTER_CRITICAL(&mux_);
+    if (index < checkpointCount_)
+    {
+        out = checkpoints_[index];
+        ok = true;
+    }
+    portEXIT_CRITICAL(&mux_);
+    return ok;
+}
+
+bool MetricsRegistry::getTask(uint8_t index, MetricsTask &out) const
+{
+    bool ok = false;
+    portENTER_CRITICAL(&mux_);
+    if (index < taskCount_)
+    {
+        out = tasks_[index];
+        ok = true;
+    }
+    portEXIT_CRITICAL(&mux_);
+    return ok;
+}
+
+MetricsPayments MetricsRegistry::getPayments() const
+{
+    portENTER_CRITICAL(&mux_);
+    MetricsPayments copy = payments_;
+    portEXIT_CRITICAL(&mux_);
+    return copy;
+}
+
+// Snapshot layout (little-endian):
+//   'X' 'M' version checkpointCount taskCount 0
+//   uptimeMs freeHeap minFreeHeap maxAllocHeap (u32) fragmentation (u8)
+//   payments: count maxPeakBytes totalPeakBytes maxPeakBlocks totalPeakBlocks (u32)
+//   per checkpoint: labelLen (u8) label hits minFreeHeap minFreeStack (u32)
+//                   maxFragmentation (u8) heapHistogram (u32 x 8)
+//   per task: nameLen (u8) name minFreeStack (u32)
+static const size_t SNAPSHOT_HEADER_SIZE = 6 + 17 + 20;
+static const size_t SNAPSHOT_CHECKPOINT_SIZE = 1 + 12 + 1 + 4 * X402_METRICS_HEAP_BUCKETS;
+static const size_t SNAPSHOT_TASK_SIZE = 1 + 4;
+
+static inline uint8_t *putU32(uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+    return p + 4;
+}
+
+static inline uint8_t labelLength(const char *label)
+{
+    size_t len = strlen(label);
+    return len > 255 ? 255 : (uint8_t)len;
+}
+
+size_t MetricsRegistry::getSnapshotSize() const
+{
+    size_t size = SNAPSHOT_HEADER_SIZE;
+    portENTER_CRITICAL(&mux_);
+    for (uint8_t i = 0; i < checkpointCount_; ++i)
+        size += SNAPSHOT_CHECKPOINT_SIZE + labelLength(checkpoints_[i].label);
+    for (uint8_t i = 0; i < taskCount_; ++i)
+        size += SNAPSHOT_TASK_SIZE + strlen(tasks_[i].name);
+    portEXIT_CRITICAL(&mux_);
+    return size;
+}
+
+size_t MetricsRegistry::snapshot(uint8_t *buffer, size_t capacity) const
+{
+    if (!buffer)
+        return 0;
+
+    // Heap figures are read before taking the lock
+    uint32_t freeHeap = getFreeHeap();
+    uint32_t maxAlloc = getMaxAllocHeap();
+    uint32_t minFree = getMinFreeHeap();
+    uint8_t fragmentation = getHeapFragmentation();
+
+    size_t needed = getSnapshotSize();
+    if (capacity < needed)
+        return 0;
+
+    uint8_t *p = buffer;
+    portENTER_CRITICAL(&mux_);
+    // Tables may have grown since getSnapshotSize() - only dump what fits
+    uint8_t cpCount = 0, taskCount = 0;
+    size_t used = SNAPSHOT_HEADER_SIZE;
+    while (cpCount < checkpointCount_ &&
+           used + SNAPSHOT_CHECKPOINT_SIZE + labelLength(checkpoints_[cpCount].label) <= capacity)
+        used += SNAPSHOT_CHECKPOINT_SIZE + labelLength(checkpoints_[cpCount++].label);
+    while (taskCount < taskCount_ &&
+           used + SNAPSHOT_TASK_SIZE + strlen(tasks_[taskCount].name) <= capacity)
+        used += SNAPSHOT_TASK_SIZE + strlen(tasks_[taskCount++].name);
+
+    *p++ = 'X';
+    *p++ = 'M';
+    *p++ = X402_METRICS_SNAPSHOT_VERSION;
+    *p++ = cpCount;
+    *p++ = taskCount;
+    *p++ = 0;
+    p = putU32(p, millis());
+    p = putU32(p, freeHeap);
+    p = putU32(p, minFree);
+    p = putU32(p, maxAlloc);
+    *p++ = fragmentation;
+    p = putU32(p, payments_.count);
+    p = putU32(p, payments_.maxPeakBytes);
+    p = putU32(p, payments_.totalPeakBytes);
+    p = putU32(p, payments_.maxPeakBlocks);
+    p = putU32(p, payments_.totalPeakBlocks);
+
+    for (uint8_t i = 0; i < cpCount; ++i)
+    {
+        const MetricsCheckpoint &cp = checkpoints_[i];
+        uint8_t len = labelLength(cp.label);
+        *p++ = len;
+        memcpy(p, cp.label, len);
+        p += len;
+        p = putU32(p, cp.hits);
+        p = putU32(p, cp.minFreeHeap);
+        p = putU32(p, cp.minFreeStack);
+        *p++ = cp.maxFragmentation;
+        for (uint8_t b = 0; b < X402_METRICS_HEAP_BUCKETS; ++b)
+            p = putU32(p, cp.heapHistogram[b]);
+    }
+    for (uint8_t i = 0; i < taskCount; ++i)
+    {
+        const MetricsTask &task = tasks_[i];
+        uint8_t len = (uint8_t)strlen(task.name);
+        *p++ = len;
+        memcpy(p, task.name, len);
+        p += len;
+        p = putU32(p, task.minFreeStack);
+    }
+    portEXIT_CRITICAL(&mux_);
+
+    return p - buffer;
+}
+
+String MetricsRegistry::toSummaryJson() const
+{
+    MetricsPayments payments = getPayments();
+
+    // Task closest to overflowing its stack
+    MetricsTask worst;
+    worst.name[0] = '\0';
+    worst.minFreeStack = 0;
+    bool haveTask = false;
+    MetricsTask task;
+    for (uint8_t i = 0; getTask(i, task); ++i)
+    {
+        if (!haveTask || task.minFreeStack < worst.minFreeStack)
+        {
+            worst = task;
+            haveTask = true;
+        }
+    }
+
+    String json;
+    json.reserve(200);
+    json = "{\"heap\":";
+    json += getFreeHeap();
+    json += ",\"minHeap\":";
+    json += getMinFreeHeap();
+    json += ",\"maxBlock\":";
+    json += getMaxAllocHeap();
+    json += ",\"frag\":";
+    json += getHeapFragmentation();
+    json += ",\"payments\":";
+    json += payments.count;
+    json += ",\"peakBytes\":";
+    json += payments.maxPeakBytes;
+    json += ",\"avgPeakBytes\":";
+    json += payments.count ? payments.totalPeakBytes / payments.count : 0;
+    json += ",\"peakBlocks\":";
+    json += payments.maxPeakBlocks;
+    json += ",\"minStack\":";
+    json += worst.minFreeStack;
+    json += ",\"minStackTask\":\"";
+    json += worst.name;
+    json += "\",\"checkpoints\":";
+    json += checkpointCount_;
+    json += "}";
+    return json;
+}
+
+void MetricsRegistry::print() const
+{
+    Serial.println("=== X402 Metrics ===");
+    Serial.println(toSummaryJson());
+    MetricsCheckpoint cp;
+    for (uint8_t i = 0; getCheckpoint(i, cp); ++i)
+    {
+        Serial.printf("%-40s hits=%u minHeap=%u minStack=%u frag=%u%%\n",
+                      cp.label, (unsigned)cp.hits, (unsigned)cp.minFreeHeap,
+                      (unsigned)cp.minFreeStack, (unsigned)cp.maxFragmentation);
+    }
+    MetricsTask task;
+    for (uint8_t i = 0; getTask(i, task); ++i)
+    {
+        Serial.printf("task %-16s minStack=%u\n", task.name, (unsigned)task.minFreeStack);
+    }
+    Serial.println("====================");
+}
@@ -0,0 +1,126 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+
+// Metrics are recorded by default; define X402_DISABLE_METRICS to compile
+// MEMORY_CHECKPOINT / STACK_CHECKPOINT back to pure debug prints.
+#ifndef X402_DISABLE_METRICS
+    #define X402_METRICS
+#endif
+
+#define X402_METRICS_MAX_CHECKPOINTS 32
+#define X402_METRICS_MAX_TASKS 8
+#define X402_METRICS_HEAP_BUCKETS 8
+
+// Binary snapshot format version (first bytes are 'X' 'M' <version>)
+#define X402_METRICS_SNAPSHOT_VERSION 1
+
+// Per-checkpoint statistics
+struct MetricsCheckpoint
+{
+    const char *label;
+    uint32_t hits;
+    uint32_t minFreeHeap;       // bytes
+    uint32_t minFreeStack;      // bytes, of whichever task passed here
+    uint8_t maxFragmentation;   // percent, from getHeapFragmentation()
+    // Free heap at each hit: <4KB, <8KB, ... <256KB, >=256KB
+    uint32_t heapHistogram[X402_METRICS_HEAP_BUCKETS];
+};
+
+// Lowest stack high-water mark seen per task
+struct MetricsTask
+{
+    void *handle;
+    char name[16];
+    uint32_t minFreeStack;      // bytes
+};
+
+// Heap use while payments are in flight (overlapping payments count together)
+struct MetricsPayments
+{
+    uint32_t count;
+    uint32_t maxPeakBytes;      // heap taken at the worst point of a payment
+    uint32_t totalPeakBytes;
+    uint32_t maxPeakBlocks;     // heap blocks allocated at that point
+    uint32_t totalPeakBlocks;
+};
+
+/**
+ * Low-overhead metrics registry fed by MEMORY_CHECKPOINT / STACK_CHECKPOINT.
+ *
+ * Each checkpoint costs a free-heap read, a largest-block lookup and a stack
+ * high-water mark scan; fixed tables, no allocation. While a payment is in
+ * flight checkpoints also walk the heap for the allocated block count.
+ * Safe to call from any task.
+ */
+class MetricsRegistry
+{
+public:
+    static MetricsRegistry &instance();
+
+    void checkpoint(const char *label);
+
+    // Bracket one payment (verify through settle)
+    void beginPayment();
+    void endPayment();
+
+    void reset();
+    void setEnabled(bool enabled) { enabled_ = enabled; }
+    bool isEnabled() const { return enabled_; }
+
+    uint8_t getCheckpointCount() const { return checkpointCount_; }
+    uint8_t getTaskCount() const { return taskCount_; }
+
+    // Copies taken under the lock
+    bool getCheckpoint(uint8_t index, MetricsCheckpoint &out) const;
+    bool getTask(uint8_t index, MetricsTask &out) const;
+    MetricsPayments getPayments() const;
+
+    // Compact little-endian dump of everything; returns bytes written,
+    // or 0 if buffer is too small (see getSnapshotSize())
+    size_t getSnapshotSize() const;
+    size_t snapshot(uint8_t *buffer, size_t capacity) const;
+
+    // Short JSON summary: heap, per-payment peaks and the tightest task stack
+    String toSummaryJson() const;
+
+    // Full table over Serial
+    void print() const;
+
+private:
+    MetricsRegistry();
+
+    MetricsCheckpoint *findOrAddCheckpoint(const char *label);
+    void recordTask(uint32_t freeStack);
+
+    bool enabled_;
+    MetricsCheckpoint checkpoints_[X402_METRICS_MAX_CHECKPOINTS];
+    uint8_t checkpointCount_;
+    MetricsTask tasks_[X402_METRICS_MAX_TASKS];
+    uint8_t taskCount_;
+    MetricsPayments payments_;
+
+    uint8_t activePayments_;
+    uint32_t paymentStartFree_;
+    uint32_t paymentStartBlocks_;
+    uint32_t paymentLowFree_;
+    uint32_t paymentHighBlocks_;
+
+    mutable portMUX_TYPE mux_;
+};
+
+// Entry point for the checkpoint macros
+inline void metricsCheckpoint(const char *label)
+{
+    MetricsRegistry::instance().checkpoint(label);
+}
+
+#ifdef X402_METRICS
+    #define METRICS_RECORD(label) metricsCheckpoint(label)
+#else
+    #define METRICS_RECORD(label)
+#endif
+
+#endif // METRICS_H
@@ -1,6 +1,9 @@
 #include "paymentutils.h"
 #include "X402Aurdino.h"
 #include "stackmonitor.h"
+#include "facilitatorconnection.h"
+#include "facilitatorregistry.h"
+#include "jsonscanner.h"
 
 // Helper function to escape JSON strings - Memory optimized
 String escapeJsonString(const String& str) {
@@ -23,63 +26,14 @@ String escapeJsonString(const String& str) {
     return escaped;
 }
 
-// Helper function to extract value from JSON string - Memory optimized
+// Helper function to extract value from JSON string - single pass, no temporaries
 String extractJsonValue(const String& json, const String& key) {
-    // Build search key without concatenation
-    String searchKey;
-    searchKey.reserve(key.length() + 4);
-    searchKey = '"';
-    searchKey += key;
-    searchKey += "\":";
-    
-    int startIndex = json.indexOf(searchKey);
-    if (startIndex == -1) {
-        searchKey = "";  // Free memory immediately
+    const char *keys[] = {key.c_str()};
+    JsonView value;
+    if (!scanJson(json.c_str(), json.length(), keys, &value, 1)) {
         return "";
     }
-    
-    startIndex += searchKey.length();
-    searchKey = "";  // Free memory immediately after use
-    
-    // Skip whitespace
-    while (startIndex < json.length() && (json.charAt(startIndex) == ' ' || json.charAt(startIndex) == '\t')) {
-        startIndex++;
-    }
-    
-    if (startIndex >= json.length()) return "";
-    
-    char firstChar = json.charAt(startIndex);
-    if (firstChar == '"') {
-        // String value
-        startIndex++; // Skip opening quote
-        int endIndex = startIndex;
-        while (endIndex < json.length() && json.charAt(endIndex) != '"') {
-            if (json.charAt(endIndex) == '\\') {
-                endIndex += 2; // Skip escaped character
-            } else {
-                endIndex++;
-            }
-        }
-        return json.substring(startIndex, endIndex);
-    } else if (firstChar == 't' || firstChar == 'f') {
-        // Boolean value
-        if (json.substring(startIndex, startIndex + 4) == "true") return "true";
-        if (json.substring(startIndex, startIndex + 5) == "false") return "false";
-        return "";
-    } else {
-        // Number or other value
-        int endIndex = startIndex;
-        while (endIndex < json.length() && 
-               json.charAt(endIndex) != ',' && 
-               json.charAt(endIndex) != '}' && 
-               json.charAt(endIndex) != ']' &&
-               json.charAt(endIndex) != ' ' &&
-               json.charAt(endIndex) != '\t' &&
-               json.charAt(endIndex) != '\n') {
-            endIndex++;
-        }
-        return json.substring(startIndex, endIndex);
-    }
+    return value.toString();
 }
 
 // Parse a complete payment JSON string into PaymentPayload struct
@@ -146,32 +100,62 @@ String createPaymentRequestJson(const PaymentPayload &decodedSignedPayload, cons
     return json;
 }
 
-HttpResponse makePaymentApiCall(const String &endpoint, const PaymentPayload &decodedSignedPayload, const String &paymentRequirements, const String &customHeaders)
+void gatherPaymentRequestJson(const PaymentPayload &decodedSignedPayload, const String &paymentRequirements, String &version, GatherStream &body)
 {
-    STACK_CHECKPOINT("makePaymentApiCall:start");
+    const String *payloadJson = &decodedSignedPayload.payloadJson;
     
-    // Build URL without concatenation - Memory optimized
-    String url;
-    url.reserve(strlen(DEFAULT_FACILITATOR_URL) + endpoint.length() + 2);
-    url = DEFAULT_FACILITATOR_URL;
-    url += '/';
-    url += endpoint;
+    // Same auto-fix as createPaymentRequestJson() for swapped fields
+    if (decodedSignedPayload.payloadJson.length() == 0 && decodedSignedPayload.x402Version.length() > 10) {
+        payloadJson = &decodedSignedPayload.x402Version;
+        version = extractJsonValue(*payloadJson, "x402Version");
+        if (version.length() == 0) {
+            version = "1";
+        }
+    } else {
+        version = decodedSignedPayload.x402Version;
+    }
     
-    STACK_CHECKPOINT("makePaymentApiCall:after_url");
+    body.add("{\"x402Version\":", 15);
+    body.add(version);
+    body.add(",\"paymentPayload\":", 18);
+    body.add(*payloadJson);
+    body.add(",\"paymentRequirements\":", 23);
+    body.add(paymentRequirements);
+    body.add("}", 1);
+}
+
+HttpResponse makePaymentApiCall(const String &endpoint, const PaymentPayload &decodedSignedPayload, const String &paymentRequirements, const String &customHeaders, FacilitatorConnection *connection)
+{
+    STACK_CHECKPOINT("makePaymentApiCall:start");
     
-    // Create payload
-    String jsonPayload = createPaymentRequestJson(decodedSignedPayload, paymentRequirements);
+    // Stream the envelope from its parts - no joined copy of the payload
+    String version;
+    GatherStream body;
+    gatherPaymentRequestJson(decodedSignedPayload, paymentRequirements, version, body);
     
     STACK_CHECKPOINT("makePaymentApiCall:after_payload");
     
-    // Make request and get response
-    HttpResponse response = postJson(url, jsonPayload, customHeaders);
-    
-    // Free temporary strings immediately
-    url = "";
-    jsonPayload = "";
+    // Reuse the kept-alive facilitator socket instead of a fresh TLS handshake
+    FacilitatorConnection &conn = connection ? *connection : FacilitatorConnection::shared();
+    HttpResponse response = FacilitatorRegistry::instance().post(endpoint, body, nullptr, customHeaders, conn);
     
     STACK_CHECKPOINT("makePaymentApiCall:end");
     
     return response;
-}
\ No newline at end of file
+}
+
+HttpResponse makePaymentApiCall(const String &endpoint, const PaymentPayload &decodedSignedPayload, const String &paymentRequirements, JsonScanner &scanner, const String &customHeaders, FacilitatorConnection *connection)
+{
+    STACK_CHECKPOINT("makePaymentApiCall:stream:start");
+    
+    String version;
+    GatherStream body;
+    gatherPaymentRequestJson(decodedSignedPayload, paymentRequirements, version, body);
+    
+    FacilitatorConnection &conn = connection ? *connection : FacilitatorConnection::shared();
+    HttpResponse response = FacilitatorRegistry::instance().post(endpoint, body, &scanner, customHeaders, conn);
+    
+    STACK_CHECKPOINT("makePaymentApiCall:stream:end");
+    
+    return response;
+}
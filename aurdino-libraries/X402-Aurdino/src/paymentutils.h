@@ -4,8 +4,10 @@
 #include <Arduino.h>
 #include "httputils.h"
 
-// Forward declaration
+// Forward declarations
 struct PaymentPayload;
+class FacilitatorConnection;
+class JsonScanner;
 
 // Helper function to escape JSON strings
 String escapeJsonString(const String& str);
@@ -19,7 +21,19 @@ PaymentPayload parsePaymentString(const String& paymentJsonStr);
 // Helper function to create payment request JSON payload
 String createPaymentRequestJson(const PaymentPayload &decodedSignedPayload, const String &paymentRequirements);
 
+// Lay out the same envelope as createPaymentRequestJson() over the existing
+// strings without copying them. version receives the x402Version to send and
+// must outlive body, like decodedSignedPayload and paymentRequirements.
+void gatherPaymentRequestJson(const PaymentPayload &decodedSignedPayload, const String &paymentRequirements, String &version, GatherStream &body);
+
 // Helper function to make payment API call
-HttpResponse makePaymentApiCall(const String &endpoint, const PaymentPayload &decodedSignedPayload, const String &paymentRequirements, const String &customHeaders = "");
+// Uses the shared keep-alive facilitator connection when none is given.
+// Once facilitators are registered in FacilitatorRegistry the call is routed
+// over them (best first, with failover) instead of the connection's base URL,
+// and back to the base URL once they are cleared.
+HttpResponse makePaymentApiCall(const String &endpoint, const PaymentPayload &decodedSignedPayload, const String &paymentRequirements, const String &customHeaders = "", FacilitatorConnection *connection = nullptr);
+
+// Same, but streams the response body into scanner (response.body stays empty)
+HttpResponse makePaymentApiCall(const String &endpoint, const PaymentPayload &decodedSignedPayload, const String &paymentRequirements, JsonScanner &scanner, const String &customHeaders = "", FacilitatorConnection *connection = nullptr);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,467 @@
+#include "precheck.h"
+#include "jsonscanner.h"
+#include "keccak.h"
+#include <time.h>
+
+#if __has_include(<mbedtls/ecp.h>)
+    #include <mbedtls/ecp.h>
+    #include <mbedtls/bignum.h>
+#endif
+
+#if defined(MBEDTLS_ECP_DP_SECP256K1_ENABLED)
+    #define X402_PRECHECK_ECRECOVER
+#endif
+
+// keccak256("EIP712Domain(string name,string version,uint256 chainId,address verifyingContract)")
+static const uint8_t DomainTypeHash[32] = {
+    0x8b, 0x73, 0xc3, 0xc6, 0x9b, 0xb8, 0xfe, 0x3d, 0x51, 0x2e, 0xcc, 0x4c, 0xf7, 0x59, 0xcc, 0x79,
+    0x23, 0x9f, 0x7b, 0x17, 0x9b, 0x0f, 0xfa, 0xca, 0xa9, 0xa7, 0x5d, 0x52, 0x2b, 0x39, 0x40, 0x0f};
+
+// keccak256("TransferWithAuthorization(address from,address to,uint256 value,uint256 validAfter,uint256 validBefore,bytes32 nonce)")
+static const uint8_t TransferTypeHash[32] = {
+    0x7c, 0x7c, 0x6c, 0xdb, 0x67, 0xa1, 0x87, 0x43, 0xf4, 0x9e, 0xc6, 0xfa, 0x9b, 0x35, 0xf5, 0x0d,
+    0x52, 0xed, 0x05, 0xcb, 0xed, 0x4c, 0xc5, 0x92, 0xe1, 0x3b, 0x44, 0x50, 0x1c, 0x1a, 0x22, 0x67};
+
+// Anything earlier means the clock was never set
+static const uint32_t MIN_PLAUSIBLE_UNIX_TIME = 1700000000;
+
+static int hexNibble(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+// "0x" + exactly 2 * length hex digits
+static bool parseHex(const char *hex, size_t hexLength, uint8_t *out, size_t length)
+{
+    if (hexLength != 2 + 2 * length || hex[0] != '0' || (hex[1] != 'x' && hex[1] != 'X'))
+        return false;
+
+    hex += 2;
+    for (size_t i = 0; i < length; ++i)
+    {
+        int hi = hexNibble(hex[2 * i]);
+        int lo = hexNibble(hex[2 * i + 1]);
+        if (hi < 0 || lo < 0)
+            return false;
+        out[i] = (uint8_t)((hi << 4) | lo);
+    }
+    return true;
+}
+
+// Decimal string -> 32-byte big-endian uint256
+static bool parseUint256(const char *dec, size_t length, uint8_t out[32])
+{
+    if (length == 0 || length > 78)
+        return false;
+
+    memset(out, 0, 32);
+    for (size_t i = 0; i < length; ++i)
+    {
+        if (dec[i] < '0' || dec[i] > '9')
+            return false;
+
+        uint16_t carry = (uint16_t)(dec[i] - '0');
+        for (int b = 31; b >= 0; --b)
+        {
+            uint16_t v = (uint16_t)(out[b] * 10 + carry);
+            out[b] = (uint8_t)v;
+            carry = v >> 8;
+        }
+        if (carry)
+            return false; // overflow
+    }
+    return true;
+}
+
+// Left-pad an address into a 32-byte ABI word
+static bool encodeAddress(const char *hex, uint8_t word[32])
+{
+    memset(word, 0, 12);
+    return parseHex(hex, strlen(hex), word + 12, 20);
+}
+
+static void hashString(const char *s, uint8_t digest[32])
+{
+    keccak256((const uint8_t *)s, strlen(s), digest);
+}
+
+bool hashTransferWithAuthorization(const char *name, const char *version, uint32_t chainId, const char *verifyingContract,
+                                   const char *from, const char *to, const char *value,
+                                   const char *validAfter, const char *validBefore, const char *nonce,
+                                   uint8_t digest[32])
+{
+    uint8_t word[32];
+    Keccak256 hash;
+
+    // domainSeparator = keccak(typeHash, keccak(name), keccak(version), chainId, verifyingContract)
+    uint8_t domainSeparator[32];
+    hash.update(DomainTypeHash, 32);
+    hashString(name, word);
+    hash.update(word, 32);
+    hashString(version, word);
+    hash.update(word, 32);
+    memset(word, 0, 28);
+    word[28] = (uint8_t)(chainId >> 24);
+    word[29] = (uint8_t)(chainId >> 16);
+    word[30] = (uint8_t)(chainId >> 8);
+    word[31] = (uint8_t)chainId;
+    hash.update(word, 32);
+    if (!encodeAddress(verifyingContract, word))
+        return false;
+    hash.update(word, 32);
+    hash.finalize(domainSeparator);
+
+    // structHash = keccak(typeHash, from, to, value, validAfter, validBefore, nonce)
+    uint8_t structHash[32];
+    hash.update(TransferTypeHash, 32);
+    if (!encodeAddress(from, word))
+        return false;
+    hash.update(word, 32);
+    if (!encodeAddress(to, word))
+        return false;
+    hash.update(word, 32);
+    if (!parseUint256(value, strlen(value), word))
+        return false;
+    hash.update(word, 32);
+    if (!parseUint256(validAfter, strlen(validAfter), word))
+        return false;
+    hash.update(word, 32);
+    if (!parseUint256(validBefore, strlen(validBefore), word))
+        return false;
+    hash.update(word, 32);
+    if (!parseHex(nonce, strlen(nonce), word, 32))
+        return false;
+    hash.update(word, 32);
+    hash.finalize(structHash);
+
+    static const uint8_t prefix[2] = {0x19, 0x01};
+    hash.update(prefix, 2);
+    hash.update(domainSeparator, 32);
+    hash.update(structHash, 32);
+    hash.finalize(digest);
+    return true;
+}
+
+#ifdef X402_PRECHECK_ECRECOVER
+
+// Copy a view into a NUL-terminated buffer; false if it does not fit
+static bool copyView(const JsonView &view, char *out, size_t capacity)
+{
+    if (view.type != JSON_STRING && view.type != JSON_LITERAL)
+        return false;
+    if (view.length >= capacity)
+        return false;
+    memcpy(out, view.data, view.length);
+    out[view.length] = '\0';
+    return true;
+}
+
+bool recoverEvmAddress(const uint8_t digest[32], const uint8_t signature[65], uint8_t address[20])
+{
+    uint8_t v = signature[64];
+    if (v >= 27)
+        v -= 27;
+    if (v > 1)
+        return false;
+
+    mbedtls_ecp_group grp;
+    mbedtls_ecp_point R, Q;
+    mbedtls_mpi r, s, e, x, y, t, u1, u2;
+    mbedtls_ecp_group_init(&grp);
+    mbedtls_ecp_point_init(&R);
+    mbedtls_ecp_point_init(&Q);
+    mbedtls_mpi_init(&r);
+    mbedtls_mpi_init(&s);
+    mbedtls_mpi_init(&e);
+    mbedtls_mpi_init(&x);
+    mbedtls_mpi_init(&y);
+    mbedtls_mpi_init(&t);
+    mbedtls_mpi_init(&u1);
+    mbedtls_mpi_init(&u2);
+
+    bool ok = false;
+    int ret = 0;
+    uint8_t point[65];
+    size_t pointLength = 0;
+
+    MBEDTLS_MPI_CHK(mbedtls_ecp_group_load(&grp, MBEDTLS_ECP_DP_SECP256K1));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_read_binary(&r, signature, 32));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_read_binary(&s, signature + 32, 32));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_read_binary(&e, digest, 32));
+
+    // 1 <= r < n, 1 <= s <= n/2 (EIP-2 low-s, as the token contract enforces)
+    MBEDTLS_MPI_CHK(mbedtls_mpi_copy(&t, &grp.N));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_shift_r(&t, 1));
+    if (mbedtls_mpi_cmp_int(&r, 1) < 0 || mbedtls_mpi_cmp_mpi(&r, &grp.N) >= 0 ||
+        mbedtls_mpi_cmp_int(&s, 1) < 0 || mbedtls_mpi_cmp_mpi(&s, &t) > 0)
+        goto cleanup;
+
+    // R = (r, y) with y^2 = r^3 + 7 and the parity given by v. p = 3 mod 4,
+    // so y = (y^2)^((p + 1) / 4)
+    MBEDTLS_MPI_CHK(mbedtls_mpi_mul_mpi(&t, &r, &r));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_mod_mpi(&t, &t, &grp.P));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_mul_mpi(&t, &t, &r));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_add_int(&t, &t, 7));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_mod_mpi(&x, &t, &grp.P)); // x holds y^2
+    MBEDTLS_MPI_CHK(mbedtls_mpi_add_int(&t, &grp.P, 1));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_shift_r(&t, 2));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_exp_mod(&y, &x, &t, &grp.P, NULL));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_mul_mpi(&t, &y, &y));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_mod_mpi(&t, &t, &grp.P));
+    if (mbedtls_mpi_cmp_mpi(&t, &x) != 0)
+        goto cleanup; // r is not an x coordinate on the curve
+    if (mbedtls_mpi_get_bit(&y, 0) != v)
+        MBEDTLS_MPI_CHK(mbedtls_mpi_sub_mpi(&y, &grp.P, &y));
+
+    point[0] = 0x04;
+    MBEDTLS_MPI_CHK(mbedtls_mpi_write_binary(&r, point + 1, 32));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_write_binary(&y, point + 33, 32));
+    MBEDTLS_MPI_CHK(mbedtls_ecp_point_read_binary(&grp, &R, point, sizeof(point)));
+
+    // Q = r^-1 (s R - e G) = (s / r) R + (-e / r) G
+    MBEDTLS_MPI_CHK(mbedtls_mpi_inv_mod(&t, &r, &grp.N));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_mul_mpi(&u2, &s, &t));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_mod_mpi(&u2, &u2, &grp.N));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_mul_mpi(&u1, &e, &t));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_mod_mpi(&u1, &u1, &grp.N));
+    if (mbedtls_mpi_cmp_int(&u1, 0) == 0)
+        goto cleanup; // e = 0 mod n; not a digest anyone signs
+    MBEDTLS_MPI_CHK(mbedtls_mpi_sub_mpi(&u1, &grp.N, &u1));
+    MBEDTLS_MPI_CHK(mbedtls_ecp_muladd(&grp, &Q, &u2, &R, &u1, &grp.G));
+
+    MBEDTLS_MPI_CHK(mbedtls_ecp_point_write_binary(&grp, &Q, MBEDTLS_ECP_PF_UNCOMPRESSED, &pointLength, point, sizeof(point)));
+    if (pointLength != sizeof(point))
+        goto cleanup;
+
+    // address = last 20 bytes of keccak(X || Y)
+    {
+        uint8_t hash[32];
+        keccak256(point + 1, 64, hash);
+        memcpy(address, hash + 12, 20);
+    }
+    ok = true;
+
+cleanup:
+    (void)ret;
+    mbedtls_mpi_free(&u2);
+    mbedtls_mpi_free(&u1);
+    mbedtls_mpi_free(&t);
+    mbedtls_mpi_free(&y);
+    mbedtls_mpi_free(&x);
+    mbedtls_mpi_free(&e);
+    mbedtls_mpi_free(&s);
+    mbedtls_mpi_free(&r);
+    mbedtls_ecp_point_free(&Q);
+    mbedtls_ecp_point_free(&R);
+    mbedtls_ecp_group_free(&grp);
+    return ok;
+}
+
+#else
+
+bool recoverEvmAddress(const uint8_t /*digest*/[32], const uint8_t /*signature*/[65], uint8_t /*address*/[20])
+{
+    return false;
+}
+
+#endif // X402_PRECHECK_ECRECOVER
+
+static bool equalsIgnoreCase(const JsonView &a, const JsonView &b)
+{
+    if (a.length != b.length)
+        return false;
+    for (size_t i = 0; i < a.length; ++i)
+    {
+        if (tolower((unsigned char)a.data[i]) != tolower((unsigned char)b.data[i]))
+            return false;
+    }
+    return true;
+}
+
+static bool isDecimal(const JsonView &view)
+{
+    if (view.length == 0)
+        return false;
+    for (size_t i = 0; i < view.length; ++i)
+    {
+        if (view.data[i] < '0' || view.data[i] > '9')
+            return false;
+    }
+    return true;
+}
+
+// Compare two unsigned decimal strings of any length
+static int compareDecimal(const JsonView &a, const JsonView &b)
+{
+    size_t ai = 0, bi = 0;
+    while (ai + 1 < a.length && a.data[ai] == '0')
+        ++ai;
+    while (bi + 1 < b.length && b.data[bi] == '0')
+        ++bi;
+
+    size_t al = a.length - ai, bl = b.length - bi;
+    if (al != bl)
+        return al < bl ? -1 : 1;
+    int c = memcmp(a.data + ai, b.data + bi, al);
+    return c < 0 ? -1 : (c > 0 ? 1 : 0);
+}
+
+// Seconds fit in 64 bits; saturate anything longer (e.g. uint256 max validBefore)
+static uint64_t decimalToSeconds(const JsonView &view)
+{
+    uint64_t v = 0;
+    for (size_t i = 0; i < view.length; ++i)
+    {
+        if (v > (UINT64_MAX - 9) / 10)
+            return UINT64_MAX;
+        v = v * 10 + (uint64_t)(view.data[i] - '0');
+    }
+    return v;
+}
+
+enum PaymentKey : uint8_t
+{
+    PAY_SCHEME,
+    PAY_NETWORK,
+    PAY_SIGNATURE,
+    PAY_FROM,
+    PAY_TO,
+    PAY_VALUE,
+    PAY_VALID_AFTER,
+    PAY_VALID_BEFORE,
+    PAY_NONCE,
+    PAY_KEY_COUNT
+};
+
+enum RequirementsKey : uint8_t
+{
+    REQ_SCHEME,
+    REQ_NETWORK,
+    REQ_PAY_TO,
+    REQ_AMOUNT,
+    REQ_ASSET,
+    REQ_NAME,
+    REQ_VERSION,
+    REQ_KEY_COUNT
+};
+
+PrecheckResult precheckPayment(const PaymentPayload &payment, const String &paymentRequirements, uint32_t nowUnix,
+                               bool *complete)
+{
+    if (complete)
+        *complete = false;
+
+    static const char *const paymentKeys[PAY_KEY_COUNT] = {
+        "scheme", "network", "signature", "from", "to", "value", "validAfter", "validBefore", "nonce"};
+    static const char *const requirementsKeys[REQ_KEY_COUNT] = {
+        "scheme", "network", "payTo", "maxAmountRequired", "asset", "name", "version"};
+
+    JsonView pay[PAY_KEY_COUNT];
+    JsonView req[REQ_KEY_COUNT];
+    scanJson(payment.payloadJson.c_str(), payment.payloadJson.length(), paymentKeys, pay, PAY_KEY_COUNT);
+    scanJson(paymentRequirements.c_str(), paymentRequirements.length(), requirementsKeys, req, REQ_KEY_COUNT);
+
+    for (uint8_t i = PAY_SIGNATURE; i < PAY_KEY_COUNT; ++i)
+    {
+        if (pay[i].type != JSON_STRING)
+            return PRECHECK_MALFORMED;
+    }
+    if (!isDecimal(pay[PAY_VALUE]) || !isDecimal(pay[PAY_VALID_AFTER]) || !isDecimal(pay[PAY_VALID_BEFORE]))
+        return PRECHECK_MALFORMED;
+
+    // Field checks against the requirements that were offered
+    if (req[REQ_SCHEME].found() && pay[PAY_SCHEME].found() && !(pay[PAY_SCHEME].length == req[REQ_SCHEME].length &&
+                                                                memcmp(pay[PAY_SCHEME].data, req[REQ_SCHEME].data, req[REQ_SCHEME].length) == 0))
+        return PRECHECK_WRONG_SCHEME;
+    if (req[REQ_NETWORK].found() && pay[PAY_NETWORK].found() && !equalsIgnoreCase(pay[PAY_NETWORK], req[REQ_NETWORK]))
+        return PRECHECK_WRONG_NETWORK;
+    if (req[REQ_PAY_TO].found() && !equalsIgnoreCase(pay[PAY_TO], req[REQ_PAY_TO]))
+        return PRECHECK_WRONG_RECIPIENT;
+    if (isDecimal(req[REQ_AMOUNT]) && compareDecimal(pay[PAY_VALUE], req[REQ_AMOUNT]) < 0)
+        return PRECHECK_AMOUNT_TOO_LOW;
+
+    // Validity window, only once the clock is known
+    if (nowUnix == 0)
+    {
+        time_t now = time(nullptr);
+        nowUnix = now > 0 ? (uint32_t)now : 0;
+    }
+    bool windowChecked = nowUnix >= MIN_PLAUSIBLE_UNIX_TIME;
+    if (windowChecked)
+    {
+        // Skew goes on the clock side: validBefore saturates at UINT64_MAX
+        // for "never expires" and must not be added to
+        uint64_t earliestEnd = (uint64_t)nowUnix + X402_PRECHECK_MIN_VALIDITY_S;
+        earliestEnd = earliestEnd > X402_PRECHECK_CLOCK_SKEW_S ? earliestEnd - X402_PRECHECK_CLOCK_SKEW_S : 0;
+        if (decimalToSeconds(pay[PAY_VALID_BEFORE]) < earliestEnd)
+            return PRECHECK_EXPIRED;
+        if (decimalToSeconds(pay[PAY_VALID_AFTER]) > (uint64_t)nowUnix + X402_PRECHECK_CLOCK_SKEW_S)
+            return PRECHECK_NOT_YET_VALID;
+    }
+
+#ifdef X402_PRECHECK_ECRECOVER
+    // Plain EOA signatures only (0x + 65 bytes); contract wallets go to the facilitator
+    uint8_t signature[65];
+    if (!parseHex(pay[PAY_SIGNATURE].data, pay[PAY_SIGNATURE].length, signature, sizeof(signature)))
+        return PRECHECK_OK;
+
+    char name[64], version[16], asset[43], from[43], to[43], value[80], validAfter[80], validBefore[80], nonce[67];
+    uint32_t chainId = pay[PAY_NETWORK].found() ? getChainIdForNetwork(pay[PAY_NETWORK].toString()) : 0;
+    if (chainId == 0 ||
+        !copyView(req[REQ_NAME], name, sizeof(name)) || !copyView(req[REQ_VERSION], version, sizeof(version)) ||
+        !copyView(req[REQ_ASSET], asset, sizeof(asset)))
+        return PRECHECK_OK; // cannot rebuild the domain
+
+    if (!copyView(pay[PAY_FROM], from, sizeof(from)) || !copyView(pay[PAY_TO], to, sizeof(to)) ||
+        !copyView(pay[PAY_VALUE], value, sizeof(value)) || !copyView(pay[PAY_VALID_AFTER], validAfter, sizeof(validAfter)) ||
+        !copyView(pay[PAY_VALID_BEFORE], validBefore, sizeof(validBefore)) || !copyView(pay[PAY_NONCE], nonce, sizeof(nonce)))
+        return PRECHECK_MALFORMED;
+
+    uint8_t digest[32];
+    if (!hashTransferWithAuthorization(name, version, chainId, asset, from, to, value, validAfter, validBefore, nonce, digest))
+        return PRECHECK_MALFORMED;
+
+    uint8_t expected[20], recovered[20];
+    if (!parseHex(from, strlen(from), expected, sizeof(expected)))
+        return PRECHECK_MALFORMED;
+    if (!recoverEvmAddress(digest, signature, recovered) || memcmp(recovered, expected, sizeof(expected)) != 0)
+        return PRECHECK_BAD_SIGNATURE;
+
+    if (complete)
+        *complete = windowChecked && req[REQ_PAY_TO].found() && isDecimal(req[REQ_AMOUNT]);
+#endif
+
+    return PRECHECK_OK;
+}
+
+const char *precheckResultReason(PrecheckResult result)
+{
+    switch (result)
+    {
+    case PRECHECK_OK:
+        return "";
+    case PRECHECK_WRONG_SCHEME:
+        return "unsupported_scheme";
+    case PRECHECK_WRONG_NETWORK:
+        return "invalid_network";
+    case PRECHECK_WRONG_RECIPIENT:
+        return "invalid_exact_evm_payload_recipient_mismatch";
+    case PRECHECK_AMOUNT_TOO_LOW:
+        return "invalid_exact_evm_payload_authorization_value";
+    case PRECHECK_EXPIRED:
+        return "invalid_exact_evm_payload_authorization_valid_before";
+    case PRECHECK_NOT_YET_VALID:
+        return "invalid_exact_evm_payload_authorization_valid_after";
+    case PRECHECK_BAD_SIGNATURE:
+        return "invalid_exact_evm_payload_signature";
+    case PRECHECK_MALFORMED:
+    default:
+        return "invalid_payload";
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef PRECHECK_H
+#define PRECHECK_H
+
+#include <Arduino.h>
+#include "X402Aurdino.h"
+
+// Clock skew tolerated on validAfter / validBefore when the device has real time
+#ifndef X402_PRECHECK_CLOCK_SKEW_S
+    #define X402_PRECHECK_CLOCK_SKEW_S 30
+#endif
+
+// validBefore must leave at least this long for /verify and /settle
+#ifndef X402_PRECHECK_MIN_VALIDITY_S
+    #define X402_PRECHECK_MIN_VALIDITY_S 6
+#endif
+
+enum PrecheckResult : uint8_t
+{
+    PRECHECK_OK = 0,
+    PRECHECK_MALFORMED,       // missing or unparseable fields
+    PRECHECK_WRONG_SCHEME,
+    PRECHECK_WRONG_NETWORK,
+    PRECHECK_WRONG_RECIPIENT, // authorization.to != payTo
+    PRECHECK_AMOUNT_TOO_LOW,  // authorization.value < maxAmountRequired
+    PRECHECK_EXPIRED,         // validBefore already passed (or about to)
+    PRECHECK_NOT_YET_VALID,   // validAfter still in the future
+    PRECHECK_BAD_SIGNATURE    // recovered signer != authorization.from
+};
+
+/**
+ * Local sanity check of an "exact" EVM payment before it goes to /verify.
+ *
+ * Compares the EIP-3009 authorization against the requirements it was signed
+ * for, then rebuilds the EIP-712 TransferWithAuthorization digest and recovers
+ * the secp256k1 signer. Only rejects what the facilitator would certainly
+ * reject; anything this cannot judge passes through:
+ *  - time windows are skipped until the clock is set (SNTP), or use nowUnix
+ *  - signatures other than 65 bytes (smart wallets, EIP-6492) are not checked
+ *  - the signer is not recovered on builds without secp256k1 in mbedtls
+ * A PRECHECK_OK payment still has to be verified by the facilitator; when
+ * complete is given it is set to whether every check above actually ran.
+ */
+PrecheckResult precheckPayment(const PaymentPayload &payment, const String &paymentRequirements, uint32_t nowUnix = 0,
+                               bool *complete = nullptr);
+
+// x402 invalidReason string for a failed pre-check
+const char *precheckResultReason(PrecheckResult result);
+
+// EIP-712 digest of TransferWithAuthorization; fields as they appear in JSON
+// (0x-hex addresses and nonce, decimal integers). False if any is malformed.
+bool hashTransferWithAuthorization(const char *name, const char *version, uint32_t chainId, const char *verifyingContract,
+                                   const char *from, const char *to, const char *value,
+                                   const char *validAfter, const char *validBefore, const char *nonce,
+                                   uint8_t digest[32]);
+
+// ecrecover: signature is r || s || v (v = 27/28 or 0/1); high-s is rejected
+bool recoverEvmAddress(const uint8_t digest[32], const uint8_t signature[65], uint8_t address[20]);
+
+#endif // PRECHECK_H
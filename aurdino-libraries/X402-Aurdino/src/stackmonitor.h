@@ -7,6 +7,7 @@
 #ifdef ESP32
     #include <freertos/FreeRTOS.h>
     #include <freertos/task.h>
+    #include "metrics.h"
     
     // Enable stack monitoring - Comment out for production
     // #define DEBUG_STACK
@@ -30,6 +31,8 @@
         } else if (bytesLeft < 1024) {
             Serial.printf("  ⚠️  CAUTION: Low stack space (%u bytes)\n", bytesLeft);
         }
+        #else
+        (void)tag;
         #endif
     }
     
@@ -84,20 +87,23 @@
             Serial.println("Status: ✅ HEALTHY");
         }
         Serial.println("========================");
+        #else
+        (void)context;
         #endif
     }
     
     /**
-     * Macro for stack checkpoints - Only active in DEBUG_STACK mode
+     * Macro for stack checkpoints - feeds the metrics registry,
+     * logs only in DEBUG_STACK mode
      */
     #ifdef DEBUG_STACK
-        #define STACK_CHECKPOINT(label) logStack(label)
+        #define STACK_CHECKPOINT(label) do { METRICS_RECORD(label); logStack(label); } while (0)
         #define STACK_CHECK_SAFE(minBytes) \
             if (!isStackSafe(minBytes)) { \
                 Serial.printf("ERROR: Stack unsafe at %s:%d\n", __FILE__, __LINE__); \
             }
     #else
-        #define STACK_CHECKPOINT(label) // No-op in production
+        #define STACK_CHECKPOINT(label) METRICS_RECORD(label)
         #define STACK_CHECK_SAFE(minBytes) // No-op in production
     #endif
     
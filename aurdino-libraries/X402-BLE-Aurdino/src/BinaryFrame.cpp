@@ -0,0 +1,118 @@
+#include "BinaryFrame.h"
+
+uint16_t crc16Ccitt(const uint8_t *data, size_t length, uint16_t crc)
+{
+    for (size_t i = 0; i < length; ++i)
+    {
+        crc ^= (uint16_t)data[i] << 8;
+        for (uint8_t bit = 0; bit < 8; ++bit)
+        {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+bool parseBinaryFrame(const uint8_t *data, size_t length, BinaryFrame &frame)
+{
+    // Smallest frame is a continuation with an empty payload
+    if (length < 5 || data[0] != X402BLE_FRAME_MAGIC)
+        return false;
+
+    uint16_t crc = (uint16_t)data[length - 2] | ((uint16_t)data[length - 1] << 8);
+    if (crc16Ccitt(data, length - 2) != crc)
+        return false;
+
+    frame.opcode = data[1] & (uint8_t)~X402BLE_FRAME_CONTINUE;
+    frame.seq = data[2];
+    frame.first = (data[1] & X402BLE_FRAME_CONTINUE) == 0;
+
+    if (frame.first)
+    {
+        if (length < X402BLE_FRAME_OVERHEAD)
+            return false;
+        frame.totalLength = (uint16_t)data[3] | ((uint16_t)data[4] << 8);
+        frame.payload = data + X402BLE_FRAME_HEADER_SIZE;
+        frame.payloadLength = length - X402BLE_FRAME_OVERHEAD;
+    }
+    else
+    {
+        frame.totalLength = 0;
+        frame.payload = data + 3;
+        frame.payloadLength = length - 5;
+    }
+    return true;
+}
+
+FrameAssembly assembleBinaryFrame(const BinaryFrame &frame, FrameReassembly &state, ReassemblyBuffer &buffer)
+{
+    if (frame.first)
+    {
+        // A new message replaces anything half-assembled
+        buffer.clear();
+        state.opcode = frame.opcode;
+        state.seq = frame.seq;
+        state.remaining = frame.totalLength;
+    }
+    else if (state.remaining == 0 || frame.opcode != state.opcode || frame.seq != state.seq)
+    {
+        // Continuation of a message we are not assembling
+        state.reset();
+        buffer.clear();
+        return FRAME_REJECTED;
+    }
+
+    if (frame.payloadLength > state.remaining || !buffer.append((const char *)frame.payload, frame.payloadLength))
+    {
+        state.reset();
+        return FRAME_REJECTED; // buffer.overflowed() tells the two apart
+    }
+
+    state.remaining -= frame.payloadLength;
+    if (state.remaining > 0)
+        return FRAME_PARTIAL;
+
+    state.reset();
+    return FRAME_COMPLETE;
+}
+
+size_t encodeBinaryFrame(uint8_t opcode, uint8_t seq, const uint8_t *payload, size_t length,
+                         uint8_t *out, size_t capacity)
+{
+    if (length > 0xFFFF || capacity < getBinaryFrameSize(length))
+        return 0;
+
+    out[0] = X402BLE_FRAME_MAGIC;
+    out[1] = opcode & (uint8_t)~X402BLE_FRAME_CONTINUE;
+    out[2] = seq;
+    out[3] = (uint8_t)(length & 0xFF);
+    out[4] = (uint8_t)(length >> 8);
+    if (length > 0)
+        memcpy(out + X402BLE_FRAME_HEADER_SIZE, payload, length);
+
+    size_t crcOffset = X402BLE_FRAME_HEADER_SIZE + length;
+    uint16_t crc = crc16Ccitt(out, crcOffset);
+    out[crcOffset] = (uint8_t)(crc & 0xFF);
+    out[crcOffset + 1] = (uint8_t)(crc >> 8);
+    return crcOffset + 2;
+}
+
+void notifyBinaryFrame(NimBLECharacteristic *ch, uint16_t connHandle, uint8_t opcode, uint8_t seq,
+                       const uint8_t *payload, size_t length)
+{
+    if (!ch)
+        return;
+
+    uint8_t stackFrame[160];
+    size_t frameSize = getBinaryFrameSize(length);
+    uint8_t *frame = frameSize <= sizeof(stackFrame) ? stackFrame : new (std::nothrow) uint8_t[frameSize];
+    if (!frame)
+        return;
+
+    size_t written = encodeBinaryFrame(opcode, seq, payload, length, frame, frameSize);
+    if (written)
+        ch->notify(frame, written, connHandle);
+
+    if (frame != stackFrame)
+        delete[] frame;
+}
@@ -0,0 +1,90 @@
+#ifndef BINARY_FRAME_H
+#define BINARY_FRAME_H
+
+#include <Arduino.h>
+#include <NimBLEDevice.h>
+#include "X402BleUtils.h"
+
+// Compact binary framing, used instead of the text prefixes by clients that
+// saw "binary": 1 in CONFIG:// (or got a HELLO reply). Text commands keep
+// working unchanged; every write is classified by its first byte.
+//
+// First frame of a message:   B4 | op | seq | total u16 LE | payload | crc u16 LE
+// Continuation frames:        B4 | op|0x80 | seq | payload | crc u16 LE
+//
+// crc is CRC-16/CCITT-FALSE over every byte of the frame before it. A message
+// is complete once `total` payload bytes have arrived; only then does the
+// device reply, so multi-frame payments need no per-chunk ACK notification.
+// Replies are single frames with the request's seq.
+
+#define X402BLE_FRAME_MAGIC 0xB4
+#define X402BLE_FRAME_VERSION 1
+#define X402BLE_FRAME_CONTINUE 0x80       // opcode bit marking a continuation frame
+#define X402BLE_FRAME_HEADER_SIZE 5       // first frame, without crc
+#define X402BLE_FRAME_OVERHEAD 7          // first frame header + crc
+
+enum FrameOpcode : uint8_t
+{
+    // client -> device
+    FRAME_OP_HELLO = 0x01,    // payload: highest version the client speaks
+    FRAME_OP_COMMAND = 0x02,  // payload: a text command such as [CONFIG] or [OPTIONS]
+    FRAME_OP_PRICE = 0x03,    // payload: customContext--[options]
+    FRAME_OP_PAYMENT = 0x04,  // payload: JSON--customContext--[options]
+
+    // device -> client
+    FRAME_OP_REPLY = 0x40,    // payload: the text reply (402://, PAYMENT:..., ...)
+    FRAME_OP_ERROR = 0x41,    // payload: ERROR:<reason>
+};
+
+// One decoded frame; payload points into the written bytes
+struct BinaryFrame
+{
+    uint8_t opcode = 0;        // without X402BLE_FRAME_CONTINUE
+    uint8_t seq = 0;
+    bool first = false;
+    uint16_t totalLength = 0;  // first frames only
+    const uint8_t *payload = nullptr;
+    size_t payloadLength = 0;
+};
+
+// Where a multi-frame message stands
+struct FrameReassembly
+{
+    uint8_t opcode = 0;
+    uint8_t seq = 0;
+    uint16_t remaining = 0;    // payload bytes still expected; 0 = idle
+
+    void reset() { opcode = 0; seq = 0; remaining = 0; }
+};
+
+enum FrameAssembly
+{
+    FRAME_PARTIAL,   // more frames expected
+    FRAME_COMPLETE,  // buffer holds the whole payload
+    FRAME_REJECTED,  // out of sequence, too long, or buffer overflow; state reset
+};
+
+uint16_t crc16Ccitt(const uint8_t *data, size_t length, uint16_t crc = 0xFFFF);
+
+inline bool isBinaryFrame(const uint8_t *data, size_t length)
+{
+    return length > 0 && data[0] == X402BLE_FRAME_MAGIC;
+}
+
+// Validate size and crc and split out the header; false for a corrupt frame
+bool parseBinaryFrame(const uint8_t *data, size_t length, BinaryFrame &frame);
+
+// Append one frame's payload to buffer (a first frame restarts the message)
+FrameAssembly assembleBinaryFrame(const BinaryFrame &frame, FrameReassembly &state, ReassemblyBuffer &buffer);
+
+// Encode a single-frame message; returns bytes written, 0 if it does not fit
+size_t encodeBinaryFrame(uint8_t opcode, uint8_t seq, const uint8_t *payload, size_t length,
+                         uint8_t *out, size_t capacity);
+
+// Encode and notify one frame to a single central (heap only for large payloads)
+void notifyBinaryFrame(NimBLECharacteristic *ch, uint16_t connHandle, uint8_t opcode, uint8_t seq,
+                       const uint8_t *payload, size_t length);
+
+inline size_t getBinaryFrameSize(size_t payloadLength) { return payloadLength + X402BLE_FRAME_OVERHEAD; }
+
+#endif // BINARY_FRAME_H
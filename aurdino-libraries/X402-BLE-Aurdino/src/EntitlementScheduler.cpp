@@ -0,0 +1,268 @@
+#include "EntitlementScheduler.h"
+
+EntitlementScheduler::EntitlementScheduler()
+    : tickUs_((int64_t)X402BLE_ENTITLEMENT_TICK_MS * 1000), lastTick_(0), timer_(nullptr),
+      lock_(xSemaphoreCreateMutex()), expiredCallback_(nullptr)
+{
+    for (auto &entry : entries_)
+    {
+        entry.expiryUs = 0;
+        entry.prev = -1;
+        entry.next = -1;
+        entry.bucket = 0;
+        entry.used = false;
+    }
+    for (auto &head : buckets_)
+    {
+        head = -1;
+    }
+}
+
+EntitlementScheduler::~EntitlementScheduler()
+{
+    end();
+    if (lock_)
+    {
+        vSemaphoreDelete(lock_);
+        lock_ = nullptr;
+    }
+}
+
+bool EntitlementScheduler::begin(uint32_t tickMs)
+{
+    if (timer_)
+        return true;
+
+    lock();
+    tickUs_ = (int64_t)(tickMs > 0 ? tickMs : 1) * 1000;
+    lastTick_ = esp_timer_get_time() / tickUs_;
+    // Entries granted before begin() were bucketed with the old tick size
+    for (auto &head : buckets_)
+        head = -1;
+    for (int i = 0; i < X402BLE_MAX_ENTITLEMENTS; ++i)
+    {
+        if (entries_[i].used)
+            link(i);
+    }
+    unlock();
+
+    esp_timer_create_args_t args = {};
+    args.callback = &EntitlementScheduler::tickTrampoline;
+    args.arg = this;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "x402_entitle";
+    if (esp_timer_create(&args, &timer_) != ESP_OK)
+    {
+        timer_ = nullptr;
+        return false;
+    }
+    if (esp_timer_start_periodic(timer_, (uint64_t)tickUs_) != ESP_OK)
+    {
+        esp_timer_delete(timer_);
+        timer_ = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void EntitlementScheduler::end()
+{
+    if (!timer_)
+        return;
+    esp_timer_stop(timer_);
+    esp_timer_delete(timer_);
+    timer_ = nullptr;
+}
+
+void EntitlementScheduler::lock() const
+{
+    if (lock_)
+        xSemaphoreTake(lock_, portMAX_DELAY);
+}
+
+void EntitlementScheduler::unlock() const
+{
+    if (lock_)
+        xSemaphoreGive(lock_);
+}
+
+uint16_t EntitlementScheduler::bucketFor(int64_t expiryUs) const
+{
+    // Round up so an entry is never inspected before its expiry tick, and
+    // never file it behind the wheel position (it would wait a whole turn)
+    int64_t tickIndex = (expiryUs + tickUs_ - 1) / tickUs_;
+    if (tickIndex <= lastTick_)
+        tickIndex = lastTick_ + 1;
+    return (uint16_t)(tickIndex % X402BLE_ENTITLEMENT_WHEEL_SLOTS);
+}
+
+// Called with the lock held
+void EntitlementScheduler::link(int index)
+{
+    Entry &entry = entries_[index];
+    uint16_t bucket = bucketFor(entry.expiryUs);
+    entry.bucket = bucket;
+    entry.prev = -1;
+    entry.next = buckets_[bucket];
+    if (entry.next >= 0)
+        entries_[entry.next].prev = index;
+    buckets_[bucket] = index;
+}
+
+// Called with the lock held
+void EntitlementScheduler::unlink(int index)
+{
+    Entry &entry = entries_[index];
+    if (entry.prev >= 0)
+        entries_[entry.prev].next = entry.next;
+    else
+        buckets_[entry.bucket] = entry.next;
+    if (entry.next >= 0)
+        entries_[entry.next].prev = entry.prev;
+    entry.prev = -1;
+    entry.next = -1;
+}
+
+// Called with the lock held
+int EntitlementScheduler::find(const String &key) const
+{
+    for (int i = 0; i < X402BLE_MAX_ENTITLEMENTS; ++i)
+    {
+        if (entries_[i].used && entries_[i].key == key)
+            return i;
+    }
+    return -1;
+}
+
+bool EntitlementScheduler::grant(const String &key, uint64_t durationMs)
+{
+    if (!timer_ && !begin())
+        return false;
+
+    int64_t now = esp_timer_get_time();
+    lock();
+    int index = find(key);
+    int64_t base = now;
+    if (index >= 0)
+    {
+        // Repeat payment: extend from the current expiry if still running
+        if (entries_[index].expiryUs > now)
+            base = entries_[index].expiryUs;
+        unlink(index);
+    }
+    else
+    {
+        for (int i = 0; i < X402BLE_MAX_ENTITLEMENTS; ++i)
+        {
+            if (!entries_[i].used)
+            {
+                index = i;
+                break;
+            }
+        }
+        if (index < 0)
+        {
+            unlock();
+            return false;
+        }
+        entries_[index].used = true;
+        entries_[index].key = key;
+    }
+    entries_[index].expiryUs = base + (int64_t)durationMs * 1000;
+    link(index);
+    unlock();
+    return true;
+}
+
+bool EntitlementScheduler::revoke(const String &key)
+{
+    lock();
+    int index = find(key);
+    if (index >= 0)
+    {
+        unlink(index);
+        entries_[index].used = false;
+        entries_[index].key = "";
+    }
+    unlock();
+    return index >= 0;
+}
+
+bool EntitlementScheduler::isActive(const String &key) const
+{
+    return getRemainingMs(key) > 0;
+}
+
+uint64_t EntitlementScheduler::getRemainingMs(const String &key) const
+{
+    int64_t now = esp_timer_get_time();
+    lock();
+    int index = find(key);
+    int64_t remainingUs = index >= 0 ? entries_[index].expiryUs - now : 0;
+    unlock();
+    // Round up so access never reads as over before the expiry callback fires
+    return remainingUs > 0 ? (uint64_t)(remainingUs + 999) / 1000 : 0;
+}
+
+size_t EntitlementScheduler::getActiveCount() const
+{
+    size_t count = 0;
+    lock();
+    for (const auto &entry : entries_)
+    {
+        if (entry.used)
+            count++;
+    }
+    unlock();
+    return count;
+}
+
+void EntitlementScheduler::tickTrampoline(void *arg)
+{
+    static_cast<EntitlementScheduler *>(arg)->tick();
+}
+
+void EntitlementScheduler::tick()
+{
+    // Keys are moved out under the lock; callbacks run after releasing it
+    String expired[X402BLE_MAX_ENTITLEMENTS];
+    uint8_t expiredCount = 0;
+
+    int64_t now = esp_timer_get_time();
+    int64_t currentTick = now / tickUs_;
+
+    lock();
+    // Catch up on ticks the timer task could not deliver (bounded by one turn)
+    int64_t firstTick = lastTick_ + 1;
+    if (currentTick - firstTick >= X402BLE_ENTITLEMENT_WHEEL_SLOTS)
+        firstTick = currentTick - X402BLE_ENTITLEMENT_WHEEL_SLOTS + 1;
+
+    for (int64_t t = firstTick; t <= currentTick; ++t)
+    {
+        int16_t index = buckets_[t % X402BLE_ENTITLEMENT_WHEEL_SLOTS];
+        while (index >= 0)
+        {
+            Entry &entry = entries_[index];
+            int16_t next = entry.next;
+            // Entries further out share the bucket - they wait for a later turn
+            if (entry.expiryUs <= now)
+            {
+                unlink(index);
+                entry.used = false;
+                expired[expiredCount++] = std::move(entry.key);
+                entry.key = "";
+            }
+            index = next;
+        }
+    }
+    lastTick_ = currentTick;
+    unlock();
+
+    if (expiredCallback_)
+    {
+        for (uint8_t i = 0; i < expiredCount; ++i)
+        {
+            expiredCallback_(expired[i]);
+        }
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+// Concurrent entitlements (e.g. one per option / locker door)
+#ifndef X402BLE_MAX_ENTITLEMENTS
+#define X402BLE_MAX_ENTITLEMENTS 16
+#endif
+
+// Timer wheel: number of buckets and time per bucket
+#ifndef X402BLE_ENTITLEMENT_WHEEL_SLOTS
+#define X402BLE_ENTITLEMENT_WHEEL_SLOTS 64
+#endif
+#ifndef X402BLE_ENTITLEMENT_TICK_MS
+#define X402BLE_ENTITLEMENT_TICK_MS 250
+#endif
+
+// Called from the esp_timer task when access for key runs out - keep it short
+typedef void (*EntitlementExpiredCallback)(const String &key);
+
+/**
+ * Time-boxed access tracker on the 64-bit esp_timer clock (no micros() wrap).
+ *
+ * Each entitlement sits in one bucket of a hashed timer wheel, chosen by its
+ * expiry tick. A periodic esp_timer advances the wheel one bucket per tick
+ * and only inspects the entitlements in that bucket, so the tick cost does
+ * not grow with the number of entitlements being tracked. Repeat grants
+ * extend the current expiry instead of restarting it.
+ */
+class EntitlementScheduler
+{
+public:
+    EntitlementScheduler();
+    ~EntitlementScheduler();
+
+    EntitlementScheduler(const EntitlementScheduler &) = delete;
+    EntitlementScheduler &operator=(const EntitlementScheduler &) = delete;
+
+    // Starts the wheel timer (once); called on the first grant if needed
+    bool begin(uint32_t tickMs = X402BLE_ENTITLEMENT_TICK_MS);
+    void end();
+
+    // Add durationMs of access to key, after any time still remaining.
+    // False when every slot holds another active entitlement.
+    bool grant(const String &key, uint64_t durationMs);
+    // Drop access immediately (no expiry callback)
+    bool revoke(const String &key);
+
+    bool isActive(const String &key) const;
+    uint64_t getRemainingMs(const String &key) const;
+    size_t getActiveCount() const;
+
+    void setExpiredCallback(EntitlementExpiredCallback callback) { expiredCallback_ = callback; }
+
+private:
+    struct Entry
+    {
+        String key;
+        int64_t expiryUs;
+        int16_t prev;
+        int16_t next;
+        uint16_t bucket;
+        bool used;
+    };
+
+    static void tickTrampoline(void *arg);
+    void tick();
+
+    int find(const String &key) const;
+    uint16_t bucketFor(int64_t expiryUs) const;
+    void link(int index);
+    void unlink(int index);
+    void lock() const;
+    void unlock() const;
+
+    Entry entries_[X402BLE_MAX_ENTITLEMENTS];
+    int16_t buckets_[X402BLE_ENTITLEMENT_WHEEL_SLOTS]; // head entry per bucket, -1 = empty
+    int64_t tickUs_;
+    int64_t lastTick_;                                 // last wheel tick processed
+    esp_timer_handle_t timer_;
+    SemaphoreHandle_t lock_;
+    EntitlementExpiredCallback expiredCallback_;
+};
@@ -0,0 +1,363 @@
+#include "NonceCache.h"
+#include <Preferences.h>
+#include <time.h>
+#include "jsonscanner.h"
+#include "keccak.h"
+
+// Anything earlier means the clock was never set
+#define NONCE_CACHE_MIN_UNIX_TIME 1700000000u
+
+// NVS blob: "NC" <version> <count> then count entries
+#define NONCE_CACHE_BLOB_KEY "entries"
+#define NONCE_CACHE_BLOB_VERSION 2
+
+static uint32_t unixNow()
+{
+    time_t now = time(nullptr);
+    return now >= (time_t)NONCE_CACHE_MIN_UNIX_TIME ? (uint32_t)now : 0;
+}
+
+static int hexNibble(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    c |= 0x20;
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+NonceCache::NonceCache()
+    : stampCounter_(0), namespace_(nullptr), lock_(xSemaphoreCreateMutex())
+{
+    memset(entries_, 0, sizeof(entries_));
+}
+
+NonceCache::~NonceCache()
+{
+    if (lock_)
+    {
+        vSemaphoreDelete(lock_);
+        lock_ = nullptr;
+    }
+}
+
+uint64_t NonceCache::keyFor(const char *from, size_t fromLength, const char *nonce, size_t nonceLength)
+{
+    // Case-insensitive hex, so checksummed and plain addresses agree
+    Keccak256 hash;
+    uint8_t c;
+    for (size_t i = 0; i < fromLength; ++i)
+    {
+        c = (uint8_t)tolower((unsigned char)from[i]);
+        hash.update(&c, 1);
+    }
+    c = ':';
+    hash.update(&c, 1);
+    for (size_t i = 0; i < nonceLength; ++i)
+    {
+        c = (uint8_t)tolower((unsigned char)nonce[i]);
+        hash.update(&c, 1);
+    }
+
+    uint8_t digest[Keccak256::DIGEST_SIZE];
+    hash.finalize(digest);
+    uint64_t key = 0;
+    for (uint8_t i = 0; i < 8; ++i)
+        key = (key << 8) | digest[i];
+    return key ? key : 1;
+}
+
+bool NonceCache::keyForPayment(const String &paymentJson, uint64_t &key, uint32_t &validBefore, uint64_t *terms)
+{
+    static const char *const keys[] = {"from", "nonce", "validBefore", "to", "value", "signature"};
+    JsonView values[6];
+    scanJson(paymentJson.c_str(), paymentJson.length(), keys, values, terms ? 6 : 3);
+    if (values[0].type != JSON_STRING || values[1].type != JSON_STRING || values[1].length == 0)
+        return false;
+
+    key = keyFor(values[0].data, values[0].length, values[1].data, values[1].length);
+    if (terms)
+    {
+        // Same hash as the key, over "to:value:signature"
+        Keccak256 hash;
+        for (uint8_t field = 3; field < 6; ++field)
+        {
+            for (size_t i = 0; i < values[field].length; ++i)
+            {
+                uint8_t c = (uint8_t)tolower((unsigned char)values[field].data[i]);
+                hash.update(&c, 1);
+            }
+            uint8_t separator = ':';
+            hash.update(&separator, 1);
+        }
+        uint8_t digest[Keccak256::DIGEST_SIZE];
+        hash.finalize(digest);
+        *terms = 0;
+        for (uint8_t i = 0; i < 8; ++i)
+            *terms = (*terms << 8) | digest[i];
+        if (!*terms)
+            *terms = 1;
+    }
+
+    // Saturate: "never expires" authorizations just age out of the cache
+    uint64_t before = 0;
+    for (size_t i = 0; i < values[2].length && before <= UINT32_MAX; ++i)
+    {
+        char d = values[2].data[i];
+        if (d < '0' || d > '9')
+            break;
+        before = before * 10 + (uint64_t)(d - '0');
+    }
+    validBefore = values[2].found() && before < UINT32_MAX ? (uint32_t)before : UINT32_MAX;
+    return true;
+}
+
+NonceCache::Entry *NonceCache::find(uint64_t key)
+{
+    for (auto &entry : entries_)
+    {
+        if (entry.key == key)
+            return &entry;
+    }
+    return nullptr;
+}
+
+// Empty slot, else an expired one, else the oldest settled one, else the
+// oldest verified one. An in-flight entry is never evicted (its worker would
+// record the outcome against nothing): nullptr if every slot is in flight.
+NonceCache::Entry *NonceCache::allocate(uint32_t now)
+{
+    Entry *target = nullptr;
+    for (auto &entry : entries_)
+    {
+        if (!entry.key || (now && entry.validBefore < now))
+            return &entry;
+        if (entry.state == IN_FLIGHT)
+            continue;
+        // SETTLED sorts after VERIFIED, so it is taken first
+        if (!target || entry.state > target->state ||
+            (entry.state == target->state && entry.stamp < target->stamp))
+            target = &entry;
+    }
+    return target;
+}
+
+NonceCache::State NonceCache::claim(uint64_t key, uint32_t validBefore, String *txHash, uint64_t terms)
+{
+    if (key == 0)
+        return NONE;
+
+    uint32_t now = unixNow();
+    State state = NONE;
+
+    if (lock_)
+        xSemaphoreTake(lock_, portMAX_DELAY);
+
+    Entry *entry = find(key);
+    if (entry && now && entry->validBefore < now)
+    {
+        // The authorization is dead on chain anyway; let the facilitator say so
+        entry->key = 0;
+        entry = nullptr;
+    }
+
+    if (entry && terms && entry->terms && terms != entry->terms)
+    {
+        // Someone else's terms under this nonce: not a retry of that payment
+        state = MISMATCH;
+    }
+    else if (entry)
+    {
+        state = (State)entry->state;
+        if (state == SETTLED && txHash)
+        {
+            static const char hex[] = "0123456789abcdef";
+            txHash->remove(0);
+            if (entry->hasTx)
+            {
+                txHash->reserve(66);
+                *txHash += "0x";
+                for (uint8_t b : entry->txHash)
+                {
+                    *txHash += hex[b >> 4];
+                    *txHash += hex[b & 0x0f];
+                }
+            }
+        }
+    }
+    else if ((entry = allocate(now)) != nullptr)
+    {
+        memset(entry, 0, sizeof(*entry));
+        entry->key = key;
+        entry->terms = terms;
+        entry->validBefore = validBefore;
+        entry->stamp = ++stampCounter_;
+        entry->state = IN_FLIGHT;
+    }
+    else
+    {
+        // Every slot is being verified; the client retries shortly
+        state = IN_FLIGHT;
+    }
+
+    if (lock_)
+        xSemaphoreGive(lock_);
+    return state;
+}
+
+void NonceCache::markVerified(uint64_t key)
+{
+    if (lock_)
+        xSemaphoreTake(lock_, portMAX_DELAY);
+    Entry *entry = key ? find(key) : nullptr;
+    if (entry)
+        entry->state = VERIFIED;
+    if (lock_)
+        xSemaphoreGive(lock_);
+}
+
+void NonceCache::markSettled(uint64_t key, const String &txHash)
+{
+    if (lock_)
+        xSemaphoreTake(lock_, portMAX_DELAY);
+    Entry *entry = key ? find(key) : nullptr;
+    if (entry)
+    {
+        entry->state = SETTLED;
+
+        // Kept as 32 raw bytes; anything but 0x + 64 hex digits is dropped
+        entry->hasTx = txHash.length() == 66 && txHash[0] == '0' && (txHash[1] == 'x' || txHash[1] == 'X');
+        for (uint8_t i = 0; entry->hasTx && i < 32; ++i)
+        {
+            int hi = hexNibble(txHash[2 + 2 * i]);
+            int lo = hexNibble(txHash[3 + 2 * i]);
+            if (hi < 0 || lo < 0)
+                entry->hasTx = false;
+            else
+                entry->txHash[i] = (uint8_t)((hi << 4) | lo);
+        }
+
+        if (namespace_)
+            saveLocked();
+    }
+    if (lock_)
+        xSemaphoreGive(lock_);
+}
+
+void NonceCache::release(uint64_t key)
+{
+    if (lock_)
+        xSemaphoreTake(lock_, portMAX_DELAY);
+    Entry *entry = key ? find(key) : nullptr;
+    if (entry)
+        entry->key = 0;
+    if (lock_)
+        xSemaphoreGive(lock_);
+}
+
+// One blob with the settled entries, rewritten on each settlement
+void NonceCache::saveLocked()
+{
+    uint8_t *blob = new (std::nothrow) uint8_t[4 + sizeof(entries_)];
+    if (!blob)
+        return;
+
+    uint8_t count = 0;
+    uint32_t now = unixNow();
+    for (const auto &entry : entries_)
+    {
+        if (!entry.key || entry.state != SETTLED || (now && entry.validBefore < now))
+            continue;
+        memcpy(blob + 4 + count * sizeof(Entry), &entry, sizeof(Entry));
+        count++;
+    }
+    blob[0] = 'N';
+    blob[1] = 'C';
+    blob[2] = NONCE_CACHE_BLOB_VERSION;
+    blob[3] = count;
+
+    Preferences prefs;
+    if (prefs.begin(namespace_, false))
+    {
+        prefs.putBytes(NONCE_CACHE_BLOB_KEY, blob, 4 + count * sizeof(Entry));
+        prefs.end();
+    }
+    delete[] blob;
+}
+
+bool NonceCache::enablePersistence(const char *nvsNamespace)
+{
+    if (!nvsNamespace || !nvsNamespace[0])
+        return false;
+
+    Preferences prefs;
+    if (!prefs.begin(nvsNamespace, true))
+    {
+        // Namespace does not exist yet - it is created on the first save
+        namespace_ = nvsNamespace;
+        return true;
+    }
+
+    const size_t capacity = 4 + sizeof(entries_);
+    uint8_t *blob = new (std::nothrow) uint8_t[capacity];
+    size_t length = blob ? prefs.getBytesLength(NONCE_CACHE_BLOB_KEY) : 0;
+    if (length >= 4 && length <= capacity)
+        length = prefs.getBytes(NONCE_CACHE_BLOB_KEY, blob, length);
+    else
+        length = 0;
+    prefs.end();
+
+    if (lock_)
+        xSemaphoreTake(lock_, portMAX_DELAY);
+    namespace_ = nvsNamespace;
+
+    if (length >= 4 && blob[0] == 'N' && blob[1] == 'C' && blob[2] == NONCE_CACHE_BLOB_VERSION &&
+        length == 4 + blob[3] * sizeof(Entry))
+    {
+        uint32_t now = unixNow();
+        for (uint8_t i = 0; i < blob[3]; ++i)
+        {
+            Entry stored;
+            memcpy(&stored, blob + 4 + i * sizeof(Entry), sizeof(Entry));
+            if (!stored.key || stored.state != SETTLED || (now && stored.validBefore < now) || find(stored.key))
+                continue;
+            Entry *entry = allocate(now);
+            if (!entry)
+                break;
+            *entry = stored;
+            entry->stamp = ++stampCounter_;
+        }
+    }
+
+    if (lock_)
+        xSemaphoreGive(lock_);
+    delete[] blob;
+    return true;
+}
+
+void NonceCache::clear()
+{
+    if (lock_)
+        xSemaphoreTake(lock_, portMAX_DELAY);
+    memset(entries_, 0, sizeof(entries_));
+    if (namespace_)
+        saveLocked();
+    if (lock_)
+        xSemaphoreGive(lock_);
+}
+
+uint8_t NonceCache::size() const
+{
+    if (lock_)
+        xSemaphoreTake(lock_, portMAX_DELAY);
+    uint8_t count = 0;
+    for (const auto &entry : entries_)
+    {
+        if (entry.key)
+            count++;
+    }
+    if (lock_)
+        xSemaphoreGive(lock_);
+    return count;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+// Authorizations remembered at once (oldest settled one is evicted first)
+#ifndef X402BLE_NONCE_CACHE_SIZE
+#define X402BLE_NONCE_CACHE_SIZE 32
+#endif
+
+// Default NVS namespace when persistence is enabled
+#ifndef X402BLE_NONCE_NAMESPACE
+#define X402BLE_NONCE_NAMESPACE "x402nonce"
+#endif
+
+/**
+ * Bounded cache of payment authorizations already seen, keyed by a hash of
+ * (payer, nonce). A retry after a lost PAYMENT:COMPLETE, or a replay, is
+ * answered from here without another /verify or /settle.
+ *
+ * Each entry also keeps a hash of the terms it was seen with (payee, value
+ * and signature), so a payment that reuses a nonce with other terms is not
+ * answered with the recorded outcome.
+ *
+ * Entries live until the authorization's validBefore passes (once the clock
+ * is set) or until they are the oldest when the cache is full; settled
+ * entries are evicted before pending ones, and in-flight ones never are.
+ * Settled entries can be persisted to NVS so dedupe survives a reboot. 64
+ * bytes per entry; safe to use from the NimBLE host task and the workers.
+ */
+class NonceCache
+{
+public:
+    enum State : uint8_t
+    {
+        NONE = 0,   // not seen before (claim() has now reserved it)
+        IN_FLIGHT,  // another worker is verifying it right now
+        VERIFIED,   // verified, settlement still pending (optimistic mode)
+        SETTLED,    // settled; the tx hash is known
+        MISMATCH    // nonce already seen with other terms (not this authorization)
+    };
+
+    NonceCache();
+    ~NonceCache();
+
+    NonceCache(const NonceCache &) = delete;
+    NonceCache &operator=(const NonceCache &) = delete;
+
+    // Keccak-256 of the lowercased payer and nonce, first 8 bytes; 0 = none
+    static uint64_t keyFor(const char *from, size_t fromLength, const char *nonce, size_t nonceLength);
+
+    // Key and validBefore of the authorization in an X-PAYMENT JSON, and if
+    // wanted the hash of its terms (to, value, signature); false if absent
+    static bool keyForPayment(const String &paymentJson, uint64_t &key, uint32_t &validBefore,
+                              uint64_t *terms = nullptr);
+
+    // Look the key up; if unseen, reserve it as IN_FLIGHT and return NONE.
+    // Otherwise returns the recorded state and fills txHash for SETTLED, or
+    // MISMATCH if terms (0 = unchecked) differ from those it was claimed with.
+    // IN_FLIGHT for an unseen key too if every slot is in flight.
+    State claim(uint64_t key, uint32_t validBefore, String *txHash = nullptr, uint64_t terms = 0);
+
+    // Record the outcome of a claimed authorization
+    void markVerified(uint64_t key);
+    void markSettled(uint64_t key, const String &txHash);
+
+    // Payment failed: forget it so a corrected retry is processed normally
+    void release(uint64_t key);
+
+    // Keep settled entries in NVS (loads what is stored there now)
+    bool enablePersistence(const char *nvsNamespace = X402BLE_NONCE_NAMESPACE);
+    void disablePersistence() { namespace_ = nullptr; }
+
+    void clear();
+    uint8_t size() const;
+    static constexpr uint8_t capacity() { return X402BLE_NONCE_CACHE_SIZE; }
+
+private:
+    struct Entry
+    {
+        uint64_t key;          // 0 = empty
+        uint64_t terms;        // hash of to, value and signature; 0 = unknown
+        uint32_t validBefore;  // unix seconds; UINT32_MAX = never
+        uint32_t stamp;        // insertion order, oldest evicted first
+        uint8_t state;
+        bool hasTx;
+        uint8_t txHash[32];
+    };
+
+    Entry *find(uint64_t key);
+    Entry *allocate(uint32_t now);
+    void saveLocked();
+
+    Entry entries_[X402BLE_NONCE_CACHE_SIZE];
+    uint32_t stampCounter_;
+    const char *namespace_;
+    SemaphoreHandle_t lock_;
+};
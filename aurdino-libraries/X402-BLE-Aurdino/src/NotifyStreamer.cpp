@@ -0,0 +1,312 @@
+#include "NotifyStreamer.h"
+#include "BinaryFrame.h"
+#include <algorithm>
+
+size_t FieldSource::read(size_t offset, uint8_t *out, size_t maxLength) const
+{
+    size_t copied = 0;
+    if (offset < prefixLength_)
+    {
+        copied = std::min<size_t>(prefixLength_ - offset, maxLength);
+        memcpy(out, prefix_ + offset, copied);
+        offset += copied;
+    }
+
+    // The field may have been replaced since the reply started; never read past its end
+    size_t fieldOffset = offset - prefixLength_;
+    if (field_ && copied < maxLength && fieldOffset < field_->length())
+    {
+        size_t n = std::min<size_t>(field_->length() - fieldOffset, maxLength - copied);
+        memcpy(out + copied, field_->c_str() + fieldOffset, n);
+        copied += n;
+    }
+    return copied;
+}
+
+BufferSource::BufferSource(const uint8_t *data, size_t length)
+    : data_((uint8_t *)malloc(length ? length : 1)), length_(data_ ? length : 0)
+{
+    if (data_ && length)
+        memcpy(data_, data, length);
+}
+
+size_t BufferSource::read(size_t offset, uint8_t *out, size_t maxLength) const
+{
+    if (offset >= length_)
+        return 0;
+    size_t n = std::min<size_t>(length_ - offset, maxLength);
+    memcpy(out, data_ + offset, n);
+    return n;
+}
+
+static uint8_t countDigits(uint32_t value)
+{
+    uint8_t digits = 1;
+    while (value >= 10)
+    {
+        value /= 10;
+        digits++;
+    }
+    return digits;
+}
+
+NotifyStreamer::NotifyStreamer()
+    : tx_(nullptr), orderCounter_(0), credits_(X402BLE_NOTIFY_CREDITS), cursor_(0)
+{
+    for (auto &stream : streams_)
+    {
+        stream.source = nullptr;
+    }
+}
+
+NotifyStreamer::~NotifyStreamer()
+{
+    clear();
+}
+
+NotifyStreamer::Stream *NotifyStreamer::claim()
+{
+    for (auto &stream : streams_)
+    {
+        if (!stream.source)
+            return &stream;
+    }
+    return nullptr;
+}
+
+bool NotifyStreamer::send(uint16_t connHandle, size_t maxNotify, int frameSeq, NotifySource *source)
+{
+    if (!source)
+        return false;
+
+    Stream *slot = claim();
+    if (slot)
+    {
+        slot->source = source;
+        if (start(*slot, connHandle, maxNotify, frameSeq))
+            return true;
+        slot->source = nullptr;
+    }
+    delete source;
+    return false;
+}
+
+bool NotifyStreamer::send(uint16_t connHandle, size_t maxNotify, int frameSeq, const char *prefix, const String &field)
+{
+    Stream *slot = claim();
+    if (!slot)
+        return false;
+
+    slot->field.assign(prefix, field);
+    slot->source = &slot->field;
+    if (start(*slot, connHandle, maxNotify, frameSeq))
+        return true;
+    slot->source = nullptr;
+    return false;
+}
+
+bool NotifyStreamer::start(Stream &stream, uint16_t connHandle, size_t maxNotify, int frameSeq)
+{
+    size_t total = stream.source->length();
+    if (maxNotify > X402BLE_MAX_NOTIFY_SIZE)
+        maxNotify = X402BLE_MAX_NOTIFY_SIZE;
+    if (maxNotify < 20)
+        maxNotify = 20; // ATT minimum
+
+    // Text replies that don't fit go as FRAG:<i>/<n>: - size the header for n's digits
+    uint16_t count = 1;
+    size_t fragmentSize = maxNotify;
+    if (frameSeq < 0 && total > maxNotify)
+    {
+        uint8_t digits = 1;
+        uint32_t fragments = 0;
+        for (;;)
+        {
+            fragmentSize = maxNotify - (7 + 2 * digits); // "FRAG:" i "/" n ":"
+            fragments = (total + fragmentSize - 1) / fragmentSize;
+            if (countDigits(fragments) <= digits)
+                break;
+            digits = countDigits(fragments);
+        }
+        count = fragments > 0xFFFF ? 0 : (uint16_t)fragments;
+    }
+
+    if (count == 0 || (frameSeq >= 0 && total > 0xFFFF))
+        return false;
+
+    stream.connHandle = connHandle;
+    stream.frameSeq = (int16_t)frameSeq;
+    stream.order = ++orderCounter_;
+    stream.offset = 0;
+    stream.fragmentSize = fragmentSize;
+    stream.index = 1;
+    stream.count = count;
+    stream.maxNotify = (uint16_t)maxNotify;
+
+    pump();
+    return true;
+}
+
+void NotifyStreamer::onNotifyComplete()
+{
+    // Completions of notifications sent elsewhere count too; cap at the budget
+    if (credits_ < X402BLE_NOTIFY_CREDITS)
+        credits_++;
+    pump();
+}
+
+void NotifyStreamer::cancel(uint16_t connHandle)
+{
+    for (auto &stream : streams_)
+    {
+        if (stream.source && stream.connHandle == connHandle)
+            release(stream);
+    }
+}
+
+void NotifyStreamer::clear()
+{
+    for (auto &stream : streams_)
+    {
+        if (stream.source)
+            release(stream);
+    }
+}
+
+size_t NotifyStreamer::getPendingCount() const
+{
+    size_t count = 0;
+    for (const auto &stream : streams_)
+    {
+        if (stream.source)
+            count++;
+    }
+    return count;
+}
+
+bool NotifyStreamer::isBusy(uint16_t connHandle) const
+{
+    for (const auto &stream : streams_)
+    {
+        if (stream.source && stream.connHandle == connHandle)
+            return true;
+    }
+    return false;
+}
+
+void NotifyStreamer::fail(Stream &stream)
+{
+    static const char busy[] = "ERROR:BUSY";
+    if (stream.frameSeq >= 0)
+        notifyBinaryFrame(tx_, stream.connHandle, FRAME_OP_ERROR, (uint8_t)stream.frameSeq,
+                          (const uint8_t *)busy, sizeof(busy) - 1);
+    else if (tx_)
+        tx_->notify((const uint8_t *)busy, sizeof(busy) - 1, stream.connHandle);
+    release(stream);
+}
+
+void NotifyStreamer::release(Stream &stream)
+{
+    if (stream.source != &stream.field)
+        delete stream.source;
+    stream.source = nullptr;
+}
+
+// Oldest reply queued for its central
+bool NotifyStreamer::isNext(const Stream &stream) const
+{
+    for (const auto &other : streams_)
+    {
+        if (other.source && other.connHandle == stream.connHandle && other.order < stream.order)
+            return false;
+    }
+    return true;
+}
+
+void NotifyStreamer::pump()
+{
+    while (credits_ > 0)
+    {
+        Stream *next = nullptr;
+        for (uint8_t i = 0; i < X402BLE_NOTIFY_STREAMS; ++i)
+        {
+            uint8_t index = (cursor_ + i) % X402BLE_NOTIFY_STREAMS;
+            if (streams_[index].source && isNext(streams_[index]))
+            {
+                next = &streams_[index];
+                cursor_ = (index + 1) % X402BLE_NOTIFY_STREAMS;
+                break;
+            }
+        }
+        if (!next)
+            return;
+
+        if (!sendFragment(*next))
+        {
+            // Nothing in flight means no completion will come to retry on -
+            // give up on it, but tell the central so it can ask again
+            if (credits_ == X402BLE_NOTIFY_CREDITS)
+                fail(*next);
+            return;
+        }
+        credits_--;
+    }
+}
+
+bool NotifyStreamer::sendFragment(Stream &stream)
+{
+    if (!tx_)
+    {
+        release(stream);
+        return true;
+    }
+
+    uint8_t buffer[X402BLE_MAX_NOTIFY_SIZE];
+    size_t total = stream.source->length();
+    size_t length = 0;
+    size_t read = 0;
+
+    if (stream.frameSeq >= 0)
+    {
+        // Binary reply: first frame carries the total, the rest are continuations
+        bool first = stream.offset == 0;
+        size_t header = first ? X402BLE_FRAME_HEADER_SIZE : 3;
+        buffer[0] = X402BLE_FRAME_MAGIC;
+        buffer[1] = first ? FRAME_OP_REPLY : (FRAME_OP_REPLY | X402BLE_FRAME_CONTINUE);
+        buffer[2] = (uint8_t)stream.frameSeq;
+        if (first)
+        {
+            buffer[3] = (uint8_t)(total & 0xFF);
+            buffer[4] = (uint8_t)(total >> 8);
+        }
+        read = stream.source->read(stream.offset, buffer + header, stream.maxNotify - header - 2);
+        length = header + read;
+        uint16_t crc = crc16Ccitt(buffer, length);
+        buffer[length++] = (uint8_t)(crc & 0xFF);
+        buffer[length++] = (uint8_t)(crc >> 8);
+    }
+    else if (stream.count == 1)
+    {
+        read = stream.source->read(0, buffer, stream.maxNotify);
+        length = read;
+    }
+    else
+    {
+        int header = snprintf((char *)buffer, sizeof(buffer), "FRAG:%u/%u:", stream.index, stream.count);
+        read = stream.source->read(stream.offset, buffer + header, stream.fragmentSize);
+        length = header + read;
+    }
+
+    if (!tx_->notify(buffer, length, stream.connHandle))
+        return false;
+
+    stream.offset += read;
+    stream.index++;
+
+    // Done, or the source shrank under us
+    bool done = stream.frameSeq >= 0 ? stream.offset >= total || (read == 0 && stream.offset > 0)
+                                     : stream.index > stream.count || read == 0;
+    if (done)
+        release(stream);
+    return true;
+}
@@ -0,0 +1,147 @@
+#ifndef NOTIFY_STREAMER_H
+#define NOTIFY_STREAMER_H
+
+#include <Arduino.h>
+#include <NimBLEDevice.h>
+#include <type_traits>
+#include <utility>
+
+// Pacing relies on NimBLE-Arduino 2.x: notify() to one connection that reports
+// failure, and a completion per notification through onStatus(ch, code).
+// In 1.x both compile against other overloads and break silently.
+static_assert(std::is_same<decltype(std::declval<NimBLECharacteristic &>().notify(
+                               (const uint8_t *)nullptr, (size_t)0, (uint16_t)0)),
+                           bool>::value,
+              "X402Ble requires NimBLE-Arduino 2.x");
+
+// Replies waiting or in progress across all centrals
+#ifndef X402BLE_NOTIFY_STREAMS
+#define X402BLE_NOTIFY_STREAMS 8
+#endif
+
+// Notifications handed to the stack before waiting for a completion (onStatus)
+#ifndef X402BLE_NOTIFY_CREDITS
+#define X402BLE_NOTIFY_CREDITS 4
+#endif
+
+// Largest notification payload (ATT MTU 517 - 3); bounds the fragment buffer
+#define X402BLE_MAX_NOTIFY_SIZE 514
+
+// Bytes of a reply, copied out one fragment at a time
+class NotifySource
+{
+public:
+    virtual ~NotifySource() {}
+    virtual size_t length() const = 0;
+    // Copy up to maxLength bytes from offset; returns bytes copied
+    virtual size_t read(size_t offset, uint8_t *out, size_t maxLength) const = 0;
+};
+
+// prefix + a stored field, e.g. "BANNER://" + banner_ (the field is read in place)
+class FieldSource : public NotifySource
+{
+public:
+    FieldSource() : prefix_(""), prefixLength_(0), field_(nullptr) {}
+    FieldSource(const char *prefix, const String &field) { assign(prefix, field); }
+
+    void assign(const char *prefix, const String &field)
+    {
+        prefix_ = prefix;
+        prefixLength_ = strlen(prefix);
+        field_ = &field;
+    }
+
+    size_t length() const override { return prefixLength_ + (field_ ? field_->length() : 0); }
+    size_t read(size_t offset, uint8_t *out, size_t maxLength) const override;
+
+private:
+    const char *prefix_;  // string literal
+    size_t prefixLength_;
+    const String *field_; // must outlive the reply (members of X402Ble)
+};
+
+// Private copy of a reply built on the fly
+class BufferSource : public NotifySource
+{
+public:
+    BufferSource(const uint8_t *data, size_t length);
+    ~BufferSource() override { free(data_); }
+    bool ok() const { return data_ != nullptr; }
+    size_t length() const override { return length_; }
+    size_t read(size_t offset, uint8_t *out, size_t maxLength) const override;
+
+private:
+    uint8_t *data_;
+    size_t length_;
+};
+
+/**
+ * Sends replies of any size as a series of notifications.
+ *
+ * A reply that fits one notification goes out unchanged. Larger text replies
+ * are split into "FRAG:<i>/<n>:<bytes>" fragments (i from 1); replies to
+ * binary frames continue as binary continuation frames. Fragments are read
+ * from the source as they are sent, so a reply costs one fragment buffer on
+ * the stack however large the field is.
+ *
+ * At most X402BLE_NOTIFY_CREDITS notifications are outstanding; each TX
+ * completion (onStatus) releases one and sends the next fragment. Replies to
+ * one central keep their order. Host task only.
+ */
+class NotifyStreamer
+{
+public:
+    NotifyStreamer();
+    ~NotifyStreamer();
+
+    void setCharacteristic(NimBLECharacteristic *tx) { tx_ = tx; }
+
+    // Queue a reply; takes ownership of source. maxNotify is the central's
+    // ATT MTU - 3; frameSeq >= 0 sends binary REPLY frames with that seq.
+    // False (source deleted) if every stream slot is busy.
+    bool send(uint16_t connHandle, size_t maxNotify, int frameSeq, NotifySource *source);
+
+    // Same for prefix + field read in place; allocates nothing
+    bool send(uint16_t connHandle, size_t maxNotify, int frameSeq, const char *prefix, const String &field);
+
+    // A notification left the stack (TX onStatus)
+    void onNotifyComplete();
+
+    // Drop replies to a central that went away
+    void cancel(uint16_t connHandle);
+    void clear();
+
+    size_t getPendingCount() const;
+    bool isBusy(uint16_t connHandle) const; // replies still queued for this central
+
+private:
+    struct Stream
+    {
+        NotifySource *source;  // nullptr = free slot; &field for borrowed replies
+        FieldSource field;     // storage for borrowed replies
+        uint16_t connHandle;
+        int16_t frameSeq;
+        uint32_t order;        // queue position among replies to the same central
+        size_t offset;         // bytes of the reply already sent
+        size_t fragmentSize;   // payload bytes per text fragment
+        uint16_t index;        // next fragment, from 1
+        uint16_t count;        // text fragments in total (1 = not fragmented)
+        uint16_t maxNotify;
+    };
+
+    Stream *claim(); // free slot or nullptr
+    bool start(Stream &stream, uint16_t connHandle, size_t maxNotify, int frameSeq);
+    void pump();
+    bool isNext(const Stream &stream) const;
+    bool sendFragment(Stream &stream); // false if the stack had no room
+    void fail(Stream &stream);         // drop with an ERROR:BUSY to the central
+    void release(Stream &stream);
+
+    NimBLECharacteristic *tx_;
+    Stream streams_[X402BLE_NOTIFY_STREAMS];
+    uint32_t orderCounter_;
+    uint8_t credits_;
+    uint8_t cursor_; // round robin between centrals
+};
+
+#endif // NOTIFY_STREAMER_H
@@ -0,0 +1,473 @@
+#include "OfflineQueue.h"
+#include <WiFi.h>
+#include <time.h>
+#include "X402Ble.h"
+#include "BinaryFrame.h"
+#include "jsonscanner.h"
+#include "facilitatorconnection.h"
+
+// Record: 'O' 'Q' crc16(LE) bodyLength(u32 LE), then the body:
+// value(u64 LE) payload\0 requirements\0 customContext\0 options(0x1f-separated)\0
+#define OFFLINE_HEADER_SIZE 8
+#define OFFLINE_MAX_BODY 8192
+#define OFFLINE_OPTION_SEPARATOR '\x1f'
+
+// Anything earlier means the clock was never set
+#define OFFLINE_MIN_UNIX_TIME 1700000000u
+
+static void putLe32(uint8_t *p, uint32_t v)
+{
+    for (uint8_t i = 0; i < 4; ++i)
+        p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static uint32_t getLe32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Decimal string to uint64, saturating (uint256 values are possible on the wire)
+static uint64_t parseDecimal(const JsonView &view)
+{
+    uint64_t v = 0;
+    for (size_t i = 0; i < view.length; ++i)
+    {
+        char d = view.data[i];
+        if (d < '0' || d > '9')
+            break;
+        if (v > (UINT64_MAX - 9) / 10)
+            return UINT64_MAX;
+        v = v * 10 + (uint64_t)(d - '0');
+    }
+    return v;
+}
+
+OfflineQueue::OfflineQueue()
+    : fs_(nullptr), head_(0), tail_(0), count_(0), value_(0),
+      maxCount_(X402BLE_OFFLINE_MAX_COUNT), maxValue_(X402BLE_OFFLINE_MAX_VALUE),
+      intervalMs_(X402BLE_OFFLINE_DRAIN_INTERVAL_MS), drainTask_(nullptr), lock_(xSemaphoreCreateMutex())
+{
+    path_[0] = '\0';
+    headPath_[0] = '\0';
+}
+
+OfflineQueue::~OfflineQueue()
+{
+    if (drainTask_)
+    {
+        vTaskDelete(drainTask_);
+        drainTask_ = nullptr;
+    }
+    if (lock_)
+    {
+        vSemaphoreDelete(lock_);
+        lock_ = nullptr;
+    }
+}
+
+void OfflineQueue::lock() const
+{
+    if (lock_)
+        xSemaphoreTake(lock_, portMAX_DELAY);
+}
+
+void OfflineQueue::unlock() const
+{
+    if (lock_)
+        xSemaphoreGive(lock_);
+}
+
+void OfflineQueue::setLimits(uint16_t maxCount, uint64_t maxValue)
+{
+    lock();
+    maxCount_ = maxCount;
+    maxValue_ = maxValue;
+    unlock();
+}
+
+// Reads the record at the file position; false at the end of the valid log
+bool OfflineQueue::readRecord(fs::File &file, OfflinePayment *out, uint32_t &recordSize, uint64_t &value)
+{
+    uint8_t header[OFFLINE_HEADER_SIZE];
+    if (file.read(header, sizeof(header)) != sizeof(header) || header[0] != 'O' || header[1] != 'Q')
+        return false;
+
+    uint16_t crc = (uint16_t)(header[2] | (header[3] << 8));
+    uint32_t length = getLe32(header + 4);
+    if (length < 12 || length > OFFLINE_MAX_BODY)
+        return false;
+
+    uint8_t *body = new (std::nothrow) uint8_t[length];
+    if (!body)
+        return false;
+
+    bool ok = file.read(body, length) == length && body[length - 1] == '\0' &&
+              crc16Ccitt(body, length) == crc;
+    if (ok)
+    {
+        recordSize = OFFLINE_HEADER_SIZE + length;
+        value = (uint64_t)getLe32(body) | ((uint64_t)getLe32(body + 4) << 32);
+    }
+    if (ok && out)
+    {
+        // Four NUL-terminated strings follow the value
+        const char *fields[4];
+        const char *p = (const char *)body + 8;
+        const char *end = (const char *)body + length;
+        for (uint8_t i = 0; i < 4; ++i)
+        {
+            if (p >= end)
+            {
+                ok = false;
+                break;
+            }
+            fields[i] = p;
+            p += strlen(p) + 1;
+        }
+        if (ok)
+        {
+            out->value = value;
+            out->payload = fields[0];
+            out->requirements = fields[1];
+            out->customContext = fields[2];
+            out->selectedOptions.clear();
+            for (const char *option = fields[3]; *option;)
+            {
+                const char *sep = strchr(option, OFFLINE_OPTION_SEPARATOR);
+                size_t optionLength = sep ? (size_t)(sep - option) : strlen(option);
+                String s;
+                s.concat(option, optionLength);
+                out->selectedOptions.push_back(std::move(s));
+                option += optionLength + (sep ? 1 : 0);
+            }
+        }
+    }
+
+    delete[] body;
+    return ok;
+}
+
+bool OfflineQueue::saveHead()
+{
+    fs::File file = fs_->open(headPath_, FILE_WRITE);
+    if (!file)
+        return false;
+    uint8_t head[4];
+    putLe32(head, head_);
+    bool ok = file.write(head, sizeof(head)) == sizeof(head);
+    file.close();
+    return ok;
+}
+
+// Rewrite the log with only the unsettled, valid records [head_, validEnd)
+bool OfflineQueue::compact(uint32_t validEnd)
+{
+    if (head_ >= validEnd)
+    {
+        fs_->remove(path_);
+        fs_->remove(headPath_);
+        head_ = tail_ = 0;
+        return true;
+    }
+
+    char tmpPath[sizeof(path_) + 4];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path_);
+
+    fs::File in = fs_->open(path_, FILE_READ);
+    fs::File out = fs_->open(tmpPath, FILE_WRITE);
+    bool ok = in && out && in.seek(head_);
+    uint8_t chunk[256];
+    for (uint32_t left = validEnd - head_; ok && left > 0;)
+    {
+        size_t n = left < sizeof(chunk) ? left : sizeof(chunk);
+        ok = in.read(chunk, n) == n && out.write(chunk, n) == n;
+        left -= n;
+    }
+    if (in)
+        in.close();
+    if (out)
+        out.close();
+
+    if (!ok || !fs_->remove(path_) || !fs_->rename(tmpPath, path_))
+    {
+        fs_->remove(tmpPath);
+        return false;
+    }
+
+    tail_ = validEnd - head_;
+    head_ = 0;
+    fs_->remove(headPath_);
+    return true;
+}
+
+bool OfflineQueue::begin(fs::FS &fs, const char *path)
+{
+    if (!path || strlen(path) >= sizeof(path_))
+        return false;
+
+    lock();
+    fs_ = &fs;
+    strcpy(path_, path);
+    snprintf(headPath_, sizeof(headPath_), "%s.head", path_);
+    head_ = tail_ = 0;
+    count_ = 0;
+    value_ = 0;
+
+    fs::File headFile = fs.open(headPath_, FILE_READ);
+    if (headFile)
+    {
+        uint8_t head[4];
+        if (headFile.read(head, sizeof(head)) == sizeof(head))
+            head_ = getLe32(head);
+        headFile.close();
+    }
+
+    // Walk the log: count what is still unsettled and find the end of the
+    // last intact record
+    uint32_t validEnd = 0;
+    size_t fileSize = 0;
+    fs::File file = fs.open(path_, FILE_READ);
+    if (file)
+    {
+        fileSize = file.size();
+        uint32_t recordSize = 0;
+        uint64_t value = 0;
+        while (readRecord(file, nullptr, recordSize, value))
+        {
+            if (validEnd >= head_)
+            {
+                count_++;
+                value_ = value_ + value < value_ ? UINT64_MAX : value_ + value;
+            }
+            validEnd += recordSize;
+        }
+        file.close();
+    }
+    if (head_ > validEnd)
+        head_ = validEnd; // head written, log lost: nothing left to settle
+    tail_ = validEnd;
+
+    // Drop settled records and any torn tail
+    bool ok = true;
+    if (head_ > 0 || validEnd < fileSize)
+        ok = compact(validEnd);
+    if (!ok)
+        fs_ = nullptr;
+    unlock();
+    return ok;
+}
+
+OfflineQueue::Result OfflineQueue::append(const OfflinePayment &payment)
+{
+    static const char *const keys[] = {"value", "validBefore"};
+    JsonView fields[2];
+    scanJson(payment.payload.c_str(), payment.payload.length(), keys, fields, 2);
+    uint64_t value = parseDecimal(fields[0]);
+
+    // Queued authorizations must outlive the outage; without a clock that
+    // cannot be judged
+    time_t now = time(nullptr);
+    if (now < (time_t)OFFLINE_MIN_UNIX_TIME || !fields[1].found() ||
+        parseDecimal(fields[1]) < (uint64_t)now + X402BLE_OFFLINE_MIN_VALIDITY_S)
+        return EXPIRES_SOON;
+
+    size_t optionsLength = 0;
+    for (const auto &option : payment.selectedOptions)
+        optionsLength += option.length() + 1;
+    size_t length = 8 + payment.payload.length() + 1 + payment.requirements.length() + 1 +
+                    payment.customContext.length() + 1 + (optionsLength ? optionsLength : 1);
+    if (length > OFFLINE_MAX_BODY)
+        return STORAGE_ERROR;
+
+    uint8_t *record = new (std::nothrow) uint8_t[OFFLINE_HEADER_SIZE + length];
+    if (!record)
+        return STORAGE_ERROR;
+
+    uint8_t *body = record + OFFLINE_HEADER_SIZE;
+    putLe32(body, (uint32_t)value);
+    putLe32(body + 4, (uint32_t)(value >> 32));
+    char *p = (char *)body + 8;
+    memcpy(p, payment.payload.c_str(), payment.payload.length() + 1);
+    p += payment.payload.length() + 1;
+    memcpy(p, payment.requirements.c_str(), payment.requirements.length() + 1);
+    p += payment.requirements.length() + 1;
+    memcpy(p, payment.customContext.c_str(), payment.customContext.length() + 1);
+    p += payment.customContext.length() + 1;
+    for (size_t i = 0; i < payment.selectedOptions.size(); ++i)
+    {
+        const String &option = payment.selectedOptions[i];
+        memcpy(p, option.c_str(), option.length());
+        p += option.length();
+        *p++ = i + 1 < payment.selectedOptions.size() ? OFFLINE_OPTION_SEPARATOR : '\0';
+    }
+    if (payment.selectedOptions.empty())
+        *p++ = '\0';
+
+    uint16_t crc = crc16Ccitt(body, length);
+    record[0] = 'O';
+    record[1] = 'Q';
+    record[2] = (uint8_t)crc;
+    record[3] = (uint8_t)(crc >> 8);
+    putLe32(record + 4, (uint32_t)length);
+
+    Result result = QUEUED;
+    lock();
+    if (!fs_)
+    {
+        result = STORAGE_ERROR;
+    }
+    else if (count_ >= maxCount_ || value > maxValue_ || value_ > maxValue_ - value)
+    {
+        result = LIMIT_REACHED;
+    }
+    else
+    {
+        fs::File file = fs_->open(path_, FILE_APPEND);
+        size_t written = file ? file.write(record, OFFLINE_HEADER_SIZE + length) : 0;
+        if (file)
+            file.close();
+
+        if (written == OFFLINE_HEADER_SIZE + length)
+        {
+            tail_ += written;
+            count_++;
+            value_ += value;
+        }
+        else
+        {
+            // Cut off the partial record so later appends stay readable
+            if (written > 0)
+                compact(tail_);
+            result = STORAGE_ERROR;
+        }
+    }
+    unlock();
+
+    delete[] record;
+    return result;
+}
+
+bool OfflineQueue::peek(OfflinePayment &out)
+{
+    lock();
+    bool ok = false;
+    if (fs_ && count_ > 0)
+    {
+        fs::File file = fs_->open(path_, FILE_READ);
+        uint32_t recordSize = 0;
+        uint64_t value = 0;
+        ok = file && file.seek(head_) && readRecord(file, &out, recordSize, value);
+        if (file)
+            file.close();
+    }
+    unlock();
+    return ok;
+}
+
+bool OfflineQueue::pop()
+{
+    lock();
+    bool ok = false;
+    if (fs_ && count_ > 0)
+    {
+        fs::File file = fs_->open(path_, FILE_READ);
+        uint32_t recordSize = 0;
+        uint64_t value = 0;
+        ok = file && file.seek(head_) && readRecord(file, nullptr, recordSize, value);
+        if (file)
+            file.close();
+
+        if (ok)
+        {
+            head_ += recordSize;
+            count_--;
+            value_ = value_ > value ? value_ - value : 0;
+            if (count_ == 0)
+                compact(head_); // all settled: start a fresh log
+            else
+                saveHead();
+        }
+    }
+    unlock();
+    return ok;
+}
+
+void OfflineQueue::clear()
+{
+    lock();
+    if (fs_)
+    {
+        fs_->remove(path_);
+        fs_->remove(headPath_);
+    }
+    head_ = tail_ = 0;
+    count_ = 0;
+    value_ = 0;
+    unlock();
+}
+
+bool OfflineQueue::startDrain(uint32_t intervalMs, size_t stackBytes, UBaseType_t prio, BaseType_t core)
+{
+    intervalMs_ = intervalMs > 0 ? intervalMs : 1;
+    if (drainTask_)
+        return true;
+    return xTaskCreatePinnedToCore(drainTrampoline, "pay_offline", stackBytes / sizeof(StackType_t),
+                                   this, prio, &drainTask_, core) == pdPASS;
+}
+
+void OfflineQueue::drainTrampoline(void *arg)
+{
+    static_cast<OfflineQueue *>(arg)->drainLoop();
+}
+
+// One settle call per interval while WiFi is up, oldest payment first
+void OfflineQueue::drainLoop()
+{
+    FacilitatorConnection *connection = new (std::nothrow) FacilitatorConnection();
+    uint32_t delayMs = intervalMs_;
+
+    for (;;)
+    {
+        vTaskDelay(pdMS_TO_TICKS(delayMs));
+        delayMs = intervalMs_;
+
+        OfflinePayment payment;
+        if (count_ == 0 || WiFi.status() != WL_CONNECTED || !peek(payment))
+            continue;
+
+        PaymentPayload payload(payment.payload);
+        SettlementResult result;
+        settlePayment(payload, payment.requirements, result, "", connection);
+
+        if (result.statusCode <= 0 || result.statusCode >= 500)
+        {
+            // Facilitator unreachable or failing: keep the payment, back off
+            delayMs = X402BLE_OFFLINE_RETRY_MS;
+            continue;
+        }
+
+        pop();
+
+        uint64_t nonceKey = 0;
+        uint32_t validBefore = 0;
+        NonceCache::keyForPayment(payment.payload, nonceKey, validBefore);
+        X402Ble *ble = X402Ble::getActiveInstance();
+        if (result.success && result.transaction.length() > 0)
+        {
+            if (ble)
+                ble->getNonceCache().markSettled(nonceKey, result.transaction);
+        }
+        else if (ble)
+        {
+            // Rejected for good (spent nonce, expired, no balance); service was
+            // already granted - let the sketch account for it
+            ble->getNonceCache().release(nonceKey);
+            if (ble->getOnSettlementFailedCallback() != nullptr)
+            {
+                ble->getOnSettlementFailedCallback()(payment.selectedOptions, payment.customContext,
+                                                     result.errorReason.length() > 0 ? result.errorReason.c_str()
+                                                                                     : "offline_settle_failed");
+            }
+        }
+    }
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include <Arduino.h>
+#include <FS.h>
+#include <vector>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+// Log file (a ".head" file next to it records how far it has been drained)
+#ifndef X402BLE_OFFLINE_PATH
+#define X402BLE_OFFLINE_PATH "/x402_offline.log"
+#endif
+
+// Default risk limits: payments held and their summed value (asset base units)
+#ifndef X402BLE_OFFLINE_MAX_COUNT
+#define X402BLE_OFFLINE_MAX_COUNT 16
+#endif
+#ifndef X402BLE_OFFLINE_MAX_VALUE
+#define X402BLE_OFFLINE_MAX_VALUE 10000000ULL // 10 USDC
+#endif
+
+// An authorization must stay valid at least this long to be queued
+#ifndef X402BLE_OFFLINE_MIN_VALIDITY_S
+#define X402BLE_OFFLINE_MIN_VALIDITY_S 120
+#endif
+
+// Drain pacing: gap between settle calls, and back-off after a network error
+#ifndef X402BLE_OFFLINE_DRAIN_INTERVAL_MS
+#define X402BLE_OFFLINE_DRAIN_INTERVAL_MS 2000
+#endif
+#ifndef X402BLE_OFFLINE_RETRY_MS
+#define X402BLE_OFFLINE_RETRY_MS 30000
+#endif
+
+// One payment accepted while the facilitator was unreachable
+struct OfflinePayment
+{
+    String payload;                      // X-PAYMENT JSON
+    String requirements;                 // paymentRequirements it was checked against
+    String customContext;
+    std::vector<String> selectedOptions;
+    uint64_t value = 0;                  // authorization value, base units (saturated)
+};
+
+/**
+ * Store-and-forward log for payments taken while WiFi is down.
+ *
+ * Locally pre-checked authorizations are appended to a file (LittleFS by
+ * default, any fs::FS works) and settled oldest first by a drain task once
+ * WiFi is back, one settle call per interval. Records carry a CRC, so a write
+ * torn by a power cut is dropped at the next begin(), which also compacts
+ * away records already settled. Risk limits cap how many payments, and how
+ * much value, can be held unsettled at once.
+ */
+class OfflineQueue
+{
+public:
+    enum Result : uint8_t
+    {
+        QUEUED = 0,
+        LIMIT_REACHED,  // count or value limit would be exceeded
+        EXPIRES_SOON,   // validBefore too close to settle later (or clock unset)
+        STORAGE_ERROR   // not begun, or the write failed
+    };
+
+    OfflineQueue();
+    ~OfflineQueue();
+
+    OfflineQueue(const OfflineQueue &) = delete;
+    OfflineQueue &operator=(const OfflineQueue &) = delete;
+
+    // Open (or recover) the log; fs must already be mounted
+    bool begin(fs::FS &fs, const char *path = X402BLE_OFFLINE_PATH);
+    bool isReady() const { return fs_ != nullptr; }
+
+    void setLimits(uint16_t maxCount, uint64_t maxValue);
+    uint16_t getMaxCount() const { return maxCount_; }
+    uint64_t getMaxValue() const { return maxValue_; }
+
+    Result append(const OfflinePayment &payment);
+
+    // Oldest unsettled payment; false if none
+    bool peek(OfflinePayment &out);
+    // Drop the oldest payment (settled, or rejected for good)
+    bool pop();
+    void clear();
+
+    uint16_t getPendingCount() const { return count_; }
+    uint64_t getPendingValue() const { return value_; }
+
+    // Settle queued payments in the background whenever WiFi is up
+    bool startDrain(uint32_t intervalMs = X402BLE_OFFLINE_DRAIN_INTERVAL_MS, size_t stackBytes = 8192,
+                    UBaseType_t prio = 1, BaseType_t core = 1);
+
+private:
+    bool readRecord(fs::File &file, OfflinePayment *out, uint32_t &recordSize, uint64_t &value);
+    bool saveHead();
+    bool compact(uint32_t validEnd);
+    void lock() const;
+    void unlock() const;
+
+    static void drainTrampoline(void *arg);
+    void drainLoop();
+
+    fs::FS *fs_;
+    char path_[32];
+    char headPath_[40];
+    uint32_t head_;      // offset of the oldest unsettled record
+    uint32_t tail_;      // end of the last valid record
+    uint16_t count_;
+    uint64_t value_;
+    uint16_t maxCount_;
+    uint64_t maxValue_;
+    uint32_t intervalMs_;
+    TaskHandle_t drainTask_;
+    SemaphoreHandle_t lock_;
+};
@@ -0,0 +1,133 @@
+#include "PaymentTrace.h"
+#include <algorithm>
+
+#define PAYMENT_TRACE_MAX_DEPTH 64
+
+PaymentTraceRecord *PaymentTracer::ring_ = nullptr;
+uint8_t PaymentTracer::depth_ = 0;
+uint8_t PaymentTracer::next_ = 0;
+uint16_t PaymentTracer::count_ = 0;
+volatile bool PaymentTracer::enabled_ = false;
+portMUX_TYPE PaymentTracer::mux_ = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *const STAGE_NAMES[TRACE_STAGE_COUNT] = {
+    "total", "chunks", "enqueue", "queued", "price", "precheck",
+    "verifyStart", "verify", "settleStart", "settle", "notify"};
+
+bool PaymentTracer::enable(bool enabled, uint8_t depth)
+{
+    if (enabled && !ring_)
+    {
+        if (depth == 0)
+            depth = 1;
+        if (depth > PAYMENT_TRACE_MAX_DEPTH)
+            depth = PAYMENT_TRACE_MAX_DEPTH;
+        ring_ = new (std::nothrow) PaymentTraceRecord[depth];
+        if (!ring_)
+            return false;
+        depth_ = depth;
+    }
+    enabled_ = enabled;
+    return true;
+}
+
+void PaymentTracer::record(const PaymentTraceRecord &trace)
+{
+    if (!enabled_ || !ring_ || !trace.active())
+        return;
+    portENTER_CRITICAL(&mux_);
+    ring_[next_] = trace;
+    next_ = (next_ + 1) % depth_;
+    if (count_ < depth_)
+        count_++;
+    portEXIT_CRITICAL(&mux_);
+}
+
+void PaymentTracer::clear()
+{
+    portENTER_CRITICAL(&mux_);
+    next_ = 0;
+    count_ = 0;
+    portEXIT_CRITICAL(&mux_);
+}
+
+uint16_t PaymentTracer::getRecordCount()
+{
+    portENTER_CRITICAL(&mux_);
+    uint16_t count = count_;
+    portEXIT_CRITICAL(&mux_);
+    return count;
+}
+
+const char *PaymentTracer::stageName(PaymentTraceStage stage)
+{
+    return stage < TRACE_STAGE_COUNT ? STAGE_NAMES[stage] : "";
+}
+
+// Time spent reaching this stage from the previous stage the payment went through
+uint32_t PaymentTracer::stageDuration(const PaymentTraceRecord &trace, uint8_t stage)
+{
+    if (stage == TRACE_FIRST_CHUNK)
+        return trace.offsetUs[TRACE_NOTIFY];
+    for (int8_t prev = stage - 1; prev > 0; --prev)
+    {
+        if (trace.offsetUs[prev])
+            return trace.offsetUs[stage] - trace.offsetUs[prev];
+    }
+    return trace.offsetUs[stage];
+}
+
+bool PaymentTracer::getLatency(PaymentTraceStage stage, PaymentStageLatency &out)
+{
+    out = PaymentStageLatency();
+    if (!ring_ || stage >= TRACE_STAGE_COUNT)
+        return false;
+
+    uint32_t samples[PAYMENT_TRACE_MAX_DEPTH];
+    uint16_t n = 0;
+    portENTER_CRITICAL(&mux_);
+    // Only payments that reached the stage count (e.g. no settle after a failed verify)
+    uint8_t marker = stage == TRACE_FIRST_CHUNK ? TRACE_NOTIFY : stage;
+    for (uint16_t i = 0; i < count_; ++i)
+    {
+        if (ring_[i].offsetUs[marker])
+            samples[n++] = stageDuration(ring_[i], stage);
+    }
+    portEXIT_CRITICAL(&mux_);
+
+    if (n == 0)
+        return false;
+
+    std::sort(samples, samples + n);
+    // Nearest-rank percentiles
+    out.p50Us = samples[(n * 50 + 99) / 100 - 1];
+    out.p95Us = samples[(n * 95 + 99) / 100 - 1];
+    out.p99Us = samples[(n * 99 + 99) / 100 - 1];
+    out.samples = n;
+    return true;
+}
+
+String PaymentTracer::toSummaryJson()
+{
+    String json;
+    json.reserve(320);
+    json = "{\"n\":";
+    json += getRecordCount();
+    for (uint8_t s = 0; s < TRACE_STAGE_COUNT; ++s)
+    {
+        PaymentStageLatency latency;
+        if (!getLatency((PaymentTraceStage)s, latency))
+            continue;
+        json += ",\"";
+        json += STAGE_NAMES[s];
+        json += "\":[";
+        json += latency.p50Us;
+        json += ',';
+        json += latency.p95Us;
+        json += ',';
+        json += latency.p99Us;
+        json += ']';
+    }
+    json += '}';
+    return json;
+}
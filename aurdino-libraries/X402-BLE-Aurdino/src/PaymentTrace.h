@@ -0,0 +1,87 @@
+#pragma once
+#include <Arduino.h>
+#include <esp_timer.h>
+
+// Default number of recent payments kept for percentiles
+#ifndef X402BLE_TRACE_DEPTH
+#define X402BLE_TRACE_DEPTH 32
+#endif
+
+// Pipeline stages, in the order a payment passes through them
+enum PaymentTraceStage : uint8_t
+{
+    TRACE_FIRST_CHUNK = 0, // X-PAYMENT:START received
+    TRACE_LAST_CHUNK,      // X-PAYMENT:END received, payload assembled
+    TRACE_ENQUEUE,         // handed to PaymentVerifyWorker
+    TRACE_DEQUEUE,         // picked up by a worker
+    TRACE_PRICE,           // dynamic price callback returned
+    TRACE_PRECHECK,        // local payload / signature pre-check done
+    TRACE_VERIFY_START,    // verify HTTP request started
+    TRACE_VERIFY_END,      // verify HTTP response parsed
+    TRACE_SETTLE_START,    // settle HTTP request started
+    TRACE_SETTLE_END,      // settle HTTP response parsed
+    TRACE_NOTIFY,          // final notification sent
+    TRACE_STAGE_COUNT
+};
+
+// Timestamps of one payment (esp_timer, microseconds)
+struct PaymentTraceRecord
+{
+    int64_t startUs = 0;                        // first chunk; 0 = not traced
+    uint32_t offsetUs[TRACE_STAGE_COUNT] = {0}; // since startUs; 0 = stage not reached
+
+    bool active() const { return startUs != 0; }
+
+    void mark(PaymentTraceStage stage)
+    {
+        if (!startUs)
+            return;
+        uint32_t offset = (uint32_t)(esp_timer_get_time() - startUs);
+        offsetUs[stage] = offset ? offset : 1;
+    }
+};
+
+// Percentiles of one stage's duration (time since the previous reached stage).
+// For TRACE_FIRST_CHUNK the whole payment (first chunk to final notify) is reported.
+struct PaymentStageLatency
+{
+    uint32_t p50Us;
+    uint32_t p95Us;
+    uint32_t p99Us;
+    uint16_t samples;
+};
+
+// Fixed-size ring of recent payment traces. Disabled by default; when disabled
+// the pipeline only tests one flag per stage.
+class PaymentTracer
+{
+public:
+    // Allocates the ring on first enable (depth up to 64); depth is fixed after that
+    static bool enable(bool enabled = true, uint8_t depth = X402BLE_TRACE_DEPTH);
+    static bool isEnabled() { return enabled_; }
+
+    // Timestamp for a new trace, or 0 when tracing is off
+    static int64_t now() { return enabled_ ? esp_timer_get_time() : 0; }
+
+    static void record(const PaymentTraceRecord &trace);
+    static void clear();
+
+    static bool getLatency(PaymentTraceStage stage, PaymentStageLatency &out);
+    static uint16_t getRecordCount();
+
+    // Stage name used in the [TRACE] summary
+    static const char *stageName(PaymentTraceStage stage);
+
+    // {"n":<payments>,"<stage>":[p50,p95,p99],...} in microseconds
+    static String toSummaryJson();
+
+private:
+    static uint32_t stageDuration(const PaymentTraceRecord &trace, uint8_t stage);
+
+    static PaymentTraceRecord *ring_;
+    static uint8_t depth_;
+    static uint8_t next_;
+    static uint16_t count_;
+    static volatile bool enabled_;
+    static portMUX_TYPE mux_;
+};
@@ -0,0 +1,461 @@
+#include "PaymentVerifyWorker.h"
+#include "facilitatorconnection.h"
+#include "metrics.h"
+#include "precheck.h"
+#include <WiFi.h>
+
+// Assumed job duration until the first payment has been timed (~5s checkout)
+#define VERIFY_WORKER_INITIAL_JOB_MS 5000
+// Never ask clients to retry sooner than this
+#define VERIFY_WORKER_MIN_RETRY_MS 500
+
+QueueHandle_t PaymentVerifyWorker::q_ = nullptr;
+QueueHandle_t PaymentVerifyWorker::settleQ_ = nullptr;
+uint8_t PaymentVerifyWorker::settleBatchSize_ = 1;
+uint32_t PaymentVerifyWorker::settleBatchWindowMs_ = 0;
+uint8_t PaymentVerifyWorker::workerCount_ = 0;
+uint32_t PaymentVerifyWorker::avgJobMs_ = VERIFY_WORKER_INITIAL_JOB_MS;
+portMUX_TYPE PaymentVerifyWorker::statsMux_ = portMUX_INITIALIZER_UNLOCKED;
+
+void PaymentVerifyWorker::begin(size_t stackBytes, UBaseType_t prio, BaseType_t core,
+                                uint8_t workerCount, uint8_t queueDepth)
+{
+    // Already running - the pool is sized once
+    if (q_)
+        return;
+
+    if (workerCount == 0)
+        workerCount = 1;
+    if (queueDepth == 0)
+        queueDepth = 1;
+
+    q_ = xQueueCreate(queueDepth, sizeof(VerifyJob *)); // queue of pointers, not objects
+    if (!q_)
+        return;
+
+    for (uint8_t i = 0; i < workerCount; ++i)
+    {
+        char name[16];
+        snprintf(name, sizeof(name), "pay_verify%u", (unsigned)i);
+        if (xTaskCreatePinnedToCore(taskTrampoline, name, stackBytes / sizeof(StackType_t),
+                                    nullptr, prio, nullptr, core) == pdPASS)
+        {
+            workerCount_++;
+        }
+    }
+}
+
+void PaymentVerifyWorker::beginSettlement(size_t stackBytes, UBaseType_t prio, BaseType_t core,
+                                          uint8_t queueDepth, uint8_t maxBatch, uint32_t windowMs)
+{
+    if (settleQ_)
+        return;
+
+    settleBatchSize_ = maxBatch == 0 ? 1 : (maxBatch > X402BLE_SETTLE_MAX_BATCH ? X402BLE_SETTLE_MAX_BATCH : maxBatch);
+    settleBatchWindowMs_ = windowMs;
+
+    settleQ_ = xQueueCreate(queueDepth > 0 ? queueDepth : 1, sizeof(VerifyJob *));
+    if (!settleQ_)
+        return;
+
+    if (xTaskCreatePinnedToCore(settleTaskTrampoline, "pay_settle", stackBytes / sizeof(StackType_t),
+                                nullptr, prio, nullptr, core) != pdPASS)
+    {
+        vQueueDelete(settleQ_);
+        settleQ_ = nullptr;
+    }
+}
+
+bool PaymentVerifyWorker::enqueue(VerifyJob &&job)
+{
+    if (!q_)
+        return false;
+    // Allocate job on heap with deep ownership transfer
+    VerifyJob *heapJob = new (std::nothrow) VerifyJob();
+    if (!heapJob)
+        return false;
+
+    // Move strings to avoid copies
+    heapJob->payload = std::move(job.payload);
+    heapJob->requirements = std::move(job.requirements);
+    heapJob->txChar = job.txChar;
+    heapJob->connHandle = job.connHandle;
+    heapJob->customContext = std::move(job.customContext);
+    heapJob->selectedOptions = std::move(job.selectedOptions);
+    heapJob->trace = job.trace;
+    heapJob->frameSeq = job.frameSeq;
+    heapJob->nonceKey = job.nonceKey;
+
+    // Queue the pointer (POD), not the object
+    if (xQueueSend(q_, &heapJob, 0) != pdTRUE)
+    {
+        delete heapJob;
+        return false;
+    }
+    return true;
+}
+
+uint32_t PaymentVerifyWorker::getQueuedJobCount()
+{
+    return q_ ? uxQueueMessagesWaiting(q_) : 0;
+}
+
+uint32_t PaymentVerifyWorker::getRetryAfterMs()
+{
+    portENTER_CRITICAL(&statsMux_);
+    uint32_t avg = avgJobMs_;
+    portEXIT_CRITICAL(&statsMux_);
+
+    // A queue slot frees up each time any worker picks up the next job
+    uint32_t retry = avg / (workerCount_ ? workerCount_ : 1);
+    return retry < VERIFY_WORKER_MIN_RETRY_MS ? VERIFY_WORKER_MIN_RETRY_MS : retry;
+}
+
+void PaymentVerifyWorker::recordJobDuration(uint32_t ms)
+{
+    // Exponential moving average, alpha = 1/4
+    portENTER_CRITICAL(&statsMux_);
+    avgJobMs_ = (avgJobMs_ * 3 + ms) / 4;
+    portEXIT_CRITICAL(&statsMux_);
+}
+
+void PaymentVerifyWorker::taskTrampoline(void *)
+{
+    // Per-worker keep-alive connection: workers never wait on each other's sockets
+    FacilitatorConnection *connection = new (std::nothrow) FacilitatorConnection();
+
+    for (;;)
+    {
+        VerifyJob *job = nullptr;
+        if (xQueueReceive(q_, &job, portMAX_DELAY) == pdTRUE && job)
+        {
+            unsigned long startMs = millis();
+            processJob(job, connection);
+            recordJobDuration(millis() - startMs);
+        }
+    }
+}
+
+void PaymentVerifyWorker::settleTaskTrampoline(void *)
+{
+    FacilitatorConnection *connection = new (std::nothrow) FacilitatorConnection();
+
+    VerifyJob *jobs[X402BLE_SETTLE_MAX_BATCH];
+
+    for (;;)
+    {
+        if (xQueueReceive(settleQ_, &jobs[0], portMAX_DELAY) != pdTRUE || !jobs[0])
+            continue;
+
+        // Top the batch up until it is full or the window after the first job closes
+        uint8_t count = 1;
+        TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(settleBatchWindowMs_);
+        while (count < settleBatchSize_)
+        {
+            TickType_t now = xTaskGetTickCount();
+            TickType_t wait = (int32_t)(deadline - now) > 0 ? deadline - now : 0;
+            if (xQueueReceive(settleQ_, &jobs[count], wait) != pdTRUE)
+                break;
+            if (jobs[count])
+                count++;
+        }
+
+        // Facilitator unreachable: give it time before the requeued jobs come round
+        if (processSettlementBatch(jobs, count, connection) > 0)
+            vTaskDelay(pdMS_TO_TICKS(X402BLE_SETTLE_RETRY_MS));
+    }
+}
+
+String PaymentVerifyWorker::buildJobRequirements(const VerifyJob *job)
+{
+    // Get active X402Ble instance to build dynamic payment requirements
+    X402Ble* ble = X402Ble::getActiveInstance();
+    if (!ble)
+        return job->requirements; // Default to passed requirements
+
+    // Calculate dynamic price if callback is set
+    String dynamicPrice = ble->getPrice(); // Default to static price
+    if (ble->getDynamicPriceCallback() != nullptr) {
+        // Same selection as a live [PRICE] quote: charge what the client was shown
+        PriceQuote quote;
+        if (ble->getQuoteCache().get(job->selectedOptions, job->customContext, quote)) {
+            return quote.requirements;
+        }
+        dynamicPrice = ble->getDynamicPriceCallback()(job->selectedOptions, job->customContext);
+    }
+    
+    // Render the prebuilt requirements template with the dynamic price
+    return ble->getRequirementsTemplate().render(dynamicPrice);
+}
+
+bool PaymentVerifyWorker::settleJob(const PaymentPayload &payload, const String &requirements,
+                                    FacilitatorConnection *connection, String &txHash, String &payer)
+{
+    // The response is parsed while it streams in - only these fields are kept
+    SettlementResult result;
+    bool settledOk = settlePayment(payload, requirements, result, "", connection);
+    txHash = std::move(result.transaction);
+    payer = std::move(result.payer);
+    // Only consider paid if settlement succeeded and we have a hash
+    return settledOk && (txHash.length() > 0);
+}
+
+const char *PaymentVerifyWorker::queueOffline(const VerifyJob *job, const String &requirements, bool precheckComplete)
+{
+    // Nothing but the local check stands behind an offline payment
+    if (!precheckComplete)
+        return "offline_unverifiable";
+
+    X402Ble *ble = X402Ble::getActiveInstance();
+    OfflinePayment payment;
+    payment.payload = job->payload;
+    payment.requirements = requirements;
+    payment.customContext = job->customContext;
+    payment.selectedOptions = job->selectedOptions;
+
+    switch (ble->getOfflineQueue().append(payment))
+    {
+    case OfflineQueue::QUEUED:
+        return nullptr;
+    case OfflineQueue::LIMIT_REACHED:
+        return "offline_limit_reached";
+    case OfflineQueue::EXPIRES_SOON:
+        return "offline_authorization_too_short";
+    default:
+        return "offline_storage_error";
+    }
+}
+
+void PaymentVerifyWorker::notify(const VerifyJob *job, const String &message)
+{
+    if (job->txChar)
+    {
+        // Reply to the paying central only, in the protocol it paid with
+        if (job->frameSeq >= 0)
+            notifyBinaryFrame(job->txChar, job->connHandle, FRAME_OP_REPLY, (uint8_t)job->frameSeq,
+                              (const uint8_t *)message.c_str(), message.length());
+        else
+            job->txChar->notify((const uint8_t *)message.c_str(), message.length(), job->connHandle);
+    }
+}
+
+void PaymentVerifyWorker::processJob(VerifyJob *job, FacilitatorConnection *connection)
+{
+    // ---- Do the heavy work OFF the NimBLE host stack ----
+    // Heap use is tracked until settlement finishes (in either stage)
+    MetricsRegistry::instance().beginPayment();
+    job->trace.mark(TRACE_DEQUEUE);
+    bool ok = false;
+    PaymentPayload *payload = nullptr;
+
+    // Avoid exceptions on ESP32 - use std::nothrow for safer allocation
+    payload = new (std::nothrow) PaymentPayload(job->payload);
+    String txHash = "";
+    String payer = "";
+    const char *reason = nullptr;   // sent as REASON: with a failed reply
+    bool queued = false;            // accepted into the offline queue
+    X402Ble* ble = X402Ble::getActiveInstance();
+    bool optimistic = ble && ble->isOptimisticSettlement() && settleQ_;
+    bool offline = ble && ble->getOfflineQueue().isReady() && WiFi.status() != WL_CONNECTED;
+    
+    if (payload)
+    {
+        String dynamicRequirements = buildJobRequirements(job);
+        job->trace.mark(TRACE_PRICE);
+
+        // Reject what the facilitator certainly would, without the round trip
+        bool precheckComplete = false;
+        if (ble && ble->isPrecheckEnabled())
+        {
+            PrecheckResult precheck = precheckPayment(*payload, dynamicRequirements, 0, &precheckComplete);
+            if (precheck != PRECHECK_OK)
+                reason = precheckResultReason(precheck);
+            job->trace.mark(TRACE_PRECHECK);
+        }
+
+        if (!reason && offline)
+        {
+            // No facilitator reachable: take it on the local check alone
+            reason = queueOffline(job, dynamicRequirements, precheckComplete);
+            ok = queued = reason == nullptr;
+        }
+        else if (!reason)
+        {
+            job->trace.mark(TRACE_VERIFY_START);
+            ok = verifyPayment(*payload, dynamicRequirements, "", connection);
+            job->trace.mark(TRACE_VERIFY_END);
+        }
+        
+        if (ok && optimistic && !queued)
+        {
+            // Verified: grant service now and settle in the next pipeline stage
+            delete payload;
+            payload = nullptr;
+
+            ble->recordPayment("", "", job->selectedOptions, job->customContext, false);
+            ble->getNonceCache().markVerified(job->nonceKey);
+            if (ble->getOnPayCallback() != nullptr) {
+                ble->getOnPayCallback()(job->selectedOptions, job->customContext);
+            }
+
+            notify(job, "PAYMENT:VERIFIED");
+
+            // Hand the job (and its requirements snapshot) to the settle stage
+            job->requirements = std::move(dynamicRequirements);
+            if (xQueueSend(settleQ_, &job, 0) != pdTRUE)
+            {
+                // Settle stage saturated - apply back-pressure by settling here
+                processSettlement(job, connection);
+            }
+            return;
+        }
+        
+        // If verification succeeded, settle the payment
+        if (ok && !queued)
+        {
+            job->trace.mark(TRACE_SETTLE_START);
+            ok = settleJob(*payload, dynamicRequirements, connection, txHash, payer);
+            job->trace.mark(TRACE_SETTLE_END);
+        }
+        
+        delete payload;
+        payload = nullptr;
+    }
+
+    // Remember the outcome for resubmissions; failures may be retried
+    if (ble)
+    {
+        if (queued)
+            ble->getNonceCache().markVerified(job->nonceKey);
+        else if (ok)
+            ble->getNonceCache().markSettled(job->nonceKey, txHash);
+        else
+            ble->getNonceCache().release(job->nonceKey);
+    }
+
+    // Update global last payment state if we have an instance
+    // Only set user context/options if payment was successful
+    if (ok && ble) {
+        // Last payment state, user selections and the waitForPayment() event
+        ble->recordPayment(txHash, payer, job->selectedOptions, job->customContext, !queued);
+        
+        // Call onPay callback if set
+        if (ble->getOnPayCallback() != nullptr) {
+            
+            ble->getOnPayCallback()(job->selectedOptions, job->customContext);
+        }
+    }
+
+    // Build and send response with transaction hash if available
+    String resp = ok ? "PAYMENT:COMPLETE VERIFIED:true" : "PAYMENT:COMPLETE VERIFIED:false";
+    if (ok && txHash.length() > 0)
+    {
+        resp += " TX:";
+        resp += txHash;
+    }
+    else if (queued)
+    {
+        resp += " QUEUED";
+    }
+    else if (reason)
+    {
+        resp += " REASON:";
+        resp += reason;
+    }
+    notify(job, resp);
+    job->trace.mark(TRACE_NOTIFY);
+    PaymentTracer::record(job->trace);
+    MetricsRegistry::instance().endPayment();
+
+    // Free the heap-allocated job
+    delete job;
+}
+
+void PaymentVerifyWorker::processSettlement(VerifyJob *job, FacilitatorConnection *connection)
+{
+    processSettlementBatch(&job, 1, connection);
+}
+
+uint8_t PaymentVerifyWorker::processSettlementBatch(VerifyJob **jobs, uint8_t count, FacilitatorConnection *connection)
+{
+    uint8_t requeued = 0;
+    PaymentPayload *payloads = new (std::nothrow) PaymentPayload[count];
+    SettlementBatchItem *items = new (std::nothrow) SettlementBatchItem[count];
+    bool allocated = payloads && items;
+    if (allocated)
+    {
+        for (uint8_t i = 0; i < count; ++i)
+        {
+            payloads[i] = PaymentPayload(jobs[i]->payload);
+            items[i].payment = &payloads[i];
+            items[i].paymentRequirements = &jobs[i]->requirements;
+            jobs[i]->trace.mark(TRACE_SETTLE_START);
+        }
+
+        // One held connection for the whole batch; results come back per item
+        settlePaymentBatch(items, count, "", connection);
+    }
+
+    X402Ble* ble = X402Ble::getActiveInstance();
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        VerifyJob *job = jobs[i];
+        bool ok = false;
+        const char *reason = allocated ? "settle_failed" : "out_of_memory";
+        if (allocated)
+        {
+            job->trace.mark(TRACE_SETTLE_END);
+            // Only consider paid if settlement succeeded and we have a hash
+            ok = items[i].result.success && items[i].result.transaction.length() > 0;
+
+            // The facilitator never saw it, so nothing is lost yet: settle it again
+            if (!items[i].sent)
+            {
+                if (++job->settleAttempts < X402BLE_SETTLE_MAX_ATTEMPTS && settleQ_ &&
+                    xQueueSend(settleQ_, &job, 0) == pdTRUE)
+                {
+                    requeued++;
+                    continue;
+                }
+                reason = "facilitator_unreachable";
+            }
+        }
+
+        if (ok)
+        {
+            const String &txHash = items[i].result.transaction;
+            if (ble)
+            {
+                ble->updateLastSettlement(txHash, items[i].result.payer);
+                ble->getNonceCache().markSettled(job->nonceKey, txHash);
+            }
+
+            String resp = "PAYMENT:SETTLED TX:";
+            resp += txHash;
+            notify(job, resp);
+        }
+        else
+        {
+            // Not on chain: a resubmission has to go through the facilitator again
+            if (ble)
+                ble->getNonceCache().release(job->nonceKey);
+
+            // Service was already granted on verify - let the sketch revoke it
+            if (ble && ble->getOnSettlementFailedCallback() != nullptr)
+            {
+                ble->getOnSettlementFailedCallback()(job->selectedOptions, job->customContext, reason);
+            }
+            notify(job, "PAYMENT:SETTLE_FAILED");
+        }
+        job->trace.mark(TRACE_NOTIFY);
+        PaymentTracer::record(job->trace);
+        MetricsRegistry::instance().endPayment();
+
+        // Free the heap-allocated job
+        delete job;
+    }
+
+    delete[] items;
+    delete[] payloads;
+    return requeued;
+}
@@ -4,160 +4,73 @@
 #include "NimBLEDevice.h"
 #include "X402Ble.h"
 
+class FacilitatorConnection;
+
 // Job struct - will be heap-allocated to avoid shallow copies
 struct VerifyJob
 {
     String payload;               // assembled payment payload (JSON only)
     String requirements;          // paymentRequirements snapshot
     NimBLECharacteristic *txChar; // TX to respond on
+    uint16_t connHandle = BLE_HS_CONN_HANDLE_NONE; // central that sent the payment
     String customContext;         // user's custom context
     std::vector<String> selectedOptions; // user's selected options
+    PaymentTraceRecord trace;     // stage timestamps (inactive unless tracing)
+    int16_t frameSeq = -1;        // seq of a binary PAYMENT frame; -1 replies in text
+    uint64_t nonceKey = 0;        // NonceCache entry claimed for this authorization
+    uint8_t settleAttempts = 0;   // settle requests that never reached the facilitator
 };
 
+// Pool of verifier tasks pulling jobs from one shared queue.
+// Each worker owns its own keep-alive facilitator connection, so a slow
+// settle only blocks the worker running it.
 class PaymentVerifyWorker
 {
 public:
-    static void begin(size_t stackBytes = 8192, UBaseType_t prio = 3, BaseType_t core = 1)
-    {
-        if (!q_)
-            q_ = xQueueCreate(4, sizeof(VerifyJob *)); // queue of pointers, not objects
-        xTaskCreatePinnedToCore(taskTrampoline, "pay_verify", stackBytes / sizeof(StackType_t),
-                                nullptr, prio, nullptr, core);
-    }
+    // Starts workerCount tasks (once); queueDepth bounds jobs waiting for a worker
+    static void begin(size_t stackBytes = 8192, UBaseType_t prio = 3, BaseType_t core = 1,
+                      uint8_t workerCount = 1, uint8_t queueDepth = 4);
 
-    static bool enqueue(VerifyJob &&job)
-    {
-        if (!q_)
-            return false;
-        // Allocate job on heap with deep ownership transfer
-        VerifyJob *heapJob = new (std::nothrow) VerifyJob();
-        if (!heapJob)
-            return false;
+    // Hands the job to the pool; false if the queue is full (caller replies BUSY)
+    static bool enqueue(VerifyJob &&job);
 
-        // Move strings to avoid copies
-        heapJob->payload = job.payload;
-        heapJob->requirements = job.requirements;
-        heapJob->txChar = job.txChar;
-        heapJob->customContext = job.customContext;
-        heapJob->selectedOptions = job.selectedOptions;
+    // Suggested client back-off when enqueue() fails, from recent job durations
+    static uint32_t getRetryAfterMs();
 
-        // Queue the pointer (POD), not the object
-        if (xQueueSend(q_, &heapJob, 0) != pdTRUE)
-        {
-            delete heapJob;
-            return false;
-        }
-        return true;
-    }
+    // Starts the settlement stage used in optimistic mode (once). With
+    // maxBatch > 1 it collects up to maxBatch jobs, waiting at most windowMs
+    // after the first, and settles them on one held connection.
+    static void beginSettlement(size_t stackBytes = 8192, UBaseType_t prio = 2, BaseType_t core = 1,
+                                uint8_t queueDepth = 8, uint8_t maxBatch = 1, uint32_t windowMs = 0);
 
-private:
-    static QueueHandle_t q_;
-    static void taskTrampoline(void *)
-    {
-        for (;;)
-        {
-            VerifyJob *job = nullptr;
-            if (xQueueReceive(q_, &job, portMAX_DELAY) == pdTRUE && job)
-            {
-                // ---- Do the heavy work OFF the NimBLE host stack ----
-                bool ok = false;
-                PaymentPayload *payload = nullptr;
+    static uint8_t getWorkerCount() { return workerCount_; }
+    static uint32_t getQueuedJobCount();
 
-                // Avoid exceptions on ESP32 - use std::nothrow for safer allocation
-                payload = new (std::nothrow) PaymentPayload(job->payload);
-                String txHash = "";
-                String payer = "";
-                String dynamicRequirements = job->requirements; // Default to passed requirements
-                
-                if (payload)
-                {
-                    // Get active X402Ble instance to build dynamic payment requirements
-                    if (X402Ble* ble = X402Ble::getActiveInstance()) {
-                        // Calculate dynamic price if callback is set
-                        String dynamicPrice = ble->getPrice(); // Default to static price
-                        if (ble->getDynamicPriceCallback() != nullptr) {
-                            dynamicPrice = ble->getDynamicPriceCallback()(job->selectedOptions, job->customContext);
-                            
-                        }
-                        
-                        // Build payment requirements with dynamic price
-                        dynamicRequirements = buildDefaultPaymentRementsJson(
-                            ble->getNetwork(),      // network
-                            ble->getPayTo(),        // payTo address
-                            dynamicPrice,           // dynamic price based on options/context
-                            ble->getLogo(),         // logo
-                            ble->getDescription()   // description
-                        );
-                        
-                        
-                    }
-                    
-                    ok = verifyPayment(*payload, dynamicRequirements, "");
-                    
-                    
-                    // If verification succeeded, settle the payment
-                    if (ok)
-                    {
-                        String txResp = settlePayment(*payload, dynamicRequirements, "");
-                        // Expecting JSON like: {"success":true,"transaction":"0x...","network":"...","payer":"0x..."}
-                        // Minimal, allocation-light parsing
-                        int txPos = txResp.indexOf("\"transaction\":\"");
-                        if (txPos >= 0) {
-                            txPos += 15; // length of "transaction":"
-                            int txEnd = txResp.indexOf('"', txPos);
-                            if (txEnd > txPos) txHash = txResp.substring(txPos, txEnd);
-                        }
-                        int payerPos = txResp.indexOf("\"payer\":\"");
-                        if (payerPos >= 0) {
-                            payerPos += 10; // length of "payer":"
-                            int payerEnd = txResp.indexOf('"', payerPos);
-                            if (payerEnd > payerPos) payer = txResp.substring(payerPos, payerEnd);
-                        }
-                        // Optional success flag
-                        bool settledOk = txResp.indexOf("\"success\":true") >= 0;
-                        // Only consider paid if settlement succeeded and we have a hash
-                        ok = ok && settledOk && (txHash.length() > 0);
-                    }
-                    
-                    delete payload;
-                    payload = nullptr;
-                }
+private:
+    static void taskTrampoline(void *);
+    static void settleTaskTrampoline(void *);
 
-                // Update global last payment state if we have an instance
-                // Only set user context/options if payment was successful
-                if (ok) {
-                    if (X402Ble* ble = X402Ble::getActiveInstance()) {
-                        ble->setLastPaymentState(true, txHash, payer);   
-                        // Set user selections only on successful payment
-                        ble->setUserCustomContext(job->customContext);
-                        ble->setUserSelectedOptions(job->selectedOptions);
-                        
-                        // Call onPay callback if set
-                        if (ble->getOnPayCallback() != nullptr) {
-                            
-                            ble->getOnPayCallback()(job->selectedOptions, job->customContext);
-                        }
-                    }
-                }
+    // Each stage takes ownership of the job and deletes it (or hands it on)
+    static void processJob(VerifyJob *job, FacilitatorConnection *connection);
+    static void processSettlement(VerifyJob *job, FacilitatorConnection *connection);
+    // Returns how many jobs went back on the settle queue to be tried again
+    static uint8_t processSettlementBatch(VerifyJob **jobs, uint8_t count, FacilitatorConnection *connection);
 
-                // Build and send response with transaction hash if available
-                String resp = ok ? "PAYMENT:COMPLETE VERIFIED:true" : "PAYMENT:COMPLETE VERIFIED:false";
-                if (ok && txHash.length() > 0)
-                {
-                    resp += " TX:";
-                    resp += txHash;
-                }
-                
-                if (job->txChar)
-                {
-                    job->txChar->setValue((const uint8_t *)resp.c_str(), resp.length());
-                    job->txChar->notify();
-                }
+    // Builds requirements for the job's options/context (dynamic price)
+    static String buildJobRequirements(const VerifyJob *job);
+    // Settles and extracts tx hash / payer; true only if settled on-chain
+    static bool settleJob(const PaymentPayload &payload, const String &requirements,
+                          FacilitatorConnection *connection, String &txHash, String &payer);
+    // Appends the job to the offline queue; nullptr when queued, else the reason
+    static const char *queueOffline(const VerifyJob *job, const String &requirements, bool precheckComplete);
+    static void notify(const VerifyJob *job, const String &message);
+    static void recordJobDuration(uint32_t ms);
 
-                // Free the heap-allocated job
-                delete job;
-            }
-        }
-    }
+    static QueueHandle_t q_;
+    static QueueHandle_t settleQ_;
+    static uint8_t settleBatchSize_;
+    static uint32_t settleBatchWindowMs_;
+    static uint8_t workerCount_;
+    static uint32_t avgJobMs_;   // moving average of verify+settle time
+    static portMUX_TYPE statsMux_;
 };
-inline QueueHandle_t PaymentVerifyWorker::q_ = nullptr;
\ No newline at end of file
@@ -0,0 +1,150 @@
+#include "PriceQuoteCache.h"
+#include <esp_timer.h>
+
+PriceQuoteCache::PriceQuoteCache(uint32_t ttlMs)
+    : useCounter_(0), ttlUs_((int64_t)ttlMs * 1000), lock_(xSemaphoreCreateMutex())
+{
+    for (auto &slot : slots_)
+    {
+        slot.lastUsed = 0;
+    }
+}
+
+PriceQuoteCache::~PriceQuoteCache()
+{
+    if (lock_)
+    {
+        vSemaphoreDelete(lock_);
+        lock_ = nullptr;
+    }
+}
+
+static inline uint32_t fnv1a(uint32_t hash, const char *data, size_t length)
+{
+    for (size_t i = 0; i < length; ++i)
+    {
+        hash ^= (uint8_t)data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+uint32_t PriceQuoteCache::keyFor(const std::vector<String> &options, const String &customContext)
+{
+    uint32_t hash = 2166136261u;
+    for (const auto &option : options)
+    {
+        hash = fnv1a(hash, option.c_str(), option.length());
+        hash = fnv1a(hash, "\x1f", 1); // keeps ["ab"] and ["a","b"] apart
+    }
+    hash = fnv1a(hash, "\x1e", 1);
+    hash = fnv1a(hash, customContext.c_str(), customContext.length());
+    return hash ? hash : 1; // 0 means "no quote"
+}
+
+String PriceQuoteCache::selectionFor(const std::vector<String> &options, const String &customContext)
+{
+    size_t length = customContext.length() + 1;
+    for (const auto &option : options)
+        length += option.length() + 6;
+
+    // Length-prefixed, so no option or context text can shift the boundaries
+    String selection;
+    selection.reserve(length);
+    for (const auto &option : options)
+    {
+        selection += option.length();
+        selection += ':';
+        selection += option;
+    }
+    selection += '|';
+    selection += customContext;
+    return selection;
+}
+
+uint32_t PriceQuoteCache::put(const std::vector<String> &options, const String &customContext,
+                              const String &price, const String &requirements)
+{
+    uint32_t id = keyFor(options, customContext);
+    String selection = selectionFor(options, customContext);
+    int64_t expiresUs = esp_timer_get_time() + ttlUs_;
+
+    if (lock_)
+        xSemaphoreTake(lock_, portMAX_DELAY);
+
+    // Same selection again, else an empty slot, else the least recently used
+    Slot *target = nullptr;
+    for (auto &slot : slots_)
+    {
+        if (slot.lastUsed && slot.quote.id == id && slot.quote.selection == selection)
+        {
+            target = &slot;
+            break;
+        }
+    }
+    if (!target)
+    {
+        for (auto &slot : slots_)
+        {
+            if (!target || slot.lastUsed < target->lastUsed)
+                target = &slot;
+        }
+    }
+
+    target->quote.id = id;
+    target->quote.selection = selection;
+    target->quote.price = price;
+    target->quote.requirements = requirements;
+    target->quote.expiresUs = expiresUs;
+    target->lastUsed = ++useCounter_;
+
+    if (lock_)
+        xSemaphoreGive(lock_);
+    return id;
+}
+
+bool PriceQuoteCache::get(const std::vector<String> &options, const String &customContext, PriceQuote &out)
+{
+    uint32_t id = keyFor(options, customContext);
+    String selection = selectionFor(options, customContext);
+    int64_t now = esp_timer_get_time();
+    bool found = false;
+
+    if (lock_)
+        xSemaphoreTake(lock_, portMAX_DELAY);
+    for (auto &slot : slots_)
+    {
+        // The id only narrows the search; a colliding selection is a miss
+        if (!slot.lastUsed || slot.quote.id != id || slot.quote.selection != selection)
+            continue;
+        if (slot.quote.expiresUs <= now)
+        {
+            // Stale price - free the slot and make the caller price again
+            slot.lastUsed = 0;
+            slot.quote.selection = "";
+            slot.quote.price = "";
+            slot.quote.requirements = "";
+            break;
+        }
+        out = slot.quote;
+        slot.lastUsed = ++useCounter_;
+        found = true;
+        break;
+    }
+    if (lock_)
+        xSemaphoreGive(lock_);
+    return found;
+}
+
+void PriceQuoteCache::clear()
+{
+    if (lock_)
+        xSemaphoreTake(lock_, portMAX_DELAY);
+    for (auto &slot : slots_)
+    {
+        slot.lastUsed = 0;
+        slot.quote = PriceQuote();
+    }
+    if (lock_)
+        xSemaphoreGive(lock_);
+}
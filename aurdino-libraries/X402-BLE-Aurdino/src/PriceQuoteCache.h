@@ -0,0 +1,74 @@
+#pragma once
+#include <Arduino.h>
+#include <vector>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+// Quotes kept at once (least recently used is evicted)
+#ifndef X402BLE_QUOTE_CACHE_SIZE
+#define X402BLE_QUOTE_CACHE_SIZE 4
+#endif
+
+// How long a [PRICE] quote stays valid for the payment that follows it
+#ifndef X402BLE_QUOTE_TTL_MS
+#define X402BLE_QUOTE_TTL_MS 120000
+#endif
+
+// Price computed for one (options, context) pair, with its rendered requirements
+struct PriceQuote
+{
+    uint32_t id = 0;          // hash of (options, context); sent to the client as quoteId
+    String selection;         // the (options, context) it was priced for, see selectionFor()
+    String price;
+    String requirements;      // paymentRequirements JSON rendered with price
+    int64_t expiresUs = 0;    // esp_timer time
+};
+
+/**
+ * Small LRU of recent [PRICE] quotes.
+ *
+ * The dynamic price callback runs once when the client asks for a price;
+ * the payment for the same options and context then reuses the quote, so
+ * the callback is not run again and the customer pays exactly the price
+ * they were shown. Quotes are matched on the full selection, not just its
+ * hash: the context is free client text, so a 32-bit id is easy to collide
+ * with a cheaper quote. Safe to use from the NimBLE host task and the workers.
+ */
+class PriceQuoteCache
+{
+public:
+    explicit PriceQuoteCache(uint32_t ttlMs = X402BLE_QUOTE_TTL_MS);
+    ~PriceQuoteCache();
+
+    PriceQuoteCache(const PriceQuoteCache &) = delete;
+    PriceQuoteCache &operator=(const PriceQuoteCache &) = delete;
+
+    // FNV-1a over the options (in order) and the context
+    static uint32_t keyFor(const std::vector<String> &options, const String &customContext);
+
+    // Options (in order, each length-prefixed) and context as one string
+    static String selectionFor(const std::vector<String> &options, const String &customContext);
+
+    // Store (or refresh) the quote for this selection; returns its id
+    uint32_t put(const std::vector<String> &options, const String &customContext,
+                 const String &price, const String &requirements);
+
+    // Copy out the live quote for exactly this selection; expired quotes are
+    // dropped and not returned
+    bool get(const std::vector<String> &options, const String &customContext, PriceQuote &out);
+
+    void clear();
+    void setTtl(uint32_t ttlMs) { ttlUs_ = (int64_t)ttlMs * 1000; }
+
+private:
+    struct Slot
+    {
+        PriceQuote quote;
+        uint32_t lastUsed; // LRU stamp, 0 = empty
+    };
+
+    Slot slots_[X402BLE_QUOTE_CACHE_SIZE];
+    uint32_t useCounter_;
+    int64_t ttlUs_;
+    SemaphoreHandle_t lock_;
+};
@@ -2,100 +2,58 @@
 #include "X402Ble.h"
 #include "X402BleUtils.h"
 #include "PaymentVerifyWorker.h"
+#include "metrics.h"
+#include "BinaryFrame.h"
 
 // Memory-optimized implementation with proper garbage collection
-void RxCallbacks::onWrite(NimBLECharacteristic *ch)
+void RxCallbacks::handleWrite(NimBLECharacteristic *ch, uint16_t connHandle)
 {
     // Get request directly as const char* to avoid String copy
     std::string req_std = ch->getValue();
     if (req_std.empty())
         return;
 
-    const char *req_cstr = req_std.c_str();
+    // Binary frames open with a byte no text command starts with
+    if (isBinaryFrame((const uint8_t *)req_std.data(), req_std.length()))
+        handleFrame((const uint8_t *)req_std.data(), req_std.length(), connHandle);
+    else
+        handleRequest(req_std.c_str(), req_std.length(), connHandle, -1);
+}
 
+void RxCallbacks::handleRequest(const char *req_cstr, size_t req_len, uint16_t connHandle, int frameSeq)
+{
     // Use stack-allocated buffer for small replies, heap for large ones
     char reply_buffer[256];
     String *heap_reply = nullptr;
     const char *reply_ptr = nullptr;
+    uint8_t *binary_reply = nullptr;
+    size_t binary_len = 0;
+    const char *stream_prefix = nullptr;  // prefix + stored field, read in place by the streamer
+    const String *stream_field = nullptr;
 
     // Check if this is a payment chunk (X-PAYMENT:START, X-PAYMENT, X-PAYMENT:END)
     if (strncmp(req_cstr, "X-PAYMENT", 9) == 0)
     {
-        if (pBle)
+        X402BleSession *session = pBle ? pBle->getSession(connHandle) : nullptr;
+        if (session)
         {
-            String currentPayload = pBle->getPaymentPayload();
-            String reqStr(req_cstr); // Only create String when needed
-            bool isComplete = assemblePaymentChunk(reqStr, currentPayload);
-            pBle->setPaymentPayload(currentPayload);
+            if (strncmp(req_cstr, "X-PAYMENT:START", 15) == 0)
+            {
+                session->traceStartUs = PaymentTracer::now();
+            }
 
-            // Clear reqStr immediately after use
-            reqStr = String();
+            // Append in place into this central's own buffer (no payload copies)
+            bool isComplete = assemblePaymentChunk(req_cstr, req_len, session->paymentBuffer);
 
-            if (isComplete)
+            if (session->paymentBuffer.overflowed())
             {
-                // Immediate lightweight ACK (keeps phone happy & host stack safe)
-                strcpy(reply_buffer, "PAYMENT:VERIFYING");
+                session->paymentBuffer.clear();
+                strcpy(reply_buffer, "ERROR:PAYLOAD_TOO_LARGE");
                 reply_ptr = reply_buffer;
-
-                // The assembled payload is: JSON -- customContext -- [options]
-                String combined = pBle->getPaymentPayload();
-                // Parse custom context
-                int firstSep = combined.indexOf("--");
-                int secondSep = firstSep >= 0 ? combined.indexOf("--", firstSep + 2) : -1;
-                String jsonPart;
-                String customContext;
-                String optionsPart;
-                if (firstSep >= 0 && secondSep > firstSep)
-                {
-                    jsonPart = combined.substring(0, firstSep);
-                    customContext = combined.substring(firstSep + 2, secondSep);
-                    optionsPart = combined.substring(secondSep + 2);
-                }
-                else
-                {
-                    // Fallback: treat whole as JSON if separators missing
-                    jsonPart = combined;
-                }
-
-                // Normalize customContext: if it's wrapped as "" (empty quoted), make empty
-                if (customContext == "\"\"")
-                    customContext = "";
-
-                // Parse options array like [opt1,opt2]
-                std::vector<String> selectedOptions;
-                if (optionsPart.length() > 1 && optionsPart[0] == '[' && optionsPart[optionsPart.length() - 1] == ']')
-                {
-                    String inner = optionsPart.substring(1, optionsPart.length() - 1);
-                    int start = 0;
-                    while (start < (int)inner.length())
-                    {
-                        int comma = inner.indexOf(',', start);
-                        String item = comma >= 0 ? inner.substring(start, comma) : inner.substring(start);
-                        item.trim();
-                        if (item.length() > 0)
-                            selectedOptions.push_back(item);
-                        if (comma < 0)
-                            break;
-                        start = comma + 1;
-                    }
-                }
-Serial.println("Payment JSON: " + jsonPart);
-Serial.println("Custom Context: " + customContext);
-Serial.print("Selected Options: ");
-for (const auto& opt : selectedOptions) {
-    Serial.print(opt + " ");
-}
-Serial.println();
-
-                // Pass to worker - will only be set on X402Ble if payment succeeds
-                // Payment requirements will be built dynamically in the worker with dynamic price
-                VerifyJob job;
-                job.payload = jsonPart;                       // only payment JSON
-                job.requirements = "";                        // Will be built dynamically in worker
-                job.txChar = pTxChar;                         // TX characteristic for response
-                job.customContext = customContext;            // parsed custom context
-                job.selectedOptions = selectedOptions;        // parsed selected options
-                PaymentVerifyWorker::enqueue(std::move(job));
+            }
+            else if (isComplete)
+            {
+                reply_ptr = completePayment(session, connHandle, frameSeq, reply_buffer, sizeof(reply_buffer));
             }
             else
             {
@@ -106,17 +64,18 @@ Serial.println();
         }
         else
         {
-            strcpy(reply_buffer, "ERROR:NO_CONTEXT");
+            // No instance, or every session slot is taken by other centrals
+            strcpy(reply_buffer, pBle ? "ERROR:NO_SESSION" : "ERROR:NO_CONTEXT");
             reply_ptr = reply_buffer;
         }
     }
     else if (strncasecmp(req_cstr, "[LOGO]", 6) == 0)
     {
-        // Return logo string - use heap for potentially large content
+        // Return logo string - read in place from the stored field, fragmented past the MTU
         if (pBle && pBle->getLogo().length() > 0)
         {
-            heap_reply = new String("LOGO://" + pBle->getLogo());
-            reply_ptr = heap_reply->c_str();
+            stream_prefix = "LOGO://";
+            stream_field = &pBle->getLogo();
         }
         else
         {
@@ -129,8 +88,8 @@ Serial.println();
         // Return banner string
         if (pBle && pBle->getBanner().length() > 0)
         {
-            heap_reply = new String("BANNER://" + pBle->getBanner());
-            reply_ptr = heap_reply->c_str();
+            stream_prefix = "BANNER://";
+            stream_field = &pBle->getBanner();
         }
         else
         {
@@ -143,8 +102,8 @@ Serial.println();
         // Return description string
         if (pBle && pBle->getDescription().length() > 0)
         {
-            heap_reply = new String("DESC://" + pBle->getDescription());
-            reply_ptr = heap_reply->c_str();
+            stream_prefix = "DESC://";
+            stream_field = &pBle->getDescription();
         }
         else
         {
@@ -154,32 +113,61 @@ Serial.println();
     }
     else if (strncasecmp(req_cstr, "[CONFIG]", 8) == 0)
     {
-        // Build CONFIG response efficiently
+        // Pre-rendered CONFIG with this central's MTU spliced in (no heap)
+        if (pBle && pBle->renderConfigReply(pBle->getPeerMTU(connHandle), reply_buffer, sizeof(reply_buffer)))
+        {
+            reply_ptr = reply_buffer;
+        }
+        else
+        {
+            strcpy(reply_buffer, "CONFIG://{}");
+            reply_ptr = reply_buffer;
+        }
+    }
+    else if (strncasecmp(req_cstr, "[TRACE]", 7) == 0)
+    {
+        // Per-stage payment latency percentiles (microseconds)
         heap_reply = new String();
-        heap_reply->reserve(128); // Pre-allocate memory
-        *heap_reply = "CONFIG://{\"frequency\": ";
-        *heap_reply += String(pBle->getFrequency());
-        *heap_reply += ", \"allowCustomContent\": ";
-        *heap_reply += (pBle->isCustomContentAllowed() ? "true" : "false");
-        *heap_reply += "}";
+        heap_reply->reserve(320);
+        *heap_reply = "TRACE://";
+        *heap_reply += PaymentTracer::toSummaryJson();
+        reply_ptr = heap_reply->c_str();
+    }
+    else if (strncasecmp(req_cstr, "[STATS]:BIN", 11) == 0)
+    {
+        // Compact binary snapshot of the metrics registry after a text prefix
+        MetricsRegistry &metrics = MetricsRegistry::instance();
+        size_t size = 12 + metrics.getSnapshotSize();
+        binary_reply = new (std::nothrow) uint8_t[size];
+        if (binary_reply)
+        {
+            memcpy(binary_reply, "STATS-BIN://", 12);
+            size_t written = metrics.snapshot(binary_reply + 12, size - 12);
+            binary_len = written ? 12 + written : 0;
+        }
+        if (!binary_len)
+        {
+            strcpy(reply_buffer, "ERROR:OUT_OF_MEMORY");
+            reply_ptr = reply_buffer;
+        }
+    }
+    else if (strncasecmp(req_cstr, "[STATS]", 7) == 0)
+    {
+        // Memory health summary for fleet monitoring
+        heap_reply = new String();
+        heap_reply->reserve(256);
+        *heap_reply = "STATS://";
+        *heap_reply += MetricsRegistry::instance().toSummaryJson();
         reply_ptr = heap_reply->c_str();
     }
     else if (strncasecmp(req_cstr, "[OPTIONS]", 9) == 0)
     {
-        // Handle options request - build comma-separated string
+        // Pre-rendered comma-separated options. Sent as a reply, not read in
+        // place: the next [OPTIONS] after enableOptions() re-renders the String
+        // while a fragmented reply could still be reading it.
         if (pBle)
         {
-            const auto &opts = pBle->getOptions();
-            heap_reply = new String();
-            heap_reply->reserve(256); // Pre-allocate for options
-            *heap_reply = "OPTIONS://";
-            for (size_t i = 0; i < opts.size(); ++i)
-            {
-                *heap_reply += opts[i];
-                if (i + 1 < opts.size())
-                    *heap_reply += ",";
-            }
-            reply_ptr = heap_reply->c_str();
+            reply_ptr = pBle->getOptionsReply().c_str();
         }
         else
         {
@@ -191,96 +179,21 @@ Serial.println();
     {
         // Handle [PRICE] chunked data: [PRICE]:START, [PRICE]:, [PRICE]:END
         
-        if (pBle)
+        X402BleSession *session = pBle ? pBle->getSession(connHandle) : nullptr;
+        if (session)
         {
-            String currentPricePayload = pBle->getPriceRequestPayload();
-            String reqStr(req_cstr); // Only create String when needed
-            bool isComplete = assemblePriceRequestChunk(reqStr, currentPricePayload);
-            pBle->setPriceRequestPayload(currentPricePayload);
+            bool isComplete = assemblePriceRequestChunk(req_cstr, req_len, session->priceBuffer);
 
-            // Clear reqStr immediately after use
-            reqStr = String();
-
-            if (isComplete)
+            if (session->priceBuffer.overflowed())
+            {
+                session->priceBuffer.clear();
+                strcpy(reply_buffer, "ERROR:PAYLOAD_TOO_LARGE");
+                reply_ptr = reply_buffer;
+            }
+            else if (isComplete)
             {
-                
-                // Parse the combined payload: customContext--[options]
-                String combined = pBle->getPriceRequestPayload();
-                
-                
-                
-                int firstSep = combined.indexOf("--");
-                String customContext;
-                String optionsPart;
-
-                if (firstSep >= 0)
-                {
-                    customContext = combined.substring(0, firstSep);
-                    optionsPart = combined.substring(firstSep + 2);
-                }
-                else
-                {
-                    // No separator, treat as empty
-                    customContext = "";
-                    optionsPart = "";
-                }
-
-                // Normalize customContext: if it's wrapped as "" (empty quoted), make empty
-                if (customContext == "\"\"")
-                    customContext = "";
-
-                
-
-                // Parse options array like [opt1,opt2]
-                std::vector<String> selectedOptions;
-                if (optionsPart.length() > 1 && optionsPart[0] == '[' && optionsPart[optionsPart.length() - 1] == ']')
-                {
-                    String inner = optionsPart.substring(1, optionsPart.length() - 1);
-                    int start = 0;
-                    while (start < (int)inner.length())
-                    {
-                        int comma = inner.indexOf(',', start);
-                        String item = comma >= 0 ? inner.substring(start, comma) : inner.substring(start);
-                        item.trim();
-                        if (item.length() > 0)
-                            selectedOptions.push_back(item);
-                        if (comma < 0)
-                            break;
-                        start = comma + 1;
-                    }
-                }
-
-                
-
-                // Call dynamic price callback if set
-                String dynamicPrice = pBle->getPrice(); // Default to static price
-                
-                
-                if (pBle->getDynamicPriceCallback() != nullptr)
-                {
-                    
-                    dynamicPrice = pBle->getDynamicPriceCallback()(selectedOptions, customContext);
-                    
-                }
-                else
-                {
-                    
-                }
-
-                // Build response with dynamic price
-                heap_reply = new String();
-                heap_reply->reserve(256);
-                *heap_reply = "402://{\"price\": \"";
-                *heap_reply += dynamicPrice;
-                *heap_reply += "\", \"payTo\": \"";
-                *heap_reply += pBle->getPayTo();
-                *heap_reply += "\", \"network\": \"";
-                *heap_reply += pBle->getNetwork();
-                *heap_reply += "\"}";
+                heap_reply = completePriceRequest(session);
                 reply_ptr = heap_reply->c_str();
-
-                // Clear price request payload after processing
-                pBle->clearPriceRequestPayload();
             }
             else
             {
@@ -291,26 +204,18 @@ Serial.println();
         }
         else
         {
-            strcpy(reply_buffer, "ERROR:NO_CONTEXT");
+            // No instance, or every session slot is taken by other centrals
+            strcpy(reply_buffer, pBle ? "ERROR:NO_SESSION" : "ERROR:NO_CONTEXT");
             reply_ptr = reply_buffer;
         }
     }
     else
     {
-        // Send price, payTo, and network from X402Ble instance
+        // Send price, payTo, and network from X402Ble instance (pre-rendered;
+        // copied if it has to be fragmented, like [OPTIONS])
         if (pBle)
         {
-            // Build JSON efficiently with pre-allocation
-            heap_reply = new String();
-            heap_reply->reserve(256);
-            *heap_reply = "402://{\"price\": \"";
-            *heap_reply += pBle->getPrice();
-            *heap_reply += "\", \"payTo\": \"";
-            *heap_reply += pBle->getPayTo();
-            *heap_reply += "\", \"network\": \"";
-            *heap_reply += pBle->getNetwork();
-            *heap_reply += "\"}";
-            reply_ptr = heap_reply->c_str();
+            reply_ptr = pBle->getPriceReply().c_str();
         }
         else
         {
@@ -320,11 +225,17 @@ Serial.println();
     }
 
     // Send response back to client via TX characteristic (notify)
-    if (pTxChar && reply_ptr && strlen(reply_ptr) > 0)
+    if (stream_field)
+    {
+        streamField(connHandle, stream_prefix, *stream_field, frameSeq);
+    }
+    else if (binary_len > 0)
+    {
+        sendReply(connHandle, binary_reply, binary_len, frameSeq);
+    }
+    else if (reply_ptr)
     {
-        size_t len = strlen(reply_ptr);
-        pTxChar->setValue((uint8_t *)reply_ptr, len);
-        pTxChar->notify();
+        sendReply(connHandle, (const uint8_t *)reply_ptr, strlen(reply_ptr), frameSeq);
     }
 
     // Proper garbage collection - clean up heap allocations
@@ -333,4 +244,312 @@ Serial.println();
         delete heap_reply;
         heap_reply = nullptr;
     }
+    if (binary_reply)
+    {
+        delete[] binary_reply;
+        binary_reply = nullptr;
+    }
+}
+
+// Hand a fully assembled payment (session->paymentBuffer) to the verify worker
+const char *RxCallbacks::completePayment(X402BleSession *session, uint16_t connHandle, int frameSeq,
+                                         char *reply_buffer, size_t reply_size)
+{
+    PaymentTraceRecord trace;
+    trace.startUs = session->traceStartUs; // 0 unless tracing
+    session->traceStartUs = 0;
+    trace.mark(TRACE_LAST_CHUNK);
+
+    // The assembled payload is: JSON -- customContext -- [options]
+    // Split in place; only the parts handed to the worker are copied
+    const char *combined = session->paymentBuffer.c_str();
+    const char *combinedEnd = combined + session->paymentBuffer.length();
+    const char *firstSep = strstr(combined, "--");
+    const char *secondSep = firstSep ? strstr(firstSep + 2, "--") : nullptr;
+    String jsonPart;
+    String customContext;
+    std::vector<String> selectedOptions;
+    if (firstSep && secondSep)
+    {
+        jsonPart.concat(combined, firstSep - combined);
+        customContext = parseCustomContext(firstSep + 2, secondSep);
+        parseOptionList(secondSep + 2, combinedEnd, selectedOptions);
+    }
+    else
+    {
+        // Fallback: treat whole as JSON if separators missing
+        jsonPart.concat(combined, combinedEnd - combined);
+    }
+    session->paymentBuffer.clear();
+
+    session->customContext = customContext;
+    session->selectedOptions = selectedOptions;
+
+    // Same authorization seen before (lost reply, retry or replay): answer
+    // with the recorded outcome instead of calling the facilitator again.
+    // Only if payee, value and signature match what was recorded; otherwise
+    // this is not that payment, and its nonce is already taken.
+    uint64_t nonceKey = 0;
+    uint64_t terms = 0;
+    uint32_t validBefore = 0;
+    if (pBle && NonceCache::keyForPayment(jsonPart, nonceKey, validBefore, &terms))
+    {
+        String txHash;
+        switch (pBle->getNonceCache().claim(nonceKey, validBefore, &txHash, terms))
+        {
+        case NonceCache::SETTLED:
+            if (txHash.length() > 0)
+                snprintf(reply_buffer, reply_size, "PAYMENT:COMPLETE VERIFIED:true TX:%s", txHash.c_str());
+            else
+                snprintf(reply_buffer, reply_size, "PAYMENT:COMPLETE VERIFIED:true");
+            return reply_buffer;
+        case NonceCache::VERIFIED:
+            snprintf(reply_buffer, reply_size, "PAYMENT:VERIFIED");
+            return reply_buffer;
+        case NonceCache::IN_FLIGHT:
+            snprintf(reply_buffer, reply_size, "PAYMENT:BUSY RETRY_MS:%lu",
+                     (unsigned long)PaymentVerifyWorker::getRetryAfterMs());
+            return reply_buffer;
+        case NonceCache::MISMATCH:
+            snprintf(reply_buffer, reply_size, "PAYMENT:COMPLETE VERIFIED:false REASON:nonce_already_used");
+            return reply_buffer;
+        case NonceCache::NONE:
+            break;
+        }
+    }
+
+    // Pass to worker - will only be set on X402Ble if payment succeeds
+    // Payment requirements will be built dynamically in the worker with dynamic price
+    VerifyJob job;
+    job.payload = jsonPart;                       // only payment JSON
+    job.requirements = "";                        // Will be built dynamically in worker
+    job.txChar = pTxChar;                         // TX characteristic for response
+    job.connHandle = connHandle;                  // reply only to the paying central
+    job.customContext = customContext;            // parsed custom context
+    job.selectedOptions = selectedOptions;        // parsed selected options
+    job.trace = trace;
+    job.trace.mark(TRACE_ENQUEUE);
+    job.frameSeq = frameSeq;                      // binary request: frame the replies
+    job.nonceKey = nonceKey;                      // outcome is recorded against it
+
+    if (PaymentVerifyWorker::enqueue(std::move(job)))
+    {
+        // Immediate lightweight ACK (keeps phone happy & host stack safe)
+        snprintf(reply_buffer, reply_size, "PAYMENT:VERIFYING");
+    }
+    else
+    {
+        // Every worker busy and the queue is full - tell the client when to retry
+        if (nonceKey)
+            pBle->getNonceCache().release(nonceKey);
+        snprintf(reply_buffer, reply_size, "PAYMENT:BUSY RETRY_MS:%lu",
+                 (unsigned long)PaymentVerifyWorker::getRetryAfterMs());
+    }
+    return reply_buffer;
+}
+
+// Price a fully assembled [PRICE] request (session->priceBuffer); caller deletes the reply
+String *RxCallbacks::completePriceRequest(X402BleSession *session)
+{
+    // Parse the combined payload in place: customContext--[options]
+    const char *combined = session->priceBuffer.c_str();
+    const char *combinedEnd = combined + session->priceBuffer.length();
+    const char *firstSep = strstr(combined, "--");
+    String customContext;
+    std::vector<String> selectedOptions;
+
+    if (firstSep)
+    {
+        customContext = parseCustomContext(combined, firstSep);
+        parseOptionList(firstSep + 2, combinedEnd, selectedOptions);
+    }
+    // No separator: treat as empty
+
+    session->customContext = customContext;
+    session->selectedOptions = selectedOptions;
+
+    // Call dynamic price callback if set
+    String dynamicPrice = pBle->getPrice(); // Default to static price
+    uint32_t quoteId = 0;
+
+    if (pBle->getDynamicPriceCallback() != nullptr)
+    {
+        dynamicPrice = pBle->getDynamicPriceCallback()(selectedOptions, customContext);
+
+        // Keep the quote so the payment for this selection is not priced again
+        quoteId = pBle->getQuoteCache().put(selectedOptions, customContext, dynamicPrice,
+                                            pBle->getRequirementsTemplate().render(dynamicPrice));
+    }
+
+    // Build response with dynamic price
+    String *heap_reply = new String();
+    heap_reply->reserve(256);
+    *heap_reply = "402://{\"price\": \"";
+    *heap_reply += dynamicPrice;
+    *heap_reply += "\", \"payTo\": \"";
+    *heap_reply += pBle->getPayTo();
+    *heap_reply += "\", \"network\": \"";
+    *heap_reply += pBle->getNetwork();
+    if (quoteId)
+    {
+        char quoteHex[9];
+        snprintf(quoteHex, sizeof(quoteHex), "%08lx", (unsigned long)quoteId);
+        *heap_reply += "\", \"quoteId\": \"";
+        *heap_reply += quoteHex;
+    }
+    *heap_reply += "\"}";
+
+    // Clear price request payload after processing
+    session->priceBuffer.clear();
+    return heap_reply;
+}
+
+// One binary frame: commands are answered at once, payments and price requests
+// once their last frame is in (no per-frame ACK)
+void RxCallbacks::handleFrame(const uint8_t *data, size_t length, uint16_t connHandle)
+{
+    BinaryFrame frame;
+    if (!parseBinaryFrame(data, length, frame))
+    {
+        // The seq byte of a corrupt frame is a best guess, enough for the client to resend
+        sendError(connHandle, length > 2 ? data[2] : 0, "ERROR:BAD_FRAME");
+        return;
+    }
+
+    switch (frame.opcode)
+    {
+    case FRAME_OP_HELLO:
+    {
+        uint8_t version = X402BLE_FRAME_VERSION;
+        notifyBinaryFrame(pTxChar, connHandle, FRAME_OP_HELLO, frame.seq, &version, 1);
+        break;
+    }
+
+    case FRAME_OP_COMMAND:
+    {
+        // Short single-frame text commands go through the text dispatcher
+        char command[32];
+        if (!frame.first || frame.payloadLength != frame.totalLength || frame.payloadLength == 0 ||
+            frame.payloadLength >= sizeof(command) || frame.payload[0] != '[')
+        {
+            sendError(connHandle, frame.seq, "ERROR:BAD_COMMAND");
+            break;
+        }
+        memcpy(command, frame.payload, frame.payloadLength);
+        command[frame.payloadLength] = '\0';
+        handleRequest(command, frame.payloadLength, connHandle, frame.seq);
+        break;
+    }
+
+    case FRAME_OP_PRICE:
+    case FRAME_OP_PAYMENT:
+    {
+        X402BleSession *session = pBle ? pBle->getSession(connHandle) : nullptr;
+        if (!session)
+        {
+            // No instance, or every session slot is taken by other centrals
+            sendError(connHandle, frame.seq, pBle ? "ERROR:NO_SESSION" : "ERROR:NO_CONTEXT");
+            break;
+        }
+
+        bool isPayment = frame.opcode == FRAME_OP_PAYMENT;
+        ReassemblyBuffer &buffer = isPayment ? session->paymentBuffer : session->priceBuffer;
+        FrameReassembly &state = isPayment ? session->paymentFrames : session->priceFrames;
+        if (isPayment && frame.first)
+        {
+            session->traceStartUs = PaymentTracer::now();
+        }
+
+        FrameAssembly result = assembleBinaryFrame(frame, state, buffer);
+        if (result == FRAME_REJECTED)
+        {
+            bool overflowed = buffer.overflowed();
+            buffer.clear();
+            sendError(connHandle, frame.seq, overflowed ? "ERROR:PAYLOAD_TOO_LARGE" : "ERROR:BAD_SEQUENCE");
+        }
+        else if (result == FRAME_COMPLETE && isPayment)
+        {
+            char reply_buffer[256]; // same as the text path: a replayed TX:<hash> reply is ~100 bytes
+            const char *reply = completePayment(session, connHandle, frame.seq, reply_buffer, sizeof(reply_buffer));
+            sendReply(connHandle, (const uint8_t *)reply, strlen(reply), frame.seq);
+        }
+        else if (result == FRAME_COMPLETE)
+        {
+            String *reply = completePriceRequest(session);
+            sendReply(connHandle, (const uint8_t *)reply->c_str(), reply->length(), frame.seq);
+            delete reply;
+        }
+        // FRAME_PARTIAL: stay quiet, the client streams the next frame
+        break;
+    }
+
+    default:
+        sendError(connHandle, frame.seq, "ERROR:UNKNOWN_OPCODE");
+        break;
+    }
+}
+
+// Reply on TX to the asking central only; framed when the request was
+void RxCallbacks::sendReply(uint16_t connHandle, const uint8_t *data, size_t length, int frameSeq)
+{
+    if (!pTxChar || length == 0)
+        return;
+
+    size_t notifySize = frameSeq >= 0 ? getBinaryFrameSize(length) : length;
+    if (pBle && (notifySize > pBle->getMaxNotifySize(connHandle) || pBle->getNotifyStreamer().isBusy(connHandle)))
+    {
+        // Too big for one notification, or queued behind a reply that was: fragment, in order
+        BufferSource *copy = new (std::nothrow) BufferSource(data, length);
+        if (copy && copy->ok())
+        {
+            streamReply(connHandle, copy, frameSeq);
+            return;
+        }
+        delete copy; // out of memory - send what fits
+    }
+
+    if (frameSeq >= 0)
+        notifyBinaryFrame(pTxChar, connHandle, FRAME_OP_REPLY, (uint8_t)frameSeq, data, length);
+    else
+        pTxChar->notify(data, length, connHandle);
+}
+
+// Hand a reply to the streamer (which owns it from here)
+void RxCallbacks::streamReply(uint16_t connHandle, NotifySource *source, int frameSeq)
+{
+    if (!source)
+    {
+        sendReply(connHandle, (const uint8_t *)"ERROR:OUT_OF_MEMORY", 19, frameSeq);
+        return;
+    }
+    if (!pBle || !pBle->getNotifyStreamer().send(connHandle, pBle->getMaxNotifySize(connHandle), frameSeq, source))
+    {
+        if (!pBle)
+            delete source;
+        sendBusy(connHandle, frameSeq);
+    }
+}
+
+// Every stream slot taken; the client asks again
+void RxCallbacks::sendBusy(uint16_t connHandle, int frameSeq)
+{
+    const char *busy = "ERROR:BUSY";
+    if (frameSeq >= 0)
+        notifyBinaryFrame(pTxChar, connHandle, FRAME_OP_ERROR, (uint8_t)frameSeq, (const uint8_t *)busy, strlen(busy));
+    else if (pTxChar)
+        pTxChar->notify((const uint8_t *)busy, strlen(busy), connHandle);
+}
+
+// Reply straight from a stored field; allocates nothing
+void RxCallbacks::streamField(uint16_t connHandle, const char *prefix, const String &field, int frameSeq)
+{
+    if (!pBle->getNotifyStreamer().send(connHandle, pBle->getMaxNotifySize(connHandle), frameSeq, prefix, field))
+    {
+        sendBusy(connHandle, frameSeq);
+    }
+}
+
+void RxCallbacks::sendError(uint16_t connHandle, uint8_t seq, const char *error)
+{
+    notifyBinaryFrame(pTxChar, connHandle, FRAME_OP_ERROR, seq, (const uint8_t *)error, strlen(error));
 }
@@ -6,16 +6,35 @@
 
 
 class X402Ble; // Forward declaration
+struct X402BleSession;
+class NotifySource;
 
 class RxCallbacks : public NimBLECharacteristicCallbacks {
 public:
     RxCallbacks(NimBLECharacteristic* txChar, X402Ble* ble) : pTxChar(txChar), pBle(ble) {}
 
-    void onWrite(NimBLECharacteristic *ch);
-    // Compatibility overload (some NimBLE versions provide connection info)
-    void onWrite(NimBLECharacteristic* ch, NimBLEConnInfo& /*info*/) { onWrite(ch); }
+    // NimBLE-Arduino 2.x (1.x is not supported, see NotifyStreamer.h)
+    void onWrite(NimBLECharacteristic* ch, NimBLEConnInfo& info) { handleWrite(ch, info.getConnHandle()); }
 
 private:
+    // Handles a write from the central identified by connHandle
+    void handleWrite(NimBLECharacteristic *ch, uint16_t connHandle);
+
+    // Text command or chunk; frameSeq >= 0 when it came in a binary frame
+    void handleRequest(const char *req_cstr, size_t req_len, uint16_t connHandle, int frameSeq);
+    void handleFrame(const uint8_t *data, size_t length, uint16_t connHandle);
+
+    // Assembled payloads, shared by the text and binary protocols
+    const char *completePayment(X402BleSession *session, uint16_t connHandle, int frameSeq,
+                                char *reply_buffer, size_t reply_size);
+    String *completePriceRequest(X402BleSession *session);
+
+    void sendReply(uint16_t connHandle, const uint8_t *data, size_t length, int frameSeq);
+    void streamReply(uint16_t connHandle, NotifySource *source, int frameSeq);
+    void streamField(uint16_t connHandle, const char *prefix, const String &field, int frameSeq);
+    void sendBusy(uint16_t connHandle, int frameSeq);
+    void sendError(uint16_t connHandle, uint8_t seq, const char *error);
+
     NimBLECharacteristic* pTxChar;  // TX characteristic for sending responses
     X402Ble* pBle;                   // Pointer to X402Ble instance
 };
@@ -1,4 +1,5 @@
 #include "ServerCallbacks.h"
+#include "X402Ble.h"
 
 // Global pointer to advertising (defined in X402Ble.cpp)
 NimBLEAdvertising *pAdvertising = nullptr;
@@ -21,23 +22,39 @@ void ServerCallbacks::onDisconnect(NimBLEServer * /*srv*/)
     }
 }
 
-// Compatibility overloads (some NimBLE versions use these)
-void ServerCallbacks::onConnect(NimBLEServer *s, NimBLEConnInfo &i)
+void ServerCallbacks::requestFastLink(NimBLEServer *s, uint16_t connHandle)
 {
-    onConnect(s);
+#if X402BLE_PREFER_FAST_LINK
+    if (!s || connHandle == BLE_HS_CONN_HANDLE_NONE)
+        return;
+
+    // 251 octets per packet instead of 27: a full-MTU write goes out in 2 packets, not 20
+    s->setDataLen(connHandle, 251);
+
+#if defined(SOC_BLE_50_SUPPORTED) && SOC_BLE_50_SUPPORTED
+    // Twice the symbol rate; the central falls back to 1M if it can't
+    s->updatePhy(connHandle, BLE_GAP_LE_PHY_2M_MASK, BLE_GAP_LE_PHY_2M_MASK, 0);
+#endif
+#endif
 }
 
-void ServerCallbacks::onDisconnect(NimBLEServer *s, NimBLEConnInfo &i)
+void ServerCallbacks::releaseSession(uint16_t connHandle)
 {
-    onDisconnect(s);
+    if (pBle)
+    {
+        pBle->releaseSession(connHandle);
+    }
 }
 
-void ServerCallbacks::onConnect(NimBLEServer *s, ble_gap_conn_desc *d)
+// NimBLE-Arduino 2.x callbacks
+void ServerCallbacks::onConnect(NimBLEServer *s, NimBLEConnInfo &i)
 {
+    requestFastLink(s, i.getConnHandle());
     onConnect(s);
 }
 
-void ServerCallbacks::onDisconnect(NimBLEServer *s, ble_gap_conn_desc *d)
+void ServerCallbacks::onDisconnect(NimBLEServer *s, NimBLEConnInfo &i, int /*reason*/)
 {
+    releaseSession(i.getConnHandle());
     onDisconnect(s);
 }
@@ -4,20 +4,31 @@
 #include <Arduino.h>
 #include <NimBLEDevice.h>
 
+class X402Ble; // Forward declaration
+
 // Forward declaration for pAdvertising
 extern NimBLEAdvertising* pAdvertising;
 
 class ServerCallbacks : public NimBLEServerCallbacks
 {
 public:
+    explicit ServerCallbacks(X402Ble* ble = nullptr) : pBle(ble) {}
+
     void onConnect(NimBLEServer* /*srv*/);
     void onDisconnect(NimBLEServer* /*srv*/);
 
-    // Compatibility overloads (some NimBLE versions use these)
+    // NimBLE-Arduino 2.x callbacks (1.x is not supported, see NotifyStreamer.h)
     void onConnect(NimBLEServer* s, NimBLEConnInfo& i);
-    void onDisconnect(NimBLEServer* s, NimBLEConnInfo& i);
-    void onConnect(NimBLEServer* s, ble_gap_conn_desc* d);
-    void onDisconnect(NimBLEServer* s, ble_gap_conn_desc* d);
+    void onDisconnect(NimBLEServer* s, NimBLEConnInfo& i, int reason);
+
+private:
+    // Asks for longer link-layer packets and the 2M PHY (X402BLE_PREFER_FAST_LINK)
+    void requestFastLink(NimBLEServer* s, uint16_t connHandle);
+
+    // Frees the per-connection session of a disconnected central
+    void releaseSession(uint16_t connHandle);
+
+    X402Ble* pBle; // Pointer to X402Ble instance owning the sessions
 };
 
 #endif // SERVERCALLBACKS_H
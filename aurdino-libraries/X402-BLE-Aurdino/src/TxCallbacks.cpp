@@ -0,0 +1,11 @@
+#include "TxCallbacks.h"
+#include "X402Ble.h"
+
+void TxCallbacks::onStatus(NimBLECharacteristic * /*ch*/, int /*code*/)
+{
+    // Success or not, the notification's buffer is free again
+    if (pBle)
+    {
+        pBle->getNotifyStreamer().onNotifyComplete();
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef TX_CALLBACKS_H
+#define TX_CALLBACKS_H
+
+#include <Arduino.h>
+#include <NimBLEDevice.h>
+
+class X402Ble; // Forward declaration
+
+// Notification completions on TX pace the fragmented replies
+class TxCallbacks : public NimBLECharacteristicCallbacks {
+public:
+    explicit TxCallbacks(X402Ble* ble) : pBle(ble) {}
+
+    // Called once per notification that left the stack (code 0) or failed.
+    // NimBLE-Arduino 2.x signature; 1.x is rejected at compile time.
+    void onStatus(NimBLECharacteristic* ch, int code);
+
+private:
+    X402Ble* pBle; // Pointer to X402Ble instance owning the streamer
+};
+
+#endif // TX_CALLBACKS_H
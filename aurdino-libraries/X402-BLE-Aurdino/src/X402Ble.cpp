@@ -1,8 +1,12 @@
 #include "X402Ble.h"
 #include "ServerCallbacks.h"
 #include "RxCallbacks.h"
+#include "TxCallbacks.h"
 #include "PaymentVerifyWorker.h"
+#include "metrics.h"
+#include <LittleFS.h>
 #include <algorithm>
+#include <esp_timer.h>
 #include <cctype>
 
 const char *X402Ble::SERVICE_UUID = "6e400002-b5a3-f393-e0a9-e50e24dcca9e";
@@ -20,13 +24,16 @@ X402Ble::X402Ble(const String &device_name,
     : device_name_(device_name), network_(network), price_(price), payTo_(payTo),
       logo_(logo), description_(description), banner_(banner),
       frequency_(0), allowCustomContent_(false),
-      pServer(nullptr), pService(nullptr), pTxCharacteristic(nullptr), pRxCharacteristic(nullptr)
+      verifyWorkerCount_(1), verifyQueueDepth_(4), repliesStale_(true),
+      precheck_(true), optimisticSettlement_(false), settleQueueDepth_(8),
+      settleBatchSize_(1), settleBatchWindowMs_(0), settlementFailedCallback_(nullptr),
+      pServer(nullptr), pService(nullptr), pTxCharacteristic(nullptr), pRxCharacteristic(nullptr),
+      stateLock_(xSemaphoreCreateMutex()),
+      paymentEvents_(xQueueCreate(X402BLE_PAYMENT_EVENT_DEPTH, sizeof(PaymentRecord *)))
 {
     // Reserve space for vectors to avoid reallocation
     options_.reserve(8); // Reserve space for typical number of options
 
-    // Initialize payment payload with reasonable capacity
-    paymentPayload_ = "";
     // Initialize last payment state
     lastPaid_ = false;
     lastTransactionhash_ = "";
@@ -36,26 +43,27 @@ X402Ble::X402Ble(const String &device_name,
     userSelectedOptions_.reserve(8);
     userCustomContext_ = "";
 
-    // Initialize price request payload and callback
-    priceRequestPayload_ = "";
+    // Initialize callbacks
     dynamicPriceCallback_ = nullptr;
     onPayCallback_ = nullptr;
 
-    // Build payment requirements once during construction
-    paymentRequirements = buildDefaultPaymentRementsJson(
+    // Build the payment requirements template once during construction;
+    // per-payment requirements only substitute the (dynamic) price
+    requirementsTemplate_.build(
         network_,    // network
         payTo_,      // payTo address
-        price_,      // amount (1 USDC)
         logo_,       // logo
         description_ // description
         // banner is not used in paymentRequirements, but available as member
     );
+    paymentRequirements = requirementsTemplate_.render(price_);
 }
 
 // Set recurring frequency (0 clears/means unset)
 void X402Ble::enableRecuring(uint32_t frequency)
 {
     frequency_ = frequency;
+    repliesStale_ = true;
 }
 
 // Memory-optimized options management
@@ -70,29 +78,145 @@ void X402Ble::enableOptions(const String options[], size_t count)
             options_.push_back(options[i]);
         }
     }
+    repliesStale_ = true;
+}
+
+// Size the verification pool started by begin()
+void X402Ble::setVerifyWorkers(uint8_t workerCount, uint8_t queueDepth)
+{
+    verifyWorkerCount_ = workerCount > 0 ? workerCount : 1;
+    verifyQueueDepth_ = queueDepth > 0 ? queueDepth : 1;
+}
+
+// Respond on verify and settle in a separate pipeline stage
+void X402Ble::enableOptimisticSettlement(bool enable, uint8_t settleQueueDepth)
+{
+    optimisticSettlement_ = enable;
+    settleQueueDepth_ = settleQueueDepth > 0 ? settleQueueDepth : 1;
+}
+
+// Collect optimistic settlements and send them back to back
+void X402Ble::enableSettlementBatching(uint8_t maxBatch, uint32_t windowMs)
+{
+    settleBatchSize_ = std::min<uint8_t>(maxBatch > 0 ? maxBatch : 1, X402BLE_SETTLE_MAX_BATCH);
+    settleBatchWindowMs_ = windowMs;
+}
+
+// Log pre-checked payments to flash while offline and settle them later
+bool X402Ble::enableOfflineQueue(uint16_t maxCount, uint64_t maxValue, fs::FS *fs)
+{
+    if (!fs)
+    {
+        if (!LittleFS.begin(true))
+            return false;
+        fs = &LittleFS;
+    }
+
+    offline_.setLimits(maxCount, maxValue);
+    return offline_.begin(*fs) && offline_.startDrain();
+}
+
+// Record per-stage payment timestamps into a ring of recent payments
+bool X402Ble::enableTracing(bool enable, uint8_t depth)
+{
+    return PaymentTracer::enable(enable, depth);
+}
+
+bool X402Ble::getStageLatency(PaymentTraceStage stage, PaymentStageLatency &out) const
+{
+    return PaymentTracer::getLatency(stage, out);
 }
 
 // Allow custom content
 void X402Ble::allowCustomised()
 {
     allowCustomContent_ = true;
+    repliesStale_ = true;
+}
+
+// Render the metadata replies once; the BLE host task then only copies them out
+void X402Ble::renderReplies()
+{
+    repliesStale_ = false;
+
+    priceReply_ = "402://{\"price\": \"";
+    priceReply_ += price_;
+    priceReply_ += "\", \"payTo\": \"";
+    priceReply_ += payTo_;
+    priceReply_ += "\", \"network\": \"";
+    priceReply_ += network_;
+    priceReply_ += "\"}";
+
+    optionsReply_ = "OPTIONS://";
+    for (size_t i = 0; i < options_.size(); ++i)
+    {
+        optionsReply_ += options_[i];
+        if (i + 1 < options_.size())
+            optionsReply_ += ",";
+    }
+
+    configHead_ = "CONFIG://{\"frequency\": ";
+    configHead_ += String(frequency_);
+    configHead_ += ", \"allowCustomContent\": ";
+    configHead_ += (allowCustomContent_ ? "true" : "false");
+    configHead_ += ", \"mtu\": ";
+
+    configTail_ = ", \"binary\": ";
+    configTail_ += String(X402BLE_FRAME_VERSION);
+    configTail_ += "}";
+}
+
+const String &X402Ble::getPriceReply()
+{
+    if (repliesStale_)
+        renderReplies();
+    return priceReply_;
+}
+
+const String &X402Ble::getOptionsReply()
+{
+    if (repliesStale_)
+        renderReplies();
+    return optionsReply_;
+}
+
+size_t X402Ble::renderConfigReply(uint16_t mtu, char *out, size_t capacity)
+{
+    if (repliesStale_)
+        renderReplies();
+    int written = snprintf(out, capacity, "%s%u%s", configHead_.c_str(), (unsigned)mtu, configTail_.c_str());
+    return written > 0 && (size_t)written < capacity ? (size_t)written : 0;
 }
 
 void X402Ble::begin()
 {
     // Set active instance for worker callbacks
     s_active = this;
+    renderReplies();
     NimBLEDevice::init(device_name_.c_str());
     NimBLEDevice::setDeviceName(device_name_.c_str());
     NimBLEDevice::setPower(ESP_PWR_LVL_P7);
     NimBLEDevice::setSecurityAuth(false, false, false);
-    NimBLEDevice::setMTU(150);
+    NimBLEDevice::setMTU(X402BLE_PREFERRED_MTU);
 
-    // Start payment verification worker with large stack on core 1
-    PaymentVerifyWorker::begin(/*stackBytes=*/8192, /*prio=*/3, /*core=*/1);
+    // Start payment verification workers with large stacks on core 1
+    PaymentVerifyWorker::begin(/*stackBytes=*/8192, /*prio=*/3, /*core=*/1,
+                               verifyWorkerCount_, verifyQueueDepth_);
+    if (optimisticSettlement_)
+    {
+        // A whole batch has to fit in the queue, or payments overflow into
+        // inline settlement while it fills
+        PaymentVerifyWorker::beginSettlement(/*stackBytes=*/8192, /*prio=*/2, /*core=*/1,
+                                             std::max(settleQueueDepth_, settleBatchSize_),
+                                             settleBatchSize_, settleBatchWindowMs_);
+    }
+    if (frequency_ > 0)
+    {
+        entitlements_.begin();
+    }
 
     pServer = NimBLEDevice::createServer();
-    pServer->setCallbacks(new ServerCallbacks());
+    pServer->setCallbacks(new ServerCallbacks(this));
 
     pService = pServer->createService(SERVICE_UUID);
 
@@ -105,6 +229,8 @@ void X402Ble::begin()
         return;
     }
     pTxCharacteristic->setValue((uint8_t *)"", 0);
+    pTxCharacteristic->setCallbacks(new TxCallbacks(this));
+    streamer_.setCharacteristic(pTxCharacteristic);
 
     // RX (write / write without response)
     pRxCharacteristic = pService->createCharacteristic(
@@ -134,30 +260,57 @@ void X402Ble::begin()
 X402Ble::~X402Ble()
 {
     cleanup();
+
+    if (paymentEvents_)
+    {
+        PaymentRecord *record = nullptr;
+        while (xQueueReceive(paymentEvents_, &record, 0) == pdTRUE)
+        {
+            delete record;
+        }
+        vQueueDelete(paymentEvents_);
+        paymentEvents_ = nullptr;
+    }
+    if (stateLock_)
+    {
+        vSemaphoreDelete(stateLock_);
+        stateLock_ = nullptr;
+    }
 }
 
 // Manual cleanup method for proper garbage collection
 void X402Ble::cleanup()
 {
-    // Clear payment payload to free memory
-    paymentPayload_ = "";
+    // Drop all per-connection assembly state
+    for (auto &session : sessions_)
+    {
+        session.reset();
+        session.paymentBuffer.release();
+        session.priceBuffer.release();
+        session.selectedOptions.shrink_to_fit();
+    }
 
     // Clear options vector and free memory
     options_.clear();
     options_.shrink_to_fit();
+    repliesStale_ = true;
 
     // Clear payment requirements
     paymentRequirements = "";
+    requirementsTemplate_.clear();
+    quotes_.clear();
 
     // Clear user-provided selections/context
+    lockState();
     userSelectedOptions_.clear();
     userSelectedOptions_.shrink_to_fit();
     userCustomContext_ = "";
+    unlockState();
 
-    // Clear price request payload and callback
-    priceRequestPayload_ = "";
+    // Clear callbacks
     dynamicPriceCallback_ = nullptr;
     onPayCallback_ = nullptr;
+    settlementFailedCallback_ = nullptr;
 
     // Stop BLE advertising if active
     if (pAdvertising)
@@ -174,6 +327,8 @@ void X402Ble::cleanup()
 
     if (pTxCharacteristic)
     {
+        streamer_.clear();
+        streamer_.setCharacteristic(nullptr);
         pTxCharacteristic = nullptr;
     }
 
@@ -191,17 +346,120 @@ void X402Ble::cleanup()
 // Memory monitoring function
 void X402Ble::printMemoryUsage() const
 {
-
     size_t total_options_size = 0;
     for (const auto &option : options_)
     {
         total_options_size += option.length();
     }
+
+    size_t session_buffers_size = 0;
+    for (const auto &session : sessions_)
+    {
+        session_buffers_size += session.paymentBuffer.capacity() + session.priceBuffer.capacity();
+    }
+
+    Serial.print("Options: ");
+    Serial.print(total_options_size);
+    Serial.print(" bytes, session buffers: ");
+    Serial.print(session_buffers_size);
+    Serial.print(" bytes, requirements: ");
+    Serial.print(paymentRequirements.length());
+    Serial.println(" bytes");
+    MetricsRegistry::instance().print();
+}
+
+void X402BleSession::reset()
+{
+    connHandle = BLE_HS_CONN_HANDLE_NONE;
+    inUse = false;
+    // Keep buffer storage so the next central reuses it without allocating
+    paymentBuffer.clear();
+    priceBuffer.clear();
+    selectedOptions.clear();
+    customContext = "";
+    traceStartUs = 0;
+    paymentFrames.reset();
+    priceFrames.reset();
+}
+
+uint16_t X402Ble::getPeerMTU(uint16_t connHandle) const
+{
+    uint16_t mtu = (pServer && connHandle != BLE_HS_CONN_HANDLE_NONE) ? pServer->getPeerMTU(connHandle) : 0;
+    return mtu ? mtu : 23; // ATT default before the exchange
+}
+
+// Find the session for a connection, optionally claiming a free slot
+X402BleSession *X402Ble::getSession(uint16_t connHandle, bool create)
+{
+    X402BleSession *freeSlot = nullptr;
+    for (auto &session : sessions_)
+    {
+        if (session.inUse && session.connHandle == connHandle)
+        {
+            return &session;
+        }
+        if (!session.inUse && !freeSlot)
+        {
+            freeSlot = &session;
+        }
+    }
+
+    if (!create || !freeSlot)
+    {
+        return nullptr;
+    }
+
+    // Allocated on first claim only, then reused by every later connection
+    if (!freeSlot->paymentBuffer.allocate(X402BLE_PAYMENT_BUFFER_SIZE) ||
+        !freeSlot->priceBuffer.allocate(X402BLE_PRICE_BUFFER_SIZE))
+    {
+        return nullptr;
+    }
+
+    freeSlot->reset();
+    freeSlot->connHandle = connHandle;
+    freeSlot->inUse = true;
+    return freeSlot;
+}
+
+// Free the session of a disconnected central
+void X402Ble::releaseSession(uint16_t connHandle)
+{
+    streamer_.cancel(connHandle);
+    for (auto &session : sessions_)
+    {
+        if (session.inUse && session.connHandle == connHandle)
+        {
+            session.reset();
+        }
+    }
+}
+
+size_t X402Ble::getActiveSessionCount() const
+{
+    size_t count = 0;
+    for (const auto &session : sessions_)
+    {
+        if (session.inUse)
+            count++;
+    }
+    return count;
+}
+
+size_t X402Ble::getPaymentPayloadSize() const
+{
+    size_t total = 0;
+    for (const auto &session : sessions_)
+    {
+        total += session.paymentBuffer.length() + session.priceBuffer.length();
+    }
+    return total;
 }
 
 // Set user selected options from C-style array
 void X402Ble::setUserSelectedOptions(const String options[], size_t count)
 {
+    lockState();
     userSelectedOptions_.clear();
     if (count > 0)
     {
@@ -211,24 +469,44 @@ void X402Ble::setUserSelectedOptions(const String options[], size_t count)
             userSelectedOptions_.push_back(options[i]);
         }
     }
+    unlockState();
 }
 
 void X402Ble::clearUserSelectedOptions()
 {
+    lockState();
     userSelectedOptions_.clear();
+    unlockState();
 }
 
 void X402Ble::setUserSelectedOptions(const std::vector<String> &options)
 {
-    userSelectedOptions_.clear();
-    if (!options.empty())
-    {
-        userSelectedOptions_.reserve(options.size());
-        for (const auto &opt : options)
-        {
-            userSelectedOptions_.push_back(opt);
-        }
-    }
+    lockState();
+    userSelectedOptions_ = options;
+    unlockState();
+}
+
+std::vector<String> X402Ble::getUserSelectedOptions() const
+{
+    lockState();
+    std::vector<String> options = userSelectedOptions_;
+    unlockState();
+    return options;
+}
+
+String X402Ble::getUserCustomContext() const
+{
+    lockState();
+    String ctx = userCustomContext_;
+    unlockState();
+    return ctx;
+}
+
+void X402Ble::setUserCustomContext(const String &ctx)
+{
+    lockState();
+    userCustomContext_ = ctx;
+    unlockState();
 }
 
 // Static active instance pointer
@@ -240,17 +518,64 @@ X402Ble *X402Ble::getActiveInstance()
     return s_active;
 }
 
+void X402Ble::lockState() const
+{
+    if (stateLock_)
+        xSemaphoreTake(stateLock_, portMAX_DELAY);
+}
+
+void X402Ble::unlockState() const
+{
+    if (stateLock_)
+        xSemaphoreGive(stateLock_);
+}
+
 // Return lastPaid and reset it to false
 bool X402Ble::getStatusAndReset()
 {
+    lockState();
     bool wasPaid = lastPaid_;
     lastPaid_ = false;
+    unlockState();
     return wasPaid;
 }
 
+bool X402Ble::getLastPaid() const
+{
+    lockState();
+    bool paid = lastPaid_;
+    unlockState();
+    return paid;
+}
+
+String X402Ble::getLastTransactionhash() const
+{
+    lockState();
+    String txHash = lastTransactionhash_;
+    unlockState();
+    return txHash;
+}
+
+String X402Ble::getLastPayer() const
+{
+    lockState();
+    String payer = lastPayer_;
+    unlockState();
+    return payer;
+}
+
+unsigned long X402Ble::getLastPaymentTimestamp() const
+{
+    lockState();
+    unsigned long timestamp = lastPaymentTimestamp_;
+    unlockState();
+    return timestamp;
+}
+
 // Update last payment state
 void X402Ble::setLastPaymentState(bool paid, const String &txHash, const String &payer)
 {
+    lockState();
     lastPaid_ = paid;
     lastTransactionhash_ = txHash;
     lastPayer_ = payer;
@@ -258,18 +583,105 @@ void X402Ble::setLastPaymentState(bool paid, const String &txHash, const String
     {
         lastPaymentTimestamp_ = micros(); // Capture timestamp when payment succeeds
     }
+    unlockState();
+}
+
+// Complete the last payment record once optimistic settlement finishes
+void X402Ble::updateLastSettlement(const String &txHash, const String &payer)
+{
+    lockState();
+    lastTransactionhash_ = txHash;
+    if (payer.length() > 0)
+    {
+        lastPayer_ = payer;
+    }
+    unlockState();
+}
+
+void X402Ble::recordPayment(const String &txHash, const String &payer, const std::vector<String> &options,
+                            const String &customContext, bool settled)
+{
+    lockState();
+    lastPaid_ = true;
+    lastTransactionhash_ = txHash;
+    lastPayer_ = payer;
+    lastPaymentTimestamp_ = micros();
+    userSelectedOptions_ = options;
+    userCustomContext_ = customContext;
+    unlockState();
+
+    // Recurring access: each payment adds one period to what is left
+    if (frequency_ > 0)
+    {
+        uint64_t periodMs = (uint64_t)frequency_ * 1000;
+        if (options.empty())
+        {
+            entitlements_.grant("", periodMs);
+        }
+        for (const auto &option : options)
+        {
+            entitlements_.grant(option, periodMs);
+        }
+    }
+
+    if (!paymentEvents_)
+        return;
+
+    PaymentRecord *record = new (std::nothrow) PaymentRecord(txHash, payer, options, customContext,
+                                                             esp_timer_get_time(), settled);
+    if (!record)
+        return;
+
+    if (xQueueSend(paymentEvents_, &record, 0) != pdTRUE)
+    {
+        // Nobody is draining fast enough - keep the newest payments
+        PaymentRecord *oldest = nullptr;
+        if (xQueueReceive(paymentEvents_, &oldest, 0) == pdTRUE)
+        {
+            delete oldest;
+        }
+        if (xQueueSend(paymentEvents_, &record, 0) != pdTRUE)
+        {
+            delete record;
+        }
+    }
+}
+
+bool X402Ble::waitForPayment(PaymentRecord &record, uint32_t timeoutMs)
+{
+    if (!paymentEvents_)
+        return false;
+
+    TickType_t ticks = timeoutMs == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(timeoutMs);
+    PaymentRecord *event = nullptr;
+    if (xQueueReceive(paymentEvents_, &event, ticks) != pdTRUE || !event)
+        return false;
+
+    record = std::move(*event);
+    delete event;
+
+    // The event is consumed - don't report it again through the polling API
+    lockState();
+    lastPaid_ = false;
+    unlockState();
+    return true;
+}
+
+uint32_t X402Ble::getPendingPaymentCount() const
+{
+    return paymentEvents_ ? uxQueueMessagesWaiting(paymentEvents_) : 0;
 }
 
 // Returns microseconds elapsed since last successful payment
 unsigned long X402Ble::getMicrosSinceLastPayment() const
 {
-    if (lastPaymentTimestamp_ == 0)
+    unsigned long timestamp = getLastPaymentTimestamp();
+    if (timestamp == 0)
     {
         return 0; // No payment has occurred yet
     }
     
     unsigned long current = micros();
-    unsigned long timestamp = lastPaymentTimestamp_;
     
     // Handle micros() overflow (happens every ~70 minutes)
     if (current >= timestamp) {
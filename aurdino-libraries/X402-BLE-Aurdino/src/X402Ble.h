@@ -4,12 +4,98 @@
 #include <Arduino.h>
 #include <NimBLEDevice.h>
 #include <vector>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
 
 #include "X402Aurdino.h"
+#include "facilitatorregistry.h"
+#include "X402BleUtils.h"
+#include "PaymentTrace.h"
+#include "EntitlementScheduler.h"
+#include "PriceQuoteCache.h"
+#include "NonceCache.h"
+#include "OfflineQueue.h"
+#include "BinaryFrame.h"
+#include "NotifyStreamer.h"
 
 // Forward declaration to avoid circular include
 class PaymentVerifyWorker;
 
+// Maximum number of concurrently connected centrals with their own payment state
+#ifndef X402BLE_MAX_SESSIONS
+#ifdef CONFIG_BT_NIMBLE_MAX_CONNECTIONS
+#define X402BLE_MAX_SESSIONS CONFIG_BT_NIMBLE_MAX_CONNECTIONS
+#else
+#define X402BLE_MAX_SESSIONS 3
+#endif
+#endif
+
+// Reassembly arena sizes per session (allocated once, reused across payments)
+#ifndef X402BLE_PAYMENT_BUFFER_SIZE
+#define X402BLE_PAYMENT_BUFFER_SIZE 2048
+#endif
+#ifndef X402BLE_PRICE_BUFFER_SIZE
+#define X402BLE_PRICE_BUFFER_SIZE 512
+#endif
+
+// ATT MTU offered to centrals; each connection settles on min(this, the central's)
+#ifndef X402BLE_PREFERRED_MTU
+#define X402BLE_PREFERRED_MTU 517
+#endif
+
+// Ask each central for 251-byte link-layer packets (Data Length Extension) and,
+// on BLE 5 controllers, the 2M PHY. Requests the controller can't honour are ignored.
+#ifndef X402BLE_PREFER_FAST_LINK
+#define X402BLE_PREFER_FAST_LINK 1
+#endif
+
+// Successful payments buffered for waitForPayment(); the oldest is dropped when full
+#ifndef X402BLE_PAYMENT_EVENT_DEPTH
+#define X402BLE_PAYMENT_EVENT_DEPTH 4
+#endif
+
+// Largest settlement batch (jobs collected by the settle stage at once)
+#ifndef X402BLE_SETTLE_MAX_BATCH
+#define X402BLE_SETTLE_MAX_BATCH 32
+#endif
+
+// Default time the settle stage waits to fill a batch
+#ifndef X402BLE_SETTLE_BATCH_WINDOW_MS
+#define X402BLE_SETTLE_BATCH_WINDOW_MS 10000
+#endif
+
+// Settlements that never reached the facilitator are queued again, after this
+// pause, up to X402BLE_SETTLE_MAX_ATTEMPTS times before they count as failed
+#ifndef X402BLE_SETTLE_RETRY_MS
+#define X402BLE_SETTLE_RETRY_MS 2000
+#endif
+#ifndef X402BLE_SETTLE_MAX_ATTEMPTS
+#define X402BLE_SETTLE_MAX_ATTEMPTS 3
+#endif
+
+// Default wait before a slow /verify is also sent to the next facilitator
+#ifndef X402BLE_VERIFY_HEDGE_MS
+#define X402BLE_VERIFY_HEDGE_MS 1500
+#endif
+
+// Per-connection state, keyed by NimBLE connection handle.
+// Only touched from the NimBLE host task (onWrite / onDisconnect).
+struct X402BleSession
+{
+    uint16_t connHandle = BLE_HS_CONN_HANDLE_NONE;
+    bool inUse = false;
+    ReassemblyBuffer paymentBuffer;       // X-PAYMENT chunks assembled so far
+    ReassemblyBuffer priceBuffer;         // [PRICE] chunks assembled so far
+    std::vector<String> selectedOptions;  // options sent by this central
+    String customContext;                 // custom context sent by this central
+    int64_t traceStartUs = 0;             // X-PAYMENT:START time when tracing
+    FrameReassembly paymentFrames;        // binary PAYMENT frames in progress
+    FrameReassembly priceFrames;          // binary PRICE frames in progress
+
+    void reset();
+};
+
 // Dynamic price callback typedef
 // Takes user selected options and custom context, returns price as String
 typedef String (*DynamicPriceCallback)(const std::vector<String>& options, const String& customContext);
@@ -19,6 +105,41 @@ typedef String (*DynamicPriceCallback)(const std::vector<String>& options, const
 // Receives selected options and custom context from the user
 typedef void (*OnPayCallback)(const std::vector<String>& options, const String& customContext);
 
+// Settlement failure callback typedef
+// Called in optimistic mode when a payment that already passed verification
+// (and triggered OnPay) fails to settle, so the sketch can revoke the service
+typedef void (*SettlementFailedCallback)(const std::vector<String>& options, const String& customContext, const String& reason);
+
+// Immutable snapshot of one successful payment, delivered by waitForPayment().
+// The sketch owns its copy - later payments never change it.
+class PaymentRecord
+{
+public:
+    PaymentRecord() : timestampUs_(0), settled_(false) {}
+    PaymentRecord(const String &txHash, const String &payer, const std::vector<String> &options,
+                  const String &customContext, int64_t timestampUs, bool settled)
+        : txHash_(txHash), payer_(payer), options_(options), customContext_(customContext),
+          timestampUs_(timestampUs), settled_(settled) {}
+
+    // Empty while an optimistic payment is still settling (see isSettled())
+    const String &getTransactionHash() const { return txHash_; }
+    const String &getPayer() const { return payer_; }
+    const std::vector<String> &getOptions() const { return options_; }
+    const String &getCustomContext() const { return customContext_; }
+    // esp_timer time (microseconds since boot) when the payment was accepted
+    int64_t getTimestampUs() const { return timestampUs_; }
+    // false in optimistic mode: service granted on verify, settlement pending
+    bool isSettled() const { return settled_; }
+
+private:
+    String txHash_;
+    String payer_;
+    std::vector<String> options_;
+    String customContext_;
+    int64_t timestampUs_;
+    bool settled_;
+};
+
 class X402Ble
 {
 public:
@@ -38,23 +159,26 @@ public:
     
     // Memory monitoring functions
     void printMemoryUsage() const;
-    size_t getPaymentPayloadSize() const { return paymentPayload_.length(); }
+    size_t getPaymentPayloadSize() const; // bytes buffered across all sessions
 
     String paymentRequirements;
 
+    // Requirements pre-split around the price; render(price) per payment
+    const PaymentRequirementsTemplate &getRequirementsTemplate() const { return requirementsTemplate_; }
+
     // Public getters for RxCallbacks
     String getPrice() const { return price_; }
     String getPayTo() const { return payTo_; }
     String getNetwork() const { return network_; }
-    String getLogo() const { return logo_; }
-    String getDescription() const { return description_; }
-    String getBanner() const { return banner_; }
+    const String &getLogo() const { return logo_; }
+    const String &getDescription() const { return description_; }
+    const String &getBanner() const { return banner_; }
 
-    // Last payment state getters
-    bool getLastPaid() const { return lastPaid_; }
-    String getLastTransactionhash() const { return lastTransactionhash_; }
-    String getLastPayer() const { return lastPayer_; }
-    unsigned long getLastPaymentTimestamp() const { return lastPaymentTimestamp_; }
+    // Last payment state getters (copies taken under the state lock)
+    bool getLastPaid() const;
+    String getLastTransactionhash() const;
+    String getLastPayer() const;
+    unsigned long getLastPaymentTimestamp() const;
 
     // Returns lastPaid and resets it to false
     bool getStatusAndReset();
@@ -63,42 +187,154 @@ public:
     unsigned long getMicrosSinceLastPayment() const;
 
     // Recurring/options/customization controls
-    void enableRecuring(uint32_t frequency);                    // set frequency (0 means unset)
+    void enableRecuring(uint32_t frequency);                    // seconds of access per payment (0 means unset)
     void enableOptions(const String options[], size_t count);   // Arduino-friendly overload
     void allowCustomised();                                     // allow custom content
 
+    // Payment verification pool (call before begin()).
+    // Each worker keeps its own facilitator TLS connection (~40KB heap).
+    void setVerifyWorkers(uint8_t workerCount, uint8_t queueDepth = 4);
+
     // Optional getters for new fields
     uint32_t getFrequency() const { return frequency_; }
     const std::vector<String> &getOptions() const { return options_; }
     bool isCustomContentAllowed() const { return allowCustomContent_; }
-    String getPaymentPayload() const { return paymentPayload_; }
 
-    // User-provided selection/context
-    const std::vector<String>& getUserSelectedOptions() const { return userSelectedOptions_; }
+    // Replies to metadata commands, rendered when first needed after a
+    // configuration change and then served as-is (NimBLE host task). The
+    // next render replaces them, so copy before keeping one past the call.
+    const String &getPriceReply();   // 402:// with the static price
+    const String &getOptionsReply(); // OPTIONS://a,b,c
+    // CONFIG:// with the central's MTU spliced in; returns bytes written
+    size_t renderConfigReply(uint16_t mtu, char *out, size_t capacity);
+
+    // User-provided selection/context (returned by value: written by the worker task)
+    std::vector<String> getUserSelectedOptions() const;
     void setUserSelectedOptions(const String options[], size_t count);
     void setUserSelectedOptions(const std::vector<String>& options);
     void clearUserSelectedOptions();
-    const String& getUserCustomContext() const { return userCustomContext_; }
-    void setUserCustomContext(const String &ctx) { userCustomContext_ = ctx; }
-    void clearUserCustomContext() { userCustomContext_ = ""; }
+    String getUserCustomContext() const;
+    void setUserCustomContext(const String &ctx);
+    void clearUserCustomContext() { setUserCustomContext(""); }
 
-    // Payment payload assembly (used by RxCallbacks)
-    void setPaymentPayload(const String &payload) { paymentPayload_ = payload; }
-    void clearPaymentPayload() { paymentPayload_ = ""; }
+    // Block the calling task until a payment succeeds or timeoutMs passes
+    // (UINT32_MAX waits forever). Instead of polling getStatusAndReset(), the
+    // task sleeps, so the CPU can idle or light-sleep between payments.
+    // Every successful payment is delivered once, oldest first.
+    bool waitForPayment(PaymentRecord &record, uint32_t timeoutMs = UINT32_MAX);
+    uint32_t getPendingPaymentCount() const;
 
-    // Price request payload assembly (for [PRICE] chunks)
-    void setPriceRequestPayload(const String &payload) { priceRequestPayload_ = payload; }
-    String getPriceRequestPayload() const { return priceRequestPayload_; }
-    void clearPriceRequestPayload() { priceRequestPayload_ = ""; }
+    // Per-connection sessions (used by RxCallbacks / ServerCallbacks)
+    // Returns the session for connHandle, claiming a free slot if create is true.
+    // A claimed slot has its reassembly buffers allocated; chunks are appended
+    // into them in place. Returns nullptr when the table is full, the handle
+    // is unknown or the buffers could not be allocated.
+    X402BleSession *getSession(uint16_t connHandle, bool create = true);
+    void releaseSession(uint16_t connHandle);
+    size_t getActiveSessionCount() const;
 
     // Dynamic price callback
-    void setDynamicPriceCallback(DynamicPriceCallback callback) { dynamicPriceCallback_ = callback; }
+    void setDynamicPriceCallback(DynamicPriceCallback callback) { dynamicPriceCallback_ = callback; quotes_.clear(); }
     DynamicPriceCallback getDynamicPriceCallback() const { return dynamicPriceCallback_; }
 
+    // Prices handed out by [PRICE], reused by the payment that follows so the
+    // dynamic price callback runs once per purchase. Quotes live
+    // X402BLE_QUOTE_TTL_MS; after that the payment prices again.
+    PriceQuoteCache &getQuoteCache() { return quotes_; }
+
+    // Authorizations already processed; a resubmitted one is answered from here
+    NonceCache &getNonceCache() { return nonces_; }
+    // Keep settled authorizations in NVS so replays are caught across reboots
+    bool enableNoncePersistence(const char *nvsNamespace = X402BLE_NONCE_NAMESPACE) { return nonces_.enablePersistence(nvsNamespace); }
+
+    // Store-and-forward while WiFi is down: fully pre-checked payments (clock
+    // set, signer recovered) are granted, answered "VERIFIED:true QUEUED" and
+    // logged to flash, then settled in the background once WiFi returns.
+    // Failed late settlements go to the settlement-failed callback. Only
+    // authorizations with validBefore far enough out are taken, so outages
+    // longer than the clients' signing window cannot be bridged.
+    // fs defaults to LittleFS (mounted, and formatted if needed).
+    bool enableOfflineQueue(uint16_t maxCount = X402BLE_OFFLINE_MAX_COUNT, uint64_t maxValue = X402BLE_OFFLINE_MAX_VALUE,
+                            fs::FS *fs = nullptr);
+    OfflineQueue &getOfflineQueue() { return offline_; }
+
+    // Replies larger than one notification go out as paced fragments
+    NotifyStreamer &getNotifyStreamer() { return streamer_; }
+
     // OnPay callback - called when payment succeeds
     void setOnPay(OnPayCallback callback) { onPayCallback_ = callback; }
     OnPayCallback getOnPayCallback() const { return onPayCallback_; }
 
+    // Optimistic settlement (call before begin()): reply PAYMENT:VERIFIED and
+    // fire OnPay right after /verify, then settle in a separate pipeline stage
+    // that notifies PAYMENT:SETTLED TX:<hash> or PAYMENT:SETTLE_FAILED.
+    void enableOptimisticSettlement(bool enable = true, uint8_t settleQueueDepth = 8);
+    bool isOptimisticSettlement() const { return optimisticSettlement_; }
+
+    // Batch the optimistic settle stage (call before begin()): payments are
+    // collected for up to windowMs or maxBatch (at most X402BLE_SETTLE_MAX_BATCH)
+    // and settled back to back on one held facilitator connection, so frequent
+    // small charges share one TLS handshake. Each payment still gets its own
+    // PAYMENT:SETTLED / SETTLE_FAILED and settlement-failed callback; one the
+    // facilitator never received is settled again instead of failed.
+    void enableSettlementBatching(uint8_t maxBatch = 8, uint32_t windowMs = X402BLE_SETTLE_BATCH_WINDOW_MS);
+
+    // Local pre-check before /verify (on by default): payTo, amount, validity
+    // window and the EIP-712 signer are checked on the device, and payments
+    // that would certainly fail are answered with REASON:<x402 reason>
+    // without a facilitator round trip.
+    void enablePrecheck(bool enable = true) { precheck_ = enable; }
+    bool isPrecheckEnabled() const { return precheck_; }
+
+    // Verify and settle over several facilitators, healthiest first, failing
+    // over when one doesn't answer. Once any is added DEFAULT_FACILITATOR_URL
+    // is no longer used on its own - add it too to keep it in the rotation.
+    // Returns the endpoint index, or -1 if the registry is full.
+    int8_t addFacilitator(const char *url, uint32_t verifyTimeoutMs = FACILITATOR_VERIFY_TIMEOUT_MS,
+                          uint32_t settleTimeoutMs = FACILITATOR_SETTLE_TIMEOUT_MS)
+    {
+        return FacilitatorRegistry::instance().add(url, verifyTimeoutMs, settleTimeoutMs);
+    }
+    FacilitatorRegistry &getFacilitators() { return FacilitatorRegistry::instance(); }
+
+    // Race each /verify: it goes to the best facilitator at once and, if no
+    // answer came back within delayMs, to the second-best one as well; the
+    // first good answer is used. Needs two or more facilitators and costs a
+    // second TLS connection while racing; 0 turns it off. One race per
+    // verify worker can run at once, so call it after setVerifyWorkers().
+    bool enableVerifyHedging(uint32_t delayMs = X402BLE_VERIFY_HEDGE_MS)
+    {
+        return FacilitatorRegistry::instance().enableHedging(delayMs, verifyWorkerCount_);
+    }
+
+    // Time-boxed access. With enableRecuring(seconds) set, every successful
+    // payment grants (or extends) that much access to each selected option,
+    // or to "" when no options were selected. Expiry is tracked on the 64-bit
+    // esp_timer clock and reported through the callback (esp_timer task).
+    bool isEntitled(const String &option = "") const { return entitlements_.isActive(option); }
+    uint64_t getEntitlementRemainingMs(const String &option = "") const { return entitlements_.getRemainingMs(option); }
+    bool grantEntitlement(const String &option, uint64_t durationMs) { return entitlements_.grant(option, durationMs); }
+    bool revokeEntitlement(const String &option) { return entitlements_.revoke(option); }
+    void setOnEntitlementExpired(EntitlementExpiredCallback callback) { entitlements_.setExpiredCallback(callback); }
+
+    // Payment latency tracing: per-stage timestamps of the last `depth` payments
+    // (up to 64). Off by default; costs one flag test per stage when off.
+    bool enableTracing(bool enable = true, uint8_t depth = X402BLE_TRACE_DEPTH);
+    bool isTracingEnabled() const { return PaymentTracer::isEnabled(); }
+    // p50/p95/p99 of one stage; false until a traced payment reached it
+    bool getStageLatency(PaymentTraceStage stage, PaymentStageLatency &out) const;
+    // Same for every stage as JSON (also served by the [TRACE] command)
+    String getTraceSummary() const { return PaymentTracer::toSummaryJson(); }
+
+    // Settlement failure callback - called when an optimistic payment fails to settle
+    void setOnSettlementFailed(SettlementFailedCallback callback) { settlementFailedCallback_ = callback; }
+    SettlementFailedCallback getOnSettlementFailedCallback() const { return settlementFailedCallback_; }
+
+    // ATT MTU negotiated with a central (23 until it exchanges MTU);
+    // one notification carries at most getMaxNotifySize() bytes
+    uint16_t getPeerMTU(uint16_t connHandle) const;
+    size_t getMaxNotifySize(uint16_t connHandle) const { return getPeerMTU(connHandle) - 3; }
+
     // BLE UUIDs
     static const char *SERVICE_UUID;
     static const char *TX_CHAR_UUID;
@@ -110,6 +346,14 @@ public:
     // Update last payment state atomically
     void setLastPaymentState(bool paid, const String &txHash, const String &payer);
 
+    // Record a successful payment: last payment state, user selection and a
+    // PaymentRecord for waitForPayment(), all under one lock (used by worker)
+    void recordPayment(const String &txHash, const String &payer, const std::vector<String> &options,
+                       const String &customContext, bool settled);
+
+    // Fill in tx hash/payer of the last payment once optimistic settlement lands
+    void updateLastSettlement(const String &txHash, const String &payer);
+
 private:
     String device_name_;
     String network_;
@@ -129,26 +373,70 @@ private:
     uint32_t frequency_;                 // 0 = not set
     std::vector<String> options_;        // empty by default
     bool allowCustomContent_;            // false by default
-    String paymentPayload_;              // assembled from chunks
+    uint8_t verifyWorkerCount_;          // verifier tasks started by begin()
+    uint8_t verifyQueueDepth_;           // payments allowed to wait for a worker
+
+    // Built once; only maxAmountRequired changes between payments
+    PaymentRequirementsTemplate requirementsTemplate_;
+
+    // Pre-rendered metadata replies; setters mark them stale
+    void renderReplies();
+    volatile bool repliesStale_;
+    String priceReply_;
+    String optionsReply_;
+    String configHead_;                  // CONFIG://{... "mtu": 
+    String configTail_;                  // , "binary": 1}
+
+    // Per-connection payment/price assembly state
+    X402BleSession sessions_[X402BLE_MAX_SESSIONS];
 
     // User-provided selection/context from client
     std::vector<String> userSelectedOptions_;
     String userCustomContext_;
 
-    // Price request payload (for [PRICE] chunks)
-    String priceRequestPayload_;
-    
     // Dynamic price callback function
     DynamicPriceCallback dynamicPriceCallback_;
     
     // OnPay callback function (called on successful payment)
     OnPayCallback onPayCallback_;
 
+    bool precheck_;
+
+    // Optimistic settlement pipeline
+    bool optimisticSettlement_;
+    uint8_t settleQueueDepth_;
+    uint8_t settleBatchSize_;
+    uint32_t settleBatchWindowMs_;
+    SettlementFailedCallback settlementFailedCallback_;
+
     NimBLEServer *pServer;
     NimBLEService *pService;
     NimBLECharacteristic *pTxCharacteristic;
     NimBLECharacteristic *pRxCharacteristic;
 
+    // Guards last payment state and user selection (worker task vs loop())
+    SemaphoreHandle_t stateLock_;
+    void lockState() const;
+    void unlockState() const;
+
+    // PaymentRecord* handed from the worker to waitForPayment()
+    QueueHandle_t paymentEvents_;
+
+    // Paid access per option (enableRecuring)
+    EntitlementScheduler entitlements_;
+
+    // Recent [PRICE] quotes (dynamic pricing only)
+    PriceQuoteCache quotes_;
+
+    // Replay / duplicate-submission cache
+    NonceCache nonces_;
+
+    // Payments waiting for WiFi to settle
+    OfflineQueue offline_;
+
+    // Fragmented TX replies (NimBLE host task only)
+    NotifyStreamer streamer_;
+
     // Track the active instance for worker callbacks
     static X402Ble* s_active;
 };
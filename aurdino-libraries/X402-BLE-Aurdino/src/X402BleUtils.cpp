@@ -1,6 +1,51 @@
 #include "X402BleUtils.h"
 #include <cctype>
 
+bool ReassemblyBuffer::allocate(size_t capacity)
+{
+    if (data_)
+        return true;
+
+    data_ = (char *)malloc(capacity + 1);
+    if (!data_)
+        return false;
+
+    capacity_ = capacity;
+    clear();
+    return true;
+}
+
+void ReassemblyBuffer::release()
+{
+    free(data_);
+    data_ = nullptr;
+    length_ = 0;
+    capacity_ = 0;
+    overflowed_ = false;
+}
+
+void ReassemblyBuffer::clear()
+{
+    length_ = 0;
+    overflowed_ = false;
+    if (data_)
+        data_[0] = '\0';
+}
+
+bool ReassemblyBuffer::append(const char *data, size_t length)
+{
+    if (!data_ || length > capacity_ - length_)
+    {
+        overflowed_ = true;
+        return false;
+    }
+
+    memcpy(data_ + length_, data, length);
+    length_ += length;
+    data_[length_] = '\0';
+    return true;
+}
+
 // Memory-optimized case-insensitive comparison using direct char comparison
 bool startsWithIgnoreCase(const String &s, const char *prefix)
 {
@@ -19,31 +64,28 @@ bool startsWithIgnoreCase(const String &s, const char *prefix)
     return true;
 }
 
-// Memory-optimized payment chunk assembly with proper capacity management
+// Zero-copy payment chunk assembly into a preallocated buffer
 // Frontend sends: "X-PAYMENT:START<data>", "X-PAYMENT<data>", ..., "X-PAYMENT:END<data>"
 // Returns true when complete (END received), false while still assembling
-bool assemblePaymentChunk(const String &chunk, String &paymentPayload)
+bool assemblePaymentChunk(const char *chunk, size_t length, ReassemblyBuffer &paymentBuffer)
 {
-    const char* chunk_ptr = chunk.c_str();
-    
-    if (strncmp(chunk_ptr, "X-PAYMENT:START", 15) == 0)
+    if (length >= 15 && strncmp(chunk, "X-PAYMENT:START", 15) == 0)
     {
-        // Start of new payment - clear existing and start fresh
-        paymentPayload = "";
-        paymentPayload.reserve(1024); // Pre-allocate expected payload size
-        paymentPayload += (chunk_ptr + 15); // Skip "X-PAYMENT:START"
+        // Start of new payment - discard any partial payload and start fresh
+        paymentBuffer.clear();
+        paymentBuffer.append(chunk + 15, length - 15); // Skip "X-PAYMENT:START"
         return false; // Not complete yet
     }
-    else if (strncmp(chunk_ptr, "X-PAYMENT:END", 13) == 0)
+    else if (length >= 13 && strncmp(chunk, "X-PAYMENT:END", 13) == 0)
     {
         // End of payment - append final chunk
-        paymentPayload += (chunk_ptr + 13); // Skip "X-PAYMENT:END"
-        return true; // Assembly complete
+        paymentBuffer.append(chunk + 13, length - 13); // Skip "X-PAYMENT:END"
+        return !paymentBuffer.overflowed(); // Assembly complete
     }
-    else if (strncmp(chunk_ptr, "X-PAYMENT", 9) == 0)
+    else if (length >= 9 && strncmp(chunk, "X-PAYMENT", 9) == 0)
     {
-        // Middle chunk - append data efficiently
-        paymentPayload += (chunk_ptr + 9); // Skip "X-PAYMENT"
+        // Middle chunk - append in place
+        paymentBuffer.append(chunk + 9, length - 9); // Skip "X-PAYMENT"
         return false; // Not complete yet
     }
     
@@ -51,44 +93,78 @@ bool assemblePaymentChunk(const String &chunk, String &paymentPayload)
     return false;
 }
 
-// Memory-optimized price request chunk assembly
+// Zero-copy price request chunk assembly into a preallocated buffer
 // Frontend sends: "[PRICE]:START<data>", "[PRICE]:<data>", ..., "[PRICE]:END<data>"
 // Returns true when complete (END received), false while still assembling
-bool assemblePriceRequestChunk(const String &chunk, String &priceRequestPayload)
+bool assemblePriceRequestChunk(const char *chunk, size_t length, ReassemblyBuffer &priceBuffer)
 {
-    const char* chunk_ptr = chunk.c_str();
-    
-    
-    
-    
-    if (strncmp(chunk_ptr, "[PRICE]:START", 13) == 0)
+    if (length >= 13 && strncmp(chunk, "[PRICE]:START", 13) == 0)
     {
-        // Start of new price request - clear existing and start fresh
-        
-        priceRequestPayload = "";
-        priceRequestPayload.reserve(512); // Pre-allocate expected payload size
-        priceRequestPayload += (chunk_ptr + 13); // Skip "[PRICE]:START"
-        
+        // Start of new price request - discard any partial payload and start fresh
+        priceBuffer.clear();
+        priceBuffer.append(chunk + 13, length - 13); // Skip "[PRICE]:START"
         return false; // Not complete yet
     }
-    else if (strncmp(chunk_ptr, "[PRICE]:END", 11) == 0)
+    else if (length >= 11 && strncmp(chunk, "[PRICE]:END", 11) == 0)
     {
         // End of price request - append final chunk
-        
-        priceRequestPayload += (chunk_ptr + 11); // Skip "[PRICE]:END"
-        
-        return true; // Assembly complete
+        priceBuffer.append(chunk + 11, length - 11); // Skip "[PRICE]:END"
+        return !priceBuffer.overflowed(); // Assembly complete
     }
-    else if (strncmp(chunk_ptr, "[PRICE]:", 8) == 0)
+    else if (length >= 8 && strncmp(chunk, "[PRICE]:", 8) == 0)
     {
-        // Middle chunk - append data efficiently
-        
-        priceRequestPayload += (chunk_ptr + 8); // Skip "[PRICE]:"
-        
+        // Middle chunk - append in place
+        priceBuffer.append(chunk + 8, length - 8); // Skip "[PRICE]:"
         return false; // Not complete yet
     }
     
     // Not a price request chunk
-    
     return false;
 }
+
+// Parse options array like [opt1,opt2] without intermediate substrings
+void parseOptionList(const char *begin, const char *end, std::vector<String> &options)
+{
+    options.clear();
+    if (end - begin < 2 || *begin != '[' || *(end - 1) != ']')
+        return;
+
+    const char *cursor = begin + 1;
+    const char *inner_end = end - 1;
+    while (cursor < inner_end)
+    {
+        const char *comma = (const char *)memchr(cursor, ',', inner_end - cursor);
+        const char *item_end = comma ? comma : inner_end;
+
+        // Trim surrounding whitespace
+        const char *item_begin = cursor;
+        while (item_begin < item_end && isspace((unsigned char)*item_begin))
+            item_begin++;
+        const char *item_last = item_end;
+        while (item_last > item_begin && isspace((unsigned char)*(item_last - 1)))
+            item_last--;
+
+        if (item_last > item_begin)
+        {
+            String item;
+            item.concat(item_begin, item_last - item_begin);
+            options.push_back(item);
+        }
+
+        if (!comma)
+            break;
+        cursor = comma + 1;
+    }
+}
+
+String parseCustomContext(const char *begin, const char *end)
+{
+    String context;
+    // Normalize customContext: if it's wrapped as "" (empty quoted), make empty
+    if (end - begin == 2 && begin[0] == '"' && begin[1] == '"')
+        return context;
+
+    if (end > begin)
+        context.concat(begin, end - begin);
+    return context;
+}
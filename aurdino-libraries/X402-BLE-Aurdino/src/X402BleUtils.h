@@ -2,16 +2,58 @@
 #define X402BLE_UTILS_H
 
 #include <Arduino.h>
+#include <vector>
+
+// Fixed-capacity byte arena that chunks are appended into in place.
+// Storage is allocated once and reused; clear() never frees it.
+class ReassemblyBuffer
+{
+public:
+    ReassemblyBuffer() : data_(nullptr), length_(0), capacity_(0), overflowed_(false) {}
+    ~ReassemblyBuffer() { release(); }
+
+    ReassemblyBuffer(const ReassemblyBuffer &) = delete;
+    ReassemblyBuffer &operator=(const ReassemblyBuffer &) = delete;
+
+    // Allocate storage once (no-op if already allocated); false on OOM
+    bool allocate(size_t capacity);
+    void release();
+
+    // Reset contents, keeping storage
+    void clear();
+
+    // Append bytes in place; false (and overflowed()) if it would not fit
+    bool append(const char *data, size_t length);
+
+    const char *c_str() const { return data_ ? data_ : ""; }
+    size_t length() const { return length_; }
+    size_t capacity() const { return capacity_; }
+    bool overflowed() const { return overflowed_; }
+
+private:
+    char *data_;       // capacity_ + 1 bytes, always NUL-terminated
+    size_t length_;
+    size_t capacity_;
+    bool overflowed_;  // set when an append did not fit, cleared by clear()
+};
 
 // Case-insensitive string comparison utility
 bool startsWithIgnoreCase(const String &s, const char *prefix);
 
 // Payment chunk assembly - handles X-PAYMENT:START, X-PAYMENT, X-PAYMENT:END chunks
-// Returns true when assembly is complete (END received), false if still assembling
-bool assemblePaymentChunk(const String &chunk, String &paymentPayload);
+// Appends directly into paymentBuffer. Returns true when assembly is complete
+// (END received), false if still assembling or the buffer overflowed.
+bool assemblePaymentChunk(const char *chunk, size_t length, ReassemblyBuffer &paymentBuffer);
 
 // Price request chunk assembly - handles [PRICE]:START, [PRICE]:, [PRICE]:END chunks
-// Returns true when assembly is complete (END received), false if still assembling
-bool assemblePriceRequestChunk(const String &chunk, String &priceRequestPayload);
+// Appends directly into priceBuffer. Returns true when assembly is complete
+// (END received), false if still assembling or the buffer overflowed.
+bool assemblePriceRequestChunk(const char *chunk, size_t length, ReassemblyBuffer &priceBuffer);
+
+// Parse an option list like "[opt1,opt2]" in [begin, end) into trimmed items
+void parseOptionList(const char *begin, const char *end, std::vector<String> &options);
+
+// Copy a custom context from [begin, end); "" (empty quoted) becomes empty
+String parseCustomContext(const char *begin, const char *end);
 
 #endif // X402BLE_UTILS_H
@@ -0,0 +1,237 @@
+// X402-BLE-Aurdino hot paths: chunk assembly, the RX dispatcher and a whole
+// payment through the verify worker against a stand-in facilitator
+
+#include "bench.h"
+#include "x402fixture.h"
+#include "X402BleUtils.h"
+#include "NonceCache.h"
+#include <unistd.h>
+
+using namespace x402fixture;
+
+// The chunk path before ReassemblyBuffer, kept as the reference: every write
+// copied the partial payload out of X402Ble, appended the chunk and copied it
+// back. copied counts the bytes each step moves.
+namespace reference
+{
+
+struct Ble
+{
+    String paymentPayload;
+    String getPaymentPayload() const { return paymentPayload; }
+    void setPaymentPayload(const String &payload) { paymentPayload = payload; }
+};
+
+static bool assemblePaymentChunk(const String &chunk, String &paymentPayload, size_t &copied)
+{
+    const char *chunk_ptr = chunk.c_str();
+    if (strncmp(chunk_ptr, "X-PAYMENT:START", 15) == 0)
+    {
+        paymentPayload = "";
+        paymentPayload.reserve(1024);
+        paymentPayload += (chunk_ptr + 15);
+        copied += chunk.length() - 15;
+    }
+    else if (strncmp(chunk_ptr, "X-PAYMENT:END", 13) == 0)
+    {
+        paymentPayload += (chunk_ptr + 13);
+        copied += chunk.length() - 13;
+        return true;
+    }
+    else if (strncmp(chunk_ptr, "X-PAYMENT", 9) == 0)
+    {
+        paymentPayload += (chunk_ptr + 9);
+        copied += chunk.length() - 9;
+    }
+    return false;
+}
+
+static bool onPaymentWrite(Ble &ble, const char *req_cstr, size_t &copied)
+{
+    String currentPayload = ble.getPaymentPayload();
+    copied += currentPayload.length();
+    String reqStr(req_cstr);
+    copied += reqStr.length();
+    bool isComplete = assemblePaymentChunk(reqStr, currentPayload, copied);
+    ble.setPaymentPayload(currentPayload);
+    copied += currentPayload.length();
+    return isComplete;
+}
+
+} // namespace reference
+
+BENCH(assemblePaymentChunk)
+{
+    std::vector<std::string> chunks = paymentChunks(paymentJson(1));
+    ReassemblyBuffer buffer;
+    buffer.allocate(2048);
+    state.setItemsPerRun((double)chunks.size());
+    state.run([&] {
+        for (const std::string &chunk : chunks)
+            assemblePaymentChunk(chunk.data(), chunk.size(), buffer);
+        hostbench::keep(buffer.length());
+    }, "payment");
+    // ReassemblyBuffer::append copies each chunk's payload once
+    size_t copied = buffer.length();
+    printf("%-44s %12zu B copied/payment\n", "assemblePaymentChunk/payment", copied);
+
+    reference::Ble ble;
+    state.run([&] {
+        copied = 0;
+        for (const std::string &chunk : chunks)
+            reference::onPaymentWrite(ble, chunk.c_str(), copied);
+        hostbench::keep(ble.paymentPayload.length());
+    }, "copy_back_reference");
+    printf("%-44s %12zu B copied/payment\n", "assemblePaymentChunk/copy_back_reference", copied);
+}
+
+BENCH(onWrite_command)
+{
+    NimBLECharacteristic *rxChar = rx();
+    state.run([&] {
+        hoststub::bleWrite(rxChar, CENTRAL, "[CONFIG]", 8);
+        tx()->sent();
+    }, "config");
+    state.run([&] {
+        hoststub::bleWrite(rxChar, CENTRAL, "[OPTIONS]", 9);
+        tx()->sent();
+    }, "options");
+    state.run([&] {
+        hoststub::bleWrite(rxChar, CENTRAL, "?", 1);
+        tx()->sent();
+    }, "price");
+    // Drop replies that completed after the last run, so they are not taken
+    // for the next bench's
+    hoststub::bleSettle();
+    tx()->sent();
+}
+
+BENCH(nonceCache_full)
+{
+    // Every lookup scans all slots, so measure with the cache full of settled
+    // entries: a replay found in the last slot, and a new nonce that misses
+    // every slot before it is claimed and released
+    NonceCache cache;
+    std::vector<uint64_t> keys;
+    uint32_t validBefore = (uint32_t)time(nullptr) + 3600;
+    for (uint32_t i = 0; i < NonceCache::capacity(); ++i)
+    {
+        std::string nonce = "0x" + std::to_string(i);
+        keys.push_back(NonceCache::keyFor(PAYER, strlen(PAYER), nonce.c_str(), nonce.size()));
+        cache.claim(keys.back(), validBefore);
+        cache.markSettled(keys.back(), "0x" + String(std::string(64, 'a').c_str()));
+    }
+    String tx;
+    state.run([&] { hostbench::keep((int)cache.claim(keys.back(), validBefore, &tx)); }, "hit");
+
+    static uint64_t fresh = 1ull << 40;
+    state.run([&] {
+        hostbench::keep((int)cache.claim(++fresh, validBefore));
+        cache.release(fresh);
+    }, "miss");
+
+    std::string json = paymentJson(0x22);
+    state.run([&] {
+        uint64_t key = 0;
+        uint32_t before = 0;
+        hostbench::keep(NonceCache::keyForPayment(json.c_str(), key, before));
+        hostbench::keep(key);
+    }, "keyForPayment");
+}
+
+BENCH(worker_payment)
+{
+    serveFacilitator();
+    NimBLECharacteristic *rxChar = rx();
+    device().enablePrecheck(true);
+
+    // Each payment needs its own nonce, or the nonce cache answers it
+    static uint64_t nonce = 1u << 20;
+    state.run([&] {
+        std::vector<std::string> chunks = paymentChunks(paymentJson(++nonce));
+        for (const std::string &chunk : chunks)
+            hoststub::bleWrite(rxChar, CENTRAL, chunk);
+        // ACKs, VERIFYING and COMPLETE from the worker (which may overtake VERIFYING)
+        std::vector<std::string> replies = received(CENTRAL, chunks.size() + 1);
+        bool complete = false;
+        for (const std::string &reply : replies)
+            complete |= reply.compare(0, 30, "PAYMENT:COMPLETE VERIFIED:true") == 0;
+        if (!complete)
+        {
+            for (const std::string &reply : replies)
+                fprintf(stderr, "worker_payment: reply %s\n", reply.c_str());
+            _exit(1);
+        }
+    }, "verify_settle");
+    hoststub::bleSettle();
+}
+
+// Payment latency against the verify pool size: every central keeps one
+// payment in flight against a facilitator that takes 20ms per request. The
+// pool is started once per process, so each size runs in its own.
+BENCH(worker_pool)
+{
+    static const uint8_t MAX_WORKERS = 4;
+    if (!state.subprocessArg())
+    {
+        for (uint8_t workers = 1; workers <= MAX_WORKERS; ++workers)
+        {
+            if (!state.runInSubprocess(std::to_string(workers)))
+                _exit(1);
+        }
+        return;
+    }
+
+    uint8_t workers = (uint8_t)atoi(state.subprocessArg());
+    serveFacilitator(20);
+    device([workers](X402Ble &ble) { ble.setVerifyWorkers(workers, X402BLE_MAX_SESSIONS); });
+    NimBLECharacteristic *rxChar = rx();
+    std::vector<uint16_t> centrals = {CENTRAL};
+    for (uint16_t handle = 2; handle <= X402BLE_MAX_SESSIONS; ++handle)
+    {
+        NimBLEDevice::getServer()->connect(handle, 247);
+        centrals.push_back(handle);
+    }
+    tx()->sent();
+
+    // One thread drives every central, so the replies are read in one place
+    static uint64_t nonce = 1u << 24;
+    std::map<uint16_t, unsigned long> startedAt;
+    auto pay = [&](uint16_t handle) {
+        startedAt[handle] = micros();
+        for (const std::string &chunk : paymentChunks(paymentJson(++nonce)))
+            hoststub::bleWrite(rxChar, handle, chunk);
+    };
+
+    std::vector<double> latenciesMs;
+    double seconds = state.budgetSeconds() * 4;
+    unsigned long begin = micros(), end = begin + (unsigned long)(seconds * 1e6);
+    for (uint16_t handle : centrals)
+        pay(handle);
+    size_t inFlight = centrals.size();
+    while (inFlight > 0)
+    {
+        if (!tx()->waitForSent(1, 5000))
+        {
+            fprintf(stderr, "worker_pool: no reply with %u workers\n", (unsigned)workers);
+            _exit(1);
+        }
+        for (const NimBLENotification &n : tx()->sent())
+        {
+            if (n.data.compare(0, 16, "PAYMENT:COMPLETE") != 0)
+                continue;
+            if (n.data.compare(0, 30, "PAYMENT:COMPLETE VERIFIED:true") != 0)
+            {
+                fprintf(stderr, "worker_pool: reply %s\n", n.data.c_str());
+                _exit(1);
+            }
+            unsigned long now = micros();
+            latenciesMs.push_back((now - startedAt[n.connHandle]) / 1000.0);
+            if ((long)(end - now) > 0)
+                pay(n.connHandle);
+            else
+                inFlight--;
+        }
+    }
+    state.reportLatencies(latenciesMs, (micros() - begin) / 1e6, ("workers_" + std::to_string(workers)).c_str());
+}
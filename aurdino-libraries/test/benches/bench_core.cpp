@@ -0,0 +1,144 @@
+// X402-Aurdino hot paths: JSON extraction and requirements rendering
+
+#include "bench.h"
+#include "x402fixture.h"
+#include "X402Aurdino.h"
+#include "jsonscanner.h"
+#include "keccak.h"
+#include "paymentutils.h"
+#include "precheck.h"
+#include <algorithm>
+
+static const String &settleResponse()
+{
+    static const String body =
+        "{\"success\":true,\"errorReason\":null,\"transaction\":\"0x4a5c9d2e0f1b3c7d8e9fa0b1c2d3e4f5a6b7c8d9e0f1a2b3c4d5e6f7a8b9c0d1\","
+        "\"network\":\"base-sepolia\",\"payer\":\"0x160f2008d1d4Efc64B0F7855ebce43471F9fffec\"}";
+    return body;
+}
+
+BENCH(extractJsonValue)
+{
+    const String &body = settleResponse();
+    state.run([&] { hostbench::keep(extractJsonValue(body, "transaction")); }, "transaction");
+    state.run([&] { hostbench::keep(extractJsonValue(body, "payer")); }, "payer");
+}
+
+BENCH(scanJson)
+{
+    const String &body = settleResponse();
+    static const char *const keys[] = {"success", "transaction", "payer", "network", "errorReason"};
+    JsonView values[5];
+    state.run([&] { hostbench::keep(scanJson(body.c_str(), body.length(), keys, values, 5)); }, "settle_5_keys");
+
+    String payment = x402fixture::paymentJson(1).c_str();
+    static const char *const paymentKeys[] = {"scheme", "network", "signature", "from", "to",
+                                              "value", "validAfter", "validBefore", "nonce"};
+    JsonView paymentValues[9];
+    state.run([&] { hostbench::keep(scanJson(payment.c_str(), payment.length(), paymentKeys, paymentValues, 9)); },
+              "payment_9_keys");
+}
+
+// Streaming scan throughput (items/s is bytes/s): a verify reply padded with
+// an echoed requirements array, fed in 64-byte pieces as a socket would
+BENCH(jsonCapture_stream)
+{
+    std::string body = "{\"invalidReason\":null,\"echo\":[";
+    for (int i = 0; i < 32; ++i)
+        body += std::string(i ? "," : "") + "{\"scheme\":\"exact\",\"payTo\":\"" + x402fixture::PAY_TO +
+                "\",\"note\":\"isValid \\\"payer\\\"\"}";
+    body += "],\"isValid\":true,\"payer\":\"";
+    body += x402fixture::PAYER;
+    body += "\"}";
+
+    static const char *const keys[] = {"isValid", "invalidReason", "payer"};
+    JsonCapture capture(keys, 3);
+    state.setItemsPerRun((double)body.size());
+    state.run([&] {
+        capture.reset();
+        for (size_t at = 0; at < body.size(); at += 64)
+            capture.feed(body.data() + at, std::min<size_t>(64, body.size() - at));
+        hostbench::keep(capture.isTrue(0));
+    }, "64_byte_pieces");
+}
+
+BENCH(buildRequirementsJson)
+{
+    state.run([&] {
+        hostbench::keep(buildDefaultPaymentRementsJson("base-sepolia", x402fixture::PAY_TO, "10000", "x402-host",
+                                                       "Coffee, one cup"));
+    }, "full");
+
+    PaymentRequirementsTemplate requirements;
+    requirements.build("base-sepolia", x402fixture::PAY_TO, "x402-host", "Coffee, one cup");
+    String price = "10000";
+    state.run([&] { hostbench::keep(requirements.render(price)); }, "template_render");
+}
+
+BENCH(paymentRequestJson)
+{
+    PaymentPayload payload(String(x402fixture::paymentJson(1).c_str()));
+    PaymentRequirementsTemplate requirements;
+    requirements.build("base-sepolia", x402fixture::PAY_TO, "x402-host");
+    String rendered = requirements.render("10000");
+    state.run([&] { hostbench::keep(createPaymentRequestJson(payload, rendered)); }, "joined");
+    state.run([&] {
+        String version;
+        GatherStream body;
+        gatherPaymentRequestJson(payload, rendered, version, body);
+        hostbench::keep(body.size());
+    }, "gathered");
+}
+
+// One permutation per 136-byte block: a word, a full block, and the
+// 2-block EIP-712 struct encoding (items/s is bytes/s)
+BENCH(keccak256)
+{
+    uint8_t input[200] = {};
+    uint8_t digest[Keccak256::DIGEST_SIZE];
+    for (size_t length : {32, 136, 200})
+    {
+        state.setItemsPerRun((double)length);
+        std::string label = std::to_string(length) + "_bytes";
+        state.run([&] {
+            keccak256(input, length, digest);
+            hostbench::keep(digest[0]);
+        }, label.c_str());
+    }
+}
+
+// The local checks that run before every /verify: field scan, amount and
+// window compare, and ecrecover where the host has mbedtls
+BENCH(precheckPayment)
+{
+    PaymentPayload payload(String(x402fixture::paymentJson(1).c_str()));
+    String requirements = buildDefaultPaymentRementsJson("base-sepolia", x402fixture::PAY_TO, "10000", "x402-host");
+    state.run([&] { hostbench::keep(precheckPayment(payload, requirements)); }, "fields");
+
+    uint8_t digest[32];
+    state.run([&] {
+        hostbench::keep(hashTransferWithAuthorization("USDC", "2", 84532, "0x036CbD53842c5426634e7929541eC2318f3dCF7e",
+                                                      x402fixture::PAYER, x402fixture::PAY_TO, "10000", "0", "1900000000",
+                                                      "0x000000000000000000000000000000000000000000000000000000000000002a",
+                                                      digest));
+    }, "eip712_digest");
+}
+
+#if X402_HOST_ECRECOVER
+// Signer recovery on its own: two scalar multiplications and a modular
+// square root, the bulk of a complete precheck
+BENCH(recoverEvmAddress)
+{
+    std::string json = x402fixture::paymentJson(1);
+    size_t at = json.find("\"signature\":\"0x") + 15;
+    uint8_t signature[65];
+    for (size_t i = 0; i < sizeof(signature); ++i)
+        signature[i] = (uint8_t)strtoul(json.substr(at + 2 * i, 2).c_str(), nullptr, 16);
+    uint8_t digest[32], address[20];
+    hashTransferWithAuthorization("USDC", "2", 84532, "0x036CbD53842c5426634e7929541eC2318f3dCF7e",
+                                  x402fixture::PAYER, x402fixture::PAY_TO, "10000", "0",
+                                  x402fixture::jsonField(json, "validBefore").c_str(),
+                                  x402fixture::jsonField(json, "nonce").c_str(), digest);
+    state.run([&] { hostbench::keep(recoverEvmAddress(digest, signature, address)); }, "secp256k1");
+}
+#endif
@@ -0,0 +1,89 @@
+// Facilitator request bodies: one joined String (createPaymentRequestJson)
+// against the gathered envelope streamed from its parts. The peak column is
+// the heap high-water mark of one /verify POST over a kept-alive connection.
+// settlePaymentBatch reports settlements/s at batch sizes 1, 8 and 32.
+// facilitator_connection compares a new connection per call with the
+// kept-alive one, against a stand-in whose handshake takes 5ms.
+
+#include "bench.h"
+#include "x402fixture.h"
+#include "X402Aurdino.h"
+#include "facilitatorconnection.h"
+#include "paymentutils.h"
+
+BENCH(facilitator_post)
+{
+    x402fixture::serveFacilitator();
+    FacilitatorConnection conn;
+
+    PaymentPayload payload(String(x402fixture::paymentJson(1).c_str()));
+    PaymentRequirementsTemplate requirements;
+    requirements.build("base-sepolia", x402fixture::PAY_TO, "x402-host", "Coffee, one cup");
+    String rendered = requirements.render(x402fixture::PRICE);
+
+    state.run([&] {
+        String body = createPaymentRequestJson(payload, rendered);
+        hostbench::keep(conn.post("verify", body).statusCode);
+    }, "joined_string");
+
+    state.run([&] {
+        String version;
+        GatherStream body;
+        gatherPaymentRequestJson(payload, rendered, version, body);
+        hostbench::keep(conn.post("verify", body).statusCode);
+    }, "gathered");
+}
+
+BENCH(facilitator_connection)
+{
+    x402fixture::serveFacilitator();
+    hoststub::setHandshakeDelay(x402fixture::FACILITATOR_ORIGIN, 5);
+    PaymentPayload payload(String(x402fixture::paymentJson(1).c_str()));
+    String requirements = buildDefaultPaymentRementsJson("base-sepolia", x402fixture::PAY_TO, x402fixture::PRICE, "x402-host");
+
+    auto measure = [&](bool reuse, const char *label) {
+        FacilitatorConnection conn;
+        uint32_t calls = 0;
+        state.run([&] {
+            if (!reuse)
+                conn.close();
+            hostbench::keep(verifyPayment(payload, requirements, "", &conn));
+            calls++;
+        }, label);
+        printf("%-44s %12.2f connects/call (getConnectCount %u over %u calls)\n",
+               (std::string("facilitator_connection/") + label).c_str(), (double)conn.getConnectCount() / calls,
+               (unsigned)conn.getConnectCount(), (unsigned)calls);
+    };
+    measure(false, "new_connection");
+    measure(true, "keep_alive");
+    hoststub::setHandshakeDelay(x402fixture::FACILITATOR_ORIGIN, 0);
+}
+
+BENCH(settlePaymentBatch)
+{
+    x402fixture::serveFacilitator();
+    FacilitatorConnection conn;
+
+    std::vector<PaymentPayload> payloads;
+    for (uint64_t nonce = 1; nonce <= 32; ++nonce)
+        payloads.emplace_back(String(x402fixture::paymentJson(nonce).c_str()));
+    String rendered = buildDefaultPaymentRementsJson("base-sepolia", x402fixture::PAY_TO, x402fixture::PRICE, "x402-host");
+
+    for (size_t batch : {1, 8, 32})
+    {
+        std::vector<SettlementBatchItem> items(batch);
+        for (size_t i = 0; i < batch; ++i)
+        {
+            items[i].payment = &payloads[i];
+            items[i].paymentRequirements = &rendered;
+        }
+        std::string label = "batch_" + std::to_string(batch);
+        state.setItemsPerRun((double)batch);
+        // Each batch opens its own socket, as one does after the idle keep-alive
+        // has lapsed; the stand-in has no TLS, so on a board the gap is wider
+        state.run([&] {
+            conn.close();
+            hostbench::keep(settlePaymentBatch(items.data(), batch, "", &conn));
+        }, label.c_str());
+    }
+}
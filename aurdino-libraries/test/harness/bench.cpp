@@ -0,0 +1,133 @@
+#include "bench.h"
+#include "hoststub.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+namespace hostbench
+{
+
+static double runSeconds = 0.5;
+
+std::vector<Case> &cases()
+{
+    static std::vector<Case> all;
+    return all;
+}
+
+void State::run(const std::function<void()> &body, const char *label)
+{
+    using clock = std::chrono::steady_clock;
+
+    // One untimed pass to warm caches and lazily built state
+    body();
+
+    hoststub::resetHeapPeak();
+    hoststub::HeapStats start = hoststub::heapStats();
+    uint64_t iterations = 0;
+    uint64_t batch = 1;
+    double elapsed = 0;
+    auto begin = clock::now();
+    while (elapsed < runSeconds)
+    {
+        for (uint64_t i = 0; i < batch; ++i)
+            body();
+        iterations += batch;
+        elapsed = std::chrono::duration<double>(clock::now() - begin).count();
+        if (batch < (1u << 20))
+            batch *= 2;
+    }
+    hoststub::HeapStats end = hoststub::heapStats();
+
+    std::string name = name_;
+    if (label)
+        name += std::string("/") + label;
+    double nsPerOp = elapsed * 1e9 / (double)iterations;
+    double allocsPerOp = (double)(end.allocations - start.allocations) / (double)iterations;
+    printf("%-44s %12.0f ns/op %8.1f allocs/op %8zu B peak", name.c_str(), nsPerOp, allocsPerOp,
+           end.peak > start.current ? end.peak - start.current : 0);
+    if (itemsPerRun_ > 0)
+        printf(" %10.0f items/s", itemsPerRun_ * (double)iterations / elapsed);
+    printf("\n");
+    fflush(stdout);
+}
+
+void State::reportLatencies(std::vector<double> latenciesMs, double seconds, const char *label)
+{
+    std::string name = name_;
+    if (label)
+        name += std::string("/") + label;
+    if (latenciesMs.empty())
+    {
+        printf("%-44s no samples\n", name.c_str());
+        fflush(stdout);
+        return;
+    }
+    std::sort(latenciesMs.begin(), latenciesMs.end());
+    auto percentile = [&](double p) { return latenciesMs[(size_t)(p * (double)(latenciesMs.size() - 1) + 0.5)]; };
+    printf("%-44s %9.1f ms p50 %9.1f ms p99 %8zu samples %10.1f items/s\n", name.c_str(), percentile(0.50),
+           percentile(0.99), latenciesMs.size(), (double)latenciesMs.size() / seconds);
+    fflush(stdout);
+}
+
+double State::budgetSeconds() const
+{
+    return runSeconds;
+}
+
+bool State::runInSubprocess(const std::string &arg)
+{
+    std::string quick = runSeconds < 0.5 ? "--quick" : "";
+    std::vector<char *> argv = {(char *)"x402_bench", (char *)"--subprocess", (char *)name_, (char *)arg.c_str()};
+    if (!quick.empty())
+        argv.push_back((char *)quick.c_str());
+    argv.push_back(nullptr);
+
+    fflush(stdout);
+    pid_t pid;
+    if (posix_spawn(&pid, "/proc/self/exe", nullptr, nullptr, argv.data(), environ) != 0)
+        return false;
+    int status = 0;
+    return waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int runMain(int argc, char **argv)
+{
+    const char *only = nullptr;
+    const char *subprocessArg = nullptr;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--quick") == 0)
+            runSeconds = 0.02;
+        else if (strcmp(argv[i], "--subprocess") == 0 && i + 2 < argc)
+        {
+            only = argv[++i];
+            subprocessArg = argv[++i];
+        }
+        else
+            only = argv[i];
+    }
+
+    for (const Case &bench : cases())
+    {
+        if (only && strcmp(only, bench.name) != 0)
+            continue;
+        State state(bench.name);
+        state.subprocessArg_ = subprocessArg;
+        bench.run(state);
+    }
+    fflush(stdout);
+    return 0;
+}
+
+} // namespace hostbench
+
+int main(int argc, char **argv)
+{
+    _exit(hostbench::runMain(argc, argv));
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+// Benchmark runner for the host build, in the spirit of Google Benchmark.
+//
+//   BENCH(name) { setup...; state.run([&] { code under test; }); }
+//
+// run() repeats the body until it has run for the time budget (--quick
+// shortens it for CI) and reports per iteration: wall time, heap
+// allocations and bytes, and the peak heap above the level before the run.
+// state.setItemsPerRun() adds a rate column, e.g. settlements/s.
+//
+// What can only be set up once per process (the verify worker pool) is
+// swept with state.runInSubprocess(arg): the BENCH runs again in a fresh
+// process, where state.subprocessArg() returns arg.
+
+#include <Arduino.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace hostbench
+{
+
+class State
+{
+public:
+    explicit State(const char *name) : name_(name) {}
+
+    // Measure body; may be called more than once per BENCH to report
+    // several variants (each gets its own row, suffixed with label)
+    void run(const std::function<void()> &body, const char *label = nullptr);
+
+    // items processed per call of body, for an items/s column
+    void setItemsPerRun(double items) { itemsPerRun_ = items; }
+
+    // Latencies the BENCH timed itself: one row with p50, p99 and the rate
+    // of samples over seconds
+    void reportLatencies(std::vector<double> latenciesMs, double seconds, const char *label = nullptr);
+
+    // How long run() measures for (--quick shortens it)
+    double budgetSeconds() const;
+
+    // Run this BENCH in a new process with arg; its rows go to stdout.
+    // False if the process failed.
+    bool runInSubprocess(const std::string &arg);
+    // arg when started by runInSubprocess(), else nullptr
+    const char *subprocessArg() const { return subprocessArg_; }
+
+private:
+    friend int runMain(int argc, char **argv);
+
+    const char *name_;
+    double itemsPerRun_ = 0;
+    const char *subprocessArg_ = nullptr;
+};
+
+struct Case
+{
+    const char *name;
+    void (*run)(State &);
+};
+
+std::vector<Case> &cases();
+
+struct Registrar
+{
+    Registrar(const char *name, void (*run)(State &)) { cases().push_back(Case{name, run}); }
+};
+
+// Keep the optimizer from dropping a computed value
+template <typename T>
+inline void keep(const T &value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+} // namespace hostbench
+
+#define BENCH(name)                                                        \
+    static void bench_##name(hostbench::State &state);                     \
+    static hostbench::Registrar register_##name(#name, bench_##name);      \
+    static void bench_##name(hostbench::State &state)
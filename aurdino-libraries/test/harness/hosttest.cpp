@@ -0,0 +1,47 @@
+#include "hosttest.h"
+#include <cstdio>
+#include <unistd.h>
+
+namespace hosttest
+{
+
+static int failures = 0;
+
+std::vector<Case> &cases()
+{
+    static std::vector<Case> all;
+    return all;
+}
+
+void fail(const char *file, int line, const std::string &what)
+{
+    failures++;
+    fprintf(stderr, "  %s:%d: %s\n", file, line, what.c_str());
+}
+
+} // namespace hosttest
+
+int main(int argc, char **argv)
+{
+    int failedCases = 0;
+    int ran = 0;
+    for (const hosttest::Case &test : hosttest::cases())
+    {
+        if (argc > 1 && strcmp(argv[1], test.name) != 0)
+            continue;
+        int before = hosttest::failures;
+        test.run();
+        ran++;
+        bool ok = hosttest::failures == before;
+        failedCases += ok ? 0 : 1;
+        printf("%-4s %s\n", ok ? "ok" : "FAIL", test.name);
+        fflush(stdout);
+    }
+    printf("%d/%d passed\n", ran - failedCases, ran);
+    fflush(stdout);
+    fflush(stderr);
+
+    // Worker tasks never return; leave without running static destructors
+    // under them
+    _exit(failedCases || ran == 0 ? 1 : 0);
+}
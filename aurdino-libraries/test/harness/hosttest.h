@@ -0,0 +1,77 @@
+#pragma once
+
+// Minimal test runner for the host build.
+//
+//   TEST(name) { CHECK(cond); CHECK_EQ(actual, expected); }
+//
+// Every TEST in the executable runs in order; a test name given on the
+// command line runs only that one. Exits non-zero if any check failed.
+
+#include <Arduino.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace hosttest
+{
+
+struct Case
+{
+    const char *name;
+    void (*run)();
+};
+
+std::vector<Case> &cases();
+
+struct Registrar
+{
+    Registrar(const char *name, void (*run)()) { cases().push_back(Case{name, run}); }
+};
+
+void fail(const char *file, int line, const std::string &what);
+
+template <typename T>
+std::string show(const T &value)
+{
+    std::ostringstream out;
+    out << value;
+    return out.str();
+}
+inline std::string show(const String &value) { return std::string("\"") + value.c_str() + "\""; }
+inline std::string show(const std::string &value) { return "\"" + value + "\""; }
+inline std::string show(const char *value) { return value ? "\"" + std::string(value) + "\"" : "null"; }
+inline std::string show(uint8_t value) { return std::to_string(value); }
+inline std::string show(int8_t value) { return std::to_string(value); }
+
+inline bool same(const char *a, const char *b) { return (!a || !b) ? a == b : strcmp(a, b) == 0; }
+inline bool same(const String &a, const char *b) { return a == b; }
+template <typename A, typename B>
+bool same(const A &a, const B &b)
+{
+    return a == b;
+}
+
+} // namespace hosttest
+
+#define TEST(name)                                                        \
+    static void test_##name();                                            \
+    static hosttest::Registrar register_##name(#name, test_##name);       \
+    static void test_##name()
+
+#define CHECK(cond)                                          \
+    do                                                       \
+    {                                                        \
+        if (!(cond))                                         \
+            hosttest::fail(__FILE__, __LINE__, #cond);       \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                                   \
+    do                                                                                               \
+    {                                                                                                \
+        const auto &actual_ = (actual);                                                              \
+        const auto &expected_ = (expected);                                                          \
+        if (!hosttest::same(actual_, expected_))                                                     \
+            hosttest::fail(__FILE__, __LINE__,                                                       \
+                           std::string(#actual " == " #expected ": got ") + hosttest::show(actual_) + \
+                               ", expected " + hosttest::show(expected_));                           \
+    } while (0)
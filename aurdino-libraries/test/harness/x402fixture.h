@@ -0,0 +1,271 @@
+#pragma once
+
+// Shared fixtures for host tests and benchmarks: signed payments, a
+// stand-in facilitator at DEFAULT_FACILITATOR_URL and one started X402Ble
+// with a connected central.
+
+#include "hoststub.h"
+#include "X402Ble.h"
+#include "precheck.h"
+#include <atomic>
+#include <ctime>
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+// With mbedtls on the host, precheck.cpp recovers signers like the board
+// does, so payments are signed for real; without it they carry a placeholder
+#if __has_include(<mbedtls/ecdsa.h>)
+#include <mbedtls/ecdsa.h>
+#endif
+#if defined(MBEDTLS_ECP_DP_SECP256K1_ENABLED)
+#define X402_HOST_ECRECOVER 1
+#else
+#define X402_HOST_ECRECOVER 0
+#endif
+
+namespace x402fixture
+{
+
+static const char *const PAY_TO = "0x209693Bc6afc0C5328bA36FaF03C514EF312287C";
+// Address of the private key keccak256("x402 host payer")
+static const char *const PAYER = "0x160f2008d1d4Efc64B0F7855ebce43471F9fffec";
+
+// Value of "key":"..." in json, empty if missing
+inline std::string jsonField(const std::string &json, const char *key)
+{
+    std::string needle = std::string("\"") + key + "\":\"";
+    size_t at = json.find(needle);
+    if (at == std::string::npos)
+        return "";
+    at += needle.size();
+    return json.substr(at, json.find('"', at) - at);
+}
+
+// Replace the signature of a paymentJson()-shaped payment with PAYER's over
+// its current authorization (EIP-712, low-s, v = 27/28). A no-op where
+// signers are not recovered, or if the fields cannot be hashed.
+inline void signPaymentJson(std::string &json)
+{
+#if X402_HOST_ECRECOVER
+    static const uint8_t key[32] = {
+        0x81, 0xe1, 0xa8, 0x79, 0xa9, 0x76, 0x4f, 0x78, 0x68, 0xe9, 0x17, 0xfd, 0xa7, 0xde, 0xe2, 0x52,
+        0x47, 0xbf, 0x0a, 0xd7, 0x39, 0xee, 0xa2, 0x5d, 0xd4, 0x18, 0xd2, 0xe9, 0x3f, 0xad, 0xa3, 0x5f};
+    const EvmNetworkInfo *network = findEvmNetwork(jsonField(json, "network").c_str());
+    uint8_t digest[32];
+    if (!network ||
+        !hashTransferWithAuthorization(network->usdc.usdcName, "2", network->chainId, network->usdc.usdcAddress,
+                                       jsonField(json, "from").c_str(), jsonField(json, "to").c_str(),
+                                       jsonField(json, "value").c_str(), jsonField(json, "validAfter").c_str(),
+                                       jsonField(json, "validBefore").c_str(), jsonField(json, "nonce").c_str(), digest))
+        return;
+
+    // Deterministic (RFC 6979); the blinding RNG only has to produce bytes
+    auto blinding = [](void *, unsigned char *out, size_t length) {
+        for (size_t i = 0; i < length; ++i)
+            out[i] = (unsigned char)(i * 131 + 7);
+        return 0;
+    };
+    uint8_t signature[65];
+    mbedtls_ecp_group grp;
+    mbedtls_mpi d, r, s, half;
+    mbedtls_ecp_group_init(&grp);
+    mbedtls_mpi_init(&d);
+    mbedtls_mpi_init(&r);
+    mbedtls_mpi_init(&s);
+    mbedtls_mpi_init(&half);
+    bool ok = mbedtls_ecp_group_load(&grp, MBEDTLS_ECP_DP_SECP256K1) == 0 &&
+              mbedtls_mpi_read_binary(&d, key, sizeof(key)) == 0 &&
+              mbedtls_ecdsa_sign_det_ext(&grp, &r, &s, &d, digest, sizeof(digest), MBEDTLS_MD_SHA256, blinding,
+                                         nullptr) == 0 &&
+              mbedtls_mpi_copy(&half, &grp.N) == 0 && mbedtls_mpi_shift_r(&half, 1) == 0;
+    // Low-s, as the token contract requires
+    if (ok && mbedtls_mpi_cmp_mpi(&s, &half) > 0)
+        ok = mbedtls_mpi_sub_mpi(&s, &grp.N, &s) == 0;
+    ok = ok && mbedtls_mpi_write_binary(&r, signature, 32) == 0 &&
+         mbedtls_mpi_write_binary(&s, signature + 32, 32) == 0;
+    mbedtls_mpi_free(&half);
+    mbedtls_mpi_free(&s);
+    mbedtls_mpi_free(&r);
+    mbedtls_mpi_free(&d);
+    mbedtls_ecp_group_free(&grp);
+    if (!ok)
+        return;
+
+    // v is whichever recovery id gives back PAYER
+    uint8_t payer[20], recovered[20];
+    for (size_t i = 0; i < sizeof(payer); ++i)
+        payer[i] = (uint8_t)strtoul(std::string(PAYER + 2 + 2 * i, 2).c_str(), nullptr, 16);
+    for (signature[64] = 27; signature[64] <= 28; ++signature[64])
+    {
+        if (recoverEvmAddress(digest, signature, recovered) && memcmp(recovered, payer, sizeof(payer)) == 0)
+            break;
+    }
+    if (signature[64] > 28)
+        return;
+
+    static const char digits[] = "0123456789abcdef";
+    std::string hex = "0x";
+    for (uint8_t byte : signature)
+    {
+        hex += digits[byte >> 4];
+        hex += digits[byte & 15];
+    }
+    size_t at = json.find("\"signature\":\"");
+    if (at != std::string::npos)
+        json.replace(at + 13, 132, hex);
+#else
+    (void)json;
+#endif
+}
+static const char *const PRICE = "10000";
+static const char *const FACILITATOR_ORIGIN = "https://www.x402.org";
+static const uint16_t CENTRAL = 1;
+
+// x402 "exact" payment JSON from PAYER with a distinct nonce; validBefore 0
+// means ten minutes from now
+inline std::string paymentJson(uint64_t nonce, const char *value = PRICE, uint64_t validBefore = 0,
+                               const char *payTo = PAY_TO)
+{
+    if (validBefore == 0)
+        validBefore = (uint64_t)time(nullptr) + 600;
+    char nonceHex[67];
+    snprintf(nonceHex, sizeof(nonceHex), "0x%048x%016llx", 0, (unsigned long long)nonce);
+    std::string json;
+    json.reserve(640);
+    json += "{\"x402Version\":1,\"scheme\":\"exact\",\"network\":\"base-sepolia\",\"payload\":{";
+    json += "\"signature\":\"0x";
+    json += std::string(130, 'a');
+    json += "\",\"authorization\":{\"from\":\"";
+    json += PAYER;
+    json += "\",\"to\":\"";
+    json += payTo;
+    json += "\",\"value\":\"";
+    json += value;
+    json += "\",\"validAfter\":\"0\",\"validBefore\":\"";
+    json += std::to_string(validBefore);
+    json += "\",\"nonce\":\"";
+    json += nonceHex;
+    json += "\"}}}";
+    signPaymentJson(json);
+    return json;
+}
+
+// The text protocol's X-PAYMENT chunks for payment--context--[options],
+// each at most chunkSize bytes of payload
+inline std::vector<std::string> paymentChunks(const std::string &json, const std::string &context = "\"\"",
+                                              const std::string &options = "[]", size_t chunkSize = 180)
+{
+    std::string combined = json + "--" + context + "--" + options;
+    std::vector<std::string> chunks;
+    for (size_t at = 0; at < combined.size(); at += chunkSize)
+    {
+        bool first = at == 0;
+        bool last = at + chunkSize >= combined.size();
+        const char *prefix = first ? "X-PAYMENT:START" : last ? "X-PAYMENT:END" : "X-PAYMENT";
+        chunks.push_back(prefix + combined.substr(at, chunkSize));
+    }
+    if (chunks.size() == 1)
+        chunks.push_back("X-PAYMENT:END");
+    return chunks;
+}
+
+struct FacilitatorStats
+{
+    std::atomic<uint32_t> verifies{0};
+    std::atomic<uint32_t> settles{0};
+};
+
+inline FacilitatorStats &facilitatorStats()
+{
+    static FacilitatorStats stats;
+    return stats;
+}
+
+// Answer /facilitator/verify and /settle at DEFAULT_FACILITATOR_URL; every
+// payment is valid and settles with a transaction hash numbered by arrival.
+// observe (if set) sees each request first, on the requesting task.
+inline void serveFacilitator(uint32_t delayMs = 0, std::function<void(const hoststub::HttpRequest &)> observe = nullptr)
+{
+    hoststub::serve(FACILITATOR_ORIGIN, [delayMs, observe](const hoststub::HttpRequest &request) {
+        if (observe)
+            observe(request);
+        hoststub::HttpReply reply;
+        reply.delayMs = delayMs;
+        if (request.path == "/facilitator/verify")
+        {
+            facilitatorStats().verifies++;
+            reply.body = std::string("{\"isValid\":true,\"payer\":\"") + PAYER + "\"}";
+        }
+        else if (request.path == "/facilitator/settle")
+        {
+            char tx[67];
+            snprintf(tx, sizeof(tx), "0x%064x", (unsigned)++facilitatorStats().settles);
+            reply.body = std::string("{\"success\":true,\"transaction\":\"") + tx + "\",\"network\":\"base-sepolia\",\"payer\":\"" +
+                         PAYER + "\"}";
+        }
+        else
+        {
+            reply.status = 404;
+        }
+        return reply;
+    });
+}
+
+// One X402Ble per process (the worker pool is started once), begun on
+// first use with CENTRAL connected at MTU 247. setup (first call only) runs
+// before begin(), for options that must be set by then.
+inline X402Ble &device(std::function<void(X402Ble &)> setup = nullptr)
+{
+    static X402Ble *ble = nullptr;
+    if (!ble)
+    {
+        hoststub::setWiFiStatus(WL_CONNECTED);
+        ble = new X402Ble("x402-host", PRICE, PAY_TO, "base-sepolia");
+        if (setup)
+            setup(*ble);
+        ble->begin();
+        NimBLEDevice::getServer()->connect(CENTRAL, 247);
+    }
+    return *ble;
+}
+
+inline NimBLECharacteristic *rx()
+{
+    device();
+    return NimBLEDevice::getServer()->getServiceByUUID(X402Ble::SERVICE_UUID)->getCharacteristic(X402Ble::RX_CHAR_UUID);
+}
+
+inline NimBLECharacteristic *tx()
+{
+    device();
+    return NimBLEDevice::getServer()->getServiceByUUID(X402Ble::SERVICE_UUID)->getCharacteristic(X402Ble::TX_CHAR_UUID);
+}
+
+// Next count notifications tx() sent to handle, waiting up to timeoutMs.
+// Notifications for other centrals are kept for their own received() call.
+inline std::vector<std::string> received(uint16_t handle, size_t count, uint32_t timeoutMs = 5000)
+{
+    static std::map<uint16_t, std::deque<std::string>> inbox;
+    std::deque<std::string> &mine = inbox[handle];
+    unsigned long start = millis();
+    for (;;)
+    {
+        for (NimBLENotification &n : tx()->sent())
+            inbox[n.connHandle].push_back(std::move(n.data));
+        if (mine.size() >= count || millis() - start > timeoutMs)
+            break;
+        tx()->waitForSent(1, 20);
+    }
+    std::vector<std::string> out;
+    while (!mine.empty() && out.size() < count)
+    {
+        out.push_back(std::move(mine.front()));
+        mine.pop_front();
+    }
+    return out;
+}
+
+} // namespace x402fixture
@@ -0,0 +1,367 @@
+#pragma once
+
+// Host stand-in for the parts of the ESP32 Arduino core the libraries use.
+// String keeps the Arduino API on top of std::string; timing is real time.
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <cmath>
+#include <string>
+#include <algorithm>
+#include <type_traits>
+#include <strings.h>
+#include <time.h>
+
+#define ESP32 1
+#define PROGMEM
+#define F(x) x
+#define ESP_PWR_LVL_P7 7
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+
+using std::max;
+using std::min;
+
+class String;
+
+class Print
+{
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size)
+    {
+        size_t n = 0;
+        while (n < size && write(buffer[n]))
+            n++;
+        return n;
+    }
+    size_t write(const char *str) { return str ? write((const uint8_t *)str, strlen(str)) : 0; }
+    size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+
+    size_t print(const char *str);
+    size_t print(const String &str);
+    size_t print(char c);
+    size_t print(int value, int base = 10);
+    size_t print(unsigned int value, int base = 10);
+    size_t print(long value, int base = 10);
+    size_t print(unsigned long value, int base = 10);
+    size_t print(long long value, int base = 10);
+    size_t print(unsigned long long value, int base = 10);
+    size_t print(double value, int digits = 2);
+    size_t println();
+    size_t println(const char *str);
+    size_t println(const String &str);
+    size_t println(char c);
+    size_t println(int value, int base = 10);
+    size_t println(unsigned int value, int base = 10);
+    size_t println(long value, int base = 10);
+    size_t println(unsigned long value, int base = 10);
+    size_t println(long long value, int base = 10);
+    size_t println(unsigned long long value, int base = 10);
+    size_t println(double value, int digits = 2);
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class String
+{
+public:
+    String(const char *cstr = "") : s_(cstr ? cstr : "") {}
+    String(const char *cstr, unsigned int length) : s_(cstr ? std::string(cstr, length) : std::string()) {}
+    String(const String &) = default;
+    String(String &&) = default;
+    explicit String(const std::string &str) : s_(str) {}
+    explicit String(char c) : s_(1, c) {}
+    explicit String(unsigned char value, unsigned char base = 10) : s_(format((unsigned long long)value, base)) {}
+    explicit String(int value, unsigned char base = 10) : s_(formatSigned(value, base)) {}
+    explicit String(unsigned int value, unsigned char base = 10) : s_(format(value, base)) {}
+    explicit String(long value, unsigned char base = 10) : s_(formatSigned(value, base)) {}
+    explicit String(unsigned long value, unsigned char base = 10) : s_(format(value, base)) {}
+    explicit String(long long value, unsigned char base = 10) : s_(formatSigned(value, base)) {}
+    explicit String(unsigned long long value, unsigned char base = 10) : s_(format(value, base)) {}
+    explicit String(float value, unsigned int decimals = 2) : s_(formatDouble(value, decimals)) {}
+    explicit String(double value, unsigned int decimals = 2) : s_(formatDouble(value, decimals)) {}
+
+    String &operator=(const String &) = default;
+    String &operator=(String &&) = default;
+    String &operator=(const char *cstr)
+    {
+        s_ = cstr ? cstr : "";
+        return *this;
+    }
+
+    bool reserve(unsigned int size)
+    {
+        s_.reserve(size);
+        return true;
+    }
+    unsigned int length() const { return (unsigned int)s_.size(); }
+    bool isEmpty() const { return s_.empty(); }
+    const char *c_str() const { return s_.c_str(); }
+    char *begin() { return &s_[0]; }
+    char *end() { return &s_[0] + s_.size(); }
+    const char *begin() const { return s_.c_str(); }
+    const char *end() const { return s_.c_str() + s_.size(); }
+
+    bool concat(const String &str)
+    {
+        s_ += str.s_;
+        return true;
+    }
+    bool concat(const char *cstr)
+    {
+        if (!cstr)
+            return false;
+        s_ += cstr;
+        return true;
+    }
+    bool concat(const char *cstr, unsigned int length)
+    {
+        if (!cstr)
+            return false;
+        s_.append(cstr, length);
+        return true;
+    }
+    bool concat(const uint8_t *data, unsigned int length) { return concat((const char *)data, length); }
+    bool concat(char c)
+    {
+        s_ += c;
+        return true;
+    }
+    bool concat(unsigned char value) { return concat(String(value)); }
+    bool concat(int value) { return concat(String(value)); }
+    bool concat(unsigned int value) { return concat(String(value)); }
+    bool concat(long value) { return concat(String(value)); }
+    bool concat(unsigned long value) { return concat(String(value)); }
+    bool concat(long long value) { return concat(String(value)); }
+    bool concat(unsigned long long value) { return concat(String(value)); }
+    bool concat(float value) { return concat(String(value)); }
+    bool concat(double value) { return concat(String(value)); }
+
+    template <typename T>
+    String &operator+=(const T &value)
+    {
+        concat(value);
+        return *this;
+    }
+
+    bool equals(const String &str) const { return s_ == str.s_; }
+    bool equals(const char *cstr) const { return s_ == (cstr ? cstr : ""); }
+    bool equalsIgnoreCase(const String &str) const
+    {
+        return s_.size() == str.s_.size() && strcasecmp(s_.c_str(), str.s_.c_str()) == 0;
+    }
+    bool operator==(const String &str) const { return s_ == str.s_; }
+    bool operator==(const char *cstr) const { return equals(cstr); }
+    bool operator!=(const String &str) const { return s_ != str.s_; }
+    bool operator!=(const char *cstr) const { return !equals(cstr); }
+    bool operator<(const String &str) const { return s_ < str.s_; }
+    int compareTo(const String &str) const { return s_.compare(str.s_); }
+    bool startsWith(const String &prefix) const { return s_.compare(0, prefix.s_.size(), prefix.s_) == 0; }
+    bool endsWith(const String &suffix) const
+    {
+        return s_.size() >= suffix.s_.size() && s_.compare(s_.size() - suffix.s_.size(), suffix.s_.size(), suffix.s_) == 0;
+    }
+
+    char charAt(unsigned int index) const { return index < s_.size() ? s_[index] : 0; }
+    void setCharAt(unsigned int index, char c)
+    {
+        if (index < s_.size())
+            s_[index] = c;
+    }
+    char operator[](unsigned int index) const { return charAt(index); }
+    char &operator[](unsigned int index)
+    {
+        static char dummy;
+        if (index >= s_.size())
+        {
+            dummy = 0;
+            return dummy;
+        }
+        return s_[index];
+    }
+    void getBytes(unsigned char *buffer, unsigned int size, unsigned int index = 0) const
+    {
+        if (!buffer || size == 0)
+            return;
+        size_t n = index < s_.size() ? std::min<size_t>(size - 1, s_.size() - index) : 0;
+        memcpy(buffer, s_.data() + index, n);
+        buffer[n] = 0;
+    }
+    void toCharArray(char *buffer, unsigned int size, unsigned int index = 0) const
+    {
+        getBytes((unsigned char *)buffer, size, index);
+    }
+
+    int indexOf(char c, unsigned int from = 0) const { return position(s_.find(c, from)); }
+    int indexOf(const String &str, unsigned int from = 0) const { return position(s_.find(str.s_, from)); }
+    int lastIndexOf(char c) const { return position(s_.rfind(c)); }
+    int lastIndexOf(const String &str) const { return position(s_.rfind(str.s_)); }
+    String substring(unsigned int from) const { return from < s_.size() ? String(s_.substr(from)) : String(); }
+    String substring(unsigned int from, unsigned int to) const
+    {
+        if (from > to)
+            std::swap(from, to);
+        if (from >= s_.size())
+            return String();
+        return String(s_.substr(from, std::min<size_t>(to, s_.size()) - from));
+    }
+
+    void replace(const String &find, const String &replacement)
+    {
+        if (find.s_.empty())
+            return;
+        size_t pos = 0;
+        while ((pos = s_.find(find.s_, pos)) != std::string::npos)
+        {
+            s_.replace(pos, find.s_.size(), replacement.s_);
+            pos += replacement.s_.size();
+        }
+    }
+    void remove(unsigned int index)
+    {
+        if (index < s_.size())
+            s_.erase(index);
+    }
+    void remove(unsigned int index, unsigned int count)
+    {
+        if (index < s_.size())
+            s_.erase(index, count);
+    }
+    void toLowerCase()
+    {
+        for (char &c : s_)
+            c = (char)tolower((unsigned char)c);
+    }
+    void toUpperCase()
+    {
+        for (char &c : s_)
+            c = (char)toupper((unsigned char)c);
+    }
+    void trim()
+    {
+        size_t first = 0;
+        while (first < s_.size() && isspace((unsigned char)s_[first]))
+            first++;
+        size_t last = s_.size();
+        while (last > first && isspace((unsigned char)s_[last - 1]))
+            last--;
+        s_ = s_.substr(first, last - first);
+    }
+    long toInt() const { return atol(s_.c_str()); }
+    float toFloat() const { return (float)atof(s_.c_str()); }
+    double toDouble() const { return atof(s_.c_str()); }
+
+    friend String operator+(const String &a, const String &b) { return String(a.s_ + b.s_); }
+    friend String operator+(const String &a, const char *b) { return String(a.s_ + (b ? b : "")); }
+    friend String operator+(const char *a, const String &b) { return String((a ? a : "") + b.s_); }
+    friend String operator+(const String &a, char b) { return String(a.s_ + b); }
+    template <typename T, typename = typename std::enable_if<std::is_arithmetic<T>::value && !std::is_same<T, char>::value>::type>
+    friend String operator+(const String &a, T b)
+    {
+        String out(a);
+        out.concat(b);
+        return out;
+    }
+
+private:
+    static int position(size_t pos) { return pos == std::string::npos ? -1 : (int)pos; }
+    static std::string format(unsigned long long value, unsigned char base)
+    {
+        if (base < 2 || base > 36)
+            base = 10;
+        char buffer[66];
+        char *p = buffer + sizeof(buffer) - 1;
+        *p = 0;
+        do
+        {
+            unsigned digit = (unsigned)(value % base);
+            *--p = (char)(digit < 10 ? '0' + digit : 'a' + digit - 10);
+            value /= base;
+        } while (value);
+        return p;
+    }
+    static std::string formatSigned(long long value, unsigned char base)
+    {
+        if (value < 0 && base == 10)
+            return "-" + format(0ULL - (unsigned long long)value, base);
+        return format((unsigned long long)value, base);
+    }
+    static std::string formatDouble(double value, unsigned int decimals)
+    {
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), "%.*f", (int)decimals, value);
+        return buffer;
+    }
+
+    std::string s_;
+};
+
+class Stream : public Print
+{
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    virtual void flush() {}
+    virtual size_t readBytes(char *buffer, size_t length)
+    {
+        size_t n = 0;
+        for (; n < length; ++n)
+        {
+            int c = read();
+            if (c < 0)
+                break;
+            buffer[n] = (char)c;
+        }
+        return n;
+    }
+    size_t readBytes(uint8_t *buffer, size_t length) { return readBytes((char *)buffer, length); }
+    void setTimeout(unsigned long timeoutMs) { timeoutMs_ = timeoutMs; }
+
+protected:
+    unsigned long timeoutMs_ = 1000;
+};
+
+// Console output; silent unless X402_HOST_VERBOSE is set, so test output
+// stays readable
+class HardwareSerial : public Stream
+{
+public:
+    using Print::write;
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    void begin(unsigned long) {}
+    operator bool() const { return true; }
+};
+extern HardwareSerial Serial;
+
+struct EspClass
+{
+    uint32_t getFreeHeap();
+    uint32_t getMinFreeHeap();
+    uint32_t getMaxAllocHeap();
+    uint32_t getHeapSize();
+    uint32_t getCycleCount();
+    void restart();
+};
+extern EspClass ESP;
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_system.h"
@@ -0,0 +1,94 @@
+#pragma once
+
+// Host stand-in for the ESP32 HTTPClient. Requests never leave the process:
+// they are answered by the stand-in servers registered with hoststub::serve().
+// Keep-alive, timeouts and redirects behave like the ESP32 client: a reused
+// socket keeps talking to the host it was opened to, sendRequest() with a
+// Stream body does not follow redirects, and POST() does when asked to.
+
+#include <Arduino.h>
+#include <WiFiClientSecure.h>
+#include <vector>
+#include <utility>
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_NOT_CONNECTED (-4)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_NO_STREAM (-6)
+#define HTTPC_ERROR_NO_HTTP_SERVER (-7)
+#define HTTPC_ERROR_TOO_LESS_RAM (-8)
+#define HTTPC_ERROR_ENCODING (-9)
+#define HTTPC_ERROR_STREAM_WRITE (-10)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+#define HTTP_CODE_OK 200
+#define HTTP_CODE_MOVED_PERMANENTLY 301
+#define HTTP_CODE_FOUND 302
+#define HTTP_CODE_SEE_OTHER 303
+#define HTTP_CODE_TEMPORARY_REDIRECT 307
+#define HTTP_CODE_PERMANENT_REDIRECT 308
+
+typedef enum
+{
+    HTTPC_DISABLE_FOLLOW_REDIRECTS,
+    HTTPC_STRICT_FOLLOW_REDIRECTS,
+    HTTPC_FORCE_FOLLOW_REDIRECTS
+} followRedirects_t;
+
+class HTTPClient
+{
+public:
+    HTTPClient() {}
+    ~HTTPClient();
+
+    bool begin(String url);
+    bool begin(WiFiClient &client, String url);
+    void end();
+
+    void setReuse(bool reuse) { reuse_ = reuse; }
+    void setFollowRedirects(followRedirects_t follow) { follow_ = follow; }
+    void setRedirectLimit(uint16_t limit) { redirectLimit_ = limit; }
+    void setTimeout(uint16_t timeoutMs) { timeoutMs_ = timeoutMs; }
+    void setConnectTimeout(int32_t) {}
+    void addHeader(const String &name, const String &value, bool first = false, bool replace = true);
+    void collectHeaders(const char *headerKeys[], const size_t headerKeysCount);
+    String header(const char *name);
+    bool hasHeader(const char *name);
+    String getLocation() { return location_; }
+
+    int GET();
+    int POST(String payload);
+    int POST(uint8_t *payload, size_t size);
+    int sendRequest(const char *type, String payload);
+    int sendRequest(const char *type, uint8_t *payload = nullptr, size_t size = 0);
+    int sendRequest(const char *type, Stream *stream, size_t size = 0);
+
+    int getSize() { return (int)body_.size(); }
+    String getString();
+    WiFiClient &getStream() { return *client_; }
+    WiFiClient *getStreamPtr() { return client_; }
+    int writeToStream(Stream *stream);
+    bool connected() { return client_ && client_->connected(); }
+
+    static String errorToString(int error);
+
+private:
+    int perform(const char *type, const std::string &body, bool followRedirects);
+    int exchange(const char *type, const std::string &body);
+
+    WiFiClient ownClient_;
+    WiFiClient *client_ = nullptr;
+    std::string url_;
+    bool reuse_ = true;
+    followRedirects_t follow_ = HTTPC_DISABLE_FOLLOW_REDIRECTS;
+    uint16_t redirectLimit_ = 10;
+    uint16_t timeoutMs_ = 5000;
+    std::vector<std::pair<std::string, std::string>> requestHeaders_;
+    std::vector<std::pair<std::string, std::string>> responseHeaders_;
+    std::string body_;
+    size_t chunkSize_ = 0;
+    bool closeAfter_ = false;
+    String location_;
+};
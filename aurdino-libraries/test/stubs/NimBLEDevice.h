@@ -0,0 +1,195 @@
+#pragma once
+
+// Host stand-in for the NimBLE-Arduino 2.x server API. There is no radio:
+// tests write to characteristics through hoststub::bleWrite() and read back
+// what the device notified from NimBLECharacteristic::sent().
+
+#include <Arduino.h>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define BLE_HS_CONN_HANDLE_NONE 0xffff
+#define BLE_ATT_MTU_DFLT 23
+#define BLE_ATT_MTU_MAX 527
+#define BLE_GAP_LE_PHY_1M_MASK 0x01
+#define BLE_GAP_LE_PHY_2M_MASK 0x02
+#define BLE_GAP_LE_PHY_CODED_MASK 0x04
+#define BLE_GAP_LE_PHY_ANY_MASK 0x0F
+
+namespace NIMBLE_PROPERTY
+{
+enum
+{
+    READ = 0x0002,
+    WRITE_NR = 0x0004,
+    WRITE = 0x0008,
+    NOTIFY = 0x0010,
+    INDICATE = 0x0020,
+};
+}
+
+class NimBLEAttValue
+{
+public:
+    NimBLEAttValue() {}
+    NimBLEAttValue(const uint8_t *data, size_t length) : value_((const char *)data, length) {}
+    const uint8_t *data() const { return (const uint8_t *)value_.data(); }
+    size_t size() const { return value_.size(); }
+    size_t length() const { return value_.size(); }
+    const char *c_str() const { return value_.c_str(); }
+    operator std::string() const { return value_; }
+
+private:
+    std::string value_;
+};
+
+class NimBLEConnInfo
+{
+public:
+    explicit NimBLEConnInfo(uint16_t connHandle = 0, uint16_t mtu = BLE_ATT_MTU_DFLT)
+        : connHandle_(connHandle), mtu_(mtu) {}
+    uint16_t getConnHandle() const { return connHandle_; }
+    uint16_t getMTU() const { return mtu_; }
+
+private:
+    uint16_t connHandle_;
+    uint16_t mtu_;
+};
+
+class NimBLECharacteristic;
+
+class NimBLECharacteristicCallbacks
+{
+public:
+    virtual ~NimBLECharacteristicCallbacks() {}
+    virtual void onRead(NimBLECharacteristic *, NimBLEConnInfo &) {}
+    virtual void onWrite(NimBLECharacteristic *, NimBLEConnInfo &) {}
+    virtual void onStatus(NimBLECharacteristic *, int) {}
+    virtual void onSubscribe(NimBLECharacteristic *, NimBLEConnInfo &, uint16_t) {}
+};
+
+// One notification as it went on air
+struct NimBLENotification
+{
+    uint16_t connHandle;
+    std::string data;
+};
+
+class NimBLECharacteristic
+{
+public:
+    explicit NimBLECharacteristic(const char *uuid = "", uint32_t properties = 0)
+        : uuid_(uuid ? uuid : ""), properties_(properties) {}
+
+    NimBLEAttValue getValue();
+    void setValue(const uint8_t *data, size_t length);
+    void setValue(const std::string &value) { setValue((const uint8_t *)value.data(), value.size()); }
+    void setCallbacks(NimBLECharacteristicCallbacks *callbacks) { callbacks_ = callbacks; }
+    NimBLECharacteristicCallbacks *getCallbacks() const { return callbacks_; }
+
+    bool notify(uint16_t connHandle = BLE_HS_CONN_HANDLE_NONE);
+    bool notify(const uint8_t *data, size_t length, uint16_t connHandle = BLE_HS_CONN_HANDLE_NONE);
+    bool notify(const std::string &value, uint16_t connHandle = BLE_HS_CONN_HANDLE_NONE)
+    {
+        return notify((const uint8_t *)value.data(), value.size(), connHandle);
+    }
+
+    // Test side: everything notified so far, oldest first (and cleared)
+    std::vector<NimBLENotification> sent(bool clear = true);
+    // Test side: wait until at least count notifications are waiting in
+    // sent(); false on timeout
+    bool waitForSent(size_t count, uint32_t timeoutMs = 5000);
+    // Test side: fail the next n notifications, as a full mbuf pool would
+    void failNotifies(uint32_t count);
+
+private:
+    std::string uuid_;
+    uint32_t properties_;
+    std::string value_;
+    NimBLECharacteristicCallbacks *callbacks_ = nullptr;
+    std::vector<NimBLENotification> sent_;
+    uint32_t failNext_ = 0;
+    std::mutex lock_;
+    std::condition_variable sentCv_;
+};
+
+class NimBLEService
+{
+public:
+    NimBLECharacteristic *createCharacteristic(const char *uuid, uint32_t properties = 0, uint16_t maxLength = 512);
+    NimBLECharacteristic *getCharacteristic(const char *uuid);
+    bool start() { return true; }
+
+private:
+    std::vector<NimBLECharacteristic *> characteristics_;
+    std::vector<std::string> uuids_;
+};
+
+class NimBLEServer;
+
+class NimBLEServerCallbacks
+{
+public:
+    virtual ~NimBLEServerCallbacks() {}
+    virtual void onConnect(NimBLEServer *, NimBLEConnInfo &) {}
+    virtual void onDisconnect(NimBLEServer *, NimBLEConnInfo &, int) {}
+    virtual void onMTUChange(uint16_t, NimBLEConnInfo &) {}
+};
+
+class NimBLEServer
+{
+public:
+    void setCallbacks(NimBLEServerCallbacks *callbacks, bool deleteCallbacks = true);
+    NimBLEServerCallbacks *getCallbacks() const { return callbacks_; }
+    NimBLEService *createService(const char *uuid);
+    NimBLEService *getServiceByUUID(const char *uuid);
+    uint16_t getPeerMTU(uint16_t connHandle);
+    size_t getConnectedCount();
+    bool setDataLen(uint16_t connHandle, uint16_t octets);
+    bool updatePhy(uint16_t connHandle, uint8_t txPhy, uint8_t rxPhy, uint16_t options);
+
+    // Test side: simulated centrals
+    void connect(uint16_t connHandle, uint16_t mtu);
+    void disconnect(uint16_t connHandle, int reason = 0x13);
+
+private:
+    NimBLEServerCallbacks *callbacks_ = nullptr;
+    std::vector<NimBLEService *> services_;
+    std::vector<std::string> serviceUuids_;
+    std::vector<std::pair<uint16_t, uint16_t>> peers_; // handle, MTU
+};
+
+class NimBLEAdvertising
+{
+public:
+    bool start() { return advertising_ = true; }
+    bool stop()
+    {
+        advertising_ = false;
+        return true;
+    }
+    bool addServiceUUID(const char *) { return true; }
+    bool isAdvertising() const { return advertising_; }
+
+private:
+    bool advertising_ = false;
+};
+
+class NimBLEDevice
+{
+public:
+    static bool init(const std::string &deviceName);
+    static bool deinit(bool clearAll = false);
+    static bool setDeviceName(const std::string &deviceName);
+    static bool setPower(int dbm);
+    static void setSecurityAuth(bool bonding, bool mitm, bool sc);
+    static bool setMTU(uint16_t mtu);
+    static uint16_t getMTU();
+    static NimBLEServer *createServer();
+    static NimBLEServer *getServer();
+    static NimBLEAdvertising *getAdvertising();
+    static bool startAdvertising(uint32_t durationMs = 0);
+    static bool stopAdvertising();
+};
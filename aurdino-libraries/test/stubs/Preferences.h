@@ -0,0 +1,26 @@
+#pragma once
+
+#include <Arduino.h>
+
+// NVS stand-in: namespaces live in process memory until hoststub::clearPreferences()
+class Preferences
+{
+public:
+    bool begin(const char *name, bool readOnly = false);
+    void end();
+    bool clear();
+    bool remove(const char *key);
+    bool isKey(const char *key);
+    size_t putBytes(const char *key, const void *value, size_t length);
+    size_t getBytes(const char *key, void *buffer, size_t maxLength);
+    size_t getBytesLength(const char *key);
+    size_t putUInt(const char *key, uint32_t value);
+    uint32_t getUInt(const char *key, uint32_t defaultValue = 0);
+    size_t putString(const char *key, const String &value);
+    String getString(const char *key, const String &defaultValue = String());
+
+private:
+    std::string name_;
+    bool open_ = false;
+    bool readOnly_ = false;
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <Arduino.h>
+
+typedef enum
+{
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_SCAN_COMPLETED = 2,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_CONNECTION_LOST = 5,
+    WL_DISCONNECTED = 6,
+} wl_status_t;
+
+class IPAddress
+{
+public:
+    String toString() const { return "127.0.0.1"; }
+};
+
+// Link state is set by the test (hoststub::setWiFiStatus)
+class WiFiClass
+{
+public:
+    wl_status_t status();
+    wl_status_t begin(const char *ssid, const char *passphrase = nullptr);
+    bool disconnect(bool wifiOff = false);
+    IPAddress localIP() { return IPAddress(); }
+};
+extern WiFiClass WiFi;
+
+// A socket to one of the in-process stand-in servers (see hoststub.h)
+class WiFiClient : public Stream
+{
+public:
+    using Print::write;
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *, size_t size) override { return connected() ? size : 0; }
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    virtual void stop();
+    virtual uint8_t connected() { return connected_; }
+    void setNoDelay(bool) {}
+
+    // Stand-in bookkeeping, used by HTTPClient
+    bool connected_ = false;
+    std::string origin_;
+    uint32_t generation_ = 0;
+};
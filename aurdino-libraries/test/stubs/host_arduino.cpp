@@ -0,0 +1,319 @@
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include "hoststub.h"
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <malloc.h>
+#include <new>
+#include <random>
+#include <thread>
+
+HardwareSerial Serial;
+EspClass ESP;
+
+// ---------------------------------------------------------------------------
+// Heap accounting. operator new is replaced here; the malloc family is
+// wrapped at link time (-Wl,--wrap=malloc,...) for code built with the stubs.
+
+// What the stand-in device reports as its heap
+#define HOST_HEAP_SIZE (320u * 1024u)
+
+static std::atomic<size_t> heapCurrent{0};
+static std::atomic<size_t> heapPeak{0};
+static std::atomic<uint64_t> heapAllocations{0};
+
+extern "C" void *__real_malloc(size_t size);
+extern "C" void *__real_calloc(size_t count, size_t size);
+extern "C" void *__real_realloc(void *ptr, size_t size);
+extern "C" void __real_free(void *ptr);
+
+static void noteAlloc(void *ptr)
+{
+    if (!ptr)
+        return;
+    size_t now = heapCurrent.fetch_add(malloc_usable_size(ptr)) + malloc_usable_size(ptr);
+    size_t peak = heapPeak.load();
+    while (now > peak && !heapPeak.compare_exchange_weak(peak, now))
+    {
+    }
+    heapAllocations++;
+}
+
+static void noteFree(void *ptr)
+{
+    if (ptr)
+        heapCurrent.fetch_sub(malloc_usable_size(ptr));
+}
+
+extern "C" void *__wrap_malloc(size_t size)
+{
+    void *ptr = __real_malloc(size);
+    noteAlloc(ptr);
+    return ptr;
+}
+
+extern "C" void *__wrap_calloc(size_t count, size_t size)
+{
+    void *ptr = __real_calloc(count, size);
+    noteAlloc(ptr);
+    return ptr;
+}
+
+extern "C" void *__wrap_realloc(void *ptr, size_t size)
+{
+    size_t before = ptr ? malloc_usable_size(ptr) : 0;
+    void *out = __real_realloc(ptr, size);
+    if (out || size == 0)
+    {
+        heapCurrent.fetch_sub(before);
+        noteAlloc(out);
+    }
+    return out;
+}
+
+extern "C" void __wrap_free(void *ptr)
+{
+    noteFree(ptr);
+    __real_free(ptr);
+}
+
+void *operator new(size_t size)
+{
+    void *ptr = __real_malloc(size ? size : 1);
+    if (!ptr)
+        throw std::bad_alloc();
+    noteAlloc(ptr);
+    return ptr;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    void *ptr = __real_malloc(size ? size : 1);
+    noteAlloc(ptr);
+    return ptr;
+}
+
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    noteFree(ptr);
+    __real_free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    operator delete(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+namespace hoststub
+{
+
+HeapStats heapStats()
+{
+    return HeapStats{heapCurrent.load(), heapPeak.load(), heapAllocations.load()};
+}
+
+void resetHeapPeak()
+{
+    heapPeak.store(heapCurrent.load());
+}
+
+} // namespace hoststub
+
+void heap_caps_get_info(multi_heap_info_t *info, uint32_t)
+{
+    memset(info, 0, sizeof(*info));
+    size_t used = heapCurrent.load();
+    info->total_allocated_bytes = used;
+    info->total_free_bytes = HOST_HEAP_SIZE > used ? HOST_HEAP_SIZE - used : 0;
+    info->largest_free_block = info->total_free_bytes;
+    info->minimum_free_bytes = HOST_HEAP_SIZE > heapPeak.load() ? HOST_HEAP_SIZE - heapPeak.load() : 0;
+    info->allocated_blocks = (size_t)heapAllocations.load();
+}
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, caps);
+    return info.total_free_bytes;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+    return heap_caps_get_free_size(caps);
+}
+
+uint32_t EspClass::getFreeHeap() { return (uint32_t)heap_caps_get_free_size(0); }
+uint32_t EspClass::getMinFreeHeap()
+{
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, 0);
+    return (uint32_t)info.minimum_free_bytes;
+}
+uint32_t EspClass::getMaxAllocHeap() { return getFreeHeap(); }
+uint32_t EspClass::getHeapSize() { return HOST_HEAP_SIZE; }
+uint32_t EspClass::getCycleCount() { return (uint32_t)(micros() * 240u); }
+void EspClass::restart() { abort(); }
+
+// ---------------------------------------------------------------------------
+// Time
+
+static const auto startTime = std::chrono::steady_clock::now();
+static std::atomic<int64_t> timerOverride{-1};
+
+unsigned long millis()
+{
+    return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now() - startTime)
+        .count();
+}
+
+unsigned long micros()
+{
+    return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now() - startTime)
+        .count();
+}
+
+void delay(unsigned long ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void yield()
+{
+    std::this_thread::yield();
+}
+
+int64_t esp_timer_get_time()
+{
+    int64_t pinned = timerOverride.load();
+    return pinned >= 0 ? pinned : (int64_t)micros();
+}
+
+namespace hoststub
+{
+
+void setTimerNow(int64_t us)
+{
+    timerOverride.store(us);
+}
+
+} // namespace hoststub
+
+uint32_t esp_random()
+{
+    static thread_local std::mt19937 generator(std::random_device{}());
+    return generator();
+}
+
+void esp_restart()
+{
+    abort();
+}
+
+// ---------------------------------------------------------------------------
+// Print / Serial
+
+static bool verbose()
+{
+    static const bool on = getenv("X402_HOST_VERBOSE") != nullptr;
+    return on;
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+    if (verbose())
+        fwrite(buffer, 1, size, stdout);
+    return size;
+}
+
+static size_t printFormatted(Print &out, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+static size_t printFormatted(Print &out, const char *format, ...)
+{
+    char buffer[64];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    return n > 0 ? out.write((const uint8_t *)buffer, strlen(buffer)) : 0;
+}
+
+static size_t printNumber(Print &out, unsigned long long value, int base, bool negative)
+{
+    String digits(value, (unsigned char)base);
+    size_t n = negative ? out.write((uint8_t)'-') : 0;
+    return n + out.write(digits.c_str(), digits.length());
+}
+
+size_t Print::print(const char *str) { return write(str); }
+size_t Print::print(const String &str) { return write(str.c_str(), str.length()); }
+size_t Print::print(char c) { return write((uint8_t)c); }
+size_t Print::print(int value, int base) { return print((long long)value, base); }
+size_t Print::print(unsigned int value, int base) { return print((unsigned long long)value, base); }
+size_t Print::print(long value, int base) { return print((long long)value, base); }
+size_t Print::print(unsigned long value, int base) { return print((unsigned long long)value, base); }
+size_t Print::print(long long value, int base)
+{
+    if (value < 0 && base == 10)
+        return printNumber(*this, 0ULL - (unsigned long long)value, base, true);
+    return printNumber(*this, (unsigned long long)value, base, false);
+}
+size_t Print::print(unsigned long long value, int base) { return printNumber(*this, value, base, false); }
+size_t Print::print(double value, int digits) { return printFormatted(*this, "%.*f", digits, value); }
+size_t Print::println() { return write("\r\n"); }
+size_t Print::println(const char *str) { return print(str) + println(); }
+size_t Print::println(const String &str) { return print(str) + println(); }
+size_t Print::println(char c) { return print(c) + println(); }
+size_t Print::println(int value, int base) { return print(value, base) + println(); }
+size_t Print::println(unsigned int value, int base) { return print(value, base) + println(); }
+size_t Print::println(long value, int base) { return print(value, base) + println(); }
+size_t Print::println(unsigned long value, int base) { return print(value, base) + println(); }
+size_t Print::println(long long value, int base) { return print(value, base) + println(); }
+size_t Print::println(unsigned long long value, int base) { return print(value, base) + println(); }
+size_t Print::println(double value, int digits) { return print(value, digits) + println(); }
+
+size_t Print::printf(const char *format, ...)
+{
+    char small[128];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(small, sizeof(small), format, args);
+    va_end(args);
+    if (n < 0)
+        return 0;
+    if ((size_t)n < sizeof(small))
+        return write((const uint8_t *)small, (size_t)n);
+
+    std::string big((size_t)n + 1, '\0');
+    va_start(args, format);
+    vsnprintf(&big[0], big.size(), format, args);
+    va_end(args);
+    return write((const uint8_t *)big.data(), (size_t)n);
+}
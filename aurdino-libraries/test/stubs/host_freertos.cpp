@@ -0,0 +1,430 @@
+#include <Arduino.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <pthread.h>
+#include <thread>
+#include <vector>
+
+// ---------------------------------------------------------------------------
+// Critical sections: interrupts off on the device, one process-wide lock here
+
+static std::recursive_mutex &criticalLock()
+{
+    static std::recursive_mutex lock;
+    return lock;
+}
+
+void portENTER_CRITICAL(portMUX_TYPE *mux)
+{
+    criticalLock().lock();
+    mux->count++;
+}
+
+void portEXIT_CRITICAL(portMUX_TYPE *mux)
+{
+    mux->count--;
+    criticalLock().unlock();
+}
+
+// Waits take ticks (ms); portMAX_DELAY waits forever
+template <typename Predicate>
+static bool waitFor(std::condition_variable &cv, std::unique_lock<std::mutex> &lock, TickType_t ticks, Predicate ready)
+{
+    if (ticks == portMAX_DELAY)
+    {
+        cv.wait(lock, ready);
+        return true;
+    }
+    return cv.wait_for(lock, std::chrono::milliseconds(ticks), ready);
+}
+
+// ---------------------------------------------------------------------------
+// Tasks
+
+struct HostTask
+{
+    HostTask(const char *taskName, TaskFunction_t taskFunction, void *taskArg)
+        : name(taskName), function(taskFunction), arg(taskArg) {}
+
+    std::string name;
+    TaskFunction_t function;
+    void *arg;
+    std::mutex lock;
+    std::condition_variable cv;
+    uint32_t notifications = 0;
+};
+
+static thread_local HostTask *currentTask = nullptr;
+
+static HostTask *mainTask()
+{
+    static HostTask task("loopTask", nullptr, nullptr);
+    return &task;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t, void *arg,
+                                   UBaseType_t, TaskHandle_t *handle, BaseType_t)
+{
+    HostTask *task = new HostTask(name ? name : "", function, arg);
+    if (handle)
+        *handle = task;
+    // Tasks never return on the device; they live until the process exits
+    std::thread([task]() {
+        currentTask = task;
+        task->function(task->arg);
+    }).detach();
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stackDepth, void *arg,
+                       UBaseType_t priority, TaskHandle_t *handle)
+{
+    return xTaskCreatePinnedToCore(function, name, stackDepth, arg, priority, handle, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task == nullptr || task == currentTask)
+        pthread_exit(nullptr);
+    // Deleting another task is not supported by the stand-in; it keeps running
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+TickType_t xTaskGetTickCount()
+{
+    return (TickType_t)millis();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+    return currentTask ? currentTask : mainTask();
+}
+
+const char *pcTaskGetName(TaskHandle_t task)
+{
+    task = task ? task : xTaskGetCurrentTaskHandle();
+    return task->name.c_str();
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t)
+{
+    // Host threads have megabytes of stack
+    return 4096;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    std::lock_guard<std::mutex> guard(task->lock);
+    task->notifications++;
+    task->cv.notify_all();
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks)
+{
+    HostTask *task = xTaskGetCurrentTaskHandle();
+    std::unique_lock<std::mutex> lock(task->lock);
+    waitFor(task->cv, lock, ticks, [task]() { return task->notifications > 0; });
+    uint32_t value = task->notifications;
+    if (value)
+        task->notifications = clearOnExit ? 0 : value - 1;
+    return value;
+}
+
+// ---------------------------------------------------------------------------
+// Queues
+
+struct HostQueue
+{
+    size_t length;
+    size_t itemSize;
+    std::deque<std::vector<uint8_t>> items;
+    std::mutex lock;
+    std::condition_variable cv;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize)
+{
+    if (length == 0)
+        return nullptr;
+    HostQueue *queue = new HostQueue();
+    queue->length = length;
+    queue->itemSize = itemSize;
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    delete queue;
+}
+
+static BaseType_t queueSend(QueueHandle_t queue, const void *item, TickType_t ticks, bool front)
+{
+    std::unique_lock<std::mutex> lock(queue->lock);
+    if (!waitFor(queue->cv, lock, ticks, [queue]() { return queue->items.size() < queue->length; }))
+        return pdFALSE;
+    const uint8_t *bytes = (const uint8_t *)item;
+    std::vector<uint8_t> copy(bytes, bytes + queue->itemSize);
+    if (front)
+        queue->items.push_front(std::move(copy));
+    else
+        queue->items.push_back(std::move(copy));
+    queue->cv.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    return queueSend(queue, item, ticks, false);
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    return queueSend(queue, item, ticks, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    return queueSend(queue, item, ticks, true);
+}
+
+static BaseType_t queueTake(QueueHandle_t queue, void *item, TickType_t ticks, bool remove)
+{
+    std::unique_lock<std::mutex> lock(queue->lock);
+    if (!waitFor(queue->cv, lock, ticks, [queue]() { return !queue->items.empty(); }))
+        return pdFALSE;
+    memcpy(item, queue->items.front().data(), queue->itemSize);
+    if (remove)
+    {
+        queue->items.pop_front();
+        queue->cv.notify_all();
+    }
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    return queueTake(queue, item, ticks, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    return queueTake(queue, item, ticks, false);
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue)
+{
+    std::lock_guard<std::mutex> guard(queue->lock);
+    queue->items.clear();
+    queue->cv.notify_all();
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    std::lock_guard<std::mutex> guard(queue->lock);
+    return (UBaseType_t)queue->items.size();
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue)
+{
+    std::lock_guard<std::mutex> guard(queue->lock);
+    return (UBaseType_t)(queue->length - queue->items.size());
+}
+
+// ---------------------------------------------------------------------------
+// Semaphores and mutexes
+
+struct HostSemaphore
+{
+    enum Kind
+    {
+        COUNTING,
+        MUTEX,
+        RECURSIVE
+    } kind;
+    UBaseType_t count;
+    UBaseType_t maxCount;
+    std::thread::id owner;
+    uint32_t depth = 0;
+    std::mutex lock;
+    std::condition_variable cv;
+};
+
+static SemaphoreHandle_t createSemaphore(HostSemaphore::Kind kind, UBaseType_t maxCount, UBaseType_t count)
+{
+    HostSemaphore *semaphore = new HostSemaphore();
+    semaphore->kind = kind;
+    semaphore->maxCount = maxCount;
+    semaphore->count = count;
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary()
+{
+    return createSemaphore(HostSemaphore::COUNTING, 1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount)
+{
+    return createSemaphore(HostSemaphore::COUNTING, maxCount, initialCount);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+    return createSemaphore(HostSemaphore::MUTEX, 1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex()
+{
+    return createSemaphore(HostSemaphore::RECURSIVE, 1, 1);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore)
+{
+    delete semaphore;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks)
+{
+    std::unique_lock<std::mutex> lock(semaphore->lock);
+    if (!waitFor(semaphore->cv, lock, ticks, [semaphore]() { return semaphore->count > 0; }))
+        return pdFALSE;
+    semaphore->count--;
+    semaphore->owner = std::this_thread::get_id();
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    std::lock_guard<std::mutex> guard(semaphore->lock);
+    if (semaphore->count >= semaphore->maxCount)
+        return pdFALSE;
+    semaphore->count++;
+    semaphore->cv.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t semaphore, TickType_t ticks)
+{
+    std::unique_lock<std::mutex> lock(semaphore->lock);
+    std::thread::id self = std::this_thread::get_id();
+    if (semaphore->depth > 0 && semaphore->owner == self)
+    {
+        semaphore->depth++;
+        return pdTRUE;
+    }
+    if (!waitFor(semaphore->cv, lock, ticks, [semaphore]() { return semaphore->depth == 0; }))
+        return pdFALSE;
+    semaphore->owner = self;
+    semaphore->depth = 1;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t semaphore)
+{
+    std::lock_guard<std::mutex> guard(semaphore->lock);
+    if (semaphore->depth == 0 || semaphore->owner != std::this_thread::get_id())
+        return pdFALSE;
+    if (--semaphore->depth == 0)
+        semaphore->cv.notify_all();
+    return pdTRUE;
+}
+
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t semaphore)
+{
+    std::lock_guard<std::mutex> guard(semaphore->lock);
+    return semaphore->count;
+}
+
+// ---------------------------------------------------------------------------
+// esp_timer: one thread per started timer
+
+struct esp_timer
+{
+    esp_timer_cb_t callback;
+    void *arg;
+    std::mutex lock;
+    std::condition_variable cv;
+    uint32_t generation = 0;
+    bool running = false;
+};
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out)
+{
+    if (!args || !args->callback || !out)
+        return ESP_FAIL;
+    esp_timer *timer = new esp_timer();
+    timer->callback = args->callback;
+    timer->arg = args->arg;
+    *out = timer;
+    return ESP_OK;
+}
+
+static esp_err_t startTimer(esp_timer_handle_t timer, uint64_t periodUs, bool periodic)
+{
+    std::lock_guard<std::mutex> guard(timer->lock);
+    if (timer->running)
+        return ESP_FAIL;
+    timer->running = true;
+    uint32_t generation = ++timer->generation;
+    std::thread([timer, periodUs, periodic, generation]() {
+        std::unique_lock<std::mutex> lock(timer->lock);
+        for (;;)
+        {
+            auto due = std::chrono::steady_clock::now() + std::chrono::microseconds(periodUs);
+            if (timer->cv.wait_until(lock, due, [&]() { return timer->generation != generation; }))
+                return; // stopped or restarted
+            lock.unlock();
+            timer->callback(timer->arg);
+            lock.lock();
+            if (!periodic)
+            {
+                if (timer->generation == generation)
+                    timer->running = false;
+                return;
+            }
+        }
+    }).detach();
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t periodUs)
+{
+    return startTimer(timer, periodUs, true);
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeoutUs)
+{
+    return startTimer(timer, timeoutUs, false);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    std::lock_guard<std::mutex> guard(timer->lock);
+    if (!timer->running)
+        return ESP_FAIL;
+    timer->running = false;
+    timer->generation++;
+    timer->cv.notify_all();
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    {
+        std::lock_guard<std::mutex> guard(timer->lock);
+        if (timer->running)
+            return ESP_FAIL;
+    }
+    // The timer thread may still be waking up from its last wait; leak
+    // rather than race it
+    return ESP_OK;
+}
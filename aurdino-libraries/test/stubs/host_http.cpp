@@ -0,0 +1,412 @@
+#include <HTTPClient.h>
+#include <WiFi.h>
+#include "hoststub.h"
+#include <map>
+#include <memory>
+#include <mutex>
+
+WiFiClass WiFi;
+
+static wl_status_t wifiStatus = WL_CONNECTED;
+
+wl_status_t WiFiClass::status() { return wifiStatus; }
+wl_status_t WiFiClass::begin(const char *, const char *) { return wifiStatus; }
+bool WiFiClass::disconnect(bool)
+{
+    wifiStatus = WL_DISCONNECTED;
+    return true;
+}
+
+void WiFiClient::stop()
+{
+    connected_ = false;
+}
+
+// ---------------------------------------------------------------------------
+// Stand-in servers
+
+struct StandInServer
+{
+    hoststub::HttpHandler handler;
+    uint32_t generation = 1; // sockets opened before a drop are dead
+    int dropError = HTTPC_ERROR_CONNECTION_LOST;
+    uint32_t handshakeMs = 0;
+    hoststub::ServerStats stats = {0, 0};
+};
+
+static std::mutex serversLock;
+static std::map<std::string, std::shared_ptr<StandInServer>> servers;
+
+static std::shared_ptr<StandInServer> findServer(const std::string &origin)
+{
+    std::lock_guard<std::mutex> guard(serversLock);
+    auto it = servers.find(origin);
+    return it == servers.end() ? nullptr : it->second;
+}
+
+namespace hoststub
+{
+
+void setWiFiStatus(wl_status_t status)
+{
+    wifiStatus = status;
+}
+
+void serve(const std::string &origin, HttpHandler handler)
+{
+    std::lock_guard<std::mutex> guard(serversLock);
+    std::shared_ptr<StandInServer> &server = servers[origin];
+    if (!server)
+        server = std::make_shared<StandInServer>();
+    server->handler = handler;
+}
+
+void stopServing(const std::string &origin)
+{
+    std::lock_guard<std::mutex> guard(serversLock);
+    servers.erase(origin);
+}
+
+void stopAllServers()
+{
+    std::lock_guard<std::mutex> guard(serversLock);
+    servers.clear();
+}
+
+void dropConnections(const std::string &origin, int error)
+{
+    std::lock_guard<std::mutex> guard(serversLock);
+    auto it = servers.find(origin);
+    if (it != servers.end())
+    {
+        it->second->generation++;
+        it->second->dropError = error;
+    }
+}
+
+void setHandshakeDelay(const std::string &origin, uint32_t ms)
+{
+    std::lock_guard<std::mutex> guard(serversLock);
+    auto it = servers.find(origin);
+    if (it != servers.end())
+        it->second->handshakeMs = ms;
+}
+
+ServerStats serverStats(const std::string &origin)
+{
+    std::lock_guard<std::mutex> guard(serversLock);
+    auto it = servers.find(origin);
+    return it == servers.end() ? ServerStats{0, 0} : it->second->stats;
+}
+
+} // namespace hoststub
+
+// "https://host:port/path" -> origin "https://host:port", path "/path"
+static bool splitUrl(const std::string &url, std::string &origin, std::string &path)
+{
+    size_t scheme = url.find("://");
+    if (scheme == std::string::npos)
+        return false;
+    size_t slash = url.find('/', scheme + 3);
+    origin = url.substr(0, slash);
+    path = slash == std::string::npos ? "/" : url.substr(slash);
+    return origin.size() > scheme + 3;
+}
+
+static bool sameName(const std::string &a, const char *b)
+{
+    return strcasecmp(a.c_str(), b) == 0;
+}
+
+// ---------------------------------------------------------------------------
+// HTTPClient
+
+HTTPClient::~HTTPClient()
+{
+    if (client_ == &ownClient_)
+        ownClient_.stop();
+}
+
+bool HTTPClient::begin(String url)
+{
+    return begin(ownClient_, url);
+}
+
+bool HTTPClient::begin(WiFiClient &client, String url)
+{
+    std::string origin, path;
+    if (!splitUrl(url.c_str(), origin, path))
+        return false;
+    client_ = &client;
+    url_ = url.c_str();
+    requestHeaders_.clear();
+    return true;
+}
+
+void HTTPClient::end()
+{
+    if (client_ && (!reuse_ || closeAfter_))
+        client_->stop();
+    responseHeaders_.clear();
+    body_.clear();
+}
+
+void HTTPClient::addHeader(const String &name, const String &value, bool, bool replace)
+{
+    if (replace)
+    {
+        for (auto &header : requestHeaders_)
+        {
+            if (sameName(header.first, name.c_str()))
+            {
+                header.second = value.c_str();
+                return;
+            }
+        }
+    }
+    requestHeaders_.emplace_back(name.c_str(), value.c_str());
+}
+
+void HTTPClient::collectHeaders(const char *[], const size_t)
+{
+    // Every response header is kept
+}
+
+String HTTPClient::header(const char *name)
+{
+    for (const auto &header : responseHeaders_)
+    {
+        if (sameName(header.first, name))
+            return String(header.second.c_str());
+    }
+    return String();
+}
+
+bool HTTPClient::hasHeader(const char *name)
+{
+    for (const auto &header : responseHeaders_)
+    {
+        if (sameName(header.first, name))
+            return true;
+    }
+    return false;
+}
+
+int HTTPClient::GET()
+{
+    return perform("GET", std::string(), true);
+}
+
+int HTTPClient::POST(String payload)
+{
+    return perform("POST", std::string(payload.c_str(), payload.length()), true);
+}
+
+int HTTPClient::POST(uint8_t *payload, size_t size)
+{
+    return perform("POST", std::string((const char *)payload, size), true);
+}
+
+int HTTPClient::sendRequest(const char *type, String payload)
+{
+    return perform(type, std::string(payload.c_str(), payload.length()), true);
+}
+
+int HTTPClient::sendRequest(const char *type, uint8_t *payload, size_t size)
+{
+    return perform(type, payload ? std::string((const char *)payload, size) : std::string(), true);
+}
+
+int HTTPClient::sendRequest(const char *type, Stream *stream, size_t size)
+{
+    if (!stream)
+        return HTTPC_ERROR_NO_STREAM;
+    std::string body(size, '\0');
+    size_t got = size ? stream->readBytes(&body[0], size) : 0;
+    if (got != size)
+        return HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+    // Like the ESP32 client: no redirect handling for streamed bodies
+    return perform(type, body, false);
+}
+
+int HTTPClient::perform(const char *type, const std::string &body, bool followRedirects)
+{
+    std::string method = type;
+    std::string payload = body;
+    for (uint16_t redirects = 0;; ++redirects)
+    {
+        int code = exchange(method.c_str(), payload);
+        bool redirect = false;
+        if (followRedirects && follow_ != HTTPC_DISABLE_FOLLOW_REDIRECTS && location_.length() > 0 &&
+            redirects < redirectLimit_)
+        {
+            bool safe = method == "GET" || method == "HEAD";
+            if (code == HTTP_CODE_MOVED_PERMANENTLY || code == HTTP_CODE_FOUND)
+                redirect = follow_ == HTTPC_FORCE_FOLLOW_REDIRECTS || safe;
+            else if (code == HTTP_CODE_SEE_OTHER)
+            {
+                redirect = true;
+                method = "GET";
+                payload.clear();
+            }
+            else if (code == HTTP_CODE_TEMPORARY_REDIRECT || code == HTTP_CODE_PERMANENT_REDIRECT)
+                redirect = follow_ == HTTPC_FORCE_FOLLOW_REDIRECTS || safe;
+        }
+        if (!redirect)
+            return code;
+
+        // Like HTTPClient::setURL(): a path stays on the socket, a URL
+        // closes it
+        String location = location_;
+        end();
+        if (location[0] == '/')
+        {
+            std::string origin, path;
+            splitUrl(url_, origin, path);
+            location = String((origin + location.c_str()).c_str());
+        }
+        else
+            client_->stop();
+        if (!begin(*client_, location))
+            return code;
+    }
+}
+
+int HTTPClient::exchange(const char *type, const std::string &body)
+{
+    responseHeaders_.clear();
+    body_.clear();
+    location_ = "";
+    closeAfter_ = false;
+    chunkSize_ = 0;
+
+    std::string origin, path;
+    splitUrl(url_, origin, path);
+
+    if (wifiStatus != WL_CONNECTED)
+    {
+        client_->stop();
+        return HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+
+    // Like the ESP32 client, a connected socket is reused as is - even when
+    // it was opened to another host
+    bool reused = client_->connected_;
+    std::string target = reused ? client_->origin_ : origin;
+    std::shared_ptr<StandInServer> server = findServer(target);
+    if (!server)
+    {
+        client_->stop();
+        return reused ? HTTPC_ERROR_CONNECTION_LOST : HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+
+    uint32_t generation;
+    uint32_t handshakeMs = 0;
+    {
+        std::lock_guard<std::mutex> guard(serversLock);
+        if (reused && client_->generation_ != server->generation)
+        {
+            client_->stop();
+            return server->dropError;
+        }
+        if (!reused)
+        {
+            server->stats.connects++;
+            client_->connected_ = true;
+            client_->origin_ = origin;
+            client_->generation_ = server->generation;
+            handshakeMs = server->handshakeMs;
+        }
+        server->stats.requests++;
+        generation = server->generation;
+    }
+    (void)generation;
+    delay(handshakeMs);
+
+    hoststub::HttpRequest request;
+    request.method = type;
+    request.url = url_;
+    request.path = path;
+    request.body = body;
+    request.headers = requestHeaders_;
+    request.reusedSocket = reused;
+
+    hoststub::HttpReply reply = server->handler ? server->handler(request) : hoststub::HttpReply();
+
+    if (reply.delayMs > timeoutMs_)
+    {
+        delay(timeoutMs_);
+        client_->stop();
+        return HTTPC_ERROR_READ_TIMEOUT;
+    }
+    delay(reply.delayMs);
+
+    if (reply.error < 0)
+    {
+        client_->stop();
+        return reply.error;
+    }
+
+    responseHeaders_ = reply.headers;
+    body_ = reply.body;
+    chunkSize_ = reply.chunkSize;
+    closeAfter_ = reply.close;
+    location_ = header("Location");
+    return reply.status;
+}
+
+String HTTPClient::getString()
+{
+    return String(body_.c_str(), (unsigned int)body_.size());
+}
+
+int HTTPClient::writeToStream(Stream *stream)
+{
+    if (!stream)
+        return HTTPC_ERROR_NO_STREAM;
+    if (!connected())
+        return HTTPC_ERROR_NOT_CONNECTED;
+
+    // Chunked bodies come out one chunk at a time, plain ones by TCP segment
+    size_t step = chunkSize_ ? chunkSize_ : 1460;
+    size_t written = 0;
+    while (written < body_.size())
+    {
+        size_t n = std::min(step, body_.size() - written);
+        if (stream->write((const uint8_t *)body_.data() + written, n) != n)
+            return HTTPC_ERROR_STREAM_WRITE;
+        written += n;
+    }
+    return (int)written;
+}
+
+String HTTPClient::errorToString(int error)
+{
+    switch (error)
+    {
+    case HTTPC_ERROR_CONNECTION_REFUSED:
+        return "connection refused";
+    case HTTPC_ERROR_SEND_HEADER_FAILED:
+        return "send header failed";
+    case HTTPC_ERROR_SEND_PAYLOAD_FAILED:
+        return "send payload failed";
+    case HTTPC_ERROR_NOT_CONNECTED:
+        return "not connected";
+    case HTTPC_ERROR_CONNECTION_LOST:
+        return "connection lost";
+    case HTTPC_ERROR_NO_STREAM:
+        return "no stream";
+    case HTTPC_ERROR_NO_HTTP_SERVER:
+        return "no HTTP server";
+    case HTTPC_ERROR_TOO_LESS_RAM:
+        return "too less ram";
+    case HTTPC_ERROR_ENCODING:
+        return "Transfer-Encoding not supported";
+    case HTTPC_ERROR_STREAM_WRITE:
+        return "Stream write error";
+    case HTTPC_ERROR_READ_TIMEOUT:
+        return "read Timeout";
+    default:
+        return String();
+    }
+}
@@ -0,0 +1,261 @@
+#include <NimBLEDevice.h>
+#include "hoststub.h"
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+// ---------------------------------------------------------------------------
+// Notification completions arrive on the NimBLE host task, never inside
+// notify(); one background thread plays that part
+
+// Every callback runs on the one NimBLE host task on the device; writes,
+// connects and completions from different test threads take turns here
+static std::recursive_mutex hostTask;
+
+static std::mutex completionsLock;
+static std::condition_variable completionsCv;
+// Runs of completions per characteristic, in order; a run is extended in
+// place so a burst of notifications does not grow the host heap
+static std::deque<std::pair<NimBLECharacteristic *, size_t>> completions;
+static size_t completionsInFlight = 0;
+
+static void completionLoop()
+{
+    std::unique_lock<std::mutex> lock(completionsLock);
+    for (;;)
+    {
+        completionsCv.wait(lock, []() { return !completions.empty(); });
+        NimBLECharacteristic *ch = completions.front().first;
+        if (--completions.front().second == 0)
+            completions.pop_front();
+        lock.unlock();
+        {
+            std::lock_guard<std::recursive_mutex> host(hostTask);
+            if (ch->getCallbacks())
+                ch->getCallbacks()->onStatus(ch, 0);
+        }
+        lock.lock();
+        completionsInFlight--;
+        completionsCv.notify_all();
+    }
+}
+
+static void queueCompletion(NimBLECharacteristic *ch)
+{
+    static std::once_flag started;
+    std::call_once(started, []() { std::thread(completionLoop).detach(); });
+    std::lock_guard<std::mutex> guard(completionsLock);
+    if (!completions.empty() && completions.back().first == ch)
+        completions.back().second++;
+    else
+        completions.emplace_back(ch, 1);
+    completionsInFlight++;
+    completionsCv.notify_all();
+}
+
+namespace hoststub
+{
+
+void bleWrite(NimBLECharacteristic *ch, uint16_t connHandle, const void *data, size_t length, uint16_t mtu)
+{
+    ch->setValue((const uint8_t *)data, length);
+    NimBLEConnInfo info(connHandle, mtu);
+    std::lock_guard<std::recursive_mutex> host(hostTask);
+    if (ch->getCallbacks())
+        ch->getCallbacks()->onWrite(ch, info);
+}
+
+void bleSettle()
+{
+    std::unique_lock<std::mutex> lock(completionsLock);
+    completionsCv.wait(lock, []() { return completionsInFlight == 0; });
+}
+
+} // namespace hoststub
+
+// ---------------------------------------------------------------------------
+// Characteristics
+
+NimBLEAttValue NimBLECharacteristic::getValue()
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    return NimBLEAttValue((const uint8_t *)value_.data(), value_.size());
+}
+
+void NimBLECharacteristic::setValue(const uint8_t *data, size_t length)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    value_.assign((const char *)data, length);
+}
+
+bool NimBLECharacteristic::notify(uint16_t connHandle)
+{
+    std::string value;
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        value = value_;
+    }
+    return notify((const uint8_t *)value.data(), value.size(), connHandle);
+}
+
+bool NimBLECharacteristic::notify(const uint8_t *data, size_t length, uint16_t connHandle)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        if (failNext_ > 0)
+        {
+            failNext_--;
+            return false;
+        }
+        sent_.push_back(NimBLENotification{connHandle, std::string((const char *)data, length)});
+        sentCv_.notify_all();
+    }
+    queueCompletion(this);
+    return true;
+}
+
+std::vector<NimBLENotification> NimBLECharacteristic::sent(bool clear)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    std::vector<NimBLENotification> out = sent_;
+    if (clear)
+        sent_.clear();
+    return out;
+}
+
+bool NimBLECharacteristic::waitForSent(size_t count, uint32_t timeoutMs)
+{
+    std::unique_lock<std::mutex> lock(lock_);
+    return sentCv_.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&]() { return sent_.size() >= count; });
+}
+
+void NimBLECharacteristic::failNotifies(uint32_t count)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    failNext_ = count;
+}
+
+NimBLECharacteristic *NimBLEService::createCharacteristic(const char *uuid, uint32_t properties, uint16_t)
+{
+    NimBLECharacteristic *ch = new NimBLECharacteristic(uuid, properties);
+    characteristics_.push_back(ch);
+    uuids_.push_back(uuid ? uuid : "");
+    return ch;
+}
+
+NimBLECharacteristic *NimBLEService::getCharacteristic(const char *uuid)
+{
+    for (size_t i = 0; i < uuids_.size(); ++i)
+    {
+        if (uuids_[i] == (uuid ? uuid : ""))
+            return characteristics_[i];
+    }
+    return nullptr;
+}
+
+// ---------------------------------------------------------------------------
+// Server and device
+
+void NimBLEServer::setCallbacks(NimBLEServerCallbacks *callbacks, bool)
+{
+    callbacks_ = callbacks;
+}
+
+NimBLEService *NimBLEServer::createService(const char *uuid)
+{
+    NimBLEService *service = new NimBLEService();
+    services_.push_back(service);
+    serviceUuids_.push_back(uuid ? uuid : "");
+    return service;
+}
+
+NimBLEService *NimBLEServer::getServiceByUUID(const char *uuid)
+{
+    for (size_t i = 0; i < serviceUuids_.size(); ++i)
+    {
+        if (serviceUuids_[i] == (uuid ? uuid : ""))
+            return services_[i];
+    }
+    return nullptr;
+}
+
+uint16_t NimBLEServer::getPeerMTU(uint16_t connHandle)
+{
+    for (const auto &peer : peers_)
+    {
+        if (peer.first == connHandle)
+            return peer.second;
+    }
+    return 0;
+}
+
+size_t NimBLEServer::getConnectedCount()
+{
+    return peers_.size();
+}
+
+bool NimBLEServer::setDataLen(uint16_t, uint16_t)
+{
+    return true;
+}
+
+bool NimBLEServer::updatePhy(uint16_t, uint8_t, uint8_t, uint16_t)
+{
+    return true;
+}
+
+void NimBLEServer::connect(uint16_t connHandle, uint16_t mtu)
+{
+    peers_.emplace_back(connHandle, mtu);
+    NimBLEConnInfo info(connHandle, mtu);
+    std::lock_guard<std::recursive_mutex> host(hostTask);
+    if (callbacks_)
+        callbacks_->onConnect(this, info);
+}
+
+void NimBLEServer::disconnect(uint16_t connHandle, int reason)
+{
+    uint16_t mtu = getPeerMTU(connHandle);
+    for (size_t i = 0; i < peers_.size(); ++i)
+    {
+        if (peers_[i].first == connHandle)
+        {
+            peers_.erase(peers_.begin() + i);
+            break;
+        }
+    }
+    NimBLEConnInfo info(connHandle, mtu);
+    std::lock_guard<std::recursive_mutex> host(hostTask);
+    if (callbacks_)
+        callbacks_->onDisconnect(this, info, reason);
+}
+
+static NimBLEServer *deviceServer = nullptr;
+static NimBLEAdvertising deviceAdvertising;
+static uint16_t deviceMtu = BLE_ATT_MTU_DFLT;
+
+bool NimBLEDevice::init(const std::string &) { return true; }
+bool NimBLEDevice::deinit(bool) { return true; }
+bool NimBLEDevice::setDeviceName(const std::string &) { return true; }
+bool NimBLEDevice::setPower(int) { return true; }
+void NimBLEDevice::setSecurityAuth(bool, bool, bool) {}
+
+bool NimBLEDevice::setMTU(uint16_t mtu)
+{
+    deviceMtu = mtu;
+    return true;
+}
+
+uint16_t NimBLEDevice::getMTU() { return deviceMtu; }
+
+NimBLEServer *NimBLEDevice::createServer()
+{
+    if (!deviceServer)
+        deviceServer = new NimBLEServer();
+    return deviceServer;
+}
+
+NimBLEServer *NimBLEDevice::getServer() { return deviceServer; }
+NimBLEAdvertising *NimBLEDevice::getAdvertising() { return &deviceAdvertising; }
+bool NimBLEDevice::startAdvertising(uint32_t) { return deviceAdvertising.start(); }
+bool NimBLEDevice::stopAdvertising() { return deviceAdvertising.stop(); }
@@ -0,0 +1,285 @@
+#include <Preferences.h>
+#include <LittleFS.h>
+#include "hoststub.h"
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+// ---------------------------------------------------------------------------
+// Preferences: namespace -> key -> bytes
+
+static std::mutex prefsLock;
+static std::map<std::string, std::map<std::string, std::vector<uint8_t>>> prefsStore;
+
+namespace hoststub
+{
+
+void clearPreferences()
+{
+    std::lock_guard<std::mutex> guard(prefsLock);
+    prefsStore.clear();
+}
+
+} // namespace hoststub
+
+bool Preferences::begin(const char *name, bool readOnly)
+{
+    if (!name || !name[0] || strlen(name) > 15)
+        return false;
+    std::lock_guard<std::mutex> guard(prefsLock);
+    // Like NVS, a read-only open of a namespace that was never written fails
+    if (readOnly && prefsStore.find(name) == prefsStore.end())
+        return false;
+    prefsStore[name];
+    name_ = name;
+    open_ = true;
+    readOnly_ = readOnly;
+    return true;
+}
+
+void Preferences::end()
+{
+    open_ = false;
+}
+
+bool Preferences::clear()
+{
+    if (!open_ || readOnly_)
+        return false;
+    std::lock_guard<std::mutex> guard(prefsLock);
+    prefsStore[name_].clear();
+    return true;
+}
+
+bool Preferences::remove(const char *key)
+{
+    if (!open_ || readOnly_)
+        return false;
+    std::lock_guard<std::mutex> guard(prefsLock);
+    return prefsStore[name_].erase(key) > 0;
+}
+
+bool Preferences::isKey(const char *key)
+{
+    if (!open_)
+        return false;
+    std::lock_guard<std::mutex> guard(prefsLock);
+    return prefsStore[name_].count(key) > 0;
+}
+
+size_t Preferences::putBytes(const char *key, const void *value, size_t length)
+{
+    if (!open_ || readOnly_ || !key)
+        return 0;
+    std::lock_guard<std::mutex> guard(prefsLock);
+    const uint8_t *bytes = (const uint8_t *)value;
+    prefsStore[name_][key].assign(bytes, bytes + length);
+    return length;
+}
+
+size_t Preferences::getBytes(const char *key, void *buffer, size_t maxLength)
+{
+    if (!open_ || !key)
+        return 0;
+    std::lock_guard<std::mutex> guard(prefsLock);
+    auto &keys = prefsStore[name_];
+    auto it = keys.find(key);
+    if (it == keys.end() || it->second.size() > maxLength)
+        return 0;
+    memcpy(buffer, it->second.data(), it->second.size());
+    return it->second.size();
+}
+
+size_t Preferences::getBytesLength(const char *key)
+{
+    if (!open_ || !key)
+        return 0;
+    std::lock_guard<std::mutex> guard(prefsLock);
+    auto &keys = prefsStore[name_];
+    auto it = keys.find(key);
+    return it == keys.end() ? 0 : it->second.size();
+}
+
+size_t Preferences::putUInt(const char *key, uint32_t value)
+{
+    return putBytes(key, &value, sizeof(value));
+}
+
+uint32_t Preferences::getUInt(const char *key, uint32_t defaultValue)
+{
+    uint32_t value = defaultValue;
+    return getBytes(key, &value, sizeof(value)) == sizeof(value) ? value : defaultValue;
+}
+
+size_t Preferences::putString(const char *key, const String &value)
+{
+    return putBytes(key, value.c_str(), value.length() + 1);
+}
+
+String Preferences::getString(const char *key, const String &defaultValue)
+{
+    size_t length = getBytesLength(key);
+    if (length == 0)
+        return defaultValue;
+    std::vector<char> buffer(length);
+    getBytes(key, buffer.data(), length);
+    return String(buffer.data());
+}
+
+// ---------------------------------------------------------------------------
+// LittleFS over a host directory
+
+LittleFSFS LittleFS;
+
+static std::string fsRoot = "x402-littlefs";
+
+namespace hoststub
+{
+
+void setFsRoot(const std::string &dir)
+{
+    fsRoot = dir;
+    mkdir(fsRoot.c_str(), 0755);
+}
+
+} // namespace hoststub
+
+static std::string hostPath(const char *path)
+{
+    std::string p = path ? path : "";
+    return fsRoot + (p.empty() || p[0] != '/' ? "/" : "") + p;
+}
+
+namespace fs
+{
+
+struct FileImpl
+{
+    FILE *file = nullptr;
+    ~FileImpl()
+    {
+        if (file)
+            fclose(file);
+    }
+};
+
+size_t File::write(const uint8_t *buffer, size_t size)
+{
+    return impl_ && impl_->file ? fwrite(buffer, 1, size, impl_->file) : 0;
+}
+
+size_t File::read(uint8_t *buffer, size_t size)
+{
+    return impl_ && impl_->file ? fread(buffer, 1, size, impl_->file) : 0;
+}
+
+int File::available()
+{
+    if (!impl_ || !impl_->file)
+        return 0;
+    return (int)(size() - position());
+}
+
+int File::read()
+{
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+int File::peek()
+{
+    if (!impl_ || !impl_->file)
+        return -1;
+    int c = fgetc(impl_->file);
+    if (c != EOF)
+        ungetc(c, impl_->file);
+    return c == EOF ? -1 : c;
+}
+
+void File::flush()
+{
+    if (impl_ && impl_->file)
+        fflush(impl_->file);
+}
+
+bool File::seek(uint32_t position, SeekMode mode)
+{
+    return impl_ && impl_->file && fseek(impl_->file, (long)position, (int)mode) == 0;
+}
+
+size_t File::position() const
+{
+    return impl_ && impl_->file ? (size_t)ftell(impl_->file) : 0;
+}
+
+size_t File::size() const
+{
+    if (!impl_ || !impl_->file)
+        return 0;
+    fflush(impl_->file);
+    struct stat st;
+    return fstat(fileno(impl_->file), &st) == 0 ? (size_t)st.st_size : 0;
+}
+
+void File::close()
+{
+    impl_.reset();
+}
+
+File::operator bool() const
+{
+    return impl_ && impl_->file;
+}
+
+File FS::open(const char *path, const char *mode, bool)
+{
+    // Arduino "r" / "w" / "a" map onto binary stdio modes
+    const char *hostMode = mode[0] == 'w' ? "wb" : mode[0] == 'a' ? "ab" : "rb";
+    FILE *file = fopen(hostPath(path).c_str(), hostMode);
+    if (!file)
+        return File();
+    std::shared_ptr<FileImpl> impl = std::make_shared<FileImpl>();
+    impl->file = file;
+    return File(impl);
+}
+
+bool FS::exists(const char *path)
+{
+    return access(hostPath(path).c_str(), F_OK) == 0;
+}
+
+bool FS::remove(const char *path)
+{
+    return ::remove(hostPath(path).c_str()) == 0;
+}
+
+bool FS::rename(const char *from, const char *to)
+{
+    return ::rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0;
+}
+
+bool FS::mkdir(const char *path)
+{
+    return ::mkdir(hostPath(path).c_str(), 0755) == 0;
+}
+
+} // namespace fs
+
+bool LittleFSFS::begin(bool, const char *, uint8_t, const char *)
+{
+    ::mkdir(fsRoot.c_str(), 0755);
+    return true;
+}
+
+size_t LittleFSFS::totalBytes()
+{
+    return 1536 * 1024;
+}
+
+size_t LittleFSFS::usedBytes()
+{
+    return 0;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+// Test-side controls for the host stand-ins: heap accounting, the clock,
+// WiFi, in-process HTTP servers, simulated BLE centrals and storage.
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <NimBLEDevice.h>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace hoststub
+{
+
+// Heap use by everything allocated through new/malloc since start
+struct HeapStats
+{
+    size_t current;
+    size_t peak;
+    uint64_t allocations;
+};
+HeapStats heapStats();
+// Restart peak tracking from the current level
+void resetHeapPeak();
+
+// Pin esp_timer_get_time() (microseconds); negative returns to real time
+void setTimerNow(int64_t us);
+
+void setWiFiStatus(wl_status_t status);
+
+struct HttpRequest
+{
+    std::string method;
+    std::string url;  // as passed to HTTPClient::begin()
+    std::string path; // /verify
+    std::string body;
+    std::vector<std::pair<std::string, std::string>> headers;
+    bool reusedSocket;
+};
+
+struct HttpReply
+{
+    int status = 200;
+    std::string body;
+    std::vector<std::pair<std::string, std::string>> headers;
+    uint32_t delayMs = 0;  // time to the response headers
+    size_t chunkSize = 0;  // >0: body arrives in chunks this size (chunked encoding)
+    bool close = false;    // Connection: close
+    int error = 0;         // <0: fail the exchange with this HTTPC_ERROR_* instead
+};
+
+typedef std::function<HttpReply(const HttpRequest &)> HttpHandler;
+
+// Answer requests to origin ("https://host[:port]") with handler, called on
+// the requesting task. Unknown origins refuse the connection.
+void serve(const std::string &origin, HttpHandler handler);
+void stopServing(const std::string &origin);
+void stopAllServers();
+// The server closes its kept-alive sockets; the next request over one of
+// them fails with error, before the handler sees it
+void dropConnections(const std::string &origin, int error = -5 /* HTTPC_ERROR_CONNECTION_LOST */);
+// Fresh sockets to origin take this long to open (the TCP + TLS handshake)
+void setHandshakeDelay(const std::string &origin, uint32_t ms);
+
+struct ServerStats
+{
+    uint32_t requests; // handed to the handler
+    uint32_t connects; // fresh sockets
+};
+ServerStats serverStats(const std::string &origin);
+
+// A central writes data to ch (runs the characteristic's onWrite callbacks)
+void bleWrite(NimBLECharacteristic *ch, uint16_t connHandle, const void *data, size_t length,
+              uint16_t mtu = 247);
+inline void bleWrite(NimBLECharacteristic *ch, uint16_t connHandle, const std::string &data, uint16_t mtu = 247)
+{
+    bleWrite(ch, connHandle, data.data(), data.size(), mtu);
+}
+// Wait until every notification handed to the stack has completed (onStatus)
+void bleSettle();
+
+void clearPreferences();
+// Directory LittleFS files live in (created if missing)
+void setFsRoot(const std::string &dir);
+
+} // namespace hoststub
@@ -0,0 +1,218 @@
+// Binary framing: frame parsing, CRC and reassembly, and one payment replayed
+// over both protocols with the bytes on air compared.
+
+#include "hosttest.h"
+#include "x402fixture.h"
+#include "BinaryFrame.h"
+
+using namespace x402fixture;
+
+// ATT opcode + handle in front of every write and notification value
+static const size_t ATT_HEADER = 3;
+static const uint16_t MTU = 247;
+static const size_t MAX_VALUE = MTU - ATT_HEADER;
+
+static std::string frame(uint8_t opcode, uint8_t seq, const std::string &payload)
+{
+    std::string out(getBinaryFrameSize(payload.size()), '\0');
+    size_t n = encodeBinaryFrame(opcode, seq, (const uint8_t *)payload.data(), payload.size(), (uint8_t *)&out[0], out.size());
+    out.resize(n);
+    return out;
+}
+
+static std::string continuation(uint8_t opcode, uint8_t seq, const std::string &payload)
+{
+    std::string out;
+    out += (char)X402BLE_FRAME_MAGIC;
+    out += (char)(opcode | X402BLE_FRAME_CONTINUE);
+    out += (char)seq;
+    out += payload;
+    uint16_t crc = crc16Ccitt((const uint8_t *)out.data(), out.size());
+    out += (char)(crc & 0xFF);
+    out += (char)(crc >> 8);
+    return out;
+}
+
+// A message as the frames a client writes at this MTU
+static std::vector<std::string> frames(uint8_t opcode, uint8_t seq, const std::string &message)
+{
+    std::vector<std::string> out;
+    size_t first = std::min(message.size(), MAX_VALUE - X402BLE_FRAME_OVERHEAD);
+    std::string head = frame(opcode, seq, message.substr(0, first));
+    // encodeBinaryFrame writes the length of this payload; patch in the total
+    head[3] = (char)(message.size() & 0xFF);
+    head[4] = (char)(message.size() >> 8);
+    uint16_t crc = crc16Ccitt((const uint8_t *)head.data(), head.size() - 2);
+    head[head.size() - 2] = (char)(crc & 0xFF);
+    head[head.size() - 1] = (char)(crc >> 8);
+    out.push_back(head);
+    for (size_t at = first; at < message.size(); at += MAX_VALUE - 5)
+        out.push_back(continuation(opcode, seq, message.substr(at, MAX_VALUE - 5)));
+    return out;
+}
+
+TEST(crc_matches_the_ccitt_false_check_value)
+{
+    CHECK_EQ(crc16Ccitt((const uint8_t *)"123456789", 9), (uint16_t)0x29B1);
+    CHECK_EQ(crc16Ccitt(nullptr, 0), (uint16_t)0xFFFF);
+}
+
+TEST(frames_round_trip_and_corruption_is_caught)
+{
+    std::string bytes = frame(FRAME_OP_PRICE, 7, "\"\"--[latte]");
+    CHECK_EQ(bytes.size(), getBinaryFrameSize(11));
+    BinaryFrame parsed;
+    CHECK(parseBinaryFrame((const uint8_t *)bytes.data(), bytes.size(), parsed));
+    CHECK(parsed.first);
+    CHECK_EQ(parsed.opcode, (uint8_t)FRAME_OP_PRICE);
+    CHECK_EQ(parsed.seq, (uint8_t)7);
+    CHECK_EQ(parsed.totalLength, (uint16_t)11);
+    CHECK_EQ(std::string((const char *)parsed.payload, parsed.payloadLength), std::string("\"\"--[latte]"));
+
+    for (size_t i = 1; i < bytes.size(); ++i)
+    {
+        std::string bad = bytes;
+        bad[i] ^= 0x10;
+        if (parseBinaryFrame((const uint8_t *)bad.data(), bad.size(), parsed))
+            hosttest::fail(__FILE__, __LINE__, "bit flip at byte " + std::to_string(i) + " not caught");
+    }
+    CHECK(!parseBinaryFrame((const uint8_t *)bytes.data(), 4, parsed));
+    CHECK(!isBinaryFrame((const uint8_t *)"[PRICE]", 7));
+
+    uint8_t small[8];
+    CHECK_EQ(encodeBinaryFrame(FRAME_OP_REPLY, 1, (const uint8_t *)"abc", 3, small, sizeof(small)), (size_t)0);
+}
+
+TEST(reassembly_checks_sequence_and_length)
+{
+    ReassemblyBuffer buffer;
+    CHECK(buffer.allocate(1024));
+    FrameReassembly state;
+    BinaryFrame parsed;
+    std::string message(600, 'm');
+    std::vector<std::string> parts = frames(FRAME_OP_PAYMENT, 3, message);
+    CHECK_EQ(parts.size(), (size_t)3);
+    for (size_t i = 0; i < parts.size(); ++i)
+    {
+        CHECK(parseBinaryFrame((const uint8_t *)parts[i].data(), parts[i].size(), parsed));
+        CHECK_EQ(assembleBinaryFrame(parsed, state, buffer), i + 1 < parts.size() ? FRAME_PARTIAL : FRAME_COMPLETE);
+    }
+    CHECK_EQ(std::string(buffer.c_str(), buffer.length()), message);
+
+    // A continuation with another seq, or with nothing in progress
+    buffer.clear();
+    std::string stray = continuation(FRAME_OP_PAYMENT, 4, "x");
+    parseBinaryFrame((const uint8_t *)parts[0].data(), parts[0].size(), parsed);
+    CHECK_EQ(assembleBinaryFrame(parsed, state, buffer), FRAME_PARTIAL);
+    parseBinaryFrame((const uint8_t *)stray.data(), stray.size(), parsed);
+    CHECK_EQ(assembleBinaryFrame(parsed, state, buffer), FRAME_REJECTED);
+    CHECK_EQ(assembleBinaryFrame(parsed, state, buffer), FRAME_REJECTED);
+
+    // More payload than the first frame announced
+    std::string overlong = frame(FRAME_OP_PRICE, 5, "abc");
+    overlong[3] = 2;
+    uint16_t crc = crc16Ccitt((const uint8_t *)overlong.data(), overlong.size() - 2);
+    overlong[overlong.size() - 2] = (char)(crc & 0xFF);
+    overlong[overlong.size() - 1] = (char)(crc >> 8);
+    parseBinaryFrame((const uint8_t *)overlong.data(), overlong.size(), parsed);
+    CHECK_EQ(assembleBinaryFrame(parsed, state, buffer), FRAME_REJECTED);
+    CHECK(!buffer.overflowed());
+
+    // More than the session buffer holds
+    std::string huge = frame(FRAME_OP_PAYMENT, 6, std::string(1100, 'h'));
+    parseBinaryFrame((const uint8_t *)huge.data(), huge.size(), parsed);
+    CHECK_EQ(assembleBinaryFrame(parsed, state, buffer), FRAME_REJECTED);
+    CHECK(buffer.overflowed());
+}
+
+struct Replay
+{
+    size_t writes = 0;
+    size_t notifies = 0;
+    size_t bytes = 0; // ATT values plus their headers, both directions
+    std::string complete;
+};
+
+static bool isComplete(const std::string &notification)
+{
+    size_t at = isBinaryFrame((const uint8_t *)notification.data(), notification.size()) ? X402BLE_FRAME_HEADER_SIZE : 0;
+    return notification.compare(at, 16, "PAYMENT:COMPLETE") == 0;
+}
+
+static Replay replay(uint16_t handle, const std::vector<std::string> &writes)
+{
+    Replay out;
+    for (const std::string &value : writes)
+    {
+        CHECK(value.size() <= MAX_VALUE);
+        hoststub::bleWrite(rx(), handle, value, MTU);
+        out.writes++;
+        out.bytes += ATT_HEADER + value.size();
+    }
+    while (out.complete.empty())
+    {
+        std::vector<std::string> next = received(handle, 1);
+        if (next.empty())
+            break;
+        out.notifies++;
+        out.bytes += ATT_HEADER + next[0].size();
+        if (isComplete(next[0]))
+            out.complete = next[0];
+    }
+    return out;
+}
+
+TEST(binary_payment_costs_fewer_bytes_on_air)
+{
+    serveFacilitator();
+    device();
+    const uint16_t TEXT = 30, BINARY = 31;
+    NimBLEDevice::getServer()->connect(TEXT, MTU);
+    NimBLEDevice::getServer()->connect(BINARY, MTU);
+
+    // The same payment (only the nonce differs, so it is not a replay)
+    std::string context = "\"table 4\"", options = "[latte,oat milk]";
+    std::string textPayment = paymentJson(0x170);
+    std::string binaryPayment = paymentJson(0x171);
+    CHECK_EQ(textPayment.size(), binaryPayment.size());
+
+    // Text: the longest prefix is X-PAYMENT:START, so chunks fill a write with it
+    Replay text = replay(TEXT, paymentChunks(textPayment, context, options, MAX_VALUE - strlen("X-PAYMENT:START")));
+    Replay binary = replay(BINARY, frames(FRAME_OP_PAYMENT, 1, binaryPayment + "--" + context + "--" + options));
+
+    CHECK(text.complete.find("VERIFIED:true") != std::string::npos);
+    CHECK(binary.complete.find("VERIFIED:true") != std::string::npos);
+    CHECK(isBinaryFrame((const uint8_t *)binary.complete.data(), binary.complete.size()));
+
+    printf("bytes on air: text %zu (%zu writes, %zu notifies), binary %zu (%zu writes, %zu notifies)\n", text.bytes,
+           text.writes, text.notifies, binary.bytes, binary.writes, binary.notifies);
+    CHECK(binary.bytes < text.bytes);
+    // No per-chunk ACK notifications on the binary path
+    CHECK(binary.notifies < text.notifies);
+    CHECK(binary.writes <= text.writes);
+
+    NimBLEDevice::getServer()->disconnect(TEXT);
+    NimBLEDevice::getServer()->disconnect(BINARY);
+}
+
+TEST(binary_commands_and_errors_are_framed)
+{
+    device();
+    const uint16_t handle = 32;
+    NimBLEDevice::getServer()->connect(handle, MTU);
+
+    uint8_t version = X402BLE_FRAME_VERSION;
+    hoststub::bleWrite(rx(), handle, frame(FRAME_OP_HELLO, 9, std::string((const char *)&version, 1)), MTU);
+    std::vector<std::string> hello = received(handle, 1);
+    BinaryFrame parsed;
+    CHECK(!hello.empty() && parseBinaryFrame((const uint8_t *)hello[0].data(), hello[0].size(), parsed));
+    CHECK_EQ(parsed.seq, (uint8_t)9);
+
+    hoststub::bleWrite(rx(), handle, continuation(FRAME_OP_PAYMENT, 2, "stray"), MTU);
+    std::vector<std::string> error = received(handle, 1);
+    CHECK(!error.empty() && parseBinaryFrame((const uint8_t *)error[0].data(), error[0].size(), parsed));
+    CHECK_EQ(parsed.opcode, (uint8_t)FRAME_OP_ERROR);
+    CHECK_EQ(std::string((const char *)parsed.payload, parsed.payloadLength), std::string("ERROR:BAD_SEQUENCE"));
+
+    NimBLEDevice::getServer()->disconnect(handle);
+}
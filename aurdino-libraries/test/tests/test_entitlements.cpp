@@ -0,0 +1,172 @@
+// EntitlementScheduler: expiry on its tick and not before, entries a whole
+// wheel turn (or more) out sharing a bucket with nearer ones, repeat grants
+// extending the remaining time, revoke and a full table. esp_timer time is
+// pinned and moved by hand; the wheel timer itself runs every 1ms.
+
+#include "hosttest.h"
+#include "hoststub.h"
+#include "EntitlementScheduler.h"
+#include <algorithm>
+#include <mutex>
+
+static const int64_t T0 = 10000000; // 10s, on a tick boundary
+static const uint32_t TURN_MS = X402BLE_ENTITLEMENT_WHEEL_SLOTS; // one turn at 1ms ticks
+
+static std::mutex expiredLock;
+static std::vector<std::string> expiredKeys;
+
+static void onExpired(const String &key)
+{
+    std::lock_guard<std::mutex> guard(expiredLock);
+    expiredKeys.push_back(key.c_str());
+}
+
+static std::vector<std::string> takeExpired()
+{
+    std::lock_guard<std::mutex> guard(expiredLock);
+    std::vector<std::string> keys;
+    keys.swap(expiredKeys);
+    return keys;
+}
+
+// Move the clock to T0 + ms and let the wheel timer catch up
+static void at(uint32_t ms)
+{
+    hoststub::setTimerNow(T0 + (int64_t)ms * 1000);
+    delay(15);
+}
+
+struct Wheel
+{
+    EntitlementScheduler scheduler;
+
+    Wheel()
+    {
+        hoststub::setTimerNow(T0);
+        takeExpired();
+        scheduler.setExpiredCallback(onExpired);
+        CHECK(scheduler.begin(1));
+    }
+    ~Wheel()
+    {
+        scheduler.end();
+        hoststub::setTimerNow(-1);
+    }
+};
+
+TEST(expires_on_its_tick_not_before)
+{
+    Wheel wheel;
+    CHECK(wheel.scheduler.grant("door", 100));
+    CHECK_EQ(wheel.scheduler.getRemainingMs("door"), (uint64_t)100);
+
+    at(99);
+    CHECK(wheel.scheduler.isActive("door"));
+    CHECK_EQ(wheel.scheduler.getRemainingMs("door"), (uint64_t)1);
+    CHECK(takeExpired().empty());
+
+    at(100);
+    CHECK(!wheel.scheduler.isActive("door"));
+    CHECK_EQ(wheel.scheduler.getActiveCount(), (size_t)0);
+    CHECK(takeExpired() == std::vector<std::string>{"door"});
+
+    // Only once
+    at(100 + TURN_MS);
+    CHECK(takeExpired().empty());
+}
+
+TEST(entries_turns_apart_share_a_bucket)
+{
+    Wheel wheel;
+    // Same bucket: 10ms, and 10ms plus three whole turns
+    CHECK(wheel.scheduler.grant("near", 10));
+    CHECK(wheel.scheduler.grant("far", 10 + 3 * TURN_MS));
+
+    at(10);
+    CHECK(takeExpired() == std::vector<std::string>{"near"});
+    CHECK(wheel.scheduler.isActive("far"));
+
+    // Passing the shared bucket on each turn leaves it alone
+    for (uint32_t turn = 1; turn < 3; ++turn)
+    {
+        at(10 + turn * TURN_MS);
+        CHECK(takeExpired().empty());
+    }
+    at(9 + 3 * TURN_MS);
+    CHECK(takeExpired().empty());
+    CHECK(wheel.scheduler.isActive("far"));
+
+    at(10 + 3 * TURN_MS);
+    CHECK(takeExpired() == std::vector<std::string>{"far"});
+}
+
+TEST(missed_ticks_are_caught_up)
+{
+    Wheel wheel;
+    CHECK(wheel.scheduler.grant("a", 5));
+    CHECK(wheel.scheduler.grant("b", 40));
+    CHECK(wheel.scheduler.grant("c", 200));
+
+    // The timer task stalled for several turns: every overdue entry goes at once
+    at(5 * TURN_MS);
+    std::vector<std::string> expired = takeExpired();
+    std::sort(expired.begin(), expired.end());
+    CHECK(expired == (std::vector<std::string>{"a", "b", "c"}));
+}
+
+TEST(repeat_grant_extends_remaining_time)
+{
+    Wheel wheel;
+    CHECK(wheel.scheduler.grant("", 100));
+    at(40);
+    CHECK(wheel.scheduler.grant("", 100));
+    CHECK_EQ(wheel.scheduler.getRemainingMs(""), (uint64_t)160);
+    CHECK_EQ(wheel.scheduler.getActiveCount(), (size_t)1);
+
+    // The old expiry is no longer scheduled
+    at(100);
+    CHECK(takeExpired().empty());
+    CHECK(wheel.scheduler.isActive(""));
+    at(200);
+    CHECK(takeExpired() == std::vector<std::string>{""});
+
+    // Once expired, a grant starts from now
+    at(300);
+    CHECK(wheel.scheduler.grant("", 50));
+    CHECK_EQ(wheel.scheduler.getRemainingMs(""), (uint64_t)50);
+}
+
+TEST(zero_duration_expires_on_the_next_tick)
+{
+    Wheel wheel;
+    at(3);
+    // Filed ahead of the wheel position, not a whole turn later
+    CHECK(wheel.scheduler.grant("now", 0));
+    CHECK(!wheel.scheduler.isActive("now"));
+    at(4);
+    CHECK(takeExpired() == std::vector<std::string>{"now"});
+}
+
+TEST(revoke_and_a_full_table)
+{
+    Wheel wheel;
+    for (int i = 0; i < X402BLE_MAX_ENTITLEMENTS; ++i)
+        CHECK(wheel.scheduler.grant(String(i), 50));
+    CHECK(!wheel.scheduler.grant("extra", 50));
+    // Extending a held key still works when full
+    CHECK(wheel.scheduler.grant("0", 50));
+
+    CHECK(wheel.scheduler.revoke("3"));
+    CHECK(!wheel.scheduler.revoke("3"));
+    CHECK(!wheel.scheduler.isActive("3"));
+    CHECK(wheel.scheduler.grant("extra", 50));
+
+    // Revoked keys never report expiry
+    at(50);
+    std::vector<std::string> expired = takeExpired();
+    CHECK_EQ(expired.size(), (size_t)X402BLE_MAX_ENTITLEMENTS - 1);
+    CHECK(std::find(expired.begin(), expired.end(), "3") == expired.end());
+    CHECK(std::find(expired.begin(), expired.end(), "0") == expired.end());
+    at(100);
+    CHECK(takeExpired() == std::vector<std::string>{"0"});
+}
@@ -0,0 +1,152 @@
+// FacilitatorConnection against stand-in facilitators: keep-alive reuse,
+// stale sockets, and redirects on both body paths.
+
+#include "hosttest.h"
+#include "hoststub.h"
+#include "facilitatorconnection.h"
+#include "facilitatorregistry.h"
+
+using hoststub::HttpReply;
+using hoststub::HttpRequest;
+
+static const char *ORIGIN = "https://facilitator.example";
+static const char *MOVED = "https://moved.example";
+
+static HttpReply ok(const HttpRequest &request)
+{
+    HttpReply reply;
+    reply.body = "{\"echo\":" + request.body + ",\"path\":\"" + request.path + "\"}";
+    return reply;
+}
+
+static HttpReply redirect(int status, const char *location)
+{
+    HttpReply reply;
+    reply.status = status;
+    reply.headers.emplace_back("Location", location);
+    return reply;
+}
+
+static void reset()
+{
+    hoststub::stopAllServers();
+    hoststub::setWiFiStatus(WL_CONNECTED);
+    FacilitatorRegistry::instance().clear();
+}
+
+static HttpResponse postGathered(FacilitatorConnection &conn, const char *endpoint, const String &a, const String &b)
+{
+    GatherStream body;
+    body.add(a);
+    body.add(b);
+    return conn.post(endpoint, body);
+}
+
+TEST(requests_reuse_one_socket)
+{
+    reset();
+    hoststub::serve(ORIGIN, ok);
+    FacilitatorConnection conn((String(ORIGIN) + "/api").c_str());
+
+    for (int i = 0; i < 5; ++i)
+    {
+        CHECK(conn.post("verify", "{}").success);
+        CHECK(postGathered(conn, "settle", "{\"a\":", "1}").success);
+    }
+    CHECK_EQ(hoststub::serverStats(ORIGIN).connects, (uint32_t)1);
+    CHECK_EQ(hoststub::serverStats(ORIGIN).requests, (uint32_t)10);
+    CHECK_EQ(conn.getConnectCount(), (uint32_t)1);
+}
+
+TEST(gathered_body_arrives_whole)
+{
+    reset();
+    std::string seen;
+    hoststub::serve(ORIGIN, [&](const HttpRequest &request) {
+        seen = request.body;
+        return ok(request);
+    });
+    FacilitatorConnection conn(ORIGIN);
+
+    HttpResponse response = postGathered(conn, "verify", "{\"x402Version\":1,", "\"paymentPayload\":{}}");
+    CHECK(response.success);
+    CHECK_EQ(seen, std::string("{\"x402Version\":1,\"paymentPayload\":{}}"));
+}
+
+TEST(stale_socket_is_reopened_once)
+{
+    reset();
+    hoststub::serve(ORIGIN, ok);
+    FacilitatorConnection conn(ORIGIN);
+
+    CHECK(conn.post("verify", "{}").success);
+    hoststub::dropConnections(ORIGIN);
+    CHECK(postGathered(conn, "verify", "{", "}").success);
+    CHECK_EQ(hoststub::serverStats(ORIGIN).connects, (uint32_t)2);
+}
+
+TEST(gathered_post_follows_relative_redirect)
+{
+    reset();
+    hoststub::serve(ORIGIN, [](const HttpRequest &request) {
+        if (request.path == "/old/verify")
+            return redirect(308, "/new/verify");
+        return ok(request);
+    });
+    FacilitatorConnection conn((String(ORIGIN) + "/old").c_str());
+
+    HttpResponse response = postGathered(conn, "verify", "{\"n\":", "7}");
+    CHECK_EQ(response.statusCode, 200);
+    CHECK(response.body.indexOf("\"echo\":{\"n\":7}") >= 0);
+    CHECK(response.body.indexOf("/new/verify") >= 0);
+}
+
+TEST(gathered_post_follows_redirect_to_another_host)
+{
+    reset();
+    hoststub::serve(ORIGIN, [](const HttpRequest &) { return redirect(307, "https://moved.example/v2/settle"); });
+    hoststub::serve(MOVED, ok);
+    FacilitatorConnection conn(ORIGIN);
+
+    HttpResponse response = postGathered(conn, "settle", "{\"n\":", "8}");
+    CHECK_EQ(response.statusCode, 200);
+    CHECK(response.body.indexOf("\"echo\":{\"n\":8}") >= 0);
+    CHECK(response.body.indexOf("/v2/settle") >= 0);
+    // A fresh socket to the new host, never the old one reused for it
+    CHECK_EQ(hoststub::serverStats(MOVED).connects, (uint32_t)1);
+}
+
+TEST(string_post_follows_redirects_too)
+{
+    reset();
+    hoststub::serve(ORIGIN, [](const HttpRequest &request) {
+        if (request.path == "/verify")
+            return redirect(301, "/v2/verify");
+        return ok(request);
+    });
+    FacilitatorConnection conn(ORIGIN);
+
+    HttpResponse response = conn.post("verify", "{\"n\":9}");
+    CHECK_EQ(response.statusCode, 200);
+    CHECK(response.body.indexOf("/v2/verify") >= 0);
+}
+
+TEST(see_other_and_loops_are_not_followed_with_a_body)
+{
+    reset();
+    hoststub::serve(ORIGIN, [](const HttpRequest &request) {
+        if (request.path == "/see")
+            return redirect(303, "/elsewhere");
+        return redirect(302, request.path.c_str());
+    });
+    FacilitatorConnection conn(ORIGIN);
+
+    // 303 would turn the POST into a GET without the payment
+    CHECK_EQ(postGathered(conn, "see", "{", "}").statusCode, 303);
+
+    uint32_t before = hoststub::serverStats(ORIGIN).requests;
+    HttpResponse response = postGathered(conn, "loop", "{", "}");
+    CHECK_EQ(response.statusCode, 302);
+    CHECK(!response.success);
+    CHECK_EQ(hoststub::serverStats(ORIGIN).requests - before, (uint32_t)(1 + FACILITATOR_MAX_REDIRECTS));
+}
@@ -0,0 +1,311 @@
+// FacilitatorRegistry against stand-in facilitators: ranking, failover,
+// the hedged /verify race and the route back to the base URL.
+
+#include "hosttest.h"
+#include "hoststub.h"
+#include "facilitatorconnection.h"
+#include "facilitatorregistry.h"
+#include "jsonscanner.h"
+#include <atomic>
+#include <mutex>
+
+using hoststub::HttpReply;
+using hoststub::HttpRequest;
+
+static const char *BASE = "https://base.example";
+static const char *FAST = "https://fast.example";
+static const char *SLOW = "https://slow.example";
+static const char *DOWN = "https://down.example";
+
+static HttpReply answer(const char *who, uint32_t delayMs = 0, int status = 200)
+{
+    HttpReply reply;
+    reply.status = status;
+    reply.delayMs = delayMs;
+    reply.body = std::string("{\"isValid\":true,\"from\":\"") + who + "\"}";
+    return reply;
+}
+
+static void reset()
+{
+    hoststub::stopAllServers();
+    hoststub::setWiFiStatus(WL_CONNECTED);
+    FacilitatorRegistry::instance().clear();
+    FacilitatorRegistry::instance().resetHealth();
+}
+
+static HttpResponse call(FacilitatorConnection &conn, const char *endpoint, const String &payload = "{}")
+{
+    GatherStream body;
+    body.add(payload);
+    return FacilitatorRegistry::instance().post(endpoint, body, nullptr, "", conn);
+}
+
+static bool from(const HttpResponse &response, const char *who)
+{
+    return response.success && response.body.indexOf(who) >= 0;
+}
+
+TEST(empty_registry_posts_to_base_url)
+{
+    reset();
+    hoststub::serve(BASE, [](const HttpRequest &) { return answer("base"); });
+    FacilitatorConnection conn(BASE);
+
+    HttpResponse response = call(conn, "verify");
+    CHECK(from(response, "base"));
+    CHECK_EQ(conn.getUrl(), BASE);
+}
+
+TEST(unmeasured_endpoints_are_probed_then_fastest_wins)
+{
+    reset();
+    hoststub::serve(FAST, [](const HttpRequest &) { return answer("fast", 5); });
+    hoststub::serve(SLOW, [](const HttpRequest &) { return answer("slow", 60); });
+    FacilitatorRegistry &registry = FacilitatorRegistry::instance();
+    registry.add(SLOW);
+    registry.add(FAST);
+    FacilitatorConnection conn(BASE);
+
+    // The first calls probe both endpoints
+    call(conn, "verify");
+    call(conn, "verify");
+    CHECK(hoststub::serverStats(FAST).requests >= 1);
+    CHECK(hoststub::serverStats(SLOW).requests >= 1);
+
+    uint8_t order[X402_MAX_FACILITATORS];
+    CHECK_EQ(registry.rank(order, X402_MAX_FACILITATORS), (uint8_t)2);
+    CHECK_EQ(order[0], (uint8_t)1);
+    CHECK(from(call(conn, "verify"), "fast"));
+}
+
+TEST(verify_and_settle_share_one_socket)
+{
+    reset();
+    // Far enough apart that scheduler jitter cannot reorder them
+    hoststub::serve(FAST, [](const HttpRequest &) { return answer("fast", 10); });
+    hoststub::serve(SLOW, [](const HttpRequest &) { return answer("slow", 40); });
+    FacilitatorRegistry &registry = FacilitatorRegistry::instance();
+    registry.add(FAST);
+    registry.add(SLOW);
+    FacilitatorConnection conn(BASE);
+    for (int i = 0; i < 4; ++i)
+    {
+        call(conn, "verify");
+        call(conn, "settle");
+    }
+
+    uint32_t connects = conn.getConnectCount();
+    for (int i = 0; i < 10; ++i)
+    {
+        CHECK(call(conn, "verify").success);
+        CHECK(call(conn, "settle").success);
+    }
+    // Sticky ranking: no reconnects between verify and settle
+    CHECK_EQ(conn.getConnectCount(), connects);
+}
+
+TEST(verify_fails_over_on_5xx)
+{
+    reset();
+    hoststub::serve(DOWN, [](const HttpRequest &) { return answer("down", 0, 503); });
+    hoststub::serve(FAST, [](const HttpRequest &) { return answer("fast"); });
+    FacilitatorRegistry &registry = FacilitatorRegistry::instance();
+    registry.add(DOWN);
+    registry.add(FAST);
+    FacilitatorConnection conn(BASE);
+
+    for (int i = 0; i < 5; ++i)
+        CHECK(from(call(conn, "verify"), "fast"));
+
+    FacilitatorEndpoint down;
+    CHECK(registry.getEndpoint(0, down));
+    CHECK(down.failures >= 1);
+    CHECK(down.consecutiveFailures >= 1);
+}
+
+TEST(settle_is_not_resent_after_it_left)
+{
+    reset();
+    hoststub::serve(DOWN, [](const HttpRequest &) {
+        HttpReply reply;
+        reply.error = HTTPC_ERROR_READ_TIMEOUT;
+        return reply;
+    });
+    hoststub::serve(FAST, [](const HttpRequest &) { return answer("fast"); });
+    FacilitatorRegistry &registry = FacilitatorRegistry::instance();
+    registry.add(DOWN);
+    registry.add(FAST);
+    FacilitatorConnection conn(BASE);
+
+    // DOWN is unmeasured and first in the table: it is probed first
+    HttpResponse response = call(conn, "settle");
+    CHECK_EQ(response.statusCode, HTTPC_ERROR_READ_TIMEOUT);
+    CHECK_EQ(hoststub::serverStats(FAST).requests, (uint32_t)0);
+}
+
+TEST(settle_fails_over_when_unsent)
+{
+    reset();
+    // No server for DOWN: the connection is refused before anything is sent
+    hoststub::serve(FAST, [](const HttpRequest &) { return answer("fast"); });
+    FacilitatorRegistry &registry = FacilitatorRegistry::instance();
+    registry.add(DOWN);
+    registry.add(FAST);
+    FacilitatorConnection conn(BASE);
+
+    CHECK(from(call(conn, "settle"), "fast"));
+}
+
+TEST(hedged_verify_takes_the_first_good_answer)
+{
+    reset();
+    std::atomic<int> slowDelay(5);
+    hoststub::serve(FAST, [](const HttpRequest &) { return answer("fast", 20); });
+    hoststub::serve(SLOW, [&](const HttpRequest &) { return answer("slow", (uint32_t)slowDelay.load()); });
+    FacilitatorRegistry &registry = FacilitatorRegistry::instance();
+    registry.add(SLOW);
+    registry.add(FAST);
+    CHECK(registry.enableHedging(30, 2));
+    CHECK(registry.isHedgingEnabled());
+    FacilitatorConnection conn(BASE);
+
+    // Measure both, then make the favourite stall
+    call(conn, "settle");
+    call(conn, "settle");
+    for (int i = 0; i < 4; ++i)
+        call(conn, "verify");
+    uint8_t order[X402_MAX_FACILITATORS];
+    registry.rank(order, X402_MAX_FACILITATORS);
+    CHECK_EQ(order[0], (uint8_t)0);
+
+    slowDelay = 1000;
+    unsigned long start = millis();
+    HttpResponse response = call(conn, "verify");
+    unsigned long took = millis() - start;
+    CHECK(from(response, "fast"));
+    // Backup after the hedge delay, answered 20ms later - well before the stalled primary
+    CHECK(took < 500);
+
+    // The next race, while the lost primary still holds its lane and the
+    // caller's socket: it takes the other lane and the backup answers. A
+    // scanner gets the body as well.
+    static const char *const keys[] = {"from"};
+    JsonCapture scanner(keys, 1);
+    GatherStream body;
+    body.add("{}", 2);
+    start = millis();
+    response = registry.post("verify", body, &scanner, "", conn);
+    CHECK(response.success);
+    CHECK_EQ(scanner.value(0), "fast");
+    CHECK(millis() - start < 500);
+
+    // Every lane is busy: another worker's verify goes unraced instead of
+    // waiting for one
+    uint32_t fastRequests = hoststub::serverStats(FAST).requests;
+    FacilitatorConnection other(BASE);
+    CHECK(from(call(other, "verify"), "slow"));
+    CHECK_EQ(hoststub::serverStats(FAST).requests, fastRequests);
+
+    // The lost legs finish in the background; the connection is usable after them
+    delay(1200);
+    CHECK(call(conn, "settle").success);
+    registry.enableHedging(0);
+    CHECK(!registry.isHedgingEnabled());
+}
+
+TEST(lost_leg_resends_from_its_own_copy)
+{
+    reset();
+    std::atomic<bool> stall(false);
+    std::mutex resentLock;
+    std::string resent;
+    hoststub::serve(FAST, [](const HttpRequest &) { return answer("fast", 20); });
+    hoststub::serve(SLOW, [&](const HttpRequest &request) {
+        if (!stall)
+            return answer("slow", 5);
+        // The kept-alive socket turns out dead after a while: sent again
+        if (request.reusedSocket)
+        {
+            HttpReply lost = answer("slow", 300);
+            lost.error = HTTPC_ERROR_CONNECTION_LOST;
+            return lost;
+        }
+        std::lock_guard<std::mutex> guard(resentLock);
+        resent = request.body;
+        return answer("slow");
+    });
+    FacilitatorRegistry &registry = FacilitatorRegistry::instance();
+    registry.add(SLOW);
+    registry.add(FAST);
+    CHECK(registry.enableHedging(30));
+    FacilitatorConnection conn(BASE);
+    call(conn, "settle");
+    call(conn, "settle");
+    call(conn, "verify");
+
+    // The backup wins and the caller's buffers are gone before the primary resends
+    stall = true;
+    char payload[] = "{\"payload\":\"kept for the lost leg\"}";
+    GatherStream body;
+    body.add(payload, 10);
+    body.add(payload + 10, strlen(payload) - 10);
+    CHECK(from(registry.post("verify", body, nullptr, "", conn), "fast"));
+    memset(payload, 'x', strlen(payload));
+
+    // The dead socket shows after 300ms; allow for a loaded machine
+    auto resentBody = [&] {
+        std::lock_guard<std::mutex> guard(resentLock);
+        return resent;
+    };
+    for (int i = 0; i < 300 && resentBody().empty(); ++i)
+        delay(10);
+    CHECK_EQ(resentBody(), std::string("{\"payload\":\"kept for the lost leg\"}"));
+    registry.enableHedging(0);
+}
+
+TEST(timeouts_above_65535ms_are_kept)
+{
+    reset();
+    FacilitatorRegistry &registry = FacilitatorRegistry::instance();
+    CHECK_EQ(registry.add(SLOW, 70000, 120000), (int8_t)0);
+    FacilitatorEndpoint endpoint;
+    CHECK(registry.getEndpoint(0, endpoint));
+    CHECK_EQ(endpoint.verifyTimeoutMs, (uint32_t)70000);
+    CHECK_EQ(endpoint.settleTimeoutMs, (uint32_t)120000);
+}
+
+TEST(hedged_verify_backup_starts_early_when_primary_fails)
+{
+    reset();
+    hoststub::serve(FAST, [](const HttpRequest &) { return answer("fast", 1); });
+    hoststub::serve(DOWN, [](const HttpRequest &) { return answer("down", 0, 500); });
+    FacilitatorRegistry &registry = FacilitatorRegistry::instance();
+    registry.add(DOWN);
+    registry.add(FAST);
+    CHECK(registry.enableHedging(2000));
+    FacilitatorConnection conn(BASE);
+
+    // DOWN is probed first; its 500 wakes the backup without the 2s delay
+    unsigned long start = millis();
+    HttpResponse response = call(conn, "verify");
+    CHECK(from(response, "fast"));
+    CHECK(millis() - start < 1000);
+    registry.enableHedging(0);
+}
+
+TEST(clear_points_the_connection_back_at_its_base_url)
+{
+    reset();
+    hoststub::serve(BASE, [](const HttpRequest &) { return answer("base"); });
+    hoststub::serve(FAST, [](const HttpRequest &) { return answer("fast"); });
+    FacilitatorRegistry &registry = FacilitatorRegistry::instance();
+    registry.add(FAST);
+    FacilitatorConnection conn(BASE);
+
+    CHECK(from(call(conn, "verify"), "fast"));
+    CHECK_EQ(conn.getUrl(), FAST);
+    registry.clear();
+    CHECK(from(call(conn, "verify"), "base"));
+    CHECK_EQ(conn.getUrl(), BASE);
+}
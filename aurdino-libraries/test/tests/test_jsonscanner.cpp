@@ -0,0 +1,259 @@
+// JsonScanner: values at any depth, strings that look like keys, escapes,
+// and input split at every possible point. The fuzz cases mutate real
+// payloads and require any split to agree with a single feed.
+
+#include "hosttest.h"
+#include "x402fixture.h"
+#include "jsonscanner.h"
+#include <algorithm>
+#include <random>
+
+static const char *const KEYS[] = {"scheme", "network", "signature", "from", "to",
+                                   "value", "validBefore", "nonce", "extra"};
+static const uint8_t KEY_COUNT = sizeof(KEYS) / sizeof(KEYS[0]);
+
+// Everything a scan produced, for comparing two scans of the same bytes
+struct Outcome
+{
+    bool accepted = true; // every feed() returned true
+    bool complete = false;
+    bool error = false;
+    std::string values[KEY_COUNT];
+    JsonValueType types[KEY_COUNT] = {};
+
+    bool operator==(const Outcome &other) const
+    {
+        if (accepted != other.accepted || complete != other.complete || error != other.error)
+            return false;
+        for (uint8_t i = 0; i < KEY_COUNT; ++i)
+        {
+            if (values[i] != other.values[i] || types[i] != other.types[i])
+                return false;
+        }
+        return true;
+    }
+};
+
+static std::ostream &operator<<(std::ostream &out, const Outcome &o)
+{
+    out << "{accepted:" << o.accepted << " complete:" << o.complete << " error:" << o.error;
+    for (uint8_t i = 0; i < KEY_COUNT; ++i)
+    {
+        if (o.types[i] != JSON_NONE)
+            out << " " << KEYS[i] << "=" << o.values[i];
+    }
+    return out << "}";
+}
+
+// Feed json cut at the given offsets (ascending)
+static Outcome scan(const std::string &json, const std::vector<size_t> &cuts = {})
+{
+    JsonCapture capture(KEYS, KEY_COUNT, 1024);
+    Outcome outcome;
+    size_t at = 0;
+    std::vector<size_t> ends = cuts;
+    ends.push_back(json.size());
+    for (size_t end : ends)
+    {
+        outcome.accepted &= capture.feed(json.data() + at, end - at);
+        at = end;
+    }
+    outcome.complete = capture.isComplete();
+    outcome.error = capture.hasError();
+    for (uint8_t i = 0; i < KEY_COUNT; ++i)
+    {
+        outcome.values[i] = capture.value(i).c_str();
+        outcome.types[i] = capture.type(i);
+    }
+    return outcome;
+}
+
+static std::string view(const JsonView &value)
+{
+    return value.found() ? std::string(value.data, value.length) : std::string("(none)");
+}
+
+TEST(finds_values_at_any_depth)
+{
+    std::string json = x402fixture::paymentJson(0x42);
+    Outcome outcome = scan(json);
+    CHECK(outcome.accepted);
+    CHECK(!outcome.error);
+    CHECK_EQ(outcome.values[0], std::string("exact"));
+    CHECK_EQ(outcome.types[0], JSON_STRING);
+    CHECK_EQ(outcome.values[3], std::string(x402fixture::PAYER));
+    CHECK_EQ(outcome.values[4], std::string(x402fixture::PAY_TO));
+    CHECK_EQ(outcome.values[5], std::string(x402fixture::PRICE));
+    CHECK_EQ(outcome.values[7].substr(outcome.values[7].size() - 2), std::string("42"));
+    CHECK_EQ(outcome.types[8], JSON_NONE);
+}
+
+TEST(containers_and_literals_keep_their_delimiters)
+{
+    static const char *const keys[] = {"a", "b", "c", "d", "e"};
+    const char *json = "{\"a\": {\"x\": [1, 2]}, \"b\": [ {\"y\": \"]\"} ], \"c\": -1.5e3, \"d\": null, \"e\": true}";
+    JsonView values[5];
+    CHECK_EQ(scanJson(json, strlen(json), keys, values, 5), (uint8_t)5);
+    CHECK_EQ(view(values[0]), std::string("{\"x\": [1, 2]}"));
+    CHECK_EQ(values[0].type, JSON_OBJECT);
+    CHECK_EQ(view(values[1]), std::string("[ {\"y\": \"]\"} ]"));
+    CHECK_EQ(values[1].type, JSON_ARRAY);
+    CHECK_EQ(view(values[2]), std::string("-1.5e3"));
+    CHECK_EQ(values[2].type, JSON_LITERAL);
+    CHECK(values[3].equals("null"));
+    CHECK(values[4].isTrue());
+}
+
+TEST(keys_inside_strings_do_not_match)
+{
+    static const char *const keys[] = {"transaction"};
+    const char *json = "{\"errorReason\":\"no \\\"transaction\\\": here\",\"note\":\"transaction\",\"transaction\":\"0xabc\"}";
+    JsonView value;
+    CHECK_EQ(scanJson(json, strlen(json), keys, &value, 1), (uint8_t)1);
+    CHECK_EQ(view(value), std::string("0xabc"));
+}
+
+TEST(first_occurrence_wins_and_escapes_stay_raw)
+{
+    static const char *const keys[] = {"k"};
+    const char *json = "{\"outer\":{\"k\":\"a\\\"b\\\\\"},\"k\":\"second\"}";
+    JsonView value;
+    CHECK_EQ(scanJson(json, strlen(json), keys, &value, 1), (uint8_t)1);
+    CHECK_EQ(view(value), std::string("a\\\"b\\\\"));
+}
+
+TEST(prefix_keys_do_not_match)
+{
+    static const char *const keys[] = {"to"};
+    const char *json = "{\"total\":1,\"t\":2,\"to\":\"0x1\"}";
+    JsonView value;
+    CHECK_EQ(scanJson(json, strlen(json), keys, &value, 1), (uint8_t)1);
+    CHECK_EQ(view(value), std::string("0x1"));
+}
+
+TEST(stops_after_the_top_level_value)
+{
+    static const char *const keys[] = {"late"};
+    const char *json = "{\"a\":1} {\"late\":2}";
+    JsonView value;
+    CHECK_EQ(scanJson(json, strlen(json), keys, &value, 1), (uint8_t)0);
+
+    JsonCapture capture(keys, 1);
+    CHECK(capture.feed("{\"a\":1}", 7));
+    CHECK(capture.isComplete());
+    CHECK(capture.feed("garbage", 7));
+    CHECK(!capture.hasError());
+}
+
+TEST(malformed_input_is_reported)
+{
+    // A key that never appears, so the scan cannot stop early
+    static const char *const keys[] = {"missing"};
+    for (const char *json : {"{\"a\" 1}", "{\"a\":1,}", "[1 2]", "{]", "}", "{\"a\":tru\"e\"}"})
+    {
+        JsonCapture capture(keys, 1);
+        capture.feed(json, strlen(json));
+        if (!capture.hasError())
+            hosttest::fail(__FILE__, __LINE__, std::string("accepted ") + json);
+    }
+}
+
+TEST(reset_starts_a_new_document)
+{
+    static const char *const keys[] = {"a"};
+    JsonCapture capture(keys, 1);
+    CHECK(!capture.feed("]", 1));
+    capture.reset();
+    CHECK(capture.feed("{\"a\":\"x\"}", 9));
+    CHECK(capture.isComplete());
+    CHECK_EQ(capture.value(0), "x");
+}
+
+TEST(long_values_are_truncated)
+{
+    static const char *const keys[] = {"v"};
+    JsonCapture capture(keys, 1, 8);
+    std::string json = "{\"v\":\"" + std::string(100, 'z') + "\"}";
+    CHECK(capture.feed(json.data(), json.size()));
+    CHECK_EQ(capture.value(0), "zzzzzzzz");
+}
+
+TEST(every_single_split_agrees)
+{
+    std::string json = x402fixture::paymentJson(7) + " ";
+    json.insert(json.find("\"payload\""), "\"extra\":{\"to\":\"not me\\\"\",\"list\":[1,{\"a\":[]}]},");
+    Outcome whole = scan(json);
+    CHECK(!whole.error);
+    CHECK_EQ(whole.values[8].substr(0, 6), std::string("{\"to\":"));
+    for (size_t cut = 0; cut <= json.size(); ++cut)
+    {
+        Outcome split = scan(json, {cut});
+        if (!(split == whole))
+        {
+            CHECK_EQ(split, whole);
+            break;
+        }
+    }
+    // One byte at a time
+    std::vector<size_t> cuts;
+    for (size_t cut = 1; cut < json.size(); ++cut)
+        cuts.push_back(cut);
+    CHECK_EQ(scan(json, cuts), whole);
+}
+
+TEST(fuzz_random_splits_and_mutations)
+{
+    static const char ALPHABET[] = "{}[]\":,\\ -.0123456789aetrufnlsx";
+    std::mt19937 rng(402);
+    std::string seeds[] = {
+        x402fixture::paymentJson(1),
+        "{\"success\":true,\"errorReason\":null,\"transaction\":\"0x01\",\"network\":\"base\",\"payer\":\"0x2\"}",
+        "{\"isValid\":false,\"invalidReason\":\"bad \\\"sig\\\"\",\"extra\":[[[]],{\"to\":{}}]}",
+    };
+
+    for (int round = 0; round < 20000; ++round)
+    {
+        std::string json = seeds[round % 3];
+        // Mutate: replace, insert or delete a few bytes
+        int edits = (int)(rng() % 4);
+        for (int e = 0; e < edits && !json.empty(); ++e)
+        {
+            size_t at = rng() % json.size();
+            char c = ALPHABET[rng() % (sizeof(ALPHABET) - 1)];
+            switch (rng() % 3)
+            {
+            case 0: json[at] = c; break;
+            case 1: json.insert(json.begin() + at, c); break;
+            default: json.erase(at, 1); break;
+            }
+        }
+
+        std::vector<size_t> cuts;
+        size_t pieces = rng() % 6;
+        for (size_t p = 0; p < pieces; ++p)
+            cuts.push_back(rng() % (json.size() + 1));
+        std::sort(cuts.begin(), cuts.end());
+
+        Outcome whole = scan(json);
+        Outcome split = scan(json, cuts);
+        if (!(split == whole))
+        {
+            hosttest::fail(__FILE__, __LINE__, "split scan differs for " + json + ": " + hosttest::show(split) +
+                                                   " vs " + hosttest::show(whole));
+            break;
+        }
+
+        // Every value scanJson saw close matches the streamed capture
+        JsonView views[KEY_COUNT];
+        scanJson(json.data(), json.size(), KEYS, views, KEY_COUNT);
+        for (uint8_t i = 0; i < KEY_COUNT; ++i)
+        {
+            if (views[i].found() && (views[i].type != whole.types[i] || view(views[i]) != whole.values[i]))
+            {
+                hosttest::fail(__FILE__, __LINE__, std::string("scanJson differs on ") + KEYS[i] + " for " + json);
+                round = 1 << 30;
+                break;
+            }
+        }
+    }
+}
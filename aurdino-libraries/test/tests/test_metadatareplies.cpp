@@ -0,0 +1,92 @@
+// Pre-rendered [PRICE]/[OPTIONS]/[CONFIG] replies: served without
+// allocating, and rendered again after enableOptions(), enableRecuring() or
+// allowCustomised() - read directly and by a central over BLE.
+
+#include "hosttest.h"
+#include "x402fixture.h"
+
+using namespace x402fixture;
+
+// The single reply a command gets over BLE
+static std::string ask(const char *command)
+{
+    hoststub::bleWrite(rx(), CENTRAL, command, strlen(command));
+    std::vector<std::string> reply = received(CENTRAL, 1);
+    return reply.empty() ? std::string() : reply[0];
+}
+
+static std::string config(X402Ble &ble, uint16_t mtu = 247)
+{
+    char out[256];
+    size_t length = ble.renderConfigReply(mtu, out, sizeof(out));
+    return std::string(out, length);
+}
+
+static std::string configFor(uint32_t frequency, bool custom, uint16_t mtu = 247)
+{
+    return "CONFIG://{\"frequency\": " + std::to_string(frequency) +
+           ", \"allowCustomContent\": " + (custom ? "true" : "false") + ", \"mtu\": " + std::to_string(mtu) +
+           ", \"binary\": " + std::to_string(X402BLE_FRAME_VERSION) + "}";
+}
+
+TEST(rendered_replies_are_served_without_allocating)
+{
+    X402Ble &ble = device();
+    std::string price = std::string("402://{\"price\": \"") + PRICE + "\", \"payTo\": \"" + PAY_TO +
+                        "\", \"network\": \"base-sepolia\"}";
+    CHECK_EQ(std::string(ble.getPriceReply().c_str()), price);
+    CHECK_EQ(std::string(ble.getOptionsReply().c_str()), std::string("OPTIONS://"));
+    CHECK_EQ(config(ble), configFor(0, false));
+
+    uint64_t allocations = hoststub::heapStats().allocations;
+    const char *kept = ble.getPriceReply().c_str();
+    char out[256];
+    for (int i = 0; i < 10; ++i)
+    {
+        CHECK(ble.getPriceReply().c_str() == kept);
+        ble.getOptionsReply();
+        CHECK(ble.renderConfigReply(100 + i, out, sizeof(out)) > 0);
+    }
+    CHECK_EQ(hoststub::heapStats().allocations, allocations);
+
+    // Anything unrecognised gets the price
+    CHECK_EQ(ask("[PRICE?]"), price);
+    CHECK_EQ(ask("[CONFIG]"), configFor(0, false));
+}
+
+TEST(enable_options_renders_options_again)
+{
+    X402Ble &ble = device();
+    String colours[] = {"red", "green", "blue"};
+    ble.enableOptions(colours, 3);
+    CHECK_EQ(std::string(ble.getOptionsReply().c_str()), std::string("OPTIONS://red,green,blue"));
+    CHECK_EQ(ask("[OPTIONS]"), std::string("OPTIONS://red,green,blue"));
+
+    // Changed between two requests from the same central
+    ble.enableOptions(colours + 2, 1);
+    CHECK_EQ(ask("[OPTIONS]"), std::string("OPTIONS://blue"));
+    CHECK_EQ(std::string(ble.getOptionsReply().c_str()), std::string("OPTIONS://blue"));
+
+    ble.enableOptions(nullptr, 0);
+    CHECK_EQ(ask("[OPTIONS]"), std::string("OPTIONS://"));
+}
+
+TEST(enable_recuring_and_allow_customised_render_config_again)
+{
+    X402Ble &ble = device();
+    CHECK_EQ(ask("[CONFIG]"), configFor(0, false));
+
+    ble.enableRecuring(60);
+    CHECK_EQ(config(ble), configFor(60, false));
+    CHECK_EQ(ask("[CONFIG]"), configFor(60, false));
+
+    ble.allowCustomised();
+    CHECK_EQ(ask("[CONFIG]"), configFor(60, true));
+    CHECK_EQ(config(ble, 517), configFor(60, true, 517));
+
+    ble.enableRecuring(0);
+    CHECK_EQ(ask("[CONFIG]"), configFor(0, true));
+
+    // None of it touches the price
+    CHECK_EQ(ask("[PRICE?]"), std::string(ble.getPriceReply().c_str()));
+}
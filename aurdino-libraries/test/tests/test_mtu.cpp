@@ -0,0 +1,159 @@
+// Per-central MTU: what each connection negotiated, CONFIG:// reporting it,
+// replies cut into fragments that fill but never exceed that central's
+// notification size, and payment writes sized from a large MTU.
+
+#include "hosttest.h"
+#include "x402fixture.h"
+
+using namespace x402fixture;
+
+// Every notification of the next reply to handle, and the reply put back
+// together from its FRAG:<i>/<n>: pieces
+struct Reply
+{
+    std::vector<std::string> notifications;
+    std::string text;
+    unsigned fragments = 0;
+};
+
+static Reply readReply(uint16_t handle)
+{
+    Reply reply;
+    for (;;)
+    {
+        std::vector<std::string> next = received(handle, 1);
+        if (next.empty())
+            return reply;
+        reply.notifications.push_back(next[0]);
+        unsigned index = 0, count = 0;
+        int header = 0;
+        if (sscanf(next[0].c_str(), "FRAG:%u/%u:%n", &index, &count, &header) != 2 || header == 0)
+        {
+            reply.text = next[0];
+            return reply;
+        }
+        reply.text += next[0].substr(header);
+        reply.fragments = count;
+        if (index == count)
+            return reply;
+    }
+}
+
+static std::vector<String> longOptions()
+{
+    std::vector<String> options;
+    for (int i = 0; i < 48; ++i)
+        options.push_back(String(("option-with-a-rather-long-name-" + std::to_string(i)).c_str()));
+    return options;
+}
+
+TEST(each_central_keeps_its_own_mtu)
+{
+    X402Ble &ble = device();
+    NimBLEServer *server = NimBLEDevice::getServer();
+    CHECK_EQ(NimBLEDevice::getMTU(), (uint16_t)X402BLE_PREFERRED_MTU);
+    server->connect(2, 517);
+    server->connect(3, 0); // never exchanged MTU
+
+    CHECK_EQ(ble.getPeerMTU(CENTRAL), (uint16_t)247);
+    CHECK_EQ(ble.getPeerMTU(2), (uint16_t)517);
+    CHECK_EQ(ble.getPeerMTU(3), (uint16_t)23);
+    CHECK_EQ(ble.getPeerMTU(BLE_HS_CONN_HANDLE_NONE), (uint16_t)23);
+    CHECK_EQ(ble.getMaxNotifySize(CENTRAL), (size_t)244);
+    CHECK_EQ(ble.getMaxNotifySize(2), (size_t)514);
+    CHECK_EQ(ble.getMaxNotifySize(3), (size_t)20);
+
+    // CONFIG:// tells each central its own
+    for (uint16_t handle : {(uint16_t)CENTRAL, (uint16_t)2, (uint16_t)3})
+    {
+        hoststub::bleWrite(rx(), handle, "[CONFIG]", 8);
+        std::string config = readReply(handle).text;
+        std::string mtu = "\"mtu\": " + std::to_string(ble.getPeerMTU(handle)) + ",";
+        if (config.find(mtu) == std::string::npos)
+            hosttest::fail(__FILE__, __LINE__, "central " + std::to_string(handle) + ": " + config);
+    }
+    server->disconnect(2);
+    server->disconnect(3);
+}
+
+TEST(fragments_fill_each_centrals_mtu)
+{
+    X402Ble &ble = device();
+    std::vector<String> options = longOptions();
+    ble.enableOptions(options.data(), options.size());
+    std::string expected = ble.getOptionsReply().c_str();
+    CHECK(expected.size() > 1500);
+
+    uint16_t handle = 10;
+    for (uint16_t mtu : {23, 100, 247, 517})
+    {
+        NimBLEDevice::getServer()->connect(++handle, mtu);
+        size_t maxNotify = mtu - 3;
+        hoststub::bleWrite(rx(), handle, "[OPTIONS]", 9);
+        Reply reply = readReply(handle);
+        CHECK_EQ(reply.text, expected);
+
+        // The header is sized for n's digits: every fragment but the last
+        // carries the same payload, and those numbered with as many digits
+        // as n fill the notification exactly
+        std::string count = std::to_string(reply.fragments);
+        size_t perFragment = maxNotify - (7 + 2 * count.size());
+        CHECK_EQ(reply.fragments, (unsigned)((expected.size() + perFragment - 1) / perFragment));
+        CHECK_EQ(reply.notifications.size(), (size_t)reply.fragments);
+        for (size_t i = 0; i < reply.notifications.size(); ++i)
+        {
+            std::string index = std::to_string(i + 1);
+            size_t length = reply.notifications[i].size();
+            size_t payload = length - (7 + index.size() + count.size());
+            bool last = i + 1 == reply.notifications.size();
+            bool full = index.size() == count.size();
+            if (length > maxNotify || (!last && payload != perFragment) || (!last && full && length != maxNotify))
+                hosttest::fail(__FILE__, __LINE__,
+                               "MTU " + std::to_string(mtu) + " fragment " + index + " is " +
+                                   std::to_string(length) + " bytes");
+        }
+        NimBLEDevice::getServer()->disconnect(handle);
+    }
+    ble.enableOptions(nullptr, 0);
+}
+
+TEST(reply_that_fits_is_not_fragmented)
+{
+    X402Ble &ble = device();
+    NimBLEServer *server = NimBLEDevice::getServer();
+    // OPTIONS://a,b... sized to exactly one notification at MTU 100, then one byte over
+    for (size_t extra : {0, 1})
+    {
+        String option(std::string(97 - 10 + extra, 'o').c_str());
+        ble.enableOptions(&option, 1);
+        CHECK_EQ(ble.getOptionsReply().length(), (unsigned)(97 + extra));
+        server->connect(20, 100);
+        hoststub::bleWrite(rx(), 20, "[OPTIONS]", 9);
+        Reply reply = readReply(20);
+        CHECK_EQ(reply.text, std::string(ble.getOptionsReply().c_str()));
+        CHECK_EQ(reply.notifications.size(), (size_t)(extra ? 2 : 1));
+        server->disconnect(20);
+    }
+    ble.enableOptions(nullptr, 0);
+}
+
+TEST(payment_written_in_mtu_sized_chunks)
+{
+    serveFacilitator();
+    device();
+    NimBLEDevice::getServer()->connect(30, 517);
+    // Two writes of up to 514 bytes instead of five of 180
+    std::vector<std::string> chunks = paymentChunks(paymentJson(0x1800), "\"\"", "[]", 514 - 15);
+    CHECK_EQ(chunks.size(), (size_t)2);
+    for (const std::string &chunk : chunks)
+        hoststub::bleWrite(rx(), 30, chunk, 517);
+
+    bool complete = false;
+    for (int i = 0; i < 6 && !complete; ++i)
+    {
+        for (const std::string &reply : received(30, 1))
+            complete |= reply.compare(0, 30, "PAYMENT:COMPLETE VERIFIED:true") == 0;
+    }
+    CHECK(complete);
+    NimBLEDevice::getServer()->disconnect(30);
+}
@@ -0,0 +1,120 @@
+// The constexpr network table against the std::map tables it replaced, and
+// runtime registration on top of it.
+
+#include "hosttest.h"
+#include "X402Aurdino.h"
+#include <map>
+#include <string>
+
+// The former EvmNetworkToChainId / EvmUSDC maps, verbatim
+static const std::map<std::string, uint32_t> OldChainIds = {
+    {"base-sepolia", 84532},
+    {"base", 8453},
+    {"avalanche-fuji", 43113},
+    {"avalanche", 43114},
+    {"iotex", 4689},
+    {"sei", 1329},
+    {"sei-testnet", 1328},
+    {"polygon", 137},
+    {"polygon-amoy", 80002},
+    {"peaq", 3338},
+};
+
+static const std::map<uint32_t, std::pair<std::string, std::string>> OldUsdc = {
+    {84532, {"0x036CbD53842c5426634e7929541eC2318f3dCF7e", "USDC"}},
+    {8453, {"0x833589fCD6eDb6E08f4c7C32D4f71b54bdA02913", "USD Coin"}},
+    {43113, {"0x5425890298aed601595a70AB815c96711a31Bc65", "USD Coin"}},
+    {43114, {"0xB97EF9Ef8734C71904D8002F8b6Bc66Dd9c48a6E", "USD Coin"}},
+    {4689, {"0xcdf79194c6c285077a58da47641d4dbe51f63542", "Bridged USDC"}},
+    {1328, {"0x4fcf1784b31630811181f670aea7a7bef803eaed", "USDC"}},
+    {1329, {"0xe15fc38f6d8c56af07bbcbe3baf5708a2bf42392", "USDC"}},
+    {137, {"0x3c499c542cef5e3811e1192ce70d8cc03d5c3359", "USD Coin"}},
+    {80002, {"0x41E94Eb019C0762f9Bfcf9Fb1E58725BfB0e7582", "USDC"}},
+    {3338, {"0xbbA60da06c2c5424f03f7434542280FCAd453d10", "USDC"}},
+};
+
+TEST(table_matches_the_old_maps)
+{
+    CHECK_EQ(EvmNetworkCount, OldChainIds.size());
+    for (size_t i = 0; i < EvmNetworkCount; ++i)
+    {
+        auto chainId = OldChainIds.find(EvmNetworks[i].name);
+        CHECK(chainId != OldChainIds.end());
+        if (chainId == OldChainIds.end())
+            continue;
+        CHECK_EQ(EvmNetworks[i].chainId, chainId->second);
+        const auto &usdc = OldUsdc.at(chainId->second);
+        CHECK_EQ(std::string(EvmNetworks[i].usdc.usdcAddress), usdc.first);
+        CHECK_EQ(std::string(EvmNetworks[i].usdc.usdcName), usdc.second);
+    }
+}
+
+TEST(lookups_agree_with_the_old_maps)
+{
+    for (const auto &network : OldChainIds)
+    {
+        const auto &usdc = OldUsdc.at(network.second);
+
+        const EvmNetworkInfo *byName = findEvmNetwork(network.first.c_str());
+        CHECK(byName != nullptr);
+        CHECK_EQ(findEvmNetworkByChainId(network.second), byName);
+        CHECK_EQ(getChainIdForNetwork(network.first.c_str()), network.second);
+
+        AssetInfo asset = getAssetForNetwork(network.first.c_str());
+        CHECK_EQ(std::string(asset.usdcAddress), usdc.first);
+        CHECK_EQ(std::string(asset.usdcName), usdc.second);
+    }
+}
+
+TEST(unknown_networks_are_empty)
+{
+    CHECK(findEvmNetwork("ethereum") == nullptr);
+    CHECK(findEvmNetwork(nullptr) == nullptr);
+    // Prefixes and neighbours of real names must miss the binary search
+    CHECK(findEvmNetwork("base-") == nullptr);
+    CHECK(findEvmNetwork("a") == nullptr);
+    CHECK(findEvmNetwork("zzz") == nullptr);
+    CHECK(findEvmNetworkByChainId(1) == nullptr);
+    CHECK_EQ(getChainIdForNetwork("ethereum"), (uint32_t)0);
+    AssetInfo asset = getAssetForNetwork("ethereum");
+    CHECK_EQ(std::string(asset.usdcAddress), std::string(""));
+    CHECK_EQ(std::string(asset.usdcName), std::string(""));
+}
+
+TEST(registered_networks_add_and_override)
+{
+    CHECK(registerEvmNetwork("ethereum", 1, "0xA0b86991c6218b36c1d19D4a2e9Eb0cE3606eB48", "USD Coin"));
+    CHECK_EQ(getChainIdForNetwork("ethereum"), (uint32_t)1);
+    CHECK_EQ(std::string(findEvmNetworkByChainId(1)->name), std::string("ethereum"));
+
+    // Overriding a built-in network shadows it by name and by chain ID
+    CHECK(registerEvmNetwork("base-sepolia", 84532, "0x0000000000000000000000000000000000000001", "Test USDC"));
+    CHECK_EQ(std::string(getAssetForNetwork("base-sepolia").usdcName), std::string("Test USDC"));
+    CHECK_EQ(std::string(findEvmNetworkByChainId(84532)->usdc.usdcName), std::string("Test USDC"));
+
+    // Re-registering replaces in place rather than taking another slot
+    CHECK(registerEvmNetwork("ethereum", 1, "0xA0b86991c6218b36c1d19D4a2e9Eb0cE3606eB48", "USDC"));
+    CHECK_EQ(std::string(getAssetForNetwork("ethereum").usdcName), std::string("USDC"));
+
+    // Strings are copied, not borrowed
+    char name[] = "scratch";
+    CHECK(registerEvmNetwork(name, 99, "0x02", "S"));
+    name[0] = 'x';
+    CHECK_EQ(getChainIdForNetwork("scratch"), (uint32_t)99);
+
+    // Bad input and a full table are refused
+    CHECK(!registerEvmNetwork("", 5, "0x", "X"));
+    CHECK(!registerEvmNetwork(std::string(40, 'n').c_str(), 5, "0x", "X"));
+    for (int i = 0; i < X402_MAX_CUSTOM_NETWORKS; ++i)
+        registerEvmNetwork(("extra-" + std::to_string(i)).c_str(), 1000 + i, "0x03", "E");
+    CHECK(!registerEvmNetwork("one-too-many", 2000, "0x04", "F"));
+
+    // The built-in table itself is untouched
+    const EvmNetworkInfo *builtIn = nullptr;
+    for (size_t i = 0; i < EvmNetworkCount; ++i)
+    {
+        if (EvmNetworks[i].chainId == 84532)
+            builtIn = &EvmNetworks[i];
+    }
+    CHECK_EQ(std::string(builtIn->usdc.usdcName), std::string("USDC"));
+}
@@ -0,0 +1,291 @@
+// NonceCache: claim / mark / release, eviction and expiry, terms checked on
+// a hit, the NVS blob that carries settled entries across a reboot, and a
+// retried payment answered from the cache over BLE (but not a tampered one).
+
+#include "hosttest.h"
+#include "x402fixture.h"
+#include "NonceCache.h"
+#include <Preferences.h>
+
+using namespace x402fixture;
+
+static const char *TX = "0x00000000000000000000000000000000000000000000000000000000000000ab";
+
+static uint64_t key(uint32_t n)
+{
+    std::string nonce = "0x" + std::to_string(n);
+    return NonceCache::keyFor(PAYER, strlen(PAYER), nonce.c_str(), nonce.size());
+}
+
+static uint32_t later() { return (uint32_t)time(nullptr) + 600; }
+
+TEST(keys_ignore_hex_case)
+{
+    std::string upper = PAYER, lower = PAYER;
+    for (char &c : lower)
+        c = (char)tolower(c);
+    CHECK_EQ(NonceCache::keyFor(upper.c_str(), upper.size(), "0xAB", 4),
+             NonceCache::keyFor(lower.c_str(), lower.size(), "0xab", 4));
+    CHECK(NonceCache::keyFor(PAYER, strlen(PAYER), "0xab", 4) != NonceCache::keyFor(PAYER, strlen(PAYER), "0xac", 4));
+
+    uint64_t fromJson = 0;
+    uint32_t validBefore = 0;
+    std::string json = paymentJson(0x5, PRICE, 1900000000);
+    CHECK(NonceCache::keyForPayment(json.c_str(), fromJson, validBefore));
+    CHECK_EQ(validBefore, (uint32_t)1900000000);
+    std::string nonce = "0x" + std::string(48, '0') + "0000000000000005";
+    CHECK_EQ(fromJson, NonceCache::keyFor(PAYER, strlen(PAYER), nonce.c_str(), nonce.size()));
+
+    // No nonce, no key; a huge validBefore means never
+    CHECK(!NonceCache::keyForPayment("{\"from\":\"0x1\"}", fromJson, validBefore));
+    std::string forever = paymentJson(0x6);
+    forever.replace(forever.find("\"validBefore\":\"") + 15, 10, "99999999999999999999");
+    CHECK(NonceCache::keyForPayment(forever.c_str(), fromJson, validBefore));
+    CHECK_EQ(validBefore, (uint32_t)UINT32_MAX);
+}
+
+TEST(claim_then_mark_then_replay)
+{
+    NonceCache cache;
+    String tx;
+    CHECK_EQ(cache.claim(key(1), later()), NonceCache::NONE);
+    // A second worker with the same authorization waits for the first
+    CHECK_EQ(cache.claim(key(1), later()), NonceCache::IN_FLIGHT);
+    cache.markVerified(key(1));
+    CHECK_EQ(cache.claim(key(1), later()), NonceCache::VERIFIED);
+    cache.markSettled(key(1), TX);
+    CHECK_EQ(cache.claim(key(1), later(), &tx), NonceCache::SETTLED);
+    CHECK_EQ(tx, TX);
+    CHECK_EQ(cache.size(), (uint8_t)1);
+
+    // A malformed hash is not kept, but the settlement is
+    CHECK_EQ(cache.claim(key(2), later()), NonceCache::NONE);
+    cache.markSettled(key(2), "pending");
+    CHECK_EQ(cache.claim(key(2), later(), &tx), NonceCache::SETTLED);
+    CHECK_EQ(tx, "");
+}
+
+TEST(release_lets_a_corrected_retry_through)
+{
+    NonceCache cache;
+    CHECK_EQ(cache.claim(key(3), later()), NonceCache::NONE);
+    cache.release(key(3));
+    CHECK_EQ(cache.size(), (uint8_t)0);
+    CHECK_EQ(cache.claim(key(3), later()), NonceCache::NONE);
+    // Unknown keys are ignored
+    cache.release(key(99));
+    cache.markSettled(key(98), TX);
+    CHECK_EQ(cache.size(), (uint8_t)1);
+}
+
+static void settle(NonceCache &cache, uint64_t k, uint32_t validBefore)
+{
+    cache.claim(k, validBefore);
+    cache.markSettled(k, TX);
+}
+
+TEST(full_cache_evicts_oldest_and_expired_first)
+{
+    NonceCache cache;
+    for (uint32_t i = 0; i < NonceCache::capacity(); ++i)
+        settle(cache, key(100 + i), later());
+    CHECK_EQ(cache.size(), NonceCache::capacity());
+
+    cache.claim(key(500), later());
+    CHECK_EQ(cache.size(), NonceCache::capacity());
+    CHECK_EQ(cache.claim(key(101), later()), NonceCache::SETTLED);
+    // The oldest went (and claiming it again evicted the next oldest)
+    CHECK_EQ(cache.claim(key(100), later()), NonceCache::NONE);
+
+    // An expired entry is reused before the oldest live one
+    NonceCache expiring;
+    uint32_t now = (uint32_t)time(nullptr);
+    settle(expiring, key(1), later());
+    settle(expiring, key(2), now - 10);
+    for (uint32_t i = 2; i < NonceCache::capacity(); ++i)
+        settle(expiring, key(100 + i), later());
+    expiring.claim(key(600), later());
+    CHECK_EQ(expiring.claim(key(1), later()), NonceCache::SETTLED);
+    // And an expired authorization is not answered from the cache
+    CHECK_EQ(expiring.claim(key(2), now - 10), NonceCache::NONE);
+}
+
+TEST(settled_entries_are_evicted_before_pending_ones)
+{
+    // Oldest first: one in flight, one verified, then settled ones
+    NonceCache cache;
+    cache.claim(key(1), later());
+    cache.claim(key(2), later());
+    cache.markVerified(key(2));
+    for (uint32_t i = 2; i < NonceCache::capacity(); ++i)
+        settle(cache, key(100 + i), later());
+
+    cache.claim(key(700), later());
+    CHECK_EQ(cache.claim(key(102), later()), NonceCache::NONE); // the oldest settled went
+    CHECK_EQ(cache.claim(key(1), later()), NonceCache::IN_FLIGHT);
+    CHECK_EQ(cache.claim(key(2), later()), NonceCache::VERIFIED);
+
+    // With nothing settled left, the verified entry goes before any in flight
+    NonceCache pending;
+    pending.claim(key(1), later());
+    pending.claim(key(2), later());
+    pending.markVerified(key(2));
+    for (uint32_t i = 2; i < NonceCache::capacity(); ++i)
+        pending.claim(key(100 + i), later());
+    CHECK_EQ(pending.claim(key(700), later()), NonceCache::NONE);
+    CHECK_EQ(pending.claim(key(1), later()), NonceCache::IN_FLIGHT);
+    // Forgotten (it would answer VERIFIED), once there is room to claim it
+    pending.markSettled(key(700), TX);
+    CHECK_EQ(pending.claim(key(2), later()), NonceCache::NONE);
+}
+
+TEST(every_slot_in_flight_evicts_nothing)
+{
+    NonceCache cache;
+    for (uint32_t i = 0; i < NonceCache::capacity(); ++i)
+        cache.claim(key(100 + i), later());
+    // No room: the newcomer is told to retry and nothing is forgotten
+    CHECK_EQ(cache.claim(key(800), later()), NonceCache::IN_FLIGHT);
+    CHECK_EQ(cache.size(), NonceCache::capacity());
+    for (uint32_t i = 0; i < NonceCache::capacity(); ++i)
+        CHECK_EQ(cache.claim(key(100 + i), later()), NonceCache::IN_FLIGHT);
+    cache.markSettled(key(800), TX);
+    CHECK_EQ(cache.size(), NonceCache::capacity());
+
+    // Once one settles, its slot can be taken
+    cache.markSettled(key(100), TX);
+    CHECK_EQ(cache.claim(key(800), later()), NonceCache::NONE);
+}
+
+TEST(other_terms_under_a_seen_nonce_are_a_mismatch)
+{
+    uint64_t k = 0, terms = 0, tamperedTerms = 0, payeeTerms = 0, sameTerms = 0;
+    uint32_t validBefore = 0;
+    std::string json = paymentJson(0x30, PRICE, 1900000000);
+    CHECK(NonceCache::keyForPayment(json.c_str(), k, validBefore, &terms));
+    CHECK(NonceCache::keyForPayment(json.c_str(), k, validBefore, &sameTerms));
+    CHECK_EQ(terms, sameTerms);
+    CHECK(terms != 0);
+
+    uint64_t otherKey = 0;
+    CHECK(NonceCache::keyForPayment(paymentJson(0x30, "1", 1900000000).c_str(), otherKey, validBefore, &tamperedTerms));
+    CHECK_EQ(otherKey, k);
+    CHECK(tamperedTerms != terms);
+    CHECK(NonceCache::keyForPayment(paymentJson(0x30, PRICE, 1900000000, PAYER).c_str(), otherKey, validBefore,
+                                    &payeeTerms));
+    CHECK(payeeTerms != terms);
+
+    NonceCache cache;
+    String tx;
+    CHECK_EQ(cache.claim(k, later(), &tx, terms), NonceCache::NONE);
+    CHECK_EQ(cache.claim(k, later(), &tx, tamperedTerms), NonceCache::MISMATCH);
+    cache.markSettled(k, TX);
+    CHECK_EQ(cache.claim(k, later(), &tx, payeeTerms), NonceCache::MISMATCH);
+    CHECK_EQ(cache.claim(k, later(), &tx, terms), NonceCache::SETTLED);
+    CHECK_EQ(tx, TX);
+    // Unchecked (0) on either side matches
+    CHECK_EQ(cache.claim(k, later(), &tx), NonceCache::SETTLED);
+}
+
+TEST(settled_entries_survive_a_reboot)
+{
+    hoststub::clearPreferences();
+    {
+        NonceCache cache;
+        CHECK(cache.enablePersistence("x402test"));
+        cache.claim(key(7), later());
+        cache.markSettled(key(7), TX);
+        // Unsettled and released entries are not written
+        cache.claim(key(8), later());
+        cache.markVerified(key(8));
+        cache.claim(key(9), later());
+        cache.markSettled(key(9), TX);
+        cache.release(key(9));
+        cache.claim(key(10), later());
+        cache.markSettled(key(10), TX);
+    }
+
+    NonceCache rebooted;
+    CHECK(rebooted.enablePersistence("x402test"));
+    String tx;
+    CHECK_EQ(rebooted.claim(key(7), later(), &tx), NonceCache::SETTLED);
+    CHECK_EQ(tx, TX);
+    CHECK_EQ(rebooted.claim(key(10), later()), NonceCache::SETTLED);
+    CHECK_EQ(rebooted.claim(key(8), later()), NonceCache::NONE);
+
+    // Another namespace starts empty; a corrupt blob is ignored
+    NonceCache other;
+    CHECK(other.enablePersistence("x402other"));
+    CHECK_EQ(other.size(), (uint8_t)0);
+    {
+        Preferences prefs;
+        prefs.begin("x402bad", false);
+        prefs.putBytes("entries", "NC\x01\x05garbage", 11);
+        prefs.end();
+    }
+    NonceCache corrupt;
+    CHECK(corrupt.enablePersistence("x402bad"));
+    CHECK_EQ(corrupt.size(), (uint8_t)0);
+    CHECK(!corrupt.enablePersistence(""));
+    hoststub::clearPreferences();
+}
+
+TEST(retried_payment_is_answered_from_the_cache)
+{
+    serveFacilitator();
+    device();
+    std::string payment = paymentJson(0x220);
+    auto pay = [&]() {
+        for (const std::string &chunk : paymentChunks(payment))
+            hoststub::bleWrite(rx(), CENTRAL, chunk);
+        for (int i = 0; i < 6; ++i)
+        {
+            for (const std::string &reply : received(CENTRAL, 1))
+            {
+                if (reply.compare(0, 16, "PAYMENT:COMPLETE") == 0)
+                    return reply;
+            }
+        }
+        return std::string("(none)");
+    };
+
+    std::string first = pay();
+    CHECK(first.find("VERIFIED:true") != std::string::npos);
+    uint32_t verifies = facilitatorStats().verifies, settles = facilitatorStats().settles;
+
+    // The client lost the reply and sends the same authorization again
+    std::string retry = pay();
+    CHECK(retry.find("VERIFIED:true") != std::string::npos);
+    CHECK(retry.find(first.substr(first.find("TX:"))) != std::string::npos);
+    CHECK_EQ(facilitatorStats().verifies.load(), verifies);
+    CHECK_EQ(facilitatorStats().settles.load(), settles);
+}
+
+TEST(tampered_payment_under_a_settled_nonce_is_refused)
+{
+    serveFacilitator();
+    device();
+    auto pay = [](const std::string &payment) {
+        for (const std::string &chunk : paymentChunks(payment))
+            hoststub::bleWrite(rx(), CENTRAL, chunk);
+        for (int i = 0; i < 6; ++i)
+        {
+            for (const std::string &reply : received(CENTRAL, 1))
+            {
+                if (reply.compare(0, 16, "PAYMENT:COMPLETE") == 0)
+                    return reply;
+            }
+        }
+        return std::string("(none)");
+    };
+
+    CHECK(pay(paymentJson(0x221)).find("VERIFIED:true") != std::string::npos);
+    uint32_t verifies = facilitatorStats().verifies;
+
+    // Same payer and nonce, but to someone else or for less: not the payment
+    // that settled, so it gets neither its receipt nor a facilitator call
+    CHECK_EQ(pay(paymentJson(0x221, "1")), std::string("PAYMENT:COMPLETE VERIFIED:false REASON:nonce_already_used"));
+    CHECK_EQ(pay(paymentJson(0x221, PRICE, 0, PAYER)),
+             std::string("PAYMENT:COMPLETE VERIFIED:false REASON:nonce_already_used"));
+    CHECK_EQ(facilitatorStats().verifies.load(), verifies);
+}
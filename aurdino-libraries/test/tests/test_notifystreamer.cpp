@@ -0,0 +1,253 @@
+// NotifyStreamer on a bare characteristic, completions delivered by hand:
+// the credit budget, reply order per central, ERROR:BUSY when the stack
+// refuses with nothing in flight, FRAG header digits, a source that shrinks
+// mid-reply and binary continuation frames.
+
+#include "hosttest.h"
+#include "hoststub.h"
+#include "NotifyStreamer.h"
+#include "BinaryFrame.h"
+#include <algorithm>
+
+static const size_t MAX_NOTIFY = 20; // ATT minimum
+
+struct Streamer
+{
+    NimBLECharacteristic tx;
+    NotifyStreamer streamer;
+
+    Streamer() { streamer.setCharacteristic(&tx); }
+    ~Streamer() { hoststub::bleSettle(); }
+
+    bool send(uint16_t connHandle, const std::string &reply, int frameSeq = -1)
+    {
+        return streamer.send(connHandle, MAX_NOTIFY, frameSeq, new BufferSource((const uint8_t *)reply.data(), reply.size()));
+    }
+
+    // Complete n notifications; what went on air meanwhile
+    std::vector<NimBLENotification> complete(size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+            streamer.onNotifyComplete();
+        return tx.sent();
+    }
+
+    // Complete until every reply is out
+    std::vector<NimBLENotification> drain()
+    {
+        std::vector<NimBLENotification> all;
+        for (int i = 0; i < 10000 && streamer.getPendingCount() > 0; ++i)
+        {
+            for (NimBLENotification &notification : complete(1))
+                all.push_back(notification);
+        }
+        for (NimBLENotification &notification : complete(X402BLE_NOTIFY_CREDITS))
+            all.push_back(notification);
+        return all;
+    }
+};
+
+static std::string text(char letter, size_t length)
+{
+    std::string out;
+    for (size_t i = 0; i < length; ++i)
+        out += (char)(letter + i % 10);
+    return out;
+}
+
+struct Fragment
+{
+    unsigned index = 0, count = 0;
+    std::string payload;
+};
+
+static Fragment parse(const std::string &notification)
+{
+    Fragment fragment;
+    int header = 0;
+    if (sscanf(notification.c_str(), "FRAG:%u/%u:%n", &fragment.index, &fragment.count, &header) != 2 || header == 0)
+        hosttest::fail(__FILE__, __LINE__, "not a fragment: " + notification);
+    fragment.payload = notification.substr(header);
+    return fragment;
+}
+
+TEST(credits_bound_what_is_in_flight)
+{
+    Streamer s;
+    std::string reply = text('a', 100);
+    CHECK(s.send(1, reply));
+    CHECK_EQ(s.tx.sent().size(), (size_t)X402BLE_NOTIFY_CREDITS);
+
+    // Each completion lets exactly one more go
+    CHECK_EQ(s.complete(1).size(), (size_t)1);
+    CHECK_EQ(s.complete(2).size(), (size_t)2);
+    CHECK(s.streamer.isBusy(1));
+    s.drain();
+    CHECK(!s.streamer.isBusy(1));
+
+    // Completions of notifications sent elsewhere never raise the budget
+    s.complete(3);
+    CHECK(s.send(1, reply));
+    CHECK_EQ(s.tx.sent().size(), (size_t)X402BLE_NOTIFY_CREDITS);
+    s.drain();
+}
+
+TEST(replies_to_one_central_keep_their_order)
+{
+    Streamer s;
+    std::string first = text('a', 60), second = text('k', 60), other = text('A', 60);
+    CHECK(s.send(1, first));
+    CHECK(s.send(1, second));
+    CHECK(s.send(2, other));
+    CHECK_EQ(s.streamer.getPendingCount(), (size_t)3);
+
+    std::vector<NimBLENotification> sent = s.tx.sent();
+    for (NimBLENotification &notification : s.drain())
+        sent.push_back(notification);
+
+    std::string one, two;
+    size_t firstDoneAt = 0, otherStartedAt = sent.size();
+    for (size_t i = 0; i < sent.size(); ++i)
+    {
+        Fragment fragment = parse(sent[i].data);
+        if (sent[i].connHandle == 1)
+        {
+            one += fragment.payload;
+            if (one.size() == first.size())
+                firstDoneAt = i;
+        }
+        else
+        {
+            two += fragment.payload;
+            otherStartedAt = std::min(otherStartedAt, i);
+        }
+    }
+    // The second reply to central 1 follows the whole first one, while
+    // central 2 takes turns with central 1 instead of waiting for both
+    CHECK_EQ(one, first + second);
+    CHECK_EQ(two, other);
+    CHECK(otherStartedAt < firstDoneAt);
+}
+
+TEST(refused_with_nothing_in_flight_answers_busy)
+{
+    Streamer s;
+    s.tx.failNotifies(1);
+    CHECK(s.send(1, text('a', 100)));
+    std::vector<NimBLENotification> sent = s.tx.sent();
+    CHECK_EQ(sent.size(), (size_t)1);
+    CHECK_EQ(sent[0].data, std::string("ERROR:BUSY"));
+    CHECK_EQ(s.streamer.getPendingCount(), (size_t)0);
+
+    // Binary replies get it as an ERROR frame
+    s.tx.failNotifies(1);
+    CHECK(s.send(1, text('a', 100), 9));
+    sent = s.tx.sent();
+    CHECK_EQ(sent.size(), (size_t)1);
+    BinaryFrame frame;
+    CHECK(parseBinaryFrame((const uint8_t *)sent[0].data.data(), sent[0].data.size(), frame));
+    CHECK_EQ(frame.opcode, (uint8_t)FRAME_OP_ERROR);
+    CHECK_EQ(frame.seq, (uint8_t)9);
+    s.complete(1);
+}
+
+TEST(refused_with_some_in_flight_waits_for_a_completion)
+{
+    Streamer s;
+    std::string reply = text('a', 100);
+    CHECK(s.send(1, reply));
+    std::vector<NimBLENotification> sent = s.tx.sent();
+
+    // The stack is full: the next completion retries instead of failing
+    s.tx.failNotifies(1);
+    CHECK(s.complete(1).empty());
+    CHECK(s.streamer.isBusy(1));
+    for (NimBLENotification &notification : s.drain())
+        sent.push_back(notification);
+
+    std::string whole;
+    for (NimBLENotification &notification : sent)
+        whole += parse(notification.data).payload;
+    CHECK_EQ(whole, reply);
+}
+
+TEST(header_digits_follow_the_fragment_count)
+{
+    // {reply length, fragments}: one digit assumed gives 10 fragments, so
+    // the header grows; and 99 fragments become 100 with one byte more
+    const size_t cases[][2] = {{99, 9}, {100, 12}, {891, 99}, {892, 128}};
+    for (const auto &c : cases)
+    {
+        Streamer s;
+        std::string reply = text('a', c[0]);
+        CHECK(s.send(1, reply));
+        std::vector<NimBLENotification> sent = s.tx.sent();
+        for (NimBLENotification &notification : s.drain())
+            sent.push_back(notification);
+
+        CHECK_EQ(sent.size(), c[1]);
+        std::string whole;
+        for (size_t i = 0; i < sent.size(); ++i)
+        {
+            Fragment fragment = parse(sent[i].data);
+            whole += fragment.payload;
+            CHECK_EQ(fragment.index, (unsigned)i + 1);
+            CHECK_EQ(fragment.count, (unsigned)c[1]);
+            if (sent[i].data.size() > MAX_NOTIFY)
+                hosttest::fail(__FILE__, __LINE__, "fragment " + std::to_string(i + 1) + " of " + std::to_string(c[1]) +
+                                                       " is " + std::to_string(sent[i].data.size()) + " bytes");
+        }
+        CHECK_EQ(whole, reply);
+        // Sized for the count's digits: indexes with as many fill a
+        // notification, fragment 1 is short by the difference
+        CHECK_EQ(sent[c[1] - 2].data.size(), MAX_NOTIFY);
+        CHECK_EQ(sent[0].data.size(), MAX_NOTIFY + 1 - std::to_string(c[1]).size());
+    }
+}
+
+TEST(source_that_shrinks_ends_the_reply)
+{
+    Streamer s;
+    String field(text('a', 100).c_str());
+    CHECK(s.streamer.send(1, MAX_NOTIFY, -1, "P://", field));
+    std::vector<NimBLENotification> sent = s.tx.sent();
+    CHECK_EQ(sent.size(), (size_t)X402BLE_NOTIFY_CREDITS);
+    CHECK_EQ(parse(sent[0].data).count, 12u);
+
+    // Replaced by a shorter value while its first fragments are on air: the
+    // next read comes back empty and the reply ends there, short of 12
+    field = "short";
+    std::vector<NimBLENotification> rest = s.drain();
+    CHECK_EQ(rest.size(), (size_t)1);
+    Fragment last = parse(rest[0].data);
+    CHECK_EQ(last.index, (unsigned)X402BLE_NOTIFY_CREDITS + 1);
+    CHECK(last.payload.empty());
+    CHECK(!s.streamer.isBusy(1));
+}
+
+TEST(binary_replies_continue_in_frames)
+{
+    Streamer s;
+    std::string reply = text('a', 50);
+    CHECK(s.send(1, reply, 5));
+    std::vector<NimBLENotification> sent = s.tx.sent();
+    for (NimBLENotification &notification : s.drain())
+        sent.push_back(notification);
+
+    // 13 bytes in the first frame, 15 in each continuation
+    CHECK_EQ(sent.size(), (size_t)4);
+    std::string whole;
+    for (size_t i = 0; i < sent.size(); ++i)
+    {
+        BinaryFrame frame;
+        CHECK(sent[i].data.size() <= MAX_NOTIFY);
+        CHECK(parseBinaryFrame((const uint8_t *)sent[i].data.data(), sent[i].data.size(), frame));
+        CHECK_EQ(frame.opcode, (uint8_t)FRAME_OP_REPLY);
+        CHECK_EQ(frame.seq, (uint8_t)5);
+        CHECK_EQ(frame.first, i == 0);
+        if (frame.first)
+            CHECK_EQ(frame.totalLength, (uint16_t)reply.size());
+        whole.append((const char *)frame.payload, frame.payloadLength);
+    }
+    CHECK_EQ(whole, reply);
+}
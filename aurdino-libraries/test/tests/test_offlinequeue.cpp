@@ -0,0 +1,251 @@
+// OfflineQueue on file-backed flash: records that survive a reboot, a torn
+// write dropped on recovery, the risk limits, and a drain that waits for WiFi
+// and settles oldest first through a stand-in facilitator.
+
+#include "hosttest.h"
+#include "x402fixture.h"
+#include "X402Aurdino.h"
+#include <LittleFS.h>
+#include <mutex>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace x402fixture;
+
+static std::string root()
+{
+    static std::string dir;
+    if (dir.empty())
+    {
+        char pattern[] = "/tmp/x402-offline-XXXXXX";
+        dir = mkdtemp(pattern);
+        hoststub::setFsRoot(dir);
+        LittleFS.begin(true);
+    }
+    return dir;
+}
+
+static size_t fileSize(const char *path)
+{
+    struct stat st;
+    return stat((root() + path).c_str(), &st) == 0 ? (size_t)st.st_size : 0;
+}
+
+static OfflinePayment offline(uint64_t nonce, const char *value = PRICE, uint64_t validBefore = 0)
+{
+    OfflinePayment payment;
+    payment.payload = paymentJson(nonce, value, validBefore).c_str();
+    payment.requirements = buildDefaultPaymentRementsJson("base-sepolia", PAY_TO, value, "x402-host");
+    payment.customContext = ("table " + std::to_string(nonce)).c_str();
+    payment.selectedOptions = {"latte", "oat milk"};
+    return payment;
+}
+
+TEST(log_survives_a_reboot)
+{
+    root();
+    {
+        OfflineQueue queue;
+        CHECK(queue.begin(LittleFS, "/reboot.log"));
+        CHECK_EQ((int)queue.append(offline(0x1)), (int)OfflineQueue::QUEUED);
+        CHECK_EQ((int)queue.append(offline(0x2, "20000")), (int)OfflineQueue::QUEUED);
+        CHECK_EQ((int)queue.append(offline(0x3)), (int)OfflineQueue::QUEUED);
+        CHECK_EQ(queue.getPendingValue(), (uint64_t)40000);
+        CHECK(queue.pop());
+    }
+
+    // Power cut: the settled record stays dropped, the rest are intact
+    OfflineQueue rebooted;
+    CHECK(rebooted.begin(LittleFS, "/reboot.log"));
+    CHECK_EQ(rebooted.getPendingCount(), (uint16_t)2);
+    CHECK_EQ(rebooted.getPendingValue(), (uint64_t)30000);
+    OfflinePayment next;
+    CHECK(rebooted.peek(next));
+    CHECK(next.payload.indexOf("0000000000000002\"") > 0);
+    CHECK_EQ(next.value, (uint64_t)20000);
+    CHECK_EQ(next.customContext, "table 2");
+    CHECK_EQ(next.selectedOptions.size(), (size_t)2);
+    CHECK_EQ(next.selectedOptions[1], "oat milk");
+    CHECK(next.requirements.indexOf("\"maxAmountRequired\"") >= 0);
+    // Compaction on begin() removed the settled record
+    CHECK(!fileSize("/reboot.log.head"));
+
+    CHECK(rebooted.pop());
+    CHECK(rebooted.pop());
+    CHECK(!rebooted.pop());
+    CHECK(!rebooted.peek(next));
+    CHECK_EQ(fileSize("/reboot.log"), (size_t)0);
+}
+
+TEST(torn_write_is_dropped_on_recovery)
+{
+    root();
+    size_t intact = 0;
+    {
+        OfflineQueue queue;
+        CHECK(queue.begin(LittleFS, "/torn.log"));
+        queue.clear();
+        queue.append(offline(0x10));
+        queue.append(offline(0x11));
+        intact = fileSize("/torn.log");
+    }
+    // Half of a third record, as a power cut mid-append leaves it
+    std::string partial = "OQ\x12\x34\xff\x01\x00\x00" + std::string(100, 'x');
+    FILE *file = fopen((root() + "/torn.log").c_str(), "ab");
+    fwrite(partial.data(), 1, partial.size(), file);
+    fclose(file);
+
+    OfflineQueue recovered;
+    CHECK(recovered.begin(LittleFS, "/torn.log"));
+    CHECK_EQ(recovered.getPendingCount(), (uint16_t)2);
+    CHECK_EQ(fileSize("/torn.log"), intact);
+    // Later appends stay readable behind the cut
+    CHECK_EQ((int)recovered.append(offline(0x12)), (int)OfflineQueue::QUEUED);
+    OfflineQueue again;
+    CHECK(again.begin(LittleFS, "/torn.log"));
+    CHECK_EQ(again.getPendingCount(), (uint16_t)3);
+    again.clear();
+}
+
+TEST(risk_limits_and_short_authorizations)
+{
+    root();
+    OfflineQueue unready;
+    CHECK_EQ((int)unready.append(offline(0x20)), (int)OfflineQueue::STORAGE_ERROR);
+
+    OfflineQueue queue;
+    CHECK(queue.begin(LittleFS, "/limits.log"));
+    queue.clear();
+    queue.setLimits(2, 25000);
+    CHECK_EQ((int)queue.append(offline(0x21)), (int)OfflineQueue::QUEUED);
+    CHECK_EQ((int)queue.append(offline(0x22, "20000")), (int)OfflineQueue::LIMIT_REACHED);
+    CHECK_EQ((int)queue.append(offline(0x23)), (int)OfflineQueue::QUEUED);
+    CHECK_EQ((int)queue.append(offline(0x24, "1")), (int)OfflineQueue::LIMIT_REACHED);
+    CHECK_EQ(queue.getPendingCount(), (uint16_t)2);
+
+    // An authorization must outlive the outage it is queued through
+    queue.clear();
+    uint64_t now = (uint64_t)time(nullptr);
+    CHECK_EQ((int)queue.append(offline(0x25, PRICE, now + X402BLE_OFFLINE_MIN_VALIDITY_S - 1)),
+             (int)OfflineQueue::EXPIRES_SOON);
+    CHECK_EQ((int)queue.append(offline(0x26, PRICE, now + X402BLE_OFFLINE_MIN_VALIDITY_S + 60)),
+             (int)OfflineQueue::QUEUED);
+    // A uint256 value saturates instead of wrapping under the limit
+    OfflinePayment huge = offline(0x27);
+    huge.payload.replace("\"value\":\"10000\"", "\"value\":\"115792089237316195423570985008687907853269984665640564039457584007913129639935\"");
+    CHECK_EQ((int)queue.append(huge), (int)OfflineQueue::LIMIT_REACHED);
+    queue.clear();
+}
+
+static std::mutex settledLock;
+static std::vector<std::string> settledNonces;
+static std::atomic<int> settleCalls{0};
+static std::atomic<bool> facilitatorDown{false};
+static std::atomic<int> failedCallbacks{0};
+static std::string failedContext, failedReason;
+
+// Rejects the nonce ending in ...bad for good; 503 while facilitatorDown
+static void serveSettlements()
+{
+    hoststub::serve(FACILITATOR_ORIGIN, [](const hoststub::HttpRequest &request) {
+        hoststub::HttpReply reply;
+        settleCalls++;
+        if (facilitatorDown)
+        {
+            reply.status = 503;
+            return reply;
+        }
+        size_t at = request.body.find("\"nonce\":\"");
+        std::string nonce = at == std::string::npos ? "" : request.body.substr(at + 9 + 50, 16);
+        if (nonce.find("bad") != std::string::npos)
+        {
+            reply.body = "{\"success\":false,\"errorReason\":\"invalid_transaction_state\",\"transaction\":\"\"}";
+            return reply;
+        }
+        std::lock_guard<std::mutex> guard(settledLock);
+        settledNonces.push_back(nonce);
+        reply.body = "{\"success\":true,\"transaction\":\"0x" + std::string(48, '0') + nonce +
+                     "\",\"network\":\"base-sepolia\",\"payer\":\"" + PAYER + "\"}";
+        return reply;
+    });
+}
+
+static void onFailed(const std::vector<String> &, const String &customContext, const String &reason)
+{
+    failedContext = customContext.c_str();
+    failedReason = reason.c_str();
+    failedCallbacks++;
+}
+
+static bool waitFor(const std::function<bool()> &done, uint32_t timeoutMs = 5000)
+{
+    unsigned long start = millis();
+    while (!done())
+    {
+        if (millis() - start > timeoutMs)
+            return false;
+        delay(5);
+    }
+    return true;
+}
+
+TEST(drain_waits_for_wifi_and_settles_oldest_first)
+{
+    root();
+    device().setOnSettlementFailed(onFailed);
+    serveSettlements();
+    hoststub::setWiFiStatus(WL_DISCONNECTED);
+
+    // The drain task cannot be stopped on the host, so the queue lives on
+    OfflineQueue *queue = new OfflineQueue();
+    CHECK(queue->begin(LittleFS, "/drain.log"));
+    queue->clear();
+    // As the verify worker does: claim each nonce, then queue the payment
+    NonceCache &nonces = device().getNonceCache();
+    uint64_t keys[3];
+    uint64_t ids[3] = {0xd1, 0xbad, 0xd3};
+    for (int i = 0; i < 3; ++i)
+    {
+        uint32_t validBefore = 0;
+        OfflinePayment payment = offline(ids[i]);
+        CHECK(NonceCache::keyForPayment(payment.payload, keys[i], validBefore));
+        CHECK_EQ((int)nonces.claim(keys[i], validBefore), (int)NonceCache::NONE);
+        CHECK_EQ((int)queue->append(payment), (int)OfflineQueue::QUEUED);
+    }
+    CHECK(queue->startDrain(10));
+
+    delay(100);
+    CHECK_EQ(settleCalls.load(), 0);
+    CHECK_EQ(queue->getPendingCount(), (uint16_t)3);
+
+    hoststub::setWiFiStatus(WL_CONNECTED);
+    CHECK(waitFor([&] { return queue->getPendingCount() == 0; }));
+    {
+        std::lock_guard<std::mutex> guard(settledLock);
+        CHECK_EQ(settledNonces.size(), (size_t)2);
+        CHECK_EQ(settledNonces[0], std::string("00000000000000d1"));
+        CHECK_EQ(settledNonces[1], std::string("00000000000000d3"));
+    }
+    // The rejected one was reported, since its service was already granted
+    CHECK(waitFor([] { return failedCallbacks.load() == 1; }));
+    CHECK_EQ(failedContext, std::string("table 2989"));
+    CHECK_EQ(failedReason, std::string("invalid_transaction_state"));
+
+    // Settled nonces are remembered, so a replay is answered from the cache;
+    // the rejected one is released for a corrected retry
+    String tx;
+    CHECK_EQ((int)nonces.claim(keys[0], UINT32_MAX, &tx), (int)NonceCache::SETTLED);
+    CHECK(tx.endsWith("00000000000000d1"));
+    CHECK_EQ((int)nonces.claim(keys[1], UINT32_MAX), (int)NonceCache::NONE);
+    nonces.release(keys[1]);
+
+    // A failing facilitator keeps the payment for a later retry
+    facilitatorDown = true;
+    int before = settleCalls;
+    queue->append(offline(0xd4));
+    CHECK(waitFor([&] { return settleCalls > before; }));
+    delay(50);
+    CHECK_EQ(queue->getPendingCount(), (uint16_t)1);
+    CHECK_EQ(failedCallbacks.load(), 1);
+    device().setOnSettlementFailed(nullptr);
+}
@@ -0,0 +1,146 @@
+// waitForPayment(): a sketch task blocked on the payment event queue is
+// woken by a payment over BLE, every payment is delivered once and whole
+// (never mixed with another's fields) while the worker keeps recording, and
+// a full queue keeps the newest payments.
+
+#include "hosttest.h"
+#include "x402fixture.h"
+#include <thread>
+
+using namespace x402fixture;
+
+// Not begun: only its payment state and event queue are used. Never
+// destroyed, so cleanup() leaves the fixture's NimBLE server alone.
+static X402Ble &standalone()
+{
+    static X402Ble *ble = new X402Ble("x402-events", PRICE, PAY_TO, "base-sepolia");
+    PaymentRecord stale;
+    while (ble->waitForPayment(stale, 0))
+    {
+    }
+    return *ble;
+}
+
+static void recordNumbered(X402Ble &ble, int n)
+{
+    std::string i = std::to_string(n);
+    ble.recordPayment(String(("0xtx" + i).c_str()), String(("0xpayer" + i).c_str()), {String(("option" + i).c_str())},
+                      String(("context" + i).c_str()), n % 2 == 0);
+}
+
+TEST(wait_times_out_without_a_payment)
+{
+    X402Ble &ble = standalone();
+    PaymentRecord record;
+    unsigned long start = millis();
+    CHECK(!ble.waitForPayment(record, 50));
+    CHECK(millis() - start >= 45);
+    CHECK_EQ(ble.getPendingPaymentCount(), 0u);
+}
+
+TEST(blocked_task_wakes_on_a_ble_payment)
+{
+    serveFacilitator();
+    X402Ble &ble = device();
+    PaymentRecord stale;
+    while (ble.waitForPayment(stale, 0))
+    {
+    }
+
+    // The sketch's task sleeps in waitForPayment() before the payment starts
+    std::atomic<bool> woke{false};
+    PaymentRecord delivered;
+    std::thread sketch([&] {
+        woke = ble.waitForPayment(delivered, 5000);
+    });
+    delay(20);
+    CHECK(!woke);
+
+    std::string payment = paymentJson(0x1400);
+    for (const std::string &chunk : paymentChunks(payment))
+        hoststub::bleWrite(rx(), CENTRAL, chunk);
+    sketch.join();
+    CHECK(woke);
+    CHECK(delivered.isSettled());
+    CHECK(delivered.getTransactionHash().startsWith("0x"));
+    CHECK_EQ(delivered.getPayer(), PAYER);
+    CHECK(delivered.getTimestampUs() > 0);
+
+    // Consumed: neither the queue nor the polling API reports it again
+    CHECK(!ble.getLastPaid());
+    CHECK(!ble.waitForPayment(stale, 0));
+    // Drop the ACKs and replies, so the next test does not read them
+    received(CENTRAL, 3, 500);
+}
+
+TEST(each_payment_is_delivered_once_in_order)
+{
+    X402Ble &ble = standalone();
+    for (int n = 1; n <= 3; ++n)
+        recordNumbered(ble, n);
+    CHECK_EQ(ble.getPendingPaymentCount(), 3u);
+    CHECK(ble.getLastPaid());
+    CHECK_EQ(ble.getLastTransactionhash(), "0xtx3");
+
+    PaymentRecord record;
+    for (int n = 1; n <= 3; ++n)
+    {
+        CHECK(ble.waitForPayment(record, 0));
+        CHECK_EQ(record.getTransactionHash(), String(("0xtx" + std::to_string(n)).c_str()));
+        CHECK_EQ(record.getOptions().size(), (size_t)1);
+        CHECK_EQ(record.getCustomContext(), String(("context" + std::to_string(n)).c_str()));
+        CHECK_EQ(record.isSettled(), n % 2 == 0);
+    }
+    CHECK(!ble.waitForPayment(record, 0));
+    CHECK(!ble.getLastPaid());
+}
+
+TEST(full_queue_keeps_the_newest)
+{
+    X402Ble &ble = standalone();
+    int total = X402BLE_PAYMENT_EVENT_DEPTH + 3;
+    for (int n = 1; n <= total; ++n)
+        recordNumbered(ble, n);
+    CHECK_EQ(ble.getPendingPaymentCount(), (uint32_t)X402BLE_PAYMENT_EVENT_DEPTH);
+
+    PaymentRecord record;
+    CHECK(ble.waitForPayment(record, 0));
+    CHECK_EQ(record.getTransactionHash(), String(("0xtx" + std::to_string(total - X402BLE_PAYMENT_EVENT_DEPTH + 1)).c_str()));
+    while (ble.waitForPayment(record, 0))
+    {
+    }
+    CHECK_EQ(record.getTransactionHash(), String(("0xtx" + std::to_string(total)).c_str()));
+}
+
+TEST(records_stay_whole_while_the_worker_writes)
+{
+    // The worker records while the sketch task drains: every record (and
+    // each snapshot of the user selection) belongs to a single payment
+    X402Ble &ble = standalone();
+    const int total = 2000;
+    std::thread worker([&] {
+        for (int n = 1; n <= total; ++n)
+            recordNumbered(ble, n);
+    });
+
+    int last = 0;
+    bool torn = false, ordered = true;
+    PaymentRecord record;
+    while (last < total && ble.waitForPayment(record, 1000))
+    {
+        int n = atoi(record.getTransactionHash().c_str() + 4);
+        std::string i = std::to_string(n);
+        torn |= record.getPayer() != String(("0xpayer" + i).c_str()) || record.getOptions().size() != 1 ||
+                record.getOptions()[0] != String(("option" + i).c_str()) ||
+                record.getCustomContext() != String(("context" + i).c_str());
+        ordered &= n > last;
+        last = n;
+
+        std::vector<String> options = ble.getUserSelectedOptions();
+        torn |= options.size() != 1 || !options[0].startsWith("option");
+    }
+    worker.join();
+    CHECK(!torn);
+    CHECK(ordered);
+    CHECK_EQ(last, total);
+}
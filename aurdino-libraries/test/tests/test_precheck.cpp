@@ -0,0 +1,303 @@
+// Keccak-256 against published vectors, the EIP-712 digest of a
+// TransferWithAuthorization, ecrecover vectors and the precheckPayment()
+// outcomes. Signers are only recovered when the host has mbedtls; without
+// it the recovery cases check that nothing claims to have been recovered.
+
+#include "hosttest.h"
+#include "x402fixture.h"
+#include "keccak.h"
+#include "precheck.h"
+
+using namespace x402fixture;
+
+static std::string hex(const uint8_t *data, size_t length)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string out;
+    for (size_t i = 0; i < length; ++i)
+    {
+        out += digits[data[i] >> 4];
+        out += digits[data[i] & 15];
+    }
+    return out;
+}
+
+static std::string keccakHex(const std::string &input)
+{
+    uint8_t digest[Keccak256::DIGEST_SIZE];
+    keccak256((const uint8_t *)input.data(), input.size(), digest);
+    return hex(digest, sizeof(digest));
+}
+
+TEST(keccak_matches_published_vectors)
+{
+    CHECK_EQ(keccakHex(""), std::string("c5d2460186f7233c927e7db2dcc703c0e500b653ca82273b7bfad8045d85a470"));
+    CHECK_EQ(keccakHex("abc"), std::string("4e03657aea45a94fc7d47ba826c8d667c0d1e6e33a64a036ec44f58fa12d6c45"));
+    CHECK_EQ(keccakHex("The quick brown fox jumps over the lazy dog"),
+             std::string("4d741b6f1eb29cb2a9b9911c82f56fa8d73b04959d3d9d222895df6c0b28aa15"));
+    // The EIP-3009 and EIP-712 type hashes every USDC contract hard-codes
+    CHECK_EQ(keccakHex("TransferWithAuthorization(address from,address to,uint256 value,uint256 validAfter,"
+                       "uint256 validBefore,bytes32 nonce)"),
+             std::string("7c7c6cdb67a18743f49ec6fa9b35f50d52ed05cbed4cc592e13b44501c1a2267"));
+    CHECK_EQ(keccakHex("EIP712Domain(string name,string version,uint256 chainId,address verifyingContract)"),
+             std::string("8b73c3c69bb8fe3d512ecc4cf759cc79239f7b179b0ffacaa9a75d522b39400f"));
+}
+
+TEST(keccak_padding_at_the_block_edge)
+{
+    // One byte short of the 136-byte rate, exactly the rate, and two blocks
+    CHECK_EQ(keccakHex(std::string(135, 'a')), std::string("34367dc248bbd832f4e3e69dfaac2f92638bd0bbd18f2912ba4ef454919cf446"));
+    CHECK_EQ(keccakHex(std::string(136, 'a')), std::string("a6c4d403279fe3e0af03729caada8374b5ca54d8065329a3ebcaeb4b60aa386e"));
+    CHECK_EQ(keccakHex(std::string(200, 'a')), std::string("96ea54061def936c4be90b518992fdc6f12f535068a256229aca54267b4d084d"));
+}
+
+TEST(keccak_incremental_matches_one_shot)
+{
+    std::string input;
+    for (int i = 0; i < 300; ++i)
+        input += (char)(i * 7);
+    std::string whole = keccakHex(input);
+    for (size_t split = 0; split <= input.size(); split += 17)
+    {
+        Keccak256 hash;
+        hash.update((const uint8_t *)input.data(), split);
+        for (size_t at = split; at < input.size(); ++at)
+            hash.update((const uint8_t *)input.data() + at, 1);
+        uint8_t digest[Keccak256::DIGEST_SIZE];
+        hash.finalize(digest);
+        CHECK_EQ(hex(digest, sizeof(digest)), whole);
+    }
+}
+
+TEST(eip712_digest_of_a_transfer_authorization)
+{
+    // Expected value computed independently from the EIP-712 encoding rules
+    uint8_t digest[32];
+    CHECK(hashTransferWithAuthorization("USDC", "2", 84532, "0x036CbD53842c5426634e7929541eC2318f3dCF7e", PAYER, PAY_TO,
+                                        "10000", "0", "1900000000",
+                                        "0x000000000000000000000000000000000000000000000000000000000000002a", digest));
+    CHECK_EQ(hex(digest, 32), std::string("b8aed48554d3ff36b2380060315ae3e65d1170c203ef80356199045d6a3ec296"));
+
+    // Malformed fields are refused rather than hashed
+    CHECK(!hashTransferWithAuthorization("USDC", "2", 84532, "0x036C", PAYER, PAY_TO, "10000", "0", "1900000000",
+                                         "0x2a", digest));
+    CHECK(!hashTransferWithAuthorization("USDC", "2", 84532, "0x036CbD53842c5426634e7929541eC2318f3dCF7e", PAYER, PAY_TO,
+                                         "1e4", "0", "1900000000",
+                                         "0x000000000000000000000000000000000000000000000000000000000000002a", digest));
+}
+
+static std::vector<uint8_t> bytes(const char *hexString)
+{
+    std::vector<uint8_t> out;
+    for (size_t i = 0; hexString[i] && hexString[i + 1]; i += 2)
+        out.push_back((uint8_t)strtoul(std::string(hexString + i, 2).c_str(), nullptr, 16));
+    return out;
+}
+
+// Signatures made independently of this code (r || s || v)
+struct RecoveryVector
+{
+    const char *digest;
+    const char *signature;
+    const char *address;
+};
+
+static const RecoveryVector RECOVERY_VECTORS[] = {
+    // PAYER over the EIP-712 digest above, once with each recovery id
+    {"b8aed48554d3ff36b2380060315ae3e65d1170c203ef80356199045d6a3ec296",
+     "24b31d06c968bbea74a510b09851a81a9a888fd351359e471acad3ef3c49e359"
+     "4c87400b233dca9f241af75d4f19928751472e216b8508d71e9c19c7a710ebc01b",
+     "160f2008d1d4efc64b0f7855ebce43471f9fffec"},
+    {"b8aed48554d3ff36b2380060315ae3e65d1170c203ef80356199045d6a3ec296",
+     "ae02ab84327c1498727f2be2e3b0174d51251f88ac79be7981ef38450a14411e"
+     "142fba806e789508e8c1c8c215d4824cc922c63b6379e58584da4a2ff712c7081c",
+     "160f2008d1d4efc64b0f7855ebce43471f9fffec"},
+    // Another key, v given as 0/1
+    {"bc207d516a2c06883f054f3d9ef20e9ad2ce3df4ef6793a86abf564497fec872",
+     "bcf3ee719db81432ef4b20769f5422592fd99534b8b311b9e2de51c9054b3095"
+     "021d5fe11023c70bb4ca67ea40dad06bbfdb2e443fb98cd3518a905e230460f800",
+     "47fc61e2ee389138a693af148f7df5b22393272e"},
+    {"bc207d516a2c06883f054f3d9ef20e9ad2ce3df4ef6793a86abf564497fec872",
+     "b4a64cab5263ca3937a418b4c52eb5979ec14eb78af77bfa0c44728312986ea3"
+     "3cef52bd0245e4cba32430c79af2535ba226db5d2b7766f3cf7acced86912bb401",
+     "47fc61e2ee389138a693af148f7df5b22393272e"},
+};
+
+static bool recover(const char *digest, const std::vector<uint8_t> &signature, std::string &address)
+{
+    uint8_t recovered[20];
+    bool ok = recoverEvmAddress(bytes(digest).data(), signature.data(), recovered);
+    address = ok ? hex(recovered, sizeof(recovered)) : "";
+    return ok;
+}
+
+#if X402_HOST_ECRECOVER
+
+TEST(recover_matches_known_signers)
+{
+    std::string address;
+    for (const RecoveryVector &vector : RECOVERY_VECTORS)
+    {
+        CHECK(recover(vector.digest, bytes(vector.signature), address));
+        CHECK_EQ(address, std::string(vector.address));
+    }
+}
+
+TEST(recover_rejects_high_s_and_bad_v)
+{
+    const RecoveryVector &vector = RECOVERY_VECTORS[3];
+    std::string address;
+
+    // The same signature with s' = n - s and the other parity recovers the
+    // same key on plain ECDSA; EIP-2 (and the token contract) refuse it
+    std::vector<uint8_t> highS = bytes("b4a64cab5263ca3937a418b4c52eb5979ec14eb78af77bfa0c44728312986ea3"
+                                       "c310ad42fdba1b345cdbcf38650daca31888018983d13947f057919f49a5158d00");
+    CHECK(!recover(vector.digest, highS, address));
+
+    // The wrong recovery id gives a valid but different key
+    std::vector<uint8_t> wrongV = bytes(vector.signature);
+    wrongV[64] = 0;
+    CHECK(recover(vector.digest, wrongV, address));
+    CHECK_EQ(address, std::string("da40fb339d5fb79130faf5f7c57c3dee439e7aa7"));
+    wrongV[64] = 27;
+    CHECK(recover(vector.digest, wrongV, address));
+    CHECK_EQ(address, std::string("da40fb339d5fb79130faf5f7c57c3dee439e7aa7"));
+
+    // v outside 0/1/27/28, r or s of zero, r at or past n, r not on the curve
+    std::vector<uint8_t> bad = bytes(vector.signature);
+    bad[64] = 29;
+    CHECK(!recover(vector.digest, bad, address));
+    bad[64] = 2;
+    CHECK(!recover(vector.digest, bad, address));
+    bad = bytes(vector.signature);
+    memset(bad.data(), 0, 32);
+    CHECK(!recover(vector.digest, bad, address));
+    bad = bytes(vector.signature);
+    memset(bad.data() + 32, 0, 32);
+    CHECK(!recover(vector.digest, bad, address));
+    bad = bytes(vector.signature);
+    memset(bad.data(), 0xff, 32);
+    CHECK(!recover(vector.digest, bad, address));
+    bad = bytes(vector.signature);
+    memset(bad.data(), 0, 31);
+    bad[31] = 5; // x = 5: 5^3 + 7 = 132 is not a square mod p
+    CHECK(!recover(vector.digest, bad, address));
+}
+
+#else
+
+TEST(recover_is_not_built_without_mbedtls)
+{
+    std::string address;
+    CHECK(!recover(RECOVERY_VECTORS[0].digest, bytes(RECOVERY_VECTORS[0].signature), address));
+}
+
+#endif // X402_HOST_ECRECOVER
+
+static const uint32_t NOW = 1800000000;
+
+// Readable results in CHECK_EQ failures (the enum is a uint8_t)
+static int check(const PaymentPayload &payment, const String &requirements, uint32_t nowUnix, bool *complete = nullptr)
+{
+    return (int)precheckPayment(payment, requirements, nowUnix, complete);
+}
+
+// paymentJson() valid for ten minutes after NOW, with one field replaced
+// (and signed again)
+static PaymentPayload payment(const char *key, const std::string &value)
+{
+    std::string json = paymentJson(0x21, PRICE, NOW + 600);
+    std::string needle = std::string("\"") + key + "\":\"";
+    size_t at = json.find(needle);
+    if (at != std::string::npos)
+    {
+        at += needle.size();
+        json.replace(at, json.find('"', at) - at, value);
+    }
+    signPaymentJson(json);
+    return PaymentPayload(String(json.c_str()));
+}
+
+static String requirements(const char *price = PRICE, const char *network = "base-sepolia")
+{
+    return buildDefaultPaymentRementsJson(network, PAY_TO, price, "x402-host");
+}
+
+TEST(precheck_accepts_a_matching_payment)
+{
+    bool complete = true;
+    CHECK_EQ(check(payment("nonce", "0x00000000000000000000000000000000000000000000000000000000000000aa"),
+                   requirements(), NOW, &complete),
+             (int)PRECHECK_OK);
+    CHECK_EQ(complete, (bool)X402_HOST_ECRECOVER); // only complete if the signer was recovered
+    // More than asked for is fine, and addresses compare case-insensitively
+    CHECK_EQ(check(payment("value", "10001"), requirements(), NOW), (int)PRECHECK_OK);
+    std::string lower = PAY_TO;
+    for (char &c : lower)
+        c = (char)tolower(c);
+    CHECK_EQ(check(payment("to", lower), requirements(), NOW), (int)PRECHECK_OK);
+}
+
+TEST(precheck_rejects_field_mismatches)
+{
+    CHECK_EQ(check(payment("scheme", "upto"), requirements(), NOW), (int)PRECHECK_WRONG_SCHEME);
+    CHECK_EQ(check(payment("network", "base"), requirements(), NOW), (int)PRECHECK_WRONG_NETWORK);
+    CHECK_EQ(check(payment("to", "0x0000000000000000000000000000000000000001"), requirements(), NOW),
+             (int)PRECHECK_WRONG_RECIPIENT);
+    CHECK_EQ(check(payment("value", "9999"), requirements(), NOW), (int)PRECHECK_AMOUNT_TOO_LOW);
+    // Compared as numbers, not as text
+    CHECK_EQ(check(payment("value", "99999"), requirements("100000"), NOW), (int)PRECHECK_AMOUNT_TOO_LOW);
+    CHECK_EQ(check(payment("value", "100000"), requirements("99999"), NOW), (int)PRECHECK_OK);
+    CHECK_EQ(check(payment("value", "ten"), requirements(), NOW), (int)PRECHECK_MALFORMED);
+    CHECK_EQ(check(PaymentPayload(String("{\"x402Version\":1}")), requirements(), NOW), (int)PRECHECK_MALFORMED);
+    CHECK(strlen(precheckResultReason(PRECHECK_AMOUNT_TOO_LOW)) > 0);
+    CHECK_EQ(precheckResultReason(PRECHECK_OK), "");
+}
+
+#if X402_HOST_ECRECOVER
+
+TEST(precheck_rejects_a_foreign_or_tampered_signature)
+{
+    // Signed by PAYER but claiming to be from someone else
+    std::string json = paymentJson(0x22, PRICE, NOW + 600);
+    json.replace(json.find(PAYER), strlen(PAYER), "0x47fc61e2ee389138a693af148f7df5b22393272e");
+    CHECK_EQ(check(PaymentPayload(String(json.c_str())), requirements(), NOW), (int)PRECHECK_BAD_SIGNATURE);
+
+    // A value changed after signing
+    json = paymentJson(0x23, PRICE, NOW + 600);
+    std::string value = "\"value\":\"10000\"";
+    json.replace(json.find(value), value.size(), "\"value\":\"20000\"");
+    CHECK_EQ(check(PaymentPayload(String(json.c_str())), requirements(), NOW), (int)PRECHECK_BAD_SIGNATURE);
+}
+
+#endif // X402_HOST_ECRECOVER
+
+TEST(precheck_time_window)
+{
+    CHECK_EQ(check(payment("validBefore", std::to_string(NOW - 60)), requirements(), NOW), (int)PRECHECK_EXPIRED);
+    // Too little time left for verify and settle, even allowing for skew
+    CHECK_EQ(check(payment("validBefore",
+                           std::to_string(NOW + X402_PRECHECK_MIN_VALIDITY_S - X402_PRECHECK_CLOCK_SKEW_S - 1)),
+                   requirements(), NOW),
+             (int)PRECHECK_EXPIRED);
+    CHECK_EQ(check(payment("validBefore", std::to_string(NOW + 600)), requirements(), NOW), (int)PRECHECK_OK);
+    CHECK_EQ(check(payment("validAfter", std::to_string(NOW + 3600)), requirements(), NOW),
+             (int)PRECHECK_NOT_YET_VALID);
+    CHECK_EQ(check(payment("validAfter", std::to_string(NOW + X402_PRECHECK_CLOCK_SKEW_S)), requirements(), NOW),
+             (int)PRECHECK_OK);
+}
+
+TEST(precheck_never_expiring_authorizations_pass)
+{
+    // uint256 max and a plain huge number both saturate instead of wrapping
+    const char *uint256Max = "115792089237316195423570985008687907853269984665640564039457584007913129639935";
+    CHECK_EQ(check(payment("validBefore", uint256Max), requirements(), NOW), (int)PRECHECK_OK);
+    CHECK_EQ(check(payment("validBefore", "18446744073709551615"), requirements(), NOW), (int)PRECHECK_OK);
+    CHECK_EQ(check(payment("validBefore", "18446744073709551616"), requirements(), NOW), (int)PRECHECK_OK);
+}
+
+TEST(precheck_skips_the_window_without_a_clock)
+{
+    // An unset clock (1970) cannot judge expiry, so an old validBefore passes
+    CHECK_EQ(check(payment("validBefore", "1000"), requirements(), 1000), (int)PRECHECK_OK);
+}
@@ -0,0 +1,162 @@
+// PriceQuoteCache: hits on the exact selection only (including one whose
+// 32-bit id collides), LRU eviction and expiry; and over BLE, a [PRICE]
+// quote that spares the payment a second run of the price callback.
+
+#include "hosttest.h"
+#include "x402fixture.h"
+#include "PriceQuoteCache.h"
+#include <unordered_map>
+
+using namespace x402fixture;
+
+static std::vector<String> opts(std::initializer_list<const char *> items)
+{
+    std::vector<String> out;
+    for (const char *item : items)
+        out.push_back(item);
+    return out;
+}
+
+TEST(hit_on_the_same_selection_only)
+{
+    PriceQuoteCache cache;
+    uint32_t id = cache.put(opts({"latte", "oat"}), "table 4", "25000", "{\"req\":1}");
+    CHECK(id != 0);
+    CHECK_EQ(id, PriceQuoteCache::keyFor(opts({"latte", "oat"}), "table 4"));
+
+    PriceQuote quote;
+    CHECK(cache.get(opts({"latte", "oat"}), "table 4", quote));
+    CHECK_EQ(quote.id, id);
+    CHECK_EQ(quote.price, "25000");
+    CHECK_EQ(quote.requirements, "{\"req\":1}");
+
+    CHECK(!cache.get(opts({"oat", "latte"}), "table 4", quote));
+    CHECK(!cache.get(opts({"latte", "oat"}), "table 5", quote));
+    CHECK(!cache.get(opts({"latteoat"}), "table 4", quote));
+    CHECK(!cache.get(opts({"latte"}), "oat|table 4", quote));
+}
+
+TEST(selection_boundaries_cannot_shift)
+{
+    // Without length prefixes these would all flatten to the same text
+    String a = PriceQuoteCache::selectionFor(opts({"ab"}), "c");
+    String b = PriceQuoteCache::selectionFor(opts({"a", "b"}), "c");
+    String c = PriceQuoteCache::selectionFor(opts({"a"}), "bc");
+    String d = PriceQuoteCache::selectionFor(opts({}), "2:abc");
+    CHECK(a != b);
+    CHECK(a != c);
+    CHECK(b != c);
+    CHECK(d != PriceQuoteCache::selectionFor(opts({"abc"}), ""));
+}
+
+TEST(colliding_ids_never_share_a_quote)
+{
+    // Birthday-search two contexts whose 32-bit ids collide
+    std::unordered_map<uint32_t, std::string> seen;
+    std::string cheap, dear;
+    for (uint32_t i = 0; cheap.empty(); ++i)
+    {
+        std::string context = "ctx-" + std::to_string(i);
+        uint32_t id = PriceQuoteCache::keyFor(opts({"espresso"}), context.c_str());
+        auto previous = seen.emplace(id, context);
+        if (!previous.second)
+        {
+            cheap = previous.first->second;
+            dear = context;
+        }
+    }
+    CHECK_EQ(PriceQuoteCache::keyFor(opts({"espresso"}), cheap.c_str()),
+             PriceQuoteCache::keyFor(opts({"espresso"}), dear.c_str()));
+
+    PriceQuoteCache cache;
+    cache.put(opts({"espresso"}), cheap.c_str(), "1", "cheap");
+    PriceQuote quote;
+    CHECK(!cache.get(opts({"espresso"}), dear.c_str(), quote));
+
+    // Both can be cached side by side, each keeping its own price
+    cache.put(opts({"espresso"}), dear.c_str(), "90000", "dear");
+    CHECK(cache.get(opts({"espresso"}), cheap.c_str(), quote));
+    CHECK_EQ(quote.price, "1");
+    CHECK(cache.get(opts({"espresso"}), dear.c_str(), quote));
+    CHECK_EQ(quote.price, "90000");
+}
+
+TEST(least_recently_used_is_evicted)
+{
+    PriceQuoteCache cache;
+    PriceQuote quote;
+    for (int i = 0; i < X402BLE_QUOTE_CACHE_SIZE; ++i)
+        cache.put(opts({}), String(i), String(i), "");
+    // Touch the oldest so the second oldest goes instead
+    CHECK(cache.get(opts({}), "0", quote));
+    cache.put(opts({}), "new", "n", "");
+    CHECK(cache.get(opts({}), "0", quote));
+    CHECK(!cache.get(opts({}), "1", quote));
+    CHECK(cache.get(opts({}), "new", quote));
+
+    // Refreshing a selection reuses its slot
+    cache.put(opts({}), "new", "n2", "");
+    CHECK(cache.get(opts({}), "2", quote));
+    CHECK(cache.get(opts({}), "new", quote));
+    CHECK_EQ(quote.price, "n2");
+}
+
+TEST(quotes_expire)
+{
+    hoststub::setTimerNow(1000000);
+    PriceQuoteCache cache(1000);
+    PriceQuote quote;
+    cache.put(opts({"tea"}), "", "5", "");
+    hoststub::setTimerNow(1000000 + 999000);
+    CHECK(cache.get(opts({"tea"}), "", quote));
+    hoststub::setTimerNow(1000000 + 1000000);
+    CHECK(!cache.get(opts({"tea"}), "", quote));
+    // An expired quote is dropped, not revived by a later clock
+    hoststub::setTimerNow(1000000);
+    CHECK(!cache.get(opts({"tea"}), "", quote));
+
+    cache.put(opts({"tea"}), "", "5", "");
+    cache.clear();
+    CHECK(!cache.get(opts({"tea"}), "", quote));
+    hoststub::setTimerNow(-1);
+}
+
+static std::atomic<int> priceCalls{0};
+
+static String countedPrice(const std::vector<String> &options, const String &)
+{
+    priceCalls++;
+    return options.size() == 2 ? "20000" : "10000";
+}
+
+TEST(payment_reuses_the_quote_shown)
+{
+    serveFacilitator();
+    device().setDynamicPriceCallback(countedPrice);
+    priceCalls = 0;
+
+    hoststub::bleWrite(rx(), CENTRAL, std::string("[PRICE]:START\"\"--[latte,oat]"));
+    hoststub::bleWrite(rx(), CENTRAL, std::string("[PRICE]:END"));
+    bool quoted = false;
+    for (const std::string &reply : received(CENTRAL, 2))
+        quoted |= reply.find("\"price\": \"20000\"") != std::string::npos && reply.find("quoteId") != std::string::npos;
+    CHECK(quoted);
+    CHECK_EQ(priceCalls.load(), 1);
+
+    for (const std::string &chunk : paymentChunks(paymentJson(0x160, "20000"), "\"\"", "[latte,oat]"))
+        hoststub::bleWrite(rx(), CENTRAL, chunk);
+    std::string complete;
+    for (int i = 0; i < 4 && complete.empty(); ++i)
+    {
+        for (const std::string &reply : received(CENTRAL, 1))
+        {
+            if (reply.compare(0, 16, "PAYMENT:COMPLETE") == 0)
+                complete = reply;
+        }
+    }
+    CHECK(complete.find("VERIFIED:true") != std::string::npos);
+    // Priced once, for the [PRICE] request
+    CHECK_EQ(priceCalls.load(), 1);
+
+    device().setDynamicPriceCallback(nullptr);
+}
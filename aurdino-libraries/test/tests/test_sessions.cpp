@@ -0,0 +1,161 @@
+// Per-connection sessions: chunk streams from several centrals interleaved
+// on the RX characteristic must not corrupt each other.
+
+#include "hosttest.h"
+#include "x402fixture.h"
+#include <algorithm>
+#include <mutex>
+
+using namespace x402fixture;
+
+static std::string next(uint16_t handle)
+{
+    std::vector<std::string> one = received(handle, 1);
+    return one.empty() ? std::string("(timeout)") : one[0];
+}
+
+static std::string expectComplete(uint16_t handle)
+{
+    for (;;)
+    {
+        std::string reply = next(handle);
+        if (reply == "(timeout)" || reply.compare(0, 16, "PAYMENT:COMPLETE") == 0)
+            return reply;
+    }
+}
+
+// Round-robin the chunk streams, one write per central per round
+static void interleave(const std::vector<std::pair<uint16_t, std::vector<std::string>>> &streams)
+{
+    size_t rounds = 0;
+    for (const auto &stream : streams)
+        rounds = std::max(rounds, stream.second.size());
+    for (size_t i = 0; i < rounds; ++i)
+    {
+        for (const auto &stream : streams)
+        {
+            if (i < stream.second.size())
+                hoststub::bleWrite(rx(), stream.first, stream.second[i]);
+        }
+    }
+}
+
+TEST(interleaved_payments_keep_their_own_payload_and_selection)
+{
+    std::mutex lock;
+    std::vector<std::string> verifyBodies;
+    serveFacilitator(0, [&](const hoststub::HttpRequest &request) {
+        if (request.path == "/facilitator/verify")
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            verifyBodies.push_back(request.body);
+        }
+    });
+    device();
+    NimBLEDevice::getServer()->connect(2, 185);
+    NimBLEDevice::getServer()->connect(3, 247);
+
+    std::string paymentA = paymentJson(0xA1);
+    std::string paymentB = paymentJson(0xB2);
+    // Different chunk sizes so the streams drift against each other
+    interleave({{2, paymentChunks(paymentA, "\"table 4\"", "[espresso,oat milk]", 61)},
+                {3, paymentChunks(paymentB, "\"to go\"", "[latte]", 97)}});
+
+    CHECK(expectComplete(2).find("VERIFIED:true") != std::string::npos);
+    CHECK(expectComplete(3).find("VERIFIED:true") != std::string::npos);
+
+    // Each payment reached the facilitator whole
+    CHECK_EQ(verifyBodies.size(), (size_t)2);
+    for (const char *nonce : {"00000000000000a1\"", "00000000000000b2\""})
+    {
+        int matches = 0;
+        for (const std::string &body : verifyBodies)
+            matches += body.find(nonce) != std::string::npos ? 1 : 0;
+        CHECK_EQ(matches, 1);
+    }
+
+    // And each selection came with its own payment
+    PaymentRecord first, second;
+    CHECK(device().waitForPayment(first, 1000));
+    CHECK(device().waitForPayment(second, 1000));
+    for (const PaymentRecord *record : {&first, &second})
+    {
+        // Contexts are kept as sent, quotes included
+        bool a = record->getCustomContext() == "\"table 4\"";
+        CHECK(a || record->getCustomContext() == "\"to go\"");
+        CHECK_EQ(record->getOptions().size(), (size_t)(a ? 2 : 1));
+        if (!record->getOptions().empty())
+            CHECK_EQ(record->getOptions()[0], a ? "espresso" : "latte");
+    }
+    CHECK(first.getCustomContext() != second.getCustomContext());
+
+    NimBLEDevice::getServer()->disconnect(2);
+    NimBLEDevice::getServer()->disconnect(3);
+}
+
+static String priceFor(const std::vector<String> &options, const String &context)
+{
+    String price = options.empty() ? "10000" : options[0] == "large" ? "30000" : "20000";
+    return context == "\"student\"" ? "5000" : price;
+}
+
+TEST(interleaved_price_requests_are_priced_per_central)
+{
+    device().setDynamicPriceCallback(priceFor);
+    NimBLEDevice::getServer()->connect(4, 247);
+    NimBLEDevice::getServer()->connect(5, 247);
+
+    interleave({{4, {"[PRICE]:START\"\"--[lar", "[PRICE]:ge,extra", "[PRICE]:END shot]"}},
+                {5, {"[PRICE]:START\"stud", "[PRICE]:ENDent\"--[small]"}}});
+
+    auto priceReply = [](uint16_t handle) {
+        for (const std::string &reply : received(handle, 3))
+        {
+            if (reply.compare(0, 6, "402://") == 0)
+                return reply;
+        }
+        return std::string("(none)");
+    };
+    CHECK(priceReply(4).find("\"price\": \"30000\"") != std::string::npos);
+    // The context arrived split as "stud" + "ent"
+    CHECK(priceReply(5).find("\"price\": \"5000\"") != std::string::npos);
+
+    device().setDynamicPriceCallback(nullptr);
+    NimBLEDevice::getServer()->disconnect(4);
+    NimBLEDevice::getServer()->disconnect(5);
+}
+
+TEST(sessions_are_bounded_and_freed_on_disconnect)
+{
+    device();
+    while (device().getActiveSessionCount() > 0)
+        delay(10);
+    CHECK_EQ(device().getActiveSessionCount(), (size_t)0);
+
+    // Claim every slot with a half-sent payment
+    for (uint16_t handle = 10; handle < 10 + X402BLE_MAX_SESSIONS; ++handle)
+    {
+        NimBLEDevice::getServer()->connect(handle, 247);
+        hoststub::bleWrite(rx(), handle, std::string("X-PAYMENT:START{\"x402Version\":1"));
+        CHECK_EQ(next(handle), std::string("PAYMENT:ACK"));
+    }
+    CHECK_EQ(device().getActiveSessionCount(), (size_t)X402BLE_MAX_SESSIONS);
+    CHECK(device().getPaymentPayloadSize() > 0);
+
+    // One more central has nowhere to assemble
+    uint16_t extra = 10 + X402BLE_MAX_SESSIONS;
+    NimBLEDevice::getServer()->connect(extra, 247);
+    hoststub::bleWrite(rx(), extra, std::string("X-PAYMENT:START{"));
+    CHECK_EQ(next(extra), std::string("ERROR:NO_SESSION"));
+
+    // A disconnect frees its slot (and drops its partial payload)
+    NimBLEDevice::getServer()->disconnect(10);
+    CHECK_EQ(device().getActiveSessionCount(), (size_t)X402BLE_MAX_SESSIONS - 1);
+    hoststub::bleWrite(rx(), extra, std::string("X-PAYMENT:START{"));
+    CHECK_EQ(next(extra), std::string("PAYMENT:ACK"));
+
+    for (uint16_t handle = 11; handle <= extra; ++handle)
+        NimBLEDevice::getServer()->disconnect(handle);
+    CHECK_EQ(device().getActiveSessionCount(), (size_t)0);
+    CHECK_EQ(device().getPaymentPayloadSize(), (size_t)0);
+}
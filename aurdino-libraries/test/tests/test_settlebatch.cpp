@@ -0,0 +1,219 @@
+// Batched settlement: one held connection per batch, a dropped socket
+// mid-batch, and optimistic payments whose settle never reached the
+// facilitator being settled again rather than revoked.
+
+#include "hosttest.h"
+#include "x402fixture.h"
+#include "X402Aurdino.h"
+#include "facilitatorconnection.h"
+#include "facilitatorregistry.h"
+
+using namespace x402fixture;
+using hoststub::HttpReply;
+using hoststub::HttpRequest;
+
+static const char *ORIGIN = "https://batch.example";
+
+struct Batch
+{
+    std::vector<PaymentPayload> payloads;
+    String requirements = buildDefaultPaymentRementsJson("base-sepolia", PAY_TO, PRICE, "x402-host");
+    std::vector<SettlementBatchItem> items;
+
+    explicit Batch(size_t count, uint64_t firstNonce)
+    {
+        for (size_t i = 0; i < count; ++i)
+            payloads.emplace_back(String(paymentJson(firstNonce + i).c_str()));
+        items.resize(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            items[i].payment = &payloads[i];
+            items[i].paymentRequirements = &requirements;
+        }
+    }
+};
+
+// Settles everything; request n (1-based) fails with failures[n] instead
+static void serveSettle(std::map<int, int> failures)
+{
+    hoststub::stopAllServers();
+    hoststub::setWiFiStatus(WL_CONNECTED);
+    FacilitatorRegistry::instance().clear();
+    auto requests = std::make_shared<std::atomic<int>>(0);
+    hoststub::serve(ORIGIN, [=](const HttpRequest &) {
+        HttpReply reply;
+        auto failure = failures.find(++*requests);
+        if (failure != failures.end())
+        {
+            reply.error = failure->second;
+            return reply;
+        }
+        reply.body = "{\"success\":true,\"transaction\":\"0x" + std::string(64, 'b') + "\",\"network\":\"base-sepolia\"}";
+        return reply;
+    });
+}
+
+TEST(one_connection_for_the_whole_batch)
+{
+    serveSettle({});
+    FacilitatorConnection conn(ORIGIN);
+    Batch batch(8, 0x2400);
+    CHECK_EQ(settlePaymentBatch(batch.items.data(), batch.items.size(), "", &conn), (size_t)8);
+    for (const SettlementBatchItem &item : batch.items)
+        CHECK(item.sent && item.result.success);
+    CHECK_EQ(hoststub::serverStats(ORIGIN).connects, 1u);
+}
+
+TEST(dropped_socket_mid_batch_gets_one_fresh_connection)
+{
+    // The third reply never arrives: that settle may have gone through
+    serveSettle({{3, HTTPC_ERROR_READ_TIMEOUT}});
+    FacilitatorConnection conn(ORIGIN);
+    Batch batch(6, 0x2410);
+    CHECK_EQ(settlePaymentBatch(batch.items.data(), batch.items.size(), "", &conn), (size_t)5);
+    CHECK(batch.items[2].sent);
+    CHECK(!batch.items[2].result.success);
+    for (size_t i : {0, 1, 3, 4, 5})
+        CHECK(batch.items[i].sent && batch.items[i].result.success);
+    CHECK_EQ(hoststub::serverStats(ORIGIN).connects, 2u);
+}
+
+TEST(unreachable_facilitator_leaves_the_rest_unsent)
+{
+    // Refused from the third request on (each settle is resent once when
+    // its reused socket turns out dead, hence the pairs)
+    serveSettle({{3, HTTPC_ERROR_CONNECTION_REFUSED}, {4, HTTPC_ERROR_CONNECTION_REFUSED},
+                 {5, HTTPC_ERROR_CONNECTION_REFUSED}, {6, HTTPC_ERROR_CONNECTION_REFUSED}});
+    FacilitatorConnection conn(ORIGIN);
+    Batch batch(6, 0x2420);
+    CHECK_EQ(settlePaymentBatch(batch.items.data(), batch.items.size(), "", &conn), (size_t)2);
+    CHECK(batch.items[0].sent && batch.items[1].sent);
+    for (size_t i = 2; i < batch.items.size(); ++i)
+    {
+        if (batch.items[i].sent)
+            hosttest::fail(__FILE__, __LINE__, "item " + std::to_string(i) + " reported as sent");
+        CHECK(!batch.items[i].result.success);
+    }
+    CHECK_EQ(batch.items[5].result.statusCode, 0);
+}
+
+// ---------------------------------------------------------------------------
+// Optimistic mode: PAYMENT:VERIFIED now, PAYMENT:SETTLED from the batch stage
+
+static std::atomic<bool> settleDown{false};
+static std::atomic<int> settleRequests{0};
+static std::atomic<int> failedCallbacks{0};
+static std::string failedReason;
+
+static void onFailed(const std::vector<String> &, const String &, const String &reason)
+{
+    failedReason = reason.c_str();
+    failedCallbacks++;
+}
+
+static bool waitFor(const std::function<bool()> &done, uint32_t timeoutMs = 5000)
+{
+    unsigned long start = millis();
+    while (!done())
+    {
+        if (millis() - start > timeoutMs)
+            return false;
+        delay(5);
+    }
+    return true;
+}
+
+static X402Ble &optimisticDevice()
+{
+    X402Ble &ble = device([](X402Ble &ble) {
+        ble.enableOptimisticSettlement(true);
+        ble.enableSettlementBatching(8, 200);
+    });
+    ble.setOnSettlementFailed(onFailed);
+    hoststub::stopAllServers();
+    FacilitatorRegistry::instance().clear();
+    hoststub::serve(FACILITATOR_ORIGIN, [](const HttpRequest &request) {
+        HttpReply reply;
+        if (request.path == "/facilitator/verify")
+        {
+            reply.body = std::string("{\"isValid\":true,\"payer\":\"") + PAYER + "\"}";
+            return reply;
+        }
+        settleRequests++;
+        if (settleDown)
+        {
+            reply.error = HTTPC_ERROR_CONNECTION_REFUSED;
+            return reply;
+        }
+        reply.body = "{\"success\":true,\"transaction\":\"0x" + std::string(64, 'c') + "\",\"network\":\"base-sepolia\"}";
+        return reply;
+    });
+    return ble;
+}
+
+// Pays with each nonce and waits for PAYMENT:VERIFIED
+static void payAll(const std::vector<uint64_t> &nonces)
+{
+    for (uint64_t nonce : nonces)
+    {
+        for (const std::string &chunk : paymentChunks(paymentJson(nonce)))
+            hoststub::bleWrite(rx(), CENTRAL, chunk);
+        bool verified = false;
+        for (int i = 0; i < 8 && !verified; ++i)
+        {
+            for (const std::string &reply : received(CENTRAL, 1))
+                verified |= reply == "PAYMENT:VERIFIED";
+        }
+        CHECK(verified);
+    }
+}
+
+// Counts the settle outcomes among the next notifications, up to expected
+static void settleOutcomes(size_t expected, size_t &settled, size_t &failed, uint32_t timeoutMs)
+{
+    settled = failed = 0;
+    unsigned long start = millis();
+    while (settled + failed < expected && millis() - start < timeoutMs)
+    {
+        for (const std::string &reply : received(CENTRAL, 1, 200))
+        {
+            settled += reply.compare(0, 15, "PAYMENT:SETTLED") == 0;
+            failed += reply == "PAYMENT:SETTLE_FAILED";
+        }
+    }
+}
+
+TEST(unsent_settlements_are_retried_not_revoked)
+{
+    optimisticDevice();
+    failedCallbacks = 0;
+    settleDown = true;
+    payAll({0x2430, 0x2431, 0x2432});
+
+    // Every settle is refused, then the facilitator comes back before the retry
+    CHECK(waitFor([] { return settleRequests.load() > 0; }));
+    delay(300);
+    settleDown = false;
+
+    size_t settled = 0, failed = 0;
+    settleOutcomes(3, settled, failed, 4 * X402BLE_SETTLE_RETRY_MS);
+    CHECK_EQ(settled, (size_t)3);
+    CHECK_EQ(failed, (size_t)0);
+    CHECK_EQ(failedCallbacks.load(), 0);
+}
+
+TEST(settlements_fail_once_the_retries_are_spent)
+{
+    optimisticDevice();
+    failedCallbacks = 0;
+    settleDown = true;
+    payAll({0x2440});
+
+    size_t settled = 0, failed = 0;
+    settleOutcomes(1, settled, failed, (X402BLE_SETTLE_MAX_ATTEMPTS + 2) * X402BLE_SETTLE_RETRY_MS);
+    CHECK_EQ(settled, (size_t)0);
+    CHECK_EQ(failed, (size_t)1);
+    CHECK_EQ(failedCallbacks.load(), 1);
+    CHECK_EQ(failedReason, std::string("facilitator_unreachable"));
+    settleDown = false;
+}
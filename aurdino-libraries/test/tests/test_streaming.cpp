@@ -0,0 +1,146 @@
+// Facilitator replies streamed into field extractors: chunked and oversized
+// bodies from a stand-in server, parsed without ever being buffered.
+
+#include "hosttest.h"
+#include "x402fixture.h"
+#include "X402Aurdino.h"
+#include "facilitatorconnection.h"
+#include "facilitatorregistry.h"
+#include "jsonscanner.h"
+
+using hoststub::HttpReply;
+using hoststub::HttpRequest;
+
+static const char *ORIGIN = "https://stream.example";
+
+static void reset()
+{
+    hoststub::stopAllServers();
+    hoststub::setWiFiStatus(WL_CONNECTED);
+    FacilitatorRegistry::instance().clear();
+}
+
+static PaymentPayload payment()
+{
+    return PaymentPayload(String(x402fixture::paymentJson(9).c_str()));
+}
+
+static String requirements()
+{
+    return buildDefaultPaymentRementsJson("base-sepolia", x402fixture::PAY_TO, x402fixture::PRICE, "x402-host");
+}
+
+// A field the scanner must skip over, big enough that buffering the body
+// would show up in the heap peak
+static std::string padding(size_t bytes)
+{
+    return "\"echo\":[\"" + std::string(bytes, 'p') + "\", {\"scheme\": \"exact\", \"n\": [1, 2]}],";
+}
+
+static HttpReply serve(const std::string &body, size_t chunkSize)
+{
+    HttpReply reply;
+    reply.body = body;
+    reply.chunkSize = chunkSize;
+    return reply;
+}
+
+TEST(verify_reads_fields_across_chunks)
+{
+    for (size_t chunkSize : {1, 3, 7, 64, 0})
+    {
+        reset();
+        hoststub::serve(ORIGIN, [=](const HttpRequest &) {
+            return serve("{" + padding(100) + "\"isValid\":true,\"payer\":\"0xabc\"}", chunkSize);
+        });
+        FacilitatorConnection conn(ORIGIN);
+        CHECK(verifyPayment(payment(), requirements(), "", &conn));
+    }
+}
+
+TEST(verify_reports_the_invalid_reason)
+{
+    reset();
+    hoststub::serve(ORIGIN, [](const HttpRequest &) {
+        return serve("{\"isValid\":false,\"invalidReason\":\"insufficient_funds\"}", 5);
+    });
+    FacilitatorConnection conn(ORIGIN);
+    CHECK(!verifyPayment(payment(), requirements(), "", &conn));
+}
+
+TEST(settle_fields_survive_any_chunking)
+{
+    const std::string tx = "0x" + std::string(64, 'e');
+    for (size_t chunkSize : {1, 2, 13, 1460})
+    {
+        reset();
+        hoststub::serve(ORIGIN, [=](const HttpRequest &request) {
+            CHECK_EQ(request.path, std::string("/settle"));
+            return serve("{\"success\":true,\"errorReason\":null," + padding(50) + "\"transaction\":\"" + tx +
+                             "\",\"network\":\"base-sepolia\",\"payer\":\"" + x402fixture::PAYER + "\"}",
+                         chunkSize);
+        });
+        FacilitatorConnection conn(ORIGIN);
+        SettlementResult result;
+        CHECK(settlePayment(payment(), requirements(), result, "", &conn));
+        CHECK(result.success);
+        CHECK_EQ(result.statusCode, 200);
+        CHECK_EQ(result.transaction, tx.c_str());
+        CHECK_EQ(result.network, "base-sepolia");
+        CHECK_EQ(result.payer, x402fixture::PAYER);
+        CHECK_EQ(result.errorReason, "");
+    }
+}
+
+TEST(settle_failure_keeps_the_reason)
+{
+    reset();
+    hoststub::serve(ORIGIN, [](const HttpRequest &) {
+        return serve("{\"success\":false,\"errorReason\":\"invalid_transaction_state\",\"transaction\":\"\"}", 4);
+    });
+    FacilitatorConnection conn(ORIGIN);
+    SettlementResult result;
+    CHECK(!settlePayment(payment(), requirements(), result, "", &conn));
+    CHECK_EQ(result.errorReason, "invalid_transaction_state");
+    CHECK_EQ(result.transaction, "");
+}
+
+TEST(large_bodies_are_not_buffered)
+{
+    reset();
+    std::string big = "{" + padding(64 * 1024) + "\"isValid\":true}";
+    hoststub::serve(ORIGIN, [&](const HttpRequest &) { return serve(big, 1460); });
+    FacilitatorConnection conn(ORIGIN);
+    PaymentPayload payload = payment();
+    String rendered = requirements();
+
+    // Warm the connection so its one-off setup is not counted
+    CHECK(verifyPayment(payload, rendered, "", &conn));
+
+    hoststub::resetHeapPeak();
+    size_t before = hoststub::heapStats().current;
+    CHECK(verifyPayment(payload, rendered, "", &conn));
+    size_t peak = hoststub::heapStats().peak - before;
+    // The stand-in server holds one copy of the reply; buffering it on the
+    // client side as well would double that
+    if (peak >= big.size() + 8 * 1024)
+        hosttest::fail(__FILE__, __LINE__, "peak heap " + std::to_string(peak) + " B while streaming 64 KB");
+}
+
+TEST(scanner_sees_the_raw_reply_through_post)
+{
+    reset();
+    hoststub::serve(ORIGIN, [](const HttpRequest &) {
+        return serve("{\"a\":{\"isValid\":\"nested\"},\"isValid\":true,\"list\":[1,2,3]}", 3);
+    });
+    FacilitatorConnection conn(ORIGIN);
+    static const char *const keys[] = {"isValid", "list"};
+    JsonCapture fields(keys, 2);
+    HttpResponse response = conn.post("verify", "{}", fields);
+    CHECK(response.success);
+    CHECK_EQ(response.body, "");
+    // First occurrence at any depth wins
+    CHECK_EQ(fields.value(0), "nested");
+    CHECK_EQ(fields.value(1), "[1,2,3]");
+    CHECK_EQ(fields.type(1), JSON_ARRAY);
+}
@@ -0,0 +1,189 @@
+// PaymentTracer: nearest-rank percentiles per stage, stages a payment skipped
+// or never reached, the ring keeping only the most recent payments, and the
+// [TRACE] summary of a real payment over BLE.
+
+#include "hosttest.h"
+#include "x402fixture.h"
+#include "PaymentTrace.h"
+
+using namespace x402fixture;
+
+static const uint8_t DEPTH = 20;
+
+// A payment that took verifyUs in verify and reached the given last stage;
+// every other reached stage 100us after the previous one
+static PaymentTraceRecord trace(uint32_t verifyUs, PaymentTraceStage last = TRACE_NOTIFY)
+{
+    PaymentTraceRecord record;
+    record.startUs = 1;
+    uint32_t at = 0;
+    for (uint8_t stage = TRACE_LAST_CHUNK; stage <= last; ++stage)
+    {
+        at += stage == TRACE_VERIFY_END ? verifyUs : 100;
+        record.offsetUs[stage] = at;
+    }
+    return record;
+}
+
+static void reset()
+{
+    CHECK(PaymentTracer::enable(true, DEPTH));
+    PaymentTracer::clear();
+}
+
+TEST(percentiles_are_nearest_rank)
+{
+    reset();
+    // 10, 20, ... 200us, recorded out of order
+    for (uint32_t i = 0; i < DEPTH; ++i)
+        PaymentTracer::record(trace(10 * ((i * 7) % DEPTH + 1)));
+    CHECK_EQ(PaymentTracer::getRecordCount(), (uint16_t)DEPTH);
+
+    PaymentStageLatency verify;
+    CHECK(PaymentTracer::getLatency(TRACE_VERIFY_END, verify));
+    CHECK_EQ(verify.samples, (uint16_t)DEPTH);
+    CHECK_EQ(verify.p50Us, 100u);
+    CHECK_EQ(verify.p95Us, 190u);
+    CHECK_EQ(verify.p99Us, 200u);
+
+    // One sample is every percentile
+    reset();
+    PaymentTracer::record(trace(42));
+    CHECK(PaymentTracer::getLatency(TRACE_VERIFY_END, verify));
+    CHECK_EQ(verify.samples, (uint16_t)1);
+    CHECK_EQ(verify.p50Us, 42u);
+    CHECK_EQ(verify.p99Us, 42u);
+}
+
+TEST(total_runs_from_first_chunk_to_notify)
+{
+    reset();
+    PaymentTracer::record(trace(500));
+    PaymentStageLatency total;
+    CHECK(PaymentTracer::getLatency(TRACE_FIRST_CHUNK, total));
+    // Nine 100us stages plus the verify
+    CHECK_EQ(total.p50Us, 1400u);
+}
+
+TEST(skipped_and_unreached_stages)
+{
+    reset();
+    // No precheck: verify start is timed from the price stage
+    PaymentTraceRecord noPrecheck = trace(50);
+    uint32_t precheckAt = noPrecheck.offsetUs[TRACE_PRECHECK];
+    noPrecheck.offsetUs[TRACE_PRECHECK] = 0;
+    noPrecheck.offsetUs[TRACE_VERIFY_START] = precheckAt + 300;
+    PaymentTracer::record(noPrecheck);
+
+    PaymentStageLatency latency;
+    CHECK(!PaymentTracer::getLatency(TRACE_PRECHECK, latency));
+    CHECK(PaymentTracer::getLatency(TRACE_VERIFY_START, latency));
+    CHECK_EQ(latency.p50Us, 400u);
+
+    // A failed verify never settles, nor (without a notify) counts in total
+    PaymentTracer::record(trace(70, TRACE_VERIFY_END));
+    CHECK(PaymentTracer::getLatency(TRACE_VERIFY_END, latency));
+    CHECK_EQ(latency.samples, (uint16_t)2);
+    CHECK(PaymentTracer::getLatency(TRACE_SETTLE_END, latency));
+    CHECK_EQ(latency.samples, (uint16_t)1);
+    CHECK(PaymentTracer::getLatency(TRACE_FIRST_CHUNK, latency));
+    CHECK_EQ(latency.samples, (uint16_t)1);
+
+    // Untraced records are dropped
+    PaymentTracer::record(PaymentTraceRecord());
+    CHECK_EQ(PaymentTracer::getRecordCount(), (uint16_t)2);
+    CHECK(!PaymentTracer::getLatency(TRACE_STAGE_COUNT, latency));
+}
+
+TEST(ring_keeps_the_most_recent_payments)
+{
+    reset();
+    // Slow payments first, then a full ring of fast ones pushes them out
+    for (int i = 0; i < 5; ++i)
+        PaymentTracer::record(trace(1000000));
+    for (uint32_t i = 0; i < DEPTH; ++i)
+        PaymentTracer::record(trace(10));
+    CHECK_EQ(PaymentTracer::getRecordCount(), (uint16_t)DEPTH);
+    PaymentStageLatency verify;
+    CHECK(PaymentTracer::getLatency(TRACE_VERIFY_END, verify));
+    CHECK_EQ(verify.p99Us, 10u);
+
+    // The depth is fixed by the first enable
+    CHECK(PaymentTracer::enable(true, 64));
+    for (uint32_t i = 0; i < DEPTH; ++i)
+        PaymentTracer::record(trace(10));
+    CHECK_EQ(PaymentTracer::getRecordCount(), (uint16_t)DEPTH);
+
+    // Nothing is recorded while disabled
+    PaymentTracer::clear();
+    PaymentTracer::enable(false);
+    CHECK_EQ(PaymentTracer::now(), (int64_t)0);
+    PaymentTracer::record(trace(10));
+    CHECK_EQ(PaymentTracer::getRecordCount(), (uint16_t)0);
+}
+
+TEST(summary_json)
+{
+    reset();
+    PaymentTracer::record(trace(20, TRACE_VERIFY_END));
+    CHECK_EQ(PaymentTracer::toSummaryJson(),
+             "{\"n\":1,\"chunks\":[100,100,100],\"enqueue\":[100,100,100],\"queued\":[100,100,100],"
+             "\"price\":[100,100,100],\"precheck\":[100,100,100],\"verifyStart\":[100,100,100],"
+             "\"verify\":[20,20,20]}");
+}
+
+TEST(trace_command_reports_a_real_payment)
+{
+    serveFacilitator();
+    X402Ble &ble = device();
+    CHECK(ble.enableTracing(true));
+    PaymentTracer::clear();
+
+    for (const std::string &chunk : paymentChunks(paymentJson(0x1300)))
+        hoststub::bleWrite(rx(), CENTRAL, chunk);
+    bool complete = false;
+    for (int i = 0; i < 8 && !complete; ++i)
+    {
+        for (const std::string &reply : received(CENTRAL, 1))
+            complete |= reply.compare(0, 30, "PAYMENT:COMPLETE VERIFIED:true") == 0;
+    }
+    CHECK(complete);
+    // The worker records the trace just after sending the reply
+    for (int i = 0; i < 100 && PaymentTracer::getRecordCount() == 0; ++i)
+        delay(5);
+
+    PaymentStageLatency total, verify;
+    CHECK(ble.getStageLatency(TRACE_FIRST_CHUNK, total));
+    CHECK(ble.getStageLatency(TRACE_VERIFY_END, verify));
+    CHECK_EQ(total.samples, (uint16_t)1);
+    CHECK(total.p50Us >= verify.p50Us);
+
+    // PAYMENT:VERIFYING may still be queued ahead of the summary, which
+    // comes in FRAG:<i>/<n>: pieces once it outgrows one notification
+    hoststub::bleWrite(rx(), CENTRAL, "[TRACE]", 7);
+    std::string summary;
+    bool whole = false;
+    for (int i = 0; i < 6 && !whole; ++i)
+    {
+        for (const std::string &reply : received(CENTRAL, 1))
+        {
+            unsigned index = 0, count = 0;
+            int header = 0;
+            if (sscanf(reply.c_str(), "FRAG:%u/%u:%n", &index, &count, &header) == 2 && header > 0)
+            {
+                summary += reply.substr(header);
+                whole = index == count;
+            }
+            else if (reply.compare(0, 8, "TRACE://") == 0)
+            {
+                summary = reply;
+                whole = true;
+            }
+        }
+    }
+    CHECK(whole);
+    CHECK(summary.compare(0, 15, "TRACE://{\"n\":1,") == 0);
+    CHECK(summary.find("\"settle\":[") != std::string::npos);
+    CHECK_EQ(summary.back(), '}');
+    ble.enableTracing(false);
+}
@@ -15,7 +15,12 @@ import { baseSepolia, base } from 'viem/chains';
 import React, { useCallback, useEffect, useMemo, useRef, useState } from 'react';
 import { Animated } from 'react-native';
 import { Buffer } from 'buffer';
-import { chunkString } from 'utils/communication-utils';
+import {
+  chunkSizeForMtu,
+  chunkString,
+  DEFAULT_CHUNK_SIZE,
+  FragmentAssembler,
+} from 'utils/communication-utils';
 import { PaymentRequirements } from 'types';
 import { buildPaymentRequirements, createPaymentPayload } from 'utils/x402-utils';
 import DeviceWindow from '../Device';
@@ -189,6 +194,8 @@ export default function Screen() {
 
   // Mirror waitingToStartAutoPay into a ref to prevent stale closure in TX monitor
   const waitingToStartAutoPayRef = useRef<boolean>(false);
+  const chunkSizeRef = useRef<number>(DEFAULT_CHUNK_SIZE);
+  const fragmentsRef = useRef(new FragmentAssembler());
   useEffect(() => {
     waitingToStartAutoPayRef.current = waitingToStartAutoPay;
   }, [waitingToStartAutoPay]);
@@ -302,7 +309,11 @@ export default function Screen() {
           console.log('Monitor error:', error);
           return;
         }
-        const text = Buffer.from(characteristic?.value ?? '', 'base64').toString('utf-8');
+        const message = fragmentsRef.current.push(
+          Buffer.from(characteristic?.value ?? '', 'base64')
+        );
+        if (!message) return; // more fragments to come
+        const text = Buffer.from(message).toString('utf-8');
 
       console.log('text', text);
 
@@ -338,6 +349,7 @@ export default function Screen() {
         const _optionsData = JSON.parse(text.slice(9));
         if (_optionsData.frequency) setFrequency(_optionsData.frequency);
         if (_optionsData.allowCustomContent) setAllowCustomtext(_optionsData.allowCustomContent);
+        if (_optionsData.mtu) chunkSizeRef.current = chunkSizeForMtu(_optionsData.mtu);
         appendLog('Config received');
       } else if (text.startsWith('OPTIONS://')) {
         const _optionsData = text.slice(10);
@@ -349,16 +361,18 @@ export default function Screen() {
         const [verified, tx] = _optionsData.split(' ');
         appendLog(`Payment verification - ${verified}`);
         if (verified === 'VERIFIED:true') {
-          const txHash = tx.split('TX:')[1];
-          appendLog(`Transaction successful: ${txHash}`);
+          // QUEUED: accepted offline, the device settles it once back online
+          const txHash = tx?.startsWith('TX:') ? tx.slice(3) : null;
+          appendLog(txHash ? `Transaction successful: ${txHash}` : 'Payment accepted, settlement queued');
           setLastSuccessfullTransaction(txHash);
           const isAuto = waitingToStartAutoPayRef.current;
           setLastTransactionStatus('SUCCESS');
 
           if (isAuto) setShowRecurringDialog(true);
         }
-        // PAYMENT:COMPLETE VERIFIED:false
+        // PAYMENT:COMPLETE VERIFIED:false [REASON:<x402 reason>]
         else {
+          if (tx?.startsWith('REASON:')) appendLog(`Rejected: ${tx.slice(7)}`);
           setLastSuccessfullTransaction(null);
           setLastTransactionStatus('FAILED');
         }
@@ -378,7 +392,7 @@ export default function Screen() {
 
     appendLog('completeChunks' + completeChunks);
 
-    const chunks = chunkString(completeChunks, 150);
+    const chunks = chunkString(completeChunks, chunkSizeRef.current);
 
     if (chunks.length == 1) {
       // divide completechunks string in two halves in two different strings
@@ -524,7 +538,7 @@ export default function Screen() {
 
       appendLog('completeChunks' + completeChunks);
 
-      const chunks = chunkString(completeChunks, 150);
+      const chunks = chunkString(completeChunks, chunkSizeRef.current);
       for (let i = 0; i < chunks.length; i++) {
         const chunk = chunks[i];
         let data = '';
@@ -642,7 +656,7 @@ export default function Screen() {
 
         const ready = await d.discoverAllServicesAndCharacteristics();
         try {
-          await device.requestMTU(247); // max practical on many Androids
+          await device.requestMTU(517); // the device reports what was agreed in CONFIG://
         } catch {}
 
         setConnectedId(ready.id);
@@ -15,6 +15,7 @@ const String BANNER = "https://images.pexels.com/photos/2047905/pexels-photo-204
 const String DESCRIPTION = "This is the first device using x402 using Ble on a Microcontroller, Have some fun, to catch up visit x : @AbhinavBuilds";
 const String options[] = { "Switch 1", "Switch 2" };
 int FREQUENCY = 15;  // Seconds
+const uint32_t ACTIVE_PERIOD_MS = 25000;  // Switches stay on this long after a payment
 
 X402Ble* x402ble;
 
@@ -67,32 +68,33 @@ void setup() {
 }
 
 void loop() {
-  bool newPayment = x402ble->getStatusAndReset();
-  if (newPayment) {
-    while (true) {
-      unsigned long elapsed = x402ble->getMicrosSinceLastPayment();
-      // convert to seconds
-      if (elapsed / 1000000.0 <= 25.0) {
-        // If its a new payment then the options and user context might have changes else its same so save some computational power
-
-        Serial.println("Transaction hash:");
-        Serial.println(x402ble->getLastTransactionhash());
-        Serial.println("Address:");
-        Serial.println(x402ble->getLastPayer());
-        Serial.println("User mesage:");
-        Serial.println(x402ble->getUserCustomContext());
-        const std::vector<String>& userOptions = x402ble->getUserSelectedOptions();
-        for (const auto& item : userOptions) {
-          if (item == "Switch 1") {
-            turn_S1_ON();
-          } else if (item == "Switch 2") {
-            turn_S2_ON();
-          }
-        }
-      } else {
-        turn_S1_OFF();
-        turn_S2_OFF();
-      }
+  PaymentRecord payment;
+  // Sleeps until a payment arrives - no polling, no busy loop
+  if (!x402ble->waitForPayment(payment)) {
+    return;
+  }
+  applyPayment(payment);
+
+  // Keep the switches on for the paid period; a new payment extends it
+  while (x402ble->waitForPayment(payment, ACTIVE_PERIOD_MS)) {
+    applyPayment(payment);
+  }
+  turn_S1_OFF();
+  turn_S2_OFF();
+}
+
+void applyPayment(const PaymentRecord& payment) {
+  Serial.println("Transaction hash:");
+  Serial.println(payment.getTransactionHash());
+  Serial.println("Address:");
+  Serial.println(payment.getPayer());
+  Serial.println("User mesage:");
+  Serial.println(payment.getCustomContext());
+  for (const auto& item : payment.getOptions()) {
+    if (item == "Switch 1") {
+      turn_S1_ON();
+    } else if (item == "Switch 2") {
+      turn_S2_ON();
     }
   }
 }
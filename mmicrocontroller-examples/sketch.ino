@@ -16,11 +16,10 @@ const String BANNER = "https://images.pexels.com/photos/2047905/pexels-photo-204
 const String DESCRIPTION = "This is the first device using x402 using Ble on a Microcontroller, Have some fun, to catch up visit x : @AbhinavBuilds";
 const String options[] = { "LED", "Buzzer" };
 int FREQUENCY = 15;  // Seconds
+const uint32_t ACTIVE_PERIOD_MS = 20000;  // Outputs stay on this long after a payment
 
 X402Ble* x402ble;
 
-bool firstTransactionMade = false;
-
 const char* ssid = "Krishna cottage B block 2nd";
 const char* password = "India@123";
 
@@ -54,35 +53,29 @@ void setup() {
 }
 
 void loop() {
-  unsigned long elapsed = x402ble->getMicrosSinceLastPayment();
-  // convert to seconds
-  if (elapsed / 1000000.0 <= 20.0) {  // 5 second will be auto added as it takes around 5 second to complete a payment
-    bool newPayment = x402ble->getStatusAndReset();
-    // If its a new payment then the options and user context might have changes else its same so save some computational power
-    if (newPayment) {
-      // Printing some User and Transaction info.
-      Serial.println("Transaction hash:");
-      Serial.println(x402ble->getLastTransactionhash());
-      Serial.println("Address:");
-      Serial.println(x402ble->getLastPayer());
-      Serial.println("User mesage:");
-      Serial.println(x402ble->getUserCustomContext());
-
-      const std::vector<String>& userOptions = x402ble->getUserSelectedOptions();
-
-      for (const auto& item : userOptions) {
-        if (item == "Buzzer") {
-          digitalWrite(buzzerPin, HIGH);
-        } else if (item == "LED") {
-          digitalWrite(ledPin, HIGH);
-        }
+  PaymentRecord payment;
+  // Sleeps until a payment arrives (no polling); outputs go off once the
+  // active period passes without a new payment
+  if (x402ble->waitForPayment(payment, ACTIVE_PERIOD_MS)) {
+    // Printing some User and Transaction info.
+    Serial.println("Transaction hash:");
+    Serial.println(payment.getTransactionHash());
+    Serial.println("Address:");
+    Serial.println(payment.getPayer());
+    Serial.println("User mesage:");
+    Serial.println(payment.getCustomContext());
+
+    for (const auto& item : payment.getOptions()) {
+      if (item == "Buzzer") {
+        digitalWrite(buzzerPin, HIGH);
+      } else if (item == "LED") {
+        digitalWrite(ledPin, HIGH);
       }
     }
   } else {
     digitalWrite(ledPin, LOW);
     digitalWrite(buzzerPin, LOW);
   }
-  delay(100);
 }
 
 String dynamicprice(const std::vector<String>& options, const String& customContext) {
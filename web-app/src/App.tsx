@@ -9,7 +9,12 @@ import {
   createPaymentPayload,
 } from "./utils/x402-utils";
 import { useWalletClient, useAccount } from "wagmi";
-import { chunkString } from "./utils/communication-utils";
+import {
+  chunkSizeForMtu,
+  chunkString,
+  DEFAULT_CHUNK_SIZE,
+  FragmentAssembler,
+} from "./utils/communication-utils";
 
 function App() {
   const { data: walletClient } = useWalletClient();
@@ -34,14 +39,20 @@ function App() {
     useState<string>("");
 
   const g = useRef<GattRefs>({});
+  const chunkSizeRef = useRef<number>(DEFAULT_CHUNK_SIZE);
+  const fragmentsRef = useRef(new FragmentAssembler());
 
   const [scanning, setScanning] = useState(false);
 
   // DONE in movile
   const onNotification = (event: any) => {
-    const value = event.target.value;
+    const value: DataView = event.target.value;
+    const message = fragmentsRef.current.push(
+      new Uint8Array(value.buffer, value.byteOffset, value.byteLength)
+    );
+    if (!message) return; // more fragments to come
     const decoder = new TextDecoder("utf-8");
-    const text = decoder.decode(value);
+    const text = decoder.decode(message);
     console.log("Received Notification:", text);
     if (text.startsWith("402://")) {
       const {
@@ -74,6 +85,8 @@ function App() {
       if (_optionsData.frequency) setFrequency(_optionsData.frequency);
       if (_optionsData.allowCustomContent)
         setAllowCustomtext(_optionsData.allowCustomContent);
+      if (_optionsData.mtu)
+        chunkSizeRef.current = chunkSizeForMtu(_optionsData.mtu);
     } else if (text.startsWith("OPTIONS://")) {
       const _optionsData = text.slice(10);
       setOptions(_optionsData.split(","));
@@ -83,8 +96,11 @@ function App() {
       const [verified, tx] = _optionsData.split(" ");
       console.log("verified", verified);
       if (verified === "VERIFIED:true") {
-        setLastSuccessfullTransaction(tx.split("TX:")[1]);
+        // "QUEUED": accepted offline, settled by the device later
+        setLastSuccessfullTransaction(tx?.startsWith("TX:") ? tx.slice(3) : "");
         setShowRecurringDialog(true);
+      } else if (tx?.startsWith("REASON:")) {
+        console.log("rejected", tx.slice(7));
       }
     }
   };
@@ -97,7 +113,7 @@ function App() {
 
     console.log("completeChunks", completeChunks);
 
-    const chunks = chunkString(completeChunks, 150);
+    const chunks = chunkString(completeChunks, chunkSizeRef.current);
 
     if (chunks.length == 1) {
       // divide completechunks string in two halves in two different strings
@@ -149,7 +165,7 @@ function App() {
 
       console.log("completeChunks", completeChunks);
 
-      const chunks = chunkString(completeChunks, 150);
+      const chunks = chunkString(completeChunks, chunkSizeRef.current);
       for (let i = 0; i < chunks.length; i++) {
         const chunk = chunks[i];
         let data = "";
@@ -8,3 +8,53 @@ export const chunkString = (str: string, size: number) => {
 
   return chunks;
 };
+
+// Chunk size used until the device reports its MTU in CONFIG://
+export const DEFAULT_CHUNK_SIZE = 150;
+
+// Largest chunk that fits one write: MTU minus the 3-byte ATT header and the
+// longest text prefix ("X-PAYMENT:START")
+export const chunkSizeForMtu = (mtu: number) => Math.max(20, mtu - 3 - 15);
+
+// Reassembles replies the device splits into FRAG:<i>/<n>:<bytes> notifications.
+// Anything else passes straight through.
+export class FragmentAssembler {
+  private parts: Uint8Array[] = [];
+  private expected = 0;
+
+  // Returns the whole message, or null while fragments are still missing
+  push(bytes: Uint8Array): Uint8Array | null {
+    const header = /^FRAG:(\d+)\/(\d+):/.exec(
+      String.fromCharCode(...bytes.subarray(0, 24))
+    );
+    if (!header) return bytes;
+
+    const index = Number(header[1]);
+    const count = Number(header[2]);
+    if (index === 1) {
+      this.parts = [];
+      this.expected = count;
+    }
+    if (count !== this.expected || index !== this.parts.length + 1) {
+      // Lost a fragment - drop the message
+      this.parts = [];
+      this.expected = 0;
+      return null;
+    }
+
+    this.parts.push(bytes.subarray(header[0].length));
+    if (index < count) return null;
+
+    const message = new Uint8Array(
+      this.parts.reduce((total, part) => total + part.length, 0)
+    );
+    let offset = 0;
+    for (const part of this.parts) {
+      message.set(part, offset);
+      offset += part.length;
+    }
+    this.parts = [];
+    this.expected = 0;
+    return message;
+  }
+}